@@ -0,0 +1,105 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+#ifndef EUTELHITCACHEREADER_H
+#define EUTELHITCACHEREADER_H
+
+// personal includes ".h"
+#include "EUTelHitCache.h"
+
+// marlin includes ".h"
+#include "marlin/DataSourceProcessor.h"
+
+// system includes <>
+#include <string>
+
+namespace eutelescope
+{
+
+   //!  Reads a hit cache file
+   /*!  This data source reads back the hit cache written by
+    *   EUTelProcessorHitCacheWriter and creates for each cached event
+    *   an LCEvent with a TrackerHit collection. The file is memory
+    *   mapped, so starting from any event costs nothing and only the
+    *   columns actually used are read from the disk.
+    *
+    *   The hits have the same position, diagonal covariance, type
+    *   and cell ID (sensorID and properties) as the original ones; the
+    *   cluster charge is stored as deposited energy and the cluster
+    *   size in the EUTelCachedClusterSize runtime extension.
+    *
+    *   No cluster is attached to the hits, their raw hit vector is
+    *   empty. Processors needing the cluster pixels cannot run on
+    *   cache input: the hot pixel rejection of EUTelPreAlign and
+    *   EUTelMille, the cluster size histograms of EUTelDUTHistograms,
+    *   EUTelProcessorSpuriousClusterFinder and
+    *   EUTelProcessorTrueHitAnalysis skip these hits.
+    *
+    *   <h4>Input - Prerequisites</h4>
+    *   A hit cache file
+    *
+    *   <h4>Output</h4>
+    *   LCEvent with TrackerHit collection
+    *
+    *   @param HitCacheFileName name of the input file
+    *   @param HitCollectionName name of the output hit collection
+    *   @param FirstEvent index in the cache of the first event to read
+    *
+    */
+
+   class EUTelHitCacheReader:public marlin::DataSourceProcessor
+   {
+
+    public:
+
+      //! Default constructor
+      EUTelHitCacheReader ();
+
+      //! New processor
+      /*! Return a new instance of a EUTelHitCacheReader. It is
+       *  called by the Marlin execution framework and shouldn't be used
+       *  by the final user.
+       */
+      virtual EUTelHitCacheReader *newProcessor ();
+
+      //! Creates events from the hit cache
+      virtual void readDataSource (int numEvents);
+
+      //! Init method
+      /*! It is called at the beginning of the cycle and it prints out
+       *  the parameters.
+       */
+      virtual void init ();
+
+      //! End method
+      /*! It unmaps the cache file
+       */
+      virtual void end ();
+
+    protected:
+
+      //! Input file name
+      std::string _fileName;
+
+      //! Output hit collection name
+      std::string _hitCollectionName;
+
+      //! First event to read
+      int _firstEvent;
+
+      //! The mapped cache
+      EUTelHitCacheFileReader _cache;
+
+   };
+
+  //! A global instance of the processor
+  EUTelHitCacheReader gEUTelHitCacheReader;
+
+}                               // end namespace eutelescope
+#endif
@@ -20,6 +20,7 @@
 // system includes <>
 #include <string>
 #include <iostream>
+#include <vector>
 
 #define RUN_HEADER_RESERVED_W32    1040
 #define EVENT_HEADER_RESERVED_W32    19
@@ -40,7 +41,12 @@ namespace eutelescope {
    *   None
    *
    *   <h4>Output</h4>
-   *   LCEvent with TrackerRawData collection
+   *   LCEvent with TrackerRawData collection. The frame collections
+   *   are written only if SaveRawFrames is true. With ZeroSuppression
+   *   the CDS pixels above threshold are also written as
+   *   EUTelGenericSparsePixel into a TrackerData collection, and the
+   *   full CDS frames are then written only together with the raw
+   *   frames.
    *
    *   @param LEPSIRunNumber Integer number corresponding to the run
    *   number
@@ -55,6 +61,22 @@ namespace eutelescope {
    *
    *   @param CDSCollectionName Name of the CDS collection
    *
+   *   @param SaveRawFrames Write the frame0 and frame1 collections
+   *
+   *   @param ZeroSuppression Write the zero suppressed CDS collection
+   *
+   *   @param ZSDataCollectionName Name of the zero suppressed collection
+   *
+   *   @param ZSPedestal Pedestal subtracted from the CDS signal, one
+   *   value per detector or one for all
+   *
+   *   @param ZSThreshold Pixels with CDS signal minus pedestal above
+   *   this value are kept, one value per detector or one for all
+   *
+   *   @param CorrectCDSSign Negate the CDS of the pixels read before
+   *   the trigger, false by default to keep the output of the
+   *   previous versions
+   *
    *   @author  Antonio Bulgheroni, INFN <mailto:antonio.bulgheroni@gmail.com>
    *   @version $Id$
    *
@@ -414,6 +436,49 @@ namespace eutelescope {
 
     //! Static variable == 1 for the time being
     static int _noOfSubMatrix;
+
+    //! Write the frame0 and frame1 collections
+    bool _saveRawFrames;
+
+    //! Write the zero suppressed CDS collection
+    bool _zeroSuppression;
+
+    //! Name of the zero suppressed CDS collection
+    std::string _zsDataCollectionName;
+
+    //! Pedestal for the zero suppression, per detector
+    std::vector<float > _zsPedestal;
+
+    //! Threshold for the zero suppression, per detector
+    std::vector<float > _zsThreshold;
+
+    //! Negate the CDS of the pixels read before the trigger
+    bool _correctCDSSign;
+
+  private:
+
+    //! Decodes the frames of one detector and computes the CDS
+    /*! Each data word holds frame0 in bits 0-11 and frame1 in bits
+     *  12-23. The loop has no branches and no push_back. The pixels
+     *  read before the trigger have the opposite CDS sign and are
+     *  negated afterwards if CorrectCDSSign is set.
+     *
+     *  @param data First word of the detector in _dataBuffer
+     *  @param cds Output, matrixSize values
+     *  @param frame0 Output, matrixSize values, or 0 if not needed
+     *  @param frame1 Output, matrixSize values, or 0 if not needed
+     */
+    void decodeFrames(const int * data, short * cds, short * frame0, short * frame1) const;
+
+    //! Value of a per detector parameter
+    /*! Parameters with a single value apply to all the detectors.
+     */
+    static float perDetector(const std::vector<float > & values, int iDetector);
+
+    //! CDS, frame0 and frame1 of the current detector
+    std::vector<short > _cdsBuffer;
+    std::vector<short > _frame0Buffer;
+    std::vector<short > _frame1Buffer;
     
   };
 
@@ -18,6 +18,8 @@
 // lcio includes <.h>
 
 // system includes <>
+#include <string>
+#include <vector>
 
 
 namespace eutelescope
@@ -43,6 +45,12 @@ namespace eutelescope
     *   @param   SUCIMAImagerFileName  name of the input file
     *   @param   NoOfXPixel number of pixels along X
     *   @param   NoOfYPixel number of pixels along Y
+   *   @param   UseBinaryCache read the frames from a binary cache of
+   *   the input file, written when the input file is converted
+   *   completely for the first time. False by default, as the data
+   *   directory may be read-only or shared
+   *   @param   BinaryCacheFileName name of the binary cache, by default
+   *   the input file name followed by .cache
     *   @author  Antonio Bulgheroni, INFN <mailto:antonio.bulgheroni@gmail.com>
     *   @version $Id$
     *
@@ -77,7 +85,7 @@ namespace eutelescope
       virtual void init ();
 
       //! End method
-      /*! It deletes the EUTelSucimaImagerReader::_buffer array
+      /*! It prints a goodbye message
        */
       virtual void end ();
 
@@ -92,18 +100,31 @@ namespace eutelescope
       //! Number of pixels along Y
       int _noOfYPixel;
 
+      //! Use and write the binary frame cache
+      bool _useBinaryCache;
+
+      //! Binary frame cache file name
+      std::string _cacheFileName;
+
       //! The buffer to store data from file
       /*! This array of short is used to temporary store data from the
        *  disk before moving them to the TrackerRawData. This is a good
        *  attitude because, if something goes wrong with the data
        *  reading (most likely a I/O error, you still have the chance of
-       *  save the other data. This array is dynamically allocated in
-       *  the EUTelSucimaImagerReader::readDataSource(int) only when
-       *  processing the first event. It is deleted in the
-       *  EUTelSucimaImagerReader::end()
+       *  save the other data.
        */
-      short *_buffer;
+      std::vector<short > _buffer;
+
+    private:
+
+      //! Processes the run header
+      void processRunHeader(int runNumber);
+
+      //! Creates and processes the event of one frame
+      void processFrame(const short * frame, int runNumber, int eventNumber);
 
+      //! Processes the end of run event
+      void processEORE(int runNumber, int eventNumber);
    };
 
   //! A global instance of the processor
@@ -0,0 +1,150 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+// personal includes
+#include "EUTelHitCacheReader.h"
+#include "EUTELESCOPE.h"
+#include "EUTelRunHeaderImpl.h"
+#include "EUTelEventImpl.h"
+
+// marlin includes
+#include "marlin/Processor.h"
+#include "marlin/DataSourceProcessor.h"
+#include "marlin/ProcessorMgr.h"
+
+// lcio includes
+#include <IMPL/LCEventImpl.h>
+#include <IMPL/LCCollectionVec.h>
+#include <IMPL/TrackerHitImpl.h>
+#include <UTIL/CellIDEncoder.h>
+#include <UTIL/LCTime.h>
+
+// system includes
+#include <memory>
+#include <cstdlib>
+
+using namespace std;
+using namespace marlin;
+using namespace eutelescope;
+
+EUTelHitCacheReader::EUTelHitCacheReader ():DataSourceProcessor  ("EUTelHitCacheReader"),
+  _fileName(),
+  _hitCollectionName(),
+  _firstEvent(0),
+  _cache() {
+
+  _description =
+    "Reads a hit cache file written by EUTelProcessorHitCacheWriter and creates LCEvent with a TrackerHit collection.\n"
+    "Make sure to not specify any LCIOInputFiles in the steering in order to read hit cache files.";
+
+  registerProcessorParameter ("HitCacheFileName", "Input file",
+			      _fileName, std::string ("hits.cache"));
+  registerProcessorParameter ("HitCollectionName", "Name of the output hit collection",
+			      _hitCollectionName, std::string ("hit"));
+  registerOptionalParameter ("FirstEvent", "Index in the cache of the first event to read",
+			     _firstEvent, static_cast < int >(0));
+}
+
+EUTelHitCacheReader * EUTelHitCacheReader::newProcessor () {
+  return new EUTelHitCacheReader;
+}
+
+void EUTelHitCacheReader::init () {
+  printParameters ();
+}
+
+void EUTelHitCacheReader::readDataSource (int numEvents) {
+
+  if ( !_cache.open( _fileName ) ) {
+    message<ERROR5> ( log() << "Problem opening file " << _fileName << " or not a valid hit cache. Exiting." );
+    exit (-1);
+  }
+
+  message<MESSAGE5> ( log() << "Hit cache " << _fileName << " contains " << _cache.getNumberOfEvents()
+		      << " events and " << _cache.getNumberOfHits() << " hits" );
+
+  uint64_t const firstEvent = _firstEvent > 0 ? static_cast<uint64_t>( _firstEvent ) : 0;
+  uint64_t lastEvent = _cache.getNumberOfEvents();
+  if ( numEvents > 0 && firstEvent + numEvents < lastEvent ) lastEvent = firstEvent + numEvents;
+
+  int runNumber = -1;
+  int eventNumber = 0;
+
+  for ( uint64_t iEvent = firstEvent; iEvent < lastEvent; ++iEvent ) {
+
+    if ( _cache.getRunNumber( iEvent ) != runNumber ) {
+
+      // a new run header each time the run number changes
+      runNumber = _cache.getRunNumber( iEvent );
+      auto lcHeader = std::make_unique<IMPL::LCRunHeaderImpl>();
+      auto runHeader = std::make_unique<EUTelRunHeaderImpl>(lcHeader.get());
+      runHeader->addProcessor( type() );
+      runHeader->lcRunHeader()->setDescription(" Events read from hit cache file: " + _fileName);
+      runHeader->lcRunHeader()->setRunNumber (runNumber);
+      runHeader->setDateTime ();
+      runHeader->addIntermediateFile (_fileName);
+
+      ProcessorMgr::instance ()->processRunHeader ( static_cast<lcio::LCRunHeader*> ( lcHeader.release()) );
+      _isFirstEvent = false;
+    }
+
+    EUTelEventImpl *event = new EUTelEventImpl;
+    event->setEventType(kDE);
+    LCTime * now = new LCTime;
+    event->setTimeStamp(now->timeStamp());
+    delete now;
+    event->setRunNumber (runNumber);
+    eventNumber = _cache.getEventNumber( iEvent );
+    event->setEventNumber (eventNumber);
+
+    if (iEvent % 10000 == 0)  message<MESSAGE5> ( log() << "Reading event " << eventNumber );
+
+    LCCollectionVec *hitCollection = new LCCollectionVec (LCIO::TRACKERHIT);
+    CellIDEncoder < TrackerHitImpl > idHitEncoder (EUTELESCOPE::HITENCODING, hitCollection);
+
+    for ( uint64_t iHit = _cache.getHitBegin( iEvent ); iHit < _cache.getHitEnd( iEvent ); ++iHit ) {
+      TrackerHitImpl *hit = new TrackerHitImpl;
+      double const pos[3] = { _cache.getX()[iHit], _cache.getY()[iHit], _cache.getZ()[iHit] };
+      hit->setPosition( pos );
+      float cov[TRKHITNCOVMATRIX] = {0.,0.,0.,0.,0.,0.};
+      cov[0] = _cache.getCovXX()[iHit];
+      cov[2] = _cache.getCovYY()[iHit];
+      hit->setCovMatrix( cov );
+      hit->setType( _cache.getType()[iHit] );
+      hit->setEDep( _cache.getCharge()[iHit] );
+      hit->ext<EUTelCachedClusterSize>() = _cache.getClusterSize()[iHit];
+
+      idHitEncoder["sensorID"] = _cache.getSensorID()[iHit];
+      idHitEncoder["properties"] = _cache.getProperties()[iHit];
+      idHitEncoder.setCellID( hit );
+      hitCollection->push_back( hit );
+    }
+
+    event->addCollection (hitCollection, _hitCollectionName);
+    ProcessorMgr::instance ()->processEvent (static_cast<LCEventImpl*> (event));
+    delete event;
+  }
+
+  EUTelEventImpl *event = new EUTelEventImpl;
+  LCTime * now = new LCTime;
+  event->setTimeStamp(now->timeStamp());
+  delete now;
+  event->setRunNumber (runNumber);
+  event->setEventNumber (++eventNumber);
+  event->setEventType(kEORE);
+  ProcessorMgr::instance ()->processEvent (static_cast<LCEventImpl*> (event));
+  delete event;
+
+  _cache.close();
+}
+
+void EUTelHitCacheReader::end () {
+  _cache.close();
+  message<MESSAGE5> ("Successfully finished") ;
+}
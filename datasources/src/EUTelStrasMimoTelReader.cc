@@ -15,6 +15,8 @@
 #include "EUTelRunHeaderImpl.h"
 #include "EUTelEventImpl.h"
 #include "EUTELESCOPE.h"
+#include "EUTelGenericSparsePixel.h"
+#include "EUTelTrackerDataInterfacerImpl.h"
 
 // marlin includes
 #include "marlin/Processor.h"
@@ -26,6 +28,7 @@
 #include <IMPL/LCEventImpl.h>
 #include <IMPL/LCCollectionVec.h>
 #include <IMPL/TrackerRawDataImpl.h>
+#include <IMPL/TrackerDataImpl.h>
 #include <UTIL/CellIDEncoder.h>
 #include <UTIL/LCTime.h>
 // #include <UTIL/LCTOOLS.h>
@@ -72,6 +75,27 @@ EUTelStrasMimoTelReader::EUTelStrasMimoTelReader ():DataSourceProcessor  ("EUTel
   registerOutputCollection(LCIO::TRACKERRAWDATA, "CDSCollectionName",
 			   "Name of the CDS collection",
 			   _cdsCollectionName, string( "cds" ));
+
+  registerProcessorParameter("SaveRawFrames","Write the frame0 and frame1 collections",
+			     _saveRawFrames, true );
+
+  registerProcessorParameter("ZeroSuppression","Write the CDS pixels above threshold as zero suppressed data.\n"
+			     "The full CDS frames are then written only if SaveRawFrames is true",
+			     _zeroSuppression, false );
+
+  registerOutputCollection(LCIO::TRACKERDATA, "ZSDataCollectionName",
+			   "Name of the zero suppressed CDS collection",
+			   _zsDataCollectionName, string( "zsdata" ));
+
+  registerProcessorParameter("ZSPedestal","Pedestal subtracted from the CDS signal (one per detector or one for all)",
+			     _zsPedestal, FloatVec( 1, 0. ) );
+
+  registerProcessorParameter("ZSThreshold","Threshold on the CDS signal minus pedestal (one per detector or one for all)",
+			     _zsThreshold, FloatVec( 1, 20. ) );
+
+  registerOptionalParameter("CorrectCDSSign","Negate the CDS of the pixels read before the trigger.\n"
+			    "Older versions never applied this correction to the output, so it is off by default",
+			    _correctCDSSign, false );
   
 }
 
@@ -145,6 +169,9 @@ void EUTelStrasMimoTelReader::readDataSource (int numEvents) {
   int nFile = _runHeader.TotEvNb / _runHeader.FileEvNb;
   _dataBuffer   = new int[_runHeader.DataSz / sizeof(int) ];
   int matrixSize   = _noOfXPixel * _noOfYPixel;
+  _cdsBuffer.resize( matrixSize );
+  _frame0Buffer.resize( matrixSize );
+  _frame1Buffer.resize( matrixSize );
   
   for ( int iFile = 0; iFile < nFile; iFile++  ) {
     
@@ -197,82 +224,101 @@ void EUTelStrasMimoTelReader::readDataSource (int numEvents) {
 	  delete now;
 	  event->setEventType( kDE );
 	  
-	  LCCollectionVec * cdsColl    = new LCCollectionVec( LCIO::TRACKERRAWDATA );
-	  LCCollectionVec * frame0Coll = new LCCollectionVec( LCIO::TRACKERRAWDATA );
-	  LCCollectionVec * frame1Coll = new LCCollectionVec( LCIO::TRACKERRAWDATA );
-	  CellIDEncoder< TrackerRawDataImpl > idEncoderCDS( EUTELESCOPE::MATRIXDEFAULTENCODING, cdsColl );
-	  idEncoderCDS["xMin"] = 0;
-	  idEncoderCDS["xMax"] = _noOfXPixel - 1;
-	  idEncoderCDS["yMin"] = 0;
-	  idEncoderCDS["yMax"] = _noOfYPixel - 1;
-	  CellIDEncoder< TrackerRawDataImpl > idEncoderFrame0( EUTELESCOPE::MATRIXDEFAULTENCODING, frame0Coll );
-	  idEncoderFrame0["xMin"] = 0;
-	  idEncoderFrame0["xMax"] = _noOfXPixel - 1;
-	  idEncoderFrame0["yMin"] = 0;
-	  idEncoderFrame0["yMax"] = _noOfYPixel - 1;
-	  CellIDEncoder< TrackerRawDataImpl > idEncoderFrame1( EUTELESCOPE::MATRIXDEFAULTENCODING, frame1Coll );
-	  idEncoderFrame1["xMin"] = 0;
-	  idEncoderFrame1["xMax"] = _noOfXPixel - 1;
-	  idEncoderFrame1["yMin"] = 0;
-	  idEncoderFrame1["yMax"] = _noOfYPixel - 1;
+	  // the full CDS frames are always there without zero suppression
+	  bool saveCDS = _saveRawFrames || !_zeroSuppression;
+
+	  // the encoders write the encoding into the collection
+	  // parameters, so they are created only for the collections
+	  // actually written
+	  LCCollectionVec * cdsColl    = 0;
+	  LCCollectionVec * frame0Coll = 0;
+	  LCCollectionVec * frame1Coll = 0;
+	  LCCollectionVec * zsColl     = 0;
+	  std::unique_ptr< CellIDEncoder< TrackerRawDataImpl > > idEncoderCDS, idEncoderFrame0, idEncoderFrame1;
+	  std::unique_ptr< CellIDEncoder< TrackerDataImpl > > idEncoderZS;
+	  if ( saveCDS ) {
+	    cdsColl = new LCCollectionVec( LCIO::TRACKERRAWDATA );
+	    idEncoderCDS = std::make_unique< CellIDEncoder< TrackerRawDataImpl > >( EUTELESCOPE::MATRIXDEFAULTENCODING, cdsColl );
+	  }
+	  if ( _saveRawFrames ) {
+	    frame0Coll = new LCCollectionVec( LCIO::TRACKERRAWDATA );
+	    frame1Coll = new LCCollectionVec( LCIO::TRACKERRAWDATA );
+	    idEncoderFrame0 = std::make_unique< CellIDEncoder< TrackerRawDataImpl > >( EUTELESCOPE::MATRIXDEFAULTENCODING, frame0Coll );
+	    idEncoderFrame1 = std::make_unique< CellIDEncoder< TrackerRawDataImpl > >( EUTELESCOPE::MATRIXDEFAULTENCODING, frame1Coll );
+	  }
+	  if ( _zeroSuppression ) {
+	    zsColl = new LCCollectionVec( LCIO::TRACKERDATA );
+	    idEncoderZS = std::make_unique< CellIDEncoder< TrackerDataImpl > >( EUTELESCOPE::ZSDATADEFAULTENCODING, zsColl );
+	    (*idEncoderZS)["sparsePixelType"] = static_cast<int> ( kEUTelGenericSparsePixel );
+	  }
+	  CellIDEncoder< TrackerRawDataImpl > * frameEncoders[3] = { idEncoderCDS.get(), idEncoderFrame0.get(), idEncoderFrame1.get() };
+	  for ( int iEncoder = 0; iEncoder < 3; iEncoder++ ) {
+	    if ( !frameEncoders[iEncoder] ) continue;
+	    (*frameEncoders[iEncoder])["xMin"] = 0;
+	    (*frameEncoders[iEncoder])["xMax"] = _noOfXPixel - 1;
+	    (*frameEncoders[iEncoder])["yMin"] = 0;
+	    (*frameEncoders[iEncoder])["yMax"] = _noOfYPixel - 1;
+	  }
 	  
 	  // this is  because the first matrix contains only rubbish! 
 	  int offset = matrixSize ;
-	  unsigned int frame0Mask  = 0xFFF;
-	  unsigned int frame0Shift = 0;
-	  unsigned int frame1Mask  = 0xFFF000;
-	  unsigned int frame1Shift = 12;
 
 	  for ( int iDetector = 0; iDetector < _runHeader.VFasPresentNb + 1; iDetector++ ) {
-	    	    
-	    TrackerRawDataImpl * frame1 = new TrackerRawDataImpl;
-	    TrackerRawDataImpl * frame0 = new TrackerRawDataImpl;
-	    idEncoderFrame1["sensorID"] = iDetector;
-	    idEncoderFrame1.setCellID(frame1);
-	    idEncoderFrame0["sensorID"] = iDetector;
-	    idEncoderFrame0.setCellID(frame0);
-	    TrackerRawDataImpl * cds    = new TrackerRawDataImpl;
-	    idEncoderCDS["sensorID"] = iDetector;
-	    idEncoderCDS.setCellID(cds);
-	    
-	    int iPixel =  offset + iDetector * matrixSize;
-	    for ( int y = 0; y < _noOfYPixel; y++ ) {  
-	      for ( int x = 0; x < _noOfXPixel; x++ ) {
-		short f0 = static_cast<short>(( _dataBuffer[iPixel] & frame0Mask ) >> frame0Shift);
-		short f1 = static_cast<short>(( _dataBuffer[iPixel] & frame1Mask ) >> frame1Shift);
-		frame0->adcValues().push_back( f0 );
-		frame1->adcValues().push_back( f1 );
-		cds->adcValues().push_back( f1 - f0 );
-		++iPixel;
-	      }
+
+	    decodeFrames( _dataBuffer + offset + iDetector * matrixSize, &_cdsBuffer[0],
+			  _saveRawFrames ? &_frame0Buffer[0] : 0, _saveRawFrames ? &_frame1Buffer[0] : 0 );
+
+	    if ( _saveRawFrames ) {
+	      TrackerRawDataImpl * frame1 = new TrackerRawDataImpl;
+	      TrackerRawDataImpl * frame0 = new TrackerRawDataImpl;
+	      (*idEncoderFrame1)["sensorID"] = iDetector;
+	      idEncoderFrame1->setCellID(frame1);
+	      (*idEncoderFrame0)["sensorID"] = iDetector;
+	      idEncoderFrame0->setCellID(frame0);
+	      frame0->setADCValues( _frame0Buffer );
+	      frame1->setADCValues( _frame1Buffer );
+	      frame0Coll->push_back( frame0 ) ;
+	      frame1Coll->push_back( frame1 ) ;
 	    }
- 	    vector<short > cdsVec = cds->adcValues();
-	    vector<short >::iterator begin, end;
-
-	    //	    cout << iDetector << " before min = " << (*min_element(cdsVec.begin(), cdsVec.end())) 
-	    //		 << " max = " << (*max_element(cdsVec.begin(), cdsVec.end())) << endl;
-
- 	    // correct for the CDS sign
-	    if ( _eventHeader.VFasCnt < matrixSize ) {
-	      begin = cdsVec.begin() + _eventHeader.VFasCnt ;
-	      end   = cdsVec.end();
-	    } else { 
-	      begin = cdsVec.begin();
-	      end   = cdsVec.begin() + _eventHeader.VFasCnt %  matrixSize;
+
+	    if ( saveCDS ) {
+	      TrackerRawDataImpl * cds    = new TrackerRawDataImpl;
+	      (*idEncoderCDS)["sensorID"] = iDetector;
+	      idEncoderCDS->setCellID(cds);
+	      cds->setADCValues( _cdsBuffer );
+	      cdsColl->push_back( cds );
 	    }
-	    transform( begin, end, begin, negate<int>() );
-	    // 	    cout << iDetector << " after min = " << (*min_element(cdsVec.begin(), cdsVec.end())) 
-	    //		 << " max = " << (*max_element(cdsVec.begin(), cdsVec.end())) << endl;
 
-	    frame0Coll->push_back( frame0 ) ;
-	    frame1Coll->push_back( frame1 ) ;
-	    cdsColl->push_back( cds );
+	    if ( _zeroSuppression ) {
+	      TrackerDataImpl * zsData = new TrackerDataImpl;
+	      (*idEncoderZS)["sensorID"] = iDetector;
+	      idEncoderZS->setCellID(zsData);
+
+	      const float pedestal  = perDetector( _zsPedestal,  iDetector );
+	      const float threshold = perDetector( _zsThreshold, iDetector );
+	      const short * cdsValue = &_cdsBuffer[0];
+
+	      EUTelTrackerDataInterfacerImpl<EUTelGenericSparsePixel> sparseData( zsData );
+	      int iPixel = 0;
+	      for ( int y = 0; y < _noOfYPixel; y++ ) {
+		for ( int x = 0; x < _noOfXPixel; x++, iPixel++ ) {
+		  float signal = cdsValue[iPixel] - pedestal;
+		  if ( signal > threshold ) {
+		    sparseData.emplace_back( x, y, signal, 0 );
+		  }
+		}
+	      }
+	      zsColl->push_back( zsData );
+	    }
 	      
 	  }
 	  
-	  event->addCollection( frame0Coll, _frame0CollectionName );
-	  event->addCollection( frame1Coll, _frame1CollectionName );
-	  event->addCollection( cdsColl,    _cdsCollectionName    );
+	  if ( _saveRawFrames ) {
+	    event->addCollection( frame0Coll, _frame0CollectionName );
+	    event->addCollection( frame1Coll, _frame1CollectionName );
+	  }
+	  if ( saveCDS )          event->addCollection( cdsColl,    _cdsCollectionName    );
+	  if ( _zeroSuppression ) event->addCollection( zsColl,     _zsDataCollectionName );
 	  
 	  ProcessorMgr::instance()->processEvent( event ) ;
 	  delete event;
@@ -303,6 +349,50 @@ void EUTelStrasMimoTelReader::readDataSource (int numEvents) {
    
 }
 
+void EUTelStrasMimoTelReader::decodeFrames(const int * data, short * cds, short * frame0, short * frame1) const {
+
+  const int matrixSize = _noOfXPixel * _noOfYPixel;
+  const unsigned int frame0Mask  = 0xFFF;
+  const unsigned int frame0Shift = 0;
+  const unsigned int frame1Mask  = 0xFFF000;
+  const unsigned int frame1Shift = 12;
+
+  if ( frame0 && frame1 ) {
+    for ( int iPixel = 0; iPixel < matrixSize; iPixel++ ) {
+      const unsigned int word = static_cast<unsigned int>( data[iPixel] );
+      const short f0 = static_cast<short>(( word & frame0Mask ) >> frame0Shift);
+      const short f1 = static_cast<short>(( word & frame1Mask ) >> frame1Shift);
+      frame0[iPixel] = f0;
+      frame1[iPixel] = f1;
+      cds[iPixel]    = f1 - f0;
+    }
+  } else {
+    for ( int iPixel = 0; iPixel < matrixSize; iPixel++ ) {
+      const unsigned int word = static_cast<unsigned int>( data[iPixel] );
+      cds[iPixel] = static_cast<short>(( word & frame1Mask ) >> frame1Shift) - static_cast<short>(( word & frame0Mask ) >> frame0Shift);
+    }
+  }
+
+  if ( !_correctCDSSign ) return;
+
+  // correct for the CDS sign
+  int begin, end;
+  if ( _eventHeader.VFasCnt < matrixSize ) {
+    begin = _eventHeader.VFasCnt;
+    end   = matrixSize;
+  } else {
+    begin = 0;
+    end   = _eventHeader.VFasCnt % matrixSize;
+  }
+  for ( int iPixel = begin; iPixel < end; iPixel++ ) cds[iPixel] = -cds[iPixel];
+}
+
+float EUTelStrasMimoTelReader::perDetector(const vector<float > & values, int iDetector) {
+  if ( values.empty() ) return 0.;
+  if ( iDetector < static_cast<int>( values.size() ) ) return values[iDetector];
+  return values.back();
+}
+
 void EUTelStrasMimoTelReader::addEORE() {
   
   EUTelEventImpl * event = new EUTelEventImpl;
@@ -14,6 +14,7 @@
 #include "EUTELESCOPE.h"
 #include "EUTelRunHeaderImpl.h"
 #include "EUTelEventImpl.h"
+#include "EUTelFrameCache.h"
 
 // marlin includes
 #include "marlin/Processor.h"
@@ -29,7 +30,6 @@
 // #include <UTIL/LCTOOLS.h>
 
 // system includes 
-#include <fstream>
 #include <memory>
 #include <cstdlib>
 
@@ -49,6 +49,11 @@ EUTelSucimaImagerReader::EUTelSucimaImagerReader ():DataSourceProcessor  ("EUTel
 			      _noOfXPixel, static_cast < int >(512));
   registerProcessorParameter ("NoOfYPixel", "Number of pixels along Y",
 			      _noOfYPixel, static_cast < int >(512));
+  registerProcessorParameter ("UseBinaryCache", "Read the frames from a binary cache of the input file, written on the first full conversion.\n"
+			      "Off by default, since the cache is written next to the input file unless BinaryCacheFileName is set",
+			      _useBinaryCache, false);
+  registerOptionalParameter ("BinaryCacheFileName", "Binary cache file name, by default the input file name followed by .cache",
+			     _cacheFileName, std::string (""));
   
 }
 
@@ -63,147 +68,176 @@ void EUTelSucimaImagerReader::init () {
 
 void EUTelSucimaImagerReader::readDataSource (int numEvents) {
 
-  ifstream inputFile;
-  inputFile.exceptions (ifstream::failbit | ifstream::badbit);
+  const int runNumber = 0;
+  int eventNumber = 0;
+  const size_t frameSize = static_cast<size_t> (_noOfXPixel) * _noOfYPixel;
+  const string cacheFileName = _cacheFileName.empty() ? _fileName + ".cache" : _cacheFileName;
+
+  // a valid cache is used instead of parsing the ASCII file
+  if (_useBinaryCache) {
+    EUTelFrameCacheReader cache;
+    if (cache.open (cacheFileName, _fileName, _noOfXPixel, _noOfYPixel)) {
+      message<MESSAGE5> ( log() << "Reading " << cache.getNumberOfFrames() << " frames from the binary cache " << cacheFileName );
+      processRunHeader (runNumber);
+      for (uint64_t iFrame = 0; iFrame < cache.getNumberOfFrames(); iFrame++) {
+	if (numEvents > 0 && eventNumber + 1 > numEvents) break;
+	processFrame (cache.getFrame(iFrame), runNumber, eventNumber++);
+      }
+      processEORE (runNumber, eventNumber++);
+      return;
+    }
+  }
+
+  EUTelAsciiNumberScanner inputFile;
   
   // try to open the input file....
-  try {
-    inputFile.open (_fileName.c_str (), ios::in);
-  } catch (exception & e) {
+  if (!inputFile.open (_fileName)) {
     message<ERROR5> ( log() << "Problem opening file " << _fileName << ". Exiting." );
     exit (-1);
   }
-  
-  int eventNumber = 0;
-  int runNumber = 0;
-  
-  
+
+  // the cache is written while converting and kept only if the
+  // whole input file has been read
+  EUTelFrameCacheWriter cacheWriter;
+  if (_useBinaryCache && !cacheWriter.open (cacheFileName, _fileName, _noOfXPixel, _noOfYPixel)) {
+    message<WARNING> ( log() << "Unable to create the binary cache " << cacheFileName << ". Continuing without." );
+  }
+
+  processRunHeader (runNumber);
+  _buffer.resize (frameSize);
+
+  bool complete = false;
   while (true)  {
     
     if (numEvents > 0 && eventNumber + 1 > numEvents) {
       break;
     }
     
-    EUTelEventImpl *event = new EUTelEventImpl;
-    event->setDetectorName("MIMOSA");
-    event->setEventType(kDE);
-    LCTime * now = new LCTime;
-    event->setTimeStamp(now->timeStamp());
-    delete now;
-
-    LCCollectionVec *rawData = new LCCollectionVec (LCIO::TRACKERRAWDATA);
-    
-    if (eventNumber % 10 == 0)  message<MESSAGE5> ( log() << "Converting event " << eventNumber );
-
-    
-    if (isFirstEvent ()) {
-      
-      // in the case it is the first run so we need to process and
-      // write out the run header.
-      auto lcHeader = std::make_unique<IMPL::LCRunHeaderImpl>();
-      auto runHeader = std::make_unique<EUTelRunHeaderImpl>(lcHeader.get());
-      runHeader->addProcessor( type() );
-      runHeader->lcRunHeader()->setDescription(" Events read from SUCIMA Imager ASCII input file: " + _fileName);
-      runHeader->lcRunHeader()->setRunNumber (runNumber);
-      runHeader->setHeaderVersion (0.0001);
-      runHeader->setDataType (EUTELESCOPE::CONVDATA);
-      runHeader->setDateTime ();
-      runHeader->setDAQHWName (EUTELESCOPE::SUCIMAIMAGER);
-      runHeader->setDAQHWVersion (0.0001);
-      runHeader->setDAQSWName (EUTELESCOPE::SUCIMAIMAGER);
-      runHeader->setDAQSWVersion (0.0001);
-      runHeader->addIntermediateFile (_fileName);
-      runHeader->addProcessor (_processorName);
-      // this is a mistake here only for testing....
-      runHeader->setNoOfEvent(100);
-      //////////////////////////////////////////////
-      runHeader->setNoOfDetector(1);
-      runHeader->setMinX(IntVec(1, 0));
-      runHeader->setMaxX(IntVec(1, _noOfXPixel - 1));
-      runHeader->setMinY(IntVec(1, 0));
-      runHeader->setMaxY(IntVec(1, _noOfYPixel - 1));
-      runHeader->lcRunHeader()->setDetectorName("MIMOSA");
-      // UTIL::LCTOOLS::dumpRunHeader(runHeader);
-      
-      // process the run header
-      ProcessorMgr::instance ()->processRunHeader ( static_cast<lcio::LCRunHeader*> ( lcHeader.release()) );
-      
-      // prepare the short buffet
-      _buffer = new short[_noOfXPixel * _noOfYPixel];
-      
-      // end of first event
-      _isFirstEvent = false;
-    }
-    
-    int nVal = 0;
-    int xPixel, yPixel;
-    try  {
-      for (yPixel = 0; yPixel < _noOfYPixel; yPixel++) {
-	for (xPixel = 0; xPixel < _noOfXPixel; xPixel++) {
-	  inputFile >> _buffer[nVal++];
-	}
-      }
-    } catch (exception & e) {
-      if (!inputFile.eof ())
-	cerr << "A read exception occurred : " << e.what () << endl;
-      if ((xPixel == 0) && (yPixel == 0)) {
-	// that's normal
-	// we are reading the last empty line.
-	// break here
+    size_t nVal = 0;
+    EUTelAsciiNumberScanner::Status status = inputFile.next (&_buffer[0], frameSize, nVal);
+    if (status == EUTelAsciiNumberScanner::kEnd) {
+      // that's normal
+      // we are reading the last empty line.
+      // break here
+      complete = true;
+      break;
+    } else if (status == EUTelAsciiNumberScanner::kError) {
+      if (nVal == 0) {
+	// not a number where a new frame should start
+	message<ERROR5> ( log() << "Unable to read a pixel value after event " << eventNumber - 1 << ". Stopping here." );
 	break;
-      } else {
-	// that's strange. it might be that the last event was not complete
-	// break here
-	message<ERROR5> ( log() << "Event " << eventNumber << " finished un-expectedly. " );
-	message<ERROR5> ( log() << "Consider to check the input file, or limit the conversion to " 	    
-			 << eventNumber - 1 << " events" << endl << "Sorry to quit!" ) ;
-	exit(-1);
       }
+      // that's strange. it might be that the last event was not complete
+      // break here
+      message<ERROR5> ( log() << "Event " << eventNumber << " finished un-expectedly. " );
+      message<ERROR5> ( log() << "Consider to check the input file, or limit the conversion to " 	    
+			<< eventNumber - 1 << " events" << endl << "Sorry to quit!" ) ;
+      exit(-1);
     }
-    
-    event->setRunNumber (runNumber);
-    event->setEventNumber (eventNumber++);
-    
-    // prepare a collection to store the raw-data
-    
-    TrackerRawDataImpl *rawMatrix = new TrackerRawDataImpl;
-    CellIDEncoder < TrackerRawDataImpl > idEncoder (EUTELESCOPE::MATRIXDEFAULTENCODING, rawData);
-    idEncoder["sensorID"] = 0;
-    idEncoder["xMin"] = 0;
-    idEncoder["xMax"] = _noOfXPixel - 1;
-    idEncoder["yMin"] = 0;
-    idEncoder["yMax"] = _noOfYPixel - 1;
-    idEncoder.setCellID (rawMatrix);
-    
-    nVal = 0;
-    for (int yPixel = 0; yPixel < _noOfYPixel; yPixel++) {
-      for (int xPixel = 0; xPixel < _noOfXPixel; xPixel++) {
-	rawMatrix->adcValues ().push_back (_buffer[nVal++]);
-      }
+
+    if (cacheWriter.isOpen () && !cacheWriter.addFrame (&_buffer[0])) {
+      message<WARNING> ( log() << "Unable to write the binary cache " << cacheFileName << ". Continuing without." );
     }
-    rawData->push_back (rawMatrix);
     
-    event->addCollection (rawData, "rawdata");
-    ProcessorMgr::instance ()->processEvent (static_cast<LCEventImpl*> (event));
-    delete event;
+    processFrame (&_buffer[0], runNumber, eventNumber++);
   }
 
+  if (cacheWriter.isOpen ()) {
+    if (!complete) {
+      cacheWriter.discard ();
+    } else if (cacheWriter.close ()) {
+      message<MESSAGE5> ( log() << "Frames written to the binary cache " << cacheFileName );
+    } else {
+      message<WARNING> ( log() << "Unable to write the binary cache " << cacheFileName );
+    }
+  }
+
+  processEORE (runNumber, eventNumber++);
+  
+}
+
+void EUTelSucimaImagerReader::processRunHeader (int runNumber) {
+
+  auto lcHeader = std::make_unique<IMPL::LCRunHeaderImpl>();
+  auto runHeader = std::make_unique<EUTelRunHeaderImpl>(lcHeader.get());
+  runHeader->addProcessor( type() );
+  runHeader->lcRunHeader()->setDescription(" Events read from SUCIMA Imager ASCII input file: " + _fileName);
+  runHeader->lcRunHeader()->setRunNumber (runNumber);
+  runHeader->setHeaderVersion (0.0001);
+  runHeader->setDataType (EUTELESCOPE::CONVDATA);
+  runHeader->setDateTime ();
+  runHeader->setDAQHWName (EUTELESCOPE::SUCIMAIMAGER);
+  runHeader->setDAQHWVersion (0.0001);
+  runHeader->setDAQSWName (EUTELESCOPE::SUCIMAIMAGER);
+  runHeader->setDAQSWVersion (0.0001);
+  runHeader->addIntermediateFile (_fileName);
+  runHeader->addProcessor (_processorName);
+  // this is a mistake here only for testing....
+  runHeader->setNoOfEvent(100);
+  //////////////////////////////////////////////
+  runHeader->setNoOfDetector(1);
+  runHeader->setMinX(IntVec(1, 0));
+  runHeader->setMaxX(IntVec(1, _noOfXPixel - 1));
+  runHeader->setMinY(IntVec(1, 0));
+  runHeader->setMaxY(IntVec(1, _noOfYPixel - 1));
+  runHeader->lcRunHeader()->setDetectorName("MIMOSA");
+  // UTIL::LCTOOLS::dumpRunHeader(runHeader);
+  
+  // process the run header
+  ProcessorMgr::instance ()->processRunHeader ( static_cast<lcio::LCRunHeader*> ( lcHeader.release()) );
+  
+  // end of first event
+  _isFirstEvent = false;
+}
+
+void EUTelSucimaImagerReader::processFrame (const short * frame, int runNumber, int eventNumber) {
+
+  if (eventNumber % 10 == 0)  message<MESSAGE5> ( log() << "Converting event " << eventNumber );
+
+  EUTelEventImpl *event = new EUTelEventImpl;
+  event->setDetectorName("MIMOSA");
+  event->setEventType(kDE);
+  LCTime * now = new LCTime;
+  event->setTimeStamp(now->timeStamp());
+  delete now;
+  event->setRunNumber (runNumber);
+  event->setEventNumber (eventNumber);
+  
+  // prepare a collection to store the raw-data
+  LCCollectionVec *rawData = new LCCollectionVec (LCIO::TRACKERRAWDATA);
+  TrackerRawDataImpl *rawMatrix = new TrackerRawDataImpl;
+  CellIDEncoder < TrackerRawDataImpl > idEncoder (EUTELESCOPE::MATRIXDEFAULTENCODING, rawData);
+  idEncoder["sensorID"] = 0;
+  idEncoder["xMin"] = 0;
+  idEncoder["xMax"] = _noOfXPixel - 1;
+  idEncoder["yMin"] = 0;
+  idEncoder["yMax"] = _noOfYPixel - 1;
+  idEncoder.setCellID (rawMatrix);
+  
+  rawMatrix->adcValues ().assign (frame, frame + static_cast<size_t> (_noOfXPixel) * _noOfYPixel);
+  rawData->push_back (rawMatrix);
+  
+  event->addCollection (rawData, "rawdata");
+  ProcessorMgr::instance ()->processEvent (static_cast<LCEventImpl*> (event));
+  delete event;
+}
+
+void EUTelSucimaImagerReader::processEORE (int runNumber, int eventNumber) {
+
   EUTelEventImpl *event = new EUTelEventImpl;
   event->setDetectorName("MIMOSA");
   LCTime * now = new LCTime;
   event->setTimeStamp(now->timeStamp());
   delete now;
   event->setRunNumber (runNumber);
-  event->setEventNumber (eventNumber++);
+  event->setEventNumber (eventNumber);
   event->setEventType(kEORE);
   ProcessorMgr::instance ()->processEvent (static_cast<LCEventImpl*> (event));
   delete event;
-  
 }
 
 
 
 void EUTelSucimaImagerReader::end () {
-  delete[]_buffer;
   message<MESSAGE5> ("Successfully finished") ;
 }
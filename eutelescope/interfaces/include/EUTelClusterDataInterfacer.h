@@ -60,6 +60,11 @@ class EUTelClusterDataInterfacer: public EUTelClusterDataInterfacerBase
 	//! The interfacer to the raw data
 	EUTelTrackerDataInterfacerImpl<PixelType> _rawDataInterfacer;
 
+	//! Points the raw data interfacer to another TrackerDataImpl
+	void rebindRawData(IMPL::TrackerDataImpl* data) {
+		_rawDataInterfacer.rebind(data);
+	}
+
   public:
 	template <typename ...Params>
 	void push_back(Params&&... params) {
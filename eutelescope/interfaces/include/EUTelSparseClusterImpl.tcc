@@ -30,6 +30,14 @@ namespace eutelescope {
     _noiseValues.clear();
   }
 
+  template<class PixelType>
+  void EUTelSparseClusterImpl<PixelType>::reset(IMPL::TrackerDataImpl* data) {
+    _trackerData = data;
+    this->rebindRawData(data);
+    _noiseValues.clear();
+    _noiseSetSwitch = false;
+  }
+
   template<class PixelType>
   void EUTelSparseClusterImpl<PixelType>::setNoiseValues(std::vector<float > noiseValues) {
     if ( noiseValues.size() != this->size() ) {
@@ -346,10 +354,14 @@ namespace eutelescope {
     std::vector<float >::iterator iter;
     
     for (size_t i = 0; i < nPixels.size(); i++ ) {
+      // as for a single N, the whole cluster if N is not smaller than its size
+      if ( static_cast< size_t >(nPixels[i]) >= allSignals.size() ) {
+        clusterSignal.push_back( getTotalCharge() );
+        continue;
+      }
       iter = allSignals.begin();
       float charge = 0;
-      while ( iter != allSignals.begin() + nPixels[i]
-            && iter != allSignals.end() ) {//add or for allsignals.end
+      while ( iter != allSignals.begin() + nPixels[i] ) {
 	charge += (*iter);
 	++iter;
       }
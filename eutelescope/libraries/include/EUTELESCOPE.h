@@ -486,13 +486,18 @@ namespace eutelescope
    *
    *  \li <b>kFittedHit</b>: if set, the hit comes from a fitted track
    *
+   *  \li <b>kEtaCorrectedHit</b>: if set, the hit position uses the
+   *  eta corrected CoG shift attached by EUTelCalculateEtaProcessor
+   *  in single pass mode
+   *
    *  There are "not assigned" bits that can be used in the
    *  future to mark other different kind of hit flags.
    */
   enum HitProperties {
     kHitInGlobalCoord  = 1L << 0,
     kFittedHit         = 1L << 1,
-    kSimulatedHit      = 1L << 2
+    kSimulatedHit      = 1L << 2,
+    kEtaCorrectedHit   = 1L << 3
   };
 
 
@@ -0,0 +1,52 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+#ifndef EUTELBITSCAN_H
+#define EUTELBITSCAN_H 1
+
+// system includes <>
+#include <cstdint>
+
+namespace eutelescope {
+
+  namespace Utility {
+
+    //! Index of the lowest set bit of a non zero word
+    /*! Uses the compiler builtin where available, a plain loop
+     *  otherwise.
+     */
+    inline int lowestSetBit(std::uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+      return __builtin_ctzll( word );
+#else
+      int bit = 0;
+      while ( ( word & 1 ) == 0 ) {
+        word >>= 1;
+        ++bit;
+      }
+      return bit;
+#endif
+    }
+
+    //! Calls @c visit with the index of each set bit of a word, lowest first
+    /*! Used by the seed finders to go through a candidate mask without
+     *  testing every bit.
+     */
+    template<typename Visitor>
+    inline void forEachSetBit(std::uint64_t word, Visitor visit) {
+      while ( word != 0 ) {
+        visit( lowestSetBit( word ) );
+        word &= word - 1;
+      }
+    }
+
+  }
+
+}
+#endif
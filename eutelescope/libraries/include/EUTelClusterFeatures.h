@@ -0,0 +1,161 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+#ifndef EUTELCLUSTERFEATURES_H
+#define EUTELCLUSTERFEATURES_H 1
+
+// eutelescope includes ".h"
+#include "EUTELESCOPE.h"
+
+// lcio includes <.h>
+#include <EVENT/LCObject.h>
+#include <LCRTRelations.h>
+
+// system includes <>
+#include <vector>
+
+namespace eutelescope {
+
+  class EUTelVirtualCluster;
+
+  //! Quantities to be computed for a cluster
+  /*! The charge and SNR over the N highest pixels and over the N x N
+   *  pixels around the center are computed only for the sizes listed
+   *  here.
+   */
+  struct EUTelClusterFeatureRequest {
+
+    //! Default constructor, only the basic quantities
+    EUTelClusterFeatureRequest() :
+      nCharge(), nxnCharge(), nSNR(), nxnSNR(), centerOfGravity(false), noise(false) { }
+
+    std::vector<int > nCharge;
+    std::vector<int > nxnCharge;
+    std::vector<int > nSNR;
+    std::vector<int > nxnSNR;
+
+    //! Compute the center of gravity
+    bool centerOfGravity;
+
+    //! Compute the noise related quantities, the noise values must
+    //! have been set to the cluster
+    bool noise;
+  };
+
+  //! Cluster quantities computed once
+  /*! Cluster selections and histograms ask a cluster several times for
+   *  its charges and SNRs, and several of the EUTelVirtualCluster
+   *  methods copy and sort the pixel charges each time. This record
+   *  is filled once per cluster, with the charges over the N highest
+   *  pixels taken from a single sort, and is then read by all the
+   *  consumers.
+   *
+   *  The record can be attached to the TrackerPulse of the cluster,
+   *  so that processors later in the chain find it without
+   *  recomputing:
+   *  @code
+   *  EUTelClusterFeatures::attach( pulse, features );
+   *  ...
+   *  const EUTelClusterFeatures * features = EUTelClusterFeatures::get( pulse );
+   *  if ( features && features->covers( request ) ) charge = features->getNCharge( 3 );
+   *  @endcode
+   *  The record is owned and deleted by the pulse. Noise related
+   *  quantities depend on the noise values set by the producer.
+   */
+  class EUTelClusterFeatures {
+
+  public:
+
+    //! Default constructor, an empty record
+    EUTelClusterFeatures();
+
+    //! Fills the record from a cluster
+    void compute(const EUTelVirtualCluster & cluster, const EUTelClusterFeatureRequest & request);
+
+    //! Are all the requested quantities available?
+    bool covers(const EUTelClusterFeatureRequest & request) const;
+
+    //! @name Basic quantities, always available
+    //@{
+    inline int getDetectorID() const { return _detectorID; }
+    inline float getTotalCharge() const { return _totalCharge; }
+    inline float getSeedCharge() const { return _seedCharge; }
+    inline ClusterQuality getClusterQuality() const { return _quality; }
+    //@}
+
+    //! Center of gravity, if requested
+    inline void getCenterOfGravity(float & x, float & y) const { x = _xCoG; y = _yCoG; }
+
+    //! Are the noise related quantities available?
+    inline bool hasNoise() const { return _hasNoise; }
+
+    //! @name Noise related quantities, if requested
+    //@{
+    inline float getClusterNoise() const { return _clusterNoise; }
+    inline float getClusterSNR() const { return _clusterSNR; }
+    inline float getSeedSNR() const { return _seedSNR; }
+    //@}
+
+    //! @name Quantities over a number of pixels
+    /*! Only valid for the sizes of the request, 0 otherwise.
+     */
+    //@{
+    inline float getNCharge(int nPixel) const { return lookUp( _nChargeSize, _nCharge, nPixel ); }
+    inline float getNxNCharge(int nxnPixel) const { return lookUp( _nxnChargeSize, _nxnCharge, nxnPixel ); }
+    inline float getNSNR(int nPixel) const { return lookUp( _nSNRSize, _nSNR, nPixel ); }
+    inline float getNxNSNR(int nxnPixel) const { return lookUp( _nxnSNRSize, _nxnSNR, nxnPixel ); }
+    //@}
+
+    //! Attaches a record to a pulse, which takes the ownership
+    /*! A record already attached is deleted.
+     */
+    static void attach(EVENT::LCObject * pulse, EUTelClusterFeatures * features);
+
+    //! Record attached to a pulse
+    /*! @return 0 if there is none
+     */
+    static const EUTelClusterFeatures * get(EVENT::LCObject * pulse);
+
+  private:
+
+    //! Value for a size, 0 if the size was not computed
+    static float lookUp(const std::vector<int > & sizes, const std::vector<float > & values, int size);
+
+    //! Are all the sizes in the list?
+    static bool contains(const std::vector<int > & sizes, const std::vector<int > & requested);
+
+    int _detectorID;
+    float _totalCharge;
+    float _seedCharge;
+    ClusterQuality _quality;
+
+    bool _hasCoG;
+    float _xCoG;
+    float _yCoG;
+
+    bool _hasNoise;
+    float _clusterNoise;
+    float _clusterSNR;
+    float _seedSNR;
+
+    std::vector<int > _nChargeSize;
+    std::vector<float > _nCharge;
+    std::vector<int > _nxnChargeSize;
+    std::vector<float > _nxnCharge;
+    std::vector<int > _nSNRSize;
+    std::vector<float > _nSNR;
+    std::vector<int > _nxnSNRSize;
+    std::vector<float > _nxnSNR;
+  };
+
+  //! LCIO runtime extension holding the EUTelClusterFeatures of a pulse
+  struct EUTelClusterFeaturesExtension : lcrtrel::LCOwnedExtension<EUTelClusterFeaturesExtension, EUTelClusterFeatures> { };
+
+}
+#endif
@@ -15,6 +15,7 @@
 // lcio includes <.h>
 #include <lcio.h>
 #include <IMPL/LCGenericObjectImpl.h>
+#include <LCRTRelations.h>
 
 // system includes <>
 #include <string>
@@ -181,6 +182,20 @@ namespace eutelescope {
 
   };
 
+  //! Eta corrected CoG shift of a cluster
+  /*! Shift from the seed pixel center along x and y, in pitch units,
+   *  after the eta correction. EUTelCalculateEtaProcessor attaches
+   *  it to the TrackerPulse of the clusters when the eta functions
+   *  are applied in the same job.
+   */
+  struct EUTelEtaCorrectedShift {
+    float x;
+    float y;
+  };
+
+  //! LCIO runtime extension holding the EUTelEtaCorrectedShift of a pulse
+  struct EUTelEtaCorrectedShiftExtension : lcrtrel::LCOwnedExtension<EUTelEtaCorrectedShiftExtension, EUTelEtaCorrectedShift> { };
+
 }
 
 #endif
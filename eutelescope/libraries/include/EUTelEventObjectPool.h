@@ -0,0 +1,93 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+#ifndef EUTELEVENTOBJECTPOOL_H
+#define EUTELEVENTOBJECTPOOL_H 1
+
+// system includes <>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace eutelescope {
+
+  //! Pool of objects living for one event
+  /*! Processors decoding many clusters per event used to create and
+   *  delete one interfacer object for each of them. With this pool
+   *  the objects are handed out during the event and given back all
+   *  together by recycle(), usually at the beginning of the next
+   *  event. Recycled objects are reused with all the memory they
+   *  have allocated, so after the first events no more allocations
+   *  are needed.
+   *
+   *  An object is created with the arguments passed to acquire() and,
+   *  when recycled, it is given the same arguments through a reset()
+   *  method which must put it in the same state as a newly
+   *  constructed object:
+   *  @code
+   *  EUTelEventObjectPool<EUTelSparseClusterImpl<EUTelGenericSparsePixel> > pool;
+   *  ...
+   *  pool.recycle();
+   *  for ( ... ) {
+   *    EUTelSparseClusterImpl<EUTelGenericSparsePixel> * cluster = pool.acquire( trackerData );
+   *    ...
+   *  }
+   *  @endcode
+   *
+   *  The objects are owned by the pool: this is meant for the
+   *  processor own work objects, not for the LCIO objects added to
+   *  the event, which are deleted together with their collection.
+   */
+  template<class T>
+  class EUTelEventObjectPool {
+
+  public:
+
+    //! Default constructor, an empty pool
+    EUTelEventObjectPool() : _objects(), _nUsed(0) { }
+
+    EUTelEventObjectPool(const EUTelEventObjectPool &) = delete;
+    EUTelEventObjectPool & operator=(const EUTelEventObjectPool &) = delete;
+
+    //! Hands out an object
+    /*! A free object is reset with @c args, if there is none a new one
+     *  is constructed. The object stays valid until recycle() is
+     *  called.
+     */
+    template<typename ...Args>
+    T * acquire(Args&&... args) {
+      if ( _nUsed < _objects.size() ) {
+        _objects[ _nUsed ]->reset( std::forward<Args>(args)... );
+      } else {
+        _objects.push_back( std::unique_ptr<T>( new T( std::forward<Args>(args)... ) ) );
+      }
+      return _objects[ _nUsed++ ].get();
+    }
+
+    //! Gives back all the objects handed out
+    inline void recycle() { _nUsed = 0; }
+
+    //! Number of objects currently handed out
+    inline std::size_t getNumberOfUsed() const { return _nUsed; }
+
+    //! Number of objects owned by the pool
+    inline std::size_t getNumberOfObjects() const { return _objects.size(); }
+
+  private:
+
+    //! All the objects, the first _nUsed are handed out
+    std::vector<std::unique_ptr<T> > _objects;
+
+    //! Number of objects handed out since the last recycle()
+    std::size_t _nUsed;
+  };
+
+}
+#endif
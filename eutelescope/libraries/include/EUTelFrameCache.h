@@ -0,0 +1,219 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+#ifndef EUTELFRAMECACHE_H
+#define EUTELFRAMECACHE_H 1
+
+// system includes <>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace eutelescope {
+
+  //! Reads whitespace separated integers from a text file
+  /*! Replaces the formatted stream extraction when converting large
+   *  ASCII data files: the file is read in large blocks and the
+   *  numbers are scanned by hand, without locale or stream state
+   *  handling for each value.
+   *
+   *  Only decimal integers with an optional sign are accepted, as
+   *  written by the DAQ systems.
+   */
+  class EUTelAsciiNumberScanner {
+
+  public:
+
+    //! Result of a scan
+    enum Status {
+      kValue,   //!< a value has been read
+      kEnd,     //!< end of the file, no more values
+      kError    //!< not a number or out of range
+    };
+
+    //! Default constructor
+    EUTelAsciiNumberScanner();
+
+    //! Closes the file
+    ~EUTelAsciiNumberScanner();
+
+    EUTelAsciiNumberScanner(const EUTelAsciiNumberScanner &) = delete;
+    EUTelAsciiNumberScanner & operator=(const EUTelAsciiNumberScanner &) = delete;
+
+    //! Opens a file
+    /*! @return false if the file can not be opened
+     */
+    bool open(const std::string & fileName);
+
+    //! Closes the file
+    void close();
+
+    //! Reads the next value
+    Status next(short & value);
+
+    //! Reads n values
+    /*! @return kValue if all the values have been read, kEnd if the
+     *  file ended before the first one. If the file ends in between
+     *  kError is returned and nRead tells how many values were read.
+     */
+    Status next(short * values, std::size_t n, std::size_t & nRead);
+
+  private:
+
+    //! Reads the next block of the file
+    /*! @return false at the end of the file
+     */
+    bool fill();
+
+    std::FILE * _file;
+
+    //! Read buffer
+    std::vector<char> _buffer;
+
+    //! Current position and end of the valid data in _buffer
+    std::size_t _position;
+    std::size_t _end;
+  };
+
+  //! Layout of the frame cache files
+  /*! A frame cache file is a binary copy of the full frames of a
+   *  single sensor read from a slow to parse input file: the header
+   *  is followed by the frames, each one of nX times nY int16 values
+   *  stored by rows, in the native byte order of the writing machine.
+   *
+   *  The size and modification time of the source file are stored in
+   *  the header, so that a cache is not used after its source has
+   *  been changed.
+   */
+  struct EUTelFrameCacheHeader {
+
+    //! File signature
+    char magic[8];
+
+    //! Format version
+    std::uint32_t version;
+
+    //! Size of the header in bytes, the frames start here
+    std::uint32_t headerSize;
+
+    //! Number of pixels along X
+    std::int32_t nX;
+
+    //! Number of pixels along Y
+    std::int32_t nY;
+
+    //! Number of frames
+    std::uint64_t nFrames;
+
+    //! Size in bytes of the source file
+    std::uint64_t sourceSize;
+
+    //! Modification time of the source file, in seconds
+    std::int64_t sourceTime;
+  };
+
+  //! Writes frame cache files
+  /*! The frames are written to a temporary file next to the cache
+   *  which is renamed only by close(), so an interrupted conversion
+   *  never leaves an incomplete cache behind.
+   */
+  class EUTelFrameCacheWriter {
+
+  public:
+
+    //! Default constructor
+    EUTelFrameCacheWriter();
+
+    //! Discards the cache if not closed
+    ~EUTelFrameCacheWriter();
+
+    EUTelFrameCacheWriter(const EUTelFrameCacheWriter &) = delete;
+    EUTelFrameCacheWriter & operator=(const EUTelFrameCacheWriter &) = delete;
+
+    //! Starts a new cache for a source file
+    /*! @return false if the source can not be found or the temporary
+     *  file can not be created
+     */
+    bool open(const std::string & fileName, const std::string & sourceFileName, int nX, int nY);
+
+    //! Is a cache being written?
+    inline bool isOpen() const { return _file != 0; }
+
+    //! Appends a frame of nX times nY values
+    /*! @return false on a write error, the cache is then discarded
+     */
+    bool addFrame(const short * frame);
+
+    //! Writes the header and moves the cache to its final name
+    /*! @return false if the cache can not be written
+     */
+    bool close();
+
+    //! Removes the temporary file
+    void discard();
+
+  private:
+
+    std::string _fileName;
+    std::string _tmpFileName;
+    std::FILE * _file;
+    EUTelFrameCacheHeader _header;
+  };
+
+  //! Reads frame cache files
+  /*! The file is memory mapped, the frames are used directly from the
+   *  mapping.
+   */
+  class EUTelFrameCacheReader {
+
+  public:
+
+    //! Default constructor
+    EUTelFrameCacheReader();
+
+    //! Unmaps the file
+    ~EUTelFrameCacheReader();
+
+    EUTelFrameCacheReader(const EUTelFrameCacheReader &) = delete;
+    EUTelFrameCacheReader & operator=(const EUTelFrameCacheReader &) = delete;
+
+    //! Maps a cache file
+    /*! @return false if the file can not be opened, is not a valid
+     *  frame cache, has a different frame size or does not belong to
+     *  the current version of the source file
+     */
+    bool open(const std::string & fileName, const std::string & sourceFileName, int nX, int nY);
+
+    //! Unmaps the file
+    void close();
+
+    //! Is a file mapped?
+    inline bool isOpen() const { return _data != 0; }
+
+    //! Number of frames
+    inline std::uint64_t getNumberOfFrames() const { return _header ? _header->nFrames : 0; }
+
+    //! Values of a frame, by rows
+    inline const short * getFrame(std::uint64_t iFrame) const {
+      return _frames + iFrame * _frameSize;
+    }
+
+  private:
+
+    const char * _data;
+    std::size_t _size;
+    const EUTelFrameCacheHeader * _header;
+    const short * _frames;
+    std::uint64_t _frameSize;
+  };
+
+}
+#endif
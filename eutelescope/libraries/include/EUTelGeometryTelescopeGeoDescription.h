@@ -10,6 +10,8 @@
 #include <string>
 #include <array>
 #include <memory>
+#include <stdexcept>
+#include <vector>
 
 // MARLIN
 #include "marlin/Global.h"
@@ -85,6 +87,65 @@ struct EUTelPlane
 	bool enabled = true;
 };
 
+/** Immutable, densely indexed copy of the plane setup
+ * Sensor IDs are resolved once into positions of a plain array,
+ * ordered along z like sensorIDsVec(), so lookups in per-hit loops
+ * are array accesses instead of map searches. The local to global
+ * transformation of each plane is stored alongside its parameters.
+ *
+ * A snapshot never changes once built and can be read from several
+ * threads. Changing the geometry produces a new snapshot, the old
+ * one stays valid for whoever still holds it.
+ */
+class EUTelGeometrySnapshot
+{
+  public:
+	struct Plane
+	{
+		/** Sensor ID of the plane*/
+		int sensorID;
+		/** Plane parameters*/
+		EUTelPlane setup;
+		/** Local to global rotation, flips included*/
+		Eigen::Matrix3d rotation;
+		/** Center of the plane in the global frame*/
+		Eigen::Vector3d offset;
+		/** Local x, y and z axes in the global frame*/
+		Eigen::Vector3d xAxis, yAxis, normal;
+	};
+
+	explicit EUTelGeometrySnapshot(std::vector<Plane> planes);
+
+	/** Number of planes */
+	size_t size() const { return _planes.size(); };
+
+	/** Position of a sensor in the table, -1 if the sensor is unknown */
+	int index(int sensorID) const {
+		return ( sensorID >= 0 && sensorID < static_cast<int>(_index.size()) ) ? _index[sensorID] : -1;
+	};
+
+	/** Plane at a given position of the table */
+	Plane const & plane(size_t index) const { return _planes[index]; };
+
+	/** Plane of a sensor, throws InvalidGeometryException if unknown */
+	Plane const & planeOfSensor(int sensorID) const;
+
+	/** All the planes, ordered along z */
+	std::vector<Plane> const & planes() const { return _planes; };
+
+	/** Transforms a position from the local frame of the plane at index */
+	void local2Master(size_t index, const double localPos[], double globalPos[]) const;
+
+	/** Transforms a position into the local frame of the plane at index */
+	void master2Local(size_t index, const double globalPos[], double localPos[]) const;
+
+  private:
+	std::vector<Plane> _planes;
+
+	/** Position in _planes of each sensor ID, -1 for unknown IDs */
+	std::vector<int> _index;
+};
+
 // Iterate over registered GEAR objects and construct their TGeo representation
 const Double_t PI     = 3.141592653589793;
 const Double_t DEG    = 180./PI; 
@@ -158,11 +219,21 @@ class EUTelGeometryTelescopeGeoDescription
 	/** Pointer to the pixel geometry manager */
 	EUTelGenericPixGeoMgr* _pixGeoMgr;
 
-	std::map<int, EUTelPlane> _planeSetup;
+	/** Plane parameters, indexed through _planeIndex */
+	std::vector<EUTelPlane> _planeSetup;
+
+	/** Position in _planeSetup of each sensor ID, -1 for unknown IDs */
+	std::vector<int> _planeIndex;
+
+	/** Current snapshot, built on demand */
+	std::shared_ptr<const EUTelGeometrySnapshot> _snapshot;
 	
 	/** Flag if geoemtry is already initialized */
 	bool _isGeoInitialized;
 
+	/** Flag if the plane setup was changed after the TGeo description was built */
+	bool _isTGeoOutdated;
+
 	/** Map containing plane path (string) and corresponding planeID */
 	std::map<int, std::string> _planePath;
 
@@ -185,7 +256,7 @@ class EUTelGeometryTelescopeGeoDescription
 	void setInitialDisplacementToFirstPlane(float initialDisplacement){_initialDisplacement = initialDisplacement; };
 
 	/** needed only for pede2lcio*/ 
-	void setGearManager( gear::GearMgr* value ) { _gearManager = value ; }
+	void setGearManager( gear::GearMgr* value ) { _gearManager = value ; _fieldFree = -1; }
 
 	/** Number of planes in the setup */
 	inline size_t getSiPlanesLayoutID() const { return _siPlanesLayoutID; } ;
@@ -199,107 +270,116 @@ class EUTelGeometryTelescopeGeoDescription
   /** set methods */
 	/** set X position  */
 
-	inline void setPlaneXPosition(int sensorID, double value){ _planeSetup[sensorID].xPos = value; this->clearMemoizedValues(); };
+	inline void setPlaneXPosition(int sensorID, double value){ planeForUpdate(sensorID).xPos = value; this->clearMemoizedValues(); };
 
 	/** set Y position  */
-	inline void setPlaneYPosition(int sensorID, double value){ _planeSetup[sensorID].yPos = value; this->clearMemoizedValues(); };
+	inline void setPlaneYPosition(int sensorID, double value){ planeForUpdate(sensorID).yPos = value; this->clearMemoizedValues(); };
 
 	/** set Z position  */
-	inline void setPlaneZPosition(int sensorID, double value){ _planeSetup[sensorID].zPos = value; this->clearMemoizedValues(); };
+	inline void setPlaneZPosition(int sensorID, double value){ planeForUpdate(sensorID).zPos = value; this->clearMemoizedValues(); };
 
 	/** set X rotation  */
-	inline void setPlaneXRotation(int sensorID, double value){ _planeSetup[sensorID].alpha = value; this->clearMemoizedValues(); };
+	inline void setPlaneXRotation(int sensorID, double value){ planeForUpdate(sensorID).alpha = value; this->clearMemoizedValues(); };
 
 	/** set Y rotation  */
-	inline void setPlaneYRotation(int sensorID, double value){ _planeSetup[sensorID].beta = value; this->clearMemoizedValues(); };
+	inline void setPlaneYRotation(int sensorID, double value){ planeForUpdate(sensorID).beta = value; this->clearMemoizedValues(); };
 
 	/** set Z rotation  */
-	inline void setPlaneZRotation(int sensorID, double value){ _planeSetup[sensorID].gamma = value; this->clearMemoizedValues(); };
+	inline void setPlaneZRotation(int sensorID, double value){ planeForUpdate(sensorID).gamma = value; this->clearMemoizedValues(); };
 
 	/** set X rotation in radians */
-	inline void setPlaneXRotationRadians(int sensorID, double value){ _planeSetup[sensorID].alpha = value*DEG; this->clearMemoizedValues(); };
+	inline void setPlaneXRotationRadians(int sensorID, double value){ planeForUpdate(sensorID).alpha = value*DEG; this->clearMemoizedValues(); };
 
 	/** set Y rotation in radians */
-	inline void setPlaneYRotationRadians(int sensorID, double value){ _planeSetup[sensorID].beta = value*DEG; this->clearMemoizedValues(); };
+	inline void setPlaneYRotationRadians(int sensorID, double value){ planeForUpdate(sensorID).beta = value*DEG; this->clearMemoizedValues(); };
 
 	/** set Z rotation in radians */
-	inline void setPlaneZRotationRadians(int sensorID, double value){ _planeSetup[sensorID].gamma = value*DEG; this->clearMemoizedValues(); };
+	inline void setPlaneZRotationRadians(int sensorID, double value){ planeForUpdate(sensorID).gamma = value*DEG; this->clearMemoizedValues(); };
 
 	//GETTER
 	/** */ 
-	float siPlaneRotation1(int sensorID){ return _planeSetup.at(sensorID).f1; };
+	float siPlaneRotation1(int sensorID){ return plane(sensorID).f1; };
 
 	/** */ 
-	float siPlaneRotation2(int sensorID){ return _planeSetup.at(sensorID).f2; };
+	float siPlaneRotation2(int sensorID){ return plane(sensorID).f2; };
 
 	/** */ 
-	float siPlaneRotation3(int sensorID){ return _planeSetup.at(sensorID).f3; };
+	float siPlaneRotation3(int sensorID){ return plane(sensorID).f3; };
 
 	/** */ 
-	float siPlaneRotation4(int sensorID){ return _planeSetup.at(sensorID).f4; };
+	float siPlaneRotation4(int sensorID){ return plane(sensorID).f4; };
 
 	/** X coordinate of center of sensor 
 	 * with given ID in global coordinate frame */
-	double siPlaneXPosition(int sensorID){ return _planeSetup.at(sensorID).xPos; };
+	double siPlaneXPosition(int sensorID){ return plane(sensorID).xPos; };
 
 	/** Y coordinate of center of sensor 
 	 * with given ID in global coordinate frame */
-	double siPlaneYPosition(int sensorID){ return _planeSetup.at(sensorID).yPos; };
+	double siPlaneYPosition(int sensorID){ return plane(sensorID).yPos; };
 
 	/** Z coordinate of center of sensor 
 	 * with given ID in global coordinate frame */
-	double siPlaneZPosition(int sensorID){ return _planeSetup.at(sensorID).zPos; };
+	double siPlaneZPosition(int sensorID){ return plane(sensorID).zPos; };
 
 	/** Rotation around X axis of the global coordinate frame */
-	double siPlaneXRotation(int sensorID){ return _planeSetup.at(sensorID).alpha; };
+	double siPlaneXRotation(int sensorID){ return plane(sensorID).alpha; };
 
 	/** Rotation around Y axis of global coordinate frame */
-	double siPlaneYRotation(int sensorID){ return _planeSetup.at(sensorID).beta; };
+	double siPlaneYRotation(int sensorID){ return plane(sensorID).beta; };
 
 	/** Rotation around Z axis of global coordinate frame */
-	double siPlaneZRotation(int sensorID){ return _planeSetup.at(sensorID).gamma; };
+	double siPlaneZRotation(int sensorID){ return plane(sensorID).gamma; };
 
 	/** Rotation around X axis of the global coordinate frame */
-	double siPlaneXRotationRadians(int sensorID){ return _planeSetup.at(sensorID).alpha*RADIAN; };
+	double siPlaneXRotationRadians(int sensorID){ return plane(sensorID).alpha*RADIAN; };
 
 	/** Rotation around Y axis of global coordinate frame */
-	double siPlaneYRotationRadians(int sensorID){ return _planeSetup.at(sensorID).beta*RADIAN; };
+	double siPlaneYRotationRadians(int sensorID){ return plane(sensorID).beta*RADIAN; };
 
 	/** Rotation around Z axis of global coordinate frame */
-	double siPlaneZRotationRadians(int sensorID){ return _planeSetup.at(sensorID).gamma*RADIAN; };
+	double siPlaneZRotationRadians(int sensorID){ return plane(sensorID).gamma*RADIAN; };
 
 	/** Sensor X side size */
-	double siPlaneXSize(int sensorID){ return _planeSetup.at(sensorID).xSize; };
+	double siPlaneXSize(int sensorID){ return plane(sensorID).xSize; };
 
 	/** Sensor Y side size */
-	double siPlaneYSize(int sensorID){ return _planeSetup.at(sensorID).ySize; };
+	double siPlaneYSize(int sensorID){ return plane(sensorID).ySize; };
 
 	/** Sensor Z side size */
-	double siPlaneZSize(int sensorID){ return _planeSetup.at(sensorID).zSize; };
+	double siPlaneZSize(int sensorID){ return plane(sensorID).zSize; };
 
 	/** Sensor X side pixel pitch [mm] */
-	double siPlaneXPitch(int sensorID){ return _planeSetup.at(sensorID).xPitch; };
+	double siPlaneXPitch(int sensorID){ return plane(sensorID).xPitch; };
 
 	/** Sensor Y side pixel pitch [mm] */
-	double siPlaneYPitch(int sensorID){ return _planeSetup.at(sensorID).yPitch; };
+	double siPlaneYPitch(int sensorID){ return plane(sensorID).yPitch; };
 
 	/** Sensor X side size in pixels */
-	int siPlaneXNpixels(int sensorID){ return _planeSetup.at(sensorID).xPixelNo; };
+	int siPlaneXNpixels(int sensorID){ return plane(sensorID).xPixelNo; };
 
 	/** Sensor Y side size in pixels */
-	int siPlaneYNpixels(int sensorID){ return _planeSetup.at(sensorID).yPixelNo; };
+	int siPlaneYNpixels(int sensorID){ return plane(sensorID).yPixelNo; };
 
 	/** Sensor X side size in pixels */
-	double siPlaneXResolution(int sensorID){ return _planeSetup.at(sensorID).xRes; };
+	double siPlaneXResolution(int sensorID){ return plane(sensorID).xRes; };
 
 	/** Sensor Y side size in pixels */
-	double siPlaneYResolution(int sensorID){ return _planeSetup.at(sensorID).yRes; };
+	double siPlaneYResolution(int sensorID){ return plane(sensorID).yRes; };
 
 	/** Sensor medium radiation length */
-	double siPlaneRadLength(int sensorID){ return _planeSetup.at(sensorID).radLength; };
+	double siPlaneRadLength(int sensorID){ return plane(sensorID).radLength; };
 
 	/** Name of pixel geometry library */
-	std::string geoLibName(int sensorID){ return _planeSetup.at(sensorID).pixGeoName; };
+	std::string geoLibName(int sensorID){ return plane(sensorID).pixGeoName; };
+
+	/** Snapshot of the current plane setup
+	 * The snapshot is rebuilt only after the geometry changed. Hold
+	 * the returned pointer for the duration of an event loop to
+	 * access the planes without further lookups. Once a setter has
+	 * changed a plane, the transformations are computed from the plane
+	 * parameters, since the TGeo description is not rebuilt.
+	 */
+	std::shared_ptr<const EUTelGeometrySnapshot> getSnapshot();
 
 	/** Plane normal vector (nx,ny,nz) */
 	TVector3 siPlaneNormal( int );
@@ -343,6 +423,27 @@ class EUTelGeometryTelescopeGeoDescription
 
 	double planeRadLengthGlobalIncidence(int planeID, Eigen::Vector3d incidenceDir);
 	double planeRadLengthLocalIncidence(int planeID, Eigen::Vector3d incidenceDir);
+
+	/** Radiation length X/X0 crossed in a plane
+	 * Interpolated in the material map at the local position (x,y) and
+	 * scaled with the incidence angle of the global direction.
+	 */
+	double planeRadLength(int planeID, double localX, double localY, Eigen::Vector3d const & incidenceDir);
+
+	/** Radiation length X/X0 between a plane and the next one along z
+	 * Returns 0 for the last plane.
+	 */
+	double radLengthToNextPlane(int planeID, Eigen::Vector3d const & incidenceDir);
+
+	/** Is the material map available? It is built with the TGeo geometry
+	 * and dropped when a plane is moved or rotated.
+	 */
+	bool hasMaterialMap() const { return !_planeMaterial.empty(); };
+
+	/** Number of bins in local x and y of the material map
+	 * Must be called before the TGeo geometry is initialised.
+	 */
+	void setMaterialMapBinning(int nBinsX, int nBinsY) { _materialBinsX = nBinsX; _materialBinsY = nBinsY; };
 	
 	void local2Master( int sensorID, std::array<double,3> const & localPos, std::array<double,3>& globalPos);
 	void master2Local( int sensorID, std::array<double,3> const & globalPos, std::array<double,3>& localPos);
@@ -354,15 +455,45 @@ class EUTelGeometryTelescopeGeoDescription
 	void local2MasterVec( int, const double[], double[] );
 	void master2LocalVec( int, const double[], double[] );
 
+	/** Intersection of a track with a plane
+	 * The track starts at (x0,y0,z0) with momentum (px,py,pz) in GeV. It
+	 * is propagated along a straight line if isFieldFree(), otherwise
+	 * along a helix in the field at the starting point. The arc length
+	 * may be negative if the plane is behind the starting point.
+	 * Returns false, with newNextPlaneID set to -999, if the plane is
+	 * not crossed.
+	 */
 	bool findIntersectionWithCertainID(	float x0, float y0, float z0, 
 						float px, float py, float pz, 
 						float beamQ, int nextPlaneID, float outputPosition[],
 						TVector3& outputMomentum, float& arcLength, int& newNextPlaneID );
 
+	/** Intersections of a batch of tracks with one plane
+	 * positions and momenta hold x,y,z of track i at 3*i. The outputs
+	 * are resized and filled in the same layout, arcLengths is NaN for
+	 * the tracks not crossing the plane.
+	 * Returns the number of tracks crossing the plane.
+	 */
+	int findIntersectionsWithPlane(	int planeID, std::vector<double> const & positions,
+					std::vector<double> const & momenta, float beamQ,
+					std::vector<double>& outputPositions, std::vector<double>& outputMomenta,
+					std::vector<double>& arcLengths );
+
+	/** Momentum after an arc length along the helix starting at globalPositionStart */
 	TVector3 getXYZMomentumfromArcLength(TVector3 momentum, TVector3 globalPositionStart, float charge, float arcLength);
 
-	//This outputs the total percentage radiation length for the full detector system. 
-	float calculateTotalRadiationLengthAndWeights(const double startD[3],const double endD[3], std::map<const int,double>&, std::map<const int,double> & );
+	/** Is the magnetic field zero at the origin and at all the planes?
+	 * Also true if GEAR has no BField. Evaluated once per geometry.
+	 */
+	bool isFieldFree();
+
+	/** Total radiation length X/X0 of a straight line through the telescope
+	 * mapSensor is filled with the fraction of the total in each crossed
+	 * plane, mapAir with the fraction in the gap following each plane
+	 * (the gap in front of the first crossed plane is added to that
+	 * plane). Only table lookups are done, no geometry navigation.
+	 */
+	float calculateTotalRadiationLengthAndWeights(const double startD[3],const double endD[3], std::map<const int,double>& mapSensor, std::map<const int,double>& mapAir );
 	double addKapton(std::map<const int, double> & mapSensor);
 
 	float getInitialDisplacementToFirstPlane() const { return _initialDisplacement; };
@@ -405,11 +536,71 @@ private:
 
 	void translateSiPlane2TGeo(TGeoVolume*,int );
 
-	void clearMemoizedValues() { _planeNormalMap.clear(); _planeXMap.clear(); _planeYMap.clear(); _planeRadMap.clear(); }
-	std::map<int, TVector3> _planeNormalMap;
-	std::map<int, TVector3> _planeXMap;
-	std::map<int, TVector3> _planeYMap;
+	/** Parameters of a plane, throws std::out_of_range if unknown */
+	EUTelPlane const & plane(int sensorID) const {
+		if( sensorID < 0 || sensorID >= static_cast<int>(_planeIndex.size()) || _planeIndex[sensorID] < 0 ) {
+			throw std::out_of_range("EUTelGeometryTelescopeGeoDescription: unknown sensor ID");
+		}
+		return _planeSetup[_planeIndex[sensorID]];
+	};
+
+	/** Parameters of a plane, added if unknown */
+	EUTelPlane & planeForUpdate(int sensorID);
+
+	/** Drops the values depending on the plane setup
+	 * The material maps are not rebuilt: until the next TGeo
+	 * initialisation the radiation lengths are found with FindRad
+	 * as without maps.
+	 */
+	void clearMemoizedValues() { _snapshot.reset(); _planeRadMap.clear(); _planeMaterial.clear(); _fieldFree = -1; }
 	std::map<int, double> _planeRadMap;
+
+	/** Fills the material map, see PlaneMaterial */
+	void buildMaterialMap();
+
+	/** Material map of a plane
+	 * X/X0 at normal incidence, sampled with FindRad at the bin centers
+	 * of a grid covering the sensitive area, plus X/X0 along z from the
+	 * back of the plane to the front of the next one.
+	 */
+	struct PlaneMaterial
+	{
+		int nBinsX, nBinsY;
+		/** Local position of the first bin center and bin sizes*/
+		double xFirst, yFirst, xStep, yStep;
+		/** X/X0 of each bin, x index running fastest*/
+		std::vector<double> radLength;
+		/** X/X0 to the next plane*/
+		double gapRadLength;
+
+		/** Bilinear interpolation of radLength, clamped at the edges */
+		double at(double x, double y) const;
+	};
+
+	/** Material maps, ordered like sensorIDsVec() */
+	std::vector<PlaneMaterial> _planeMaterial;
+
+	/** Material map of a sensor, throws InvalidGeometryException if unknown */
+	PlaneMaterial const & materialOfSensor(int planeID);
+
+	/** Binning of the material maps */
+	int _materialBinsX, _materialBinsY;
+
+	/** Field free flag of isFieldFree(), -1 if not evaluated yet */
+	int _fieldFree;
+
+	/** Field in Tesla at a global position, zero if GEAR has no BField */
+	Eigen::Vector3d fieldAt(Eigen::Vector3d const & position);
+
+	/** Arc length from a track state to a plane, false if it is not crossed */
+	bool arcLengthToPlane(	EUTelGeometrySnapshot::Plane const & p, Eigen::Vector3d const & position,
+				Eigen::Vector3d const & momentum, double beamQ, Eigen::Vector3d const & field,
+				double& arcLength );
+
+	/** Position and momentum after an arc length along a helix */
+	static void propagateHelix(	Eigen::Vector3d const & position, Eigen::Vector3d const & momentum,
+					double beamQ, Eigen::Vector3d const & field, double arcLength,
+					Eigen::Vector3d& outputPosition, Eigen::Vector3d& outputMomentum );
 };
         
 inline EUTelGeometryTelescopeGeoDescription& gGeometry( gear::GearMgr* _g = marlin::Global::GEAR )
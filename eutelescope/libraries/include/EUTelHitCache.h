@@ -0,0 +1,267 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+#ifndef EUTELHITCACHE_H
+#define EUTELHITCACHE_H 1
+
+// lcio includes <.h>
+#include <LCRTRelations.h>
+
+// system includes <>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace eutelescope {
+
+  //! Layout of the hit cache files
+  /*! A hit cache file stores only the few quantities per hit that are
+   *  needed to refit tracks or to analyse a DUT, in a columnar binary
+   *  layout which can be memory mapped and accessed randomly:
+   *
+   *  - a fixed size EUTelHitCacheHeader;
+   *  - the event index: run number, event number (int32) and the
+   *    offset of the first hit of each event (uint64, one more entry
+   *    than events);
+   *  - one column per hit quantity, see EUTelHitCacheHeader::Column.
+   *
+   *  Every section starts at a multiple of 8 bytes. Numbers are
+   *  stored in the native byte order of the writing machine.
+   */
+  struct EUTelHitCacheHeader {
+
+    //! Sections of the file, the offsets are stored in this order
+    enum Column {
+      kRunNumber = 0,   //!< int32 per event
+      kEventNumber,     //!< int32 per event
+      kHitBegin,        //!< uint64 per event, plus the total
+      kX,               //!< float per hit
+      kY,               //!< float per hit
+      kZ,               //!< float per hit
+      kCovXX,           //!< float per hit
+      kCovYY,           //!< float per hit
+      kCharge,          //!< float per hit
+      kSensorID,        //!< int32 per hit
+      kClusterSize,     //!< int32 per hit
+      kProperties,      //!< int32 per hit
+      kType,            //!< int32 per hit
+      kNColumns
+    };
+
+    //! File signature
+    char magic[8];
+
+    //! Format version
+    std::uint32_t version;
+
+    //! Number of sections, kNColumns
+    std::uint32_t nColumns;
+
+    //! Number of events
+    std::uint64_t nEvents;
+
+    //! Number of hits
+    std::uint64_t nHits;
+
+    //! Offset in bytes of each section from the beginning of the file
+    std::uint64_t offset[kNColumns];
+  };
+
+  //! A hit as stored in the cache
+  struct EUTelCachedHit {
+    float x, y, z;
+    float covXX, covYY;
+    float charge;
+    std::int32_t sensorID;
+    std::int32_t clusterSize;
+    std::int32_t properties;
+    std::int32_t type;
+  };
+
+  //! LCIO runtime extension with the cluster size of a hit read from a cache
+  /*! The hits read back from a cache have no cluster attached, their
+   *  cluster size is available as
+   *  @code
+   *  int size = hit->ext<EUTelCachedClusterSize>();
+   *  @endcode
+   *  It is not written out with the hit.
+   */
+  struct EUTelCachedClusterSize : lcrtrel::LCIntExtension<EUTelCachedClusterSize> { };
+
+  //! Writes hit cache files
+  /*! The hits are appended event by event. Each column is first
+   *  streamed into its own temporary file, so that the memory used
+   *  does not grow with the number of hits, and the columns are
+   *  concatenated after the header in close().
+   */
+  class EUTelHitCacheFileWriter {
+
+  public:
+
+    //! Default constructor
+    EUTelHitCacheFileWriter();
+
+    //! Closes the file if still open
+    ~EUTelHitCacheFileWriter();
+
+    EUTelHitCacheFileWriter(const EUTelHitCacheFileWriter &) = delete;
+    EUTelHitCacheFileWriter & operator=(const EUTelHitCacheFileWriter &) = delete;
+
+    //! Opens a new cache file
+    /*! @return false if the temporary files can not be created
+     */
+    bool open(const std::string & fileName);
+
+    //! Adds an event with its hits
+    void addEvent(int runNumber, int eventNumber, const std::vector<EUTelCachedHit> & hits);
+
+    //! Writes the file
+    /*! @return false if the output file can not be written
+     */
+    bool close();
+
+    //! Number of events written so far
+    inline std::uint64_t getNumberOfEvents() const { return _eventNumber.size(); }
+
+    //! Number of hits written so far
+    inline std::uint64_t getNumberOfHits() const { return _nHits; }
+
+  private:
+
+    //! Output file name
+    std::string _fileName;
+
+    //! Run number of each event
+    std::vector<std::int32_t> _runNumber;
+
+    //! Event number of each event
+    std::vector<std::int32_t> _eventNumber;
+
+    //! First hit of each event
+    std::vector<std::uint64_t> _hitBegin;
+
+    //! Total number of hits
+    std::uint64_t _nHits;
+
+    //! Temporary files of the hit columns, indexed by column - kX
+    std::vector<std::FILE *> _columnFiles;
+  };
+
+  //! Reads hit cache files
+  /*! The file is memory mapped, so opening it does not read it and
+   *  events can be accessed in any order; only the pages actually
+   *  used are read from the disk.
+   *
+   *  Typical usage:
+   *  @code
+   *  EUTelHitCacheFileReader cache;
+   *  cache.open( "run000123-hits.cache" );
+   *  for ( std::uint64_t iEvent = 0; iEvent < cache.getNumberOfEvents(); ++iEvent ) {
+   *    for ( std::uint64_t iHit = cache.getHitBegin(iEvent); iHit < cache.getHitEnd(iEvent); ++iHit ) {
+   *      float x = cache.getX()[iHit];
+   *    }
+   *  }
+   *  @endcode
+   */
+  class EUTelHitCacheFileReader {
+
+  public:
+
+    //! Default constructor
+    EUTelHitCacheFileReader();
+
+    //! Unmaps the file
+    ~EUTelHitCacheFileReader();
+
+    EUTelHitCacheFileReader(const EUTelHitCacheFileReader &) = delete;
+    EUTelHitCacheFileReader & operator=(const EUTelHitCacheFileReader &) = delete;
+
+    //! Maps a cache file
+    /*! @return false if the file can not be opened or is not a valid
+     *  hit cache
+     */
+    bool open(const std::string & fileName);
+
+    //! Unmaps the file
+    void close();
+
+    //! Is a file mapped?
+    inline bool isOpen() const { return _data != 0; }
+
+    //! Number of events
+    inline std::uint64_t getNumberOfEvents() const { return _header ? _header->nEvents : 0; }
+
+    //! Number of hits
+    inline std::uint64_t getNumberOfHits() const { return _header ? _header->nHits : 0; }
+
+    //! Run number of an event
+    inline int getRunNumber(std::uint64_t iEvent) const { return _runNumber[iEvent]; }
+
+    //! Event number of an event
+    inline int getEventNumber(std::uint64_t iEvent) const { return _eventNumber[iEvent]; }
+
+    //! Index of the first hit of an event
+    inline std::uint64_t getHitBegin(std::uint64_t iEvent) const { return _hitBegin[iEvent]; }
+
+    //! Index after the last hit of an event
+    inline std::uint64_t getHitEnd(std::uint64_t iEvent) const { return _hitBegin[iEvent + 1]; }
+
+    //! Copies a hit out of the columns
+    EUTelCachedHit getHit(std::uint64_t iHit) const;
+
+    //! @name Columns, indexed by hit
+    //@{
+    inline const float * getX() const { return _x; }
+    inline const float * getY() const { return _y; }
+    inline const float * getZ() const { return _z; }
+    inline const float * getCovXX() const { return _covXX; }
+    inline const float * getCovYY() const { return _covYY; }
+    inline const float * getCharge() const { return _charge; }
+    inline const std::int32_t * getSensorID() const { return _sensorID; }
+    inline const std::int32_t * getClusterSize() const { return _clusterSize; }
+    inline const std::int32_t * getProperties() const { return _properties; }
+    inline const std::int32_t * getType() const { return _type; }
+    //@}
+
+  private:
+
+    //! Pointer to a section of the mapped file
+    template <class T>
+    const T * column(int iColumn) const {
+      return reinterpret_cast<const T *>( _data + _header->offset[iColumn] );
+    }
+
+    //! Mapped file
+    const char * _data;
+
+    //! Size of the mapped file
+    std::size_t _size;
+
+    //! Header, at the beginning of the mapped file
+    const EUTelHitCacheHeader * _header;
+
+    const std::int32_t * _runNumber;
+    const std::int32_t * _eventNumber;
+    const std::uint64_t * _hitBegin;
+    const float * _x;
+    const float * _y;
+    const float * _z;
+    const float * _covXX;
+    const float * _covYY;
+    const float * _charge;
+    const std::int32_t * _sensorID;
+    const std::int32_t * _clusterSize;
+    const std::int32_t * _properties;
+    const std::int32_t * _type;
+  };
+
+}
+#endif
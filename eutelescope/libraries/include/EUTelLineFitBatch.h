@@ -0,0 +1,168 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+#ifndef EUTELLINEFITBATCH_H
+#define EUTELLINEFITBATCH_H 1
+
+// system includes <>
+#include <vector>
+
+namespace eutelescope {
+
+  //! Batched weighted straight line fit in XZ and YZ
+  /*! This class fits straight lines, x = a + b z and y = c + d z,
+   *  to a batch of track candidates at once. It is meant as a fast
+   *  first pass fitter, e.g. for pre-alignment or for quick-look
+   *  data quality monitoring, when the full DAF or GBL fits are too
+   *  expensive. Multiple scattering is not taken into account.
+   *
+   *  Hits are stored as structure of arrays: for each plane there is
+   *  one contiguous array running over the tracks of the batch. All
+   *  the sums of the least squares fit are accumulated plane by
+   *  plane with an inner loop over the tracks.
+   *
+   *  A plane is excluded from the fit of a given track if its
+   *  position error is not positive. Tracks can be collected from a
+   *  single event or from many events before calling fit().
+   *
+   *  Typical usage:
+   *  @code
+   *  EUTelLineFitBatch batch( nPlanes );
+   *  batch.addTrack( x, y, z, ex, ey );  // for each candidate
+   *  batch.fit();
+   *  double slope = batch.getSlopeX( iTrack );
+   *  @endcode
+   */
+  class EUTelLineFitBatch {
+
+  public:
+
+    //! Constructor with the number of planes of each track
+    explicit EUTelLineFitBatch(int nPlanes = 0);
+
+    //! Remove all tracks and change the number of planes
+    void reset(int nPlanes);
+
+    //! Remove all tracks, keeping the allocated memory
+    void clear();
+
+    //! Reserve memory for a given number of tracks
+    void reserve(int nTracks);
+
+    //! Add a track candidate to the batch
+    /*! All arrays have getNumberOfPlanes() entries.
+     *
+     *  @param x measured x positions
+     *  @param y measured y positions
+     *  @param z plane positions along the beam
+     *  @param ex x position errors, planes with ex <= 0 are not used in XZ
+     *  @param ey y position errors, planes with ey <= 0 are not used in YZ
+     *
+     *  @return the index of the track in the batch
+     */
+    int addTrack(const double * x, const double * y, const double * z,
+                 const double * ex, const double * ey);
+
+    //! Fit all tracks in the batch
+    void fit();
+
+    //! Number of tracks in the batch
+    inline int getNumberOfTracks() const { return _nTracks; }
+
+    //! Number of planes per track
+    inline int getNumberOfPlanes() const { return _nPlanes; }
+
+    //! Slope in XZ of a given track
+    inline double getSlopeX(int iTrack) const { return _slopeX[iTrack]; }
+
+    //! Slope in YZ of a given track
+    inline double getSlopeY(int iTrack) const { return _slopeY[iTrack]; }
+
+    //! X position at z = 0 of a given track
+    inline double getInterceptX(int iTrack) const { return _interceptX[iTrack]; }
+
+    //! Y position at z = 0 of a given track
+    inline double getInterceptY(int iTrack) const { return _interceptY[iTrack]; }
+
+    //! Chi2 of the fit in XZ
+    inline double getChi2X(int iTrack) const { return _chi2X[iTrack]; }
+
+    //! Chi2 of the fit in YZ
+    inline double getChi2Y(int iTrack) const { return _chi2Y[iTrack]; }
+
+    //! Fitted x position of a given track in a given plane
+    inline double getFitX(int iPlane, int iTrack) const {
+      return _interceptX[iTrack] + _slopeX[iTrack] * _z[iPlane][iTrack];
+    }
+
+    //! Fitted y position of a given track in a given plane
+    inline double getFitY(int iPlane, int iTrack) const {
+      return _interceptY[iTrack] + _slopeY[iTrack] * _z[iPlane][iTrack];
+    }
+
+    //! Residual (fitted - measured) in x
+    inline double getResidualX(int iPlane, int iTrack) const { return _residualX[iPlane][iTrack]; }
+
+    //! Residual (fitted - measured) in y
+    inline double getResidualY(int iPlane, int iTrack) const { return _residualY[iPlane][iTrack]; }
+
+    //! Was the fit in XZ and YZ possible for this track?
+    /*! At least two planes with different z positions are needed
+     *  in each projection.
+     */
+    inline bool isValid(int iTrack) const { return _valid[iTrack] != 0; }
+
+  private:
+
+    //! Fit one projection for all tracks
+    void fitProjection(const std::vector< std::vector<double> > & pos,
+                       const std::vector< std::vector<double> > & weight,
+                       std::vector<double> & intercept,
+                       std::vector<double> & slope,
+                       std::vector<double> & chi2,
+                       std::vector< std::vector<double> > & residual);
+
+    //! Number of planes per track
+    int _nPlanes;
+
+    //! Number of tracks in the batch
+    int _nTracks;
+
+    //! Input arrays, indexed [plane][track]
+    std::vector< std::vector<double> > _x;
+    std::vector< std::vector<double> > _y;
+    std::vector< std::vector<double> > _z;
+    std::vector< std::vector<double> > _wx;
+    std::vector< std::vector<double> > _wy;
+
+    //! Fit results, indexed [track]
+    std::vector<double> _interceptX;
+    std::vector<double> _slopeX;
+    std::vector<double> _chi2X;
+    std::vector<double> _interceptY;
+    std::vector<double> _slopeY;
+    std::vector<double> _chi2Y;
+    std::vector<char>   _valid;
+
+    //! Residuals, indexed [plane][track]
+    std::vector< std::vector<double> > _residualX;
+    std::vector< std::vector<double> > _residualY;
+
+    //! Work arrays for the weighted sums, indexed [track]
+    std::vector<double> _sumW;
+    std::vector<double> _sumWZ;
+    std::vector<double> _sumWP;
+    std::vector<double> _sumWZZ;
+    std::vector<double> _sumWZP;
+
+  };
+
+}
+
+#endif
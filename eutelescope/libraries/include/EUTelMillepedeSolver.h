@@ -0,0 +1,210 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+#ifndef EUTELMILLEPEDESOLVER_H
+#define EUTELMILLEPEDESOLVER_H 1
+
+// Eigen
+#include <Eigen/Core>
+
+// system includes <>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace eutelescope {
+
+  //! In-process solver for Millepede style alignment problems
+  /*! This class is a drop-in replacement for the Mille / pede pair
+   *  for the alignment processors. Measurements are passed with the
+   *  same interface as Mille::mille() and Mille::end(), but instead of
+   *  being written to a binary file they are immediately folded into
+   *  the normal equations of the global parameters: at the end of
+   *  each track the local (track) parameters are eliminated, so that
+   *  the memory needed does not depend on the number of tracks.
+   *
+   *  The global parameters, their start values and pre-sigmas as well
+   *  as the linear constraints are taken from a pede steering file
+   *  (Parameter and Constraint sections) or set directly. The model
+   *  is the one of pede:
+   *
+   *  rMeas = sum_i derLC[i] * local[i] + sum_j derGL[j] * global[label[j]]
+   *
+   *  and the parameters are obtained with a single linear solution,
+   *  which is what pede does with "method inversion" on a linear
+   *  problem without outlier rejection. Parameters with a negative
+   *  pre-sigma are fixed to their start value, a positive pre-sigma
+   *  adds a Gaussian constraint around the start value. Constraints
+   *  are enforced with Lagrange multipliers.
+   *
+   *  The results can be written into a file with the same layout as
+   *  millepede.res, so that the code reading back the pede output can
+   *  be used unchanged.
+   *
+   *  Typical usage:
+   *  @code
+   *  EUTelMillepedeSolver solver;
+   *  solver.mille( nLC, derLC, nGL, derGL, label, residual, sigma ); // for each measurement
+   *  solver.end();                                                   // for each track
+   *  solver.readSteeringFile( "steer_mille.txt" );
+   *  if ( solver.solve() ) solver.writeResultFile( "millepede.res" );
+   *  @endcode
+   */
+  class EUTelMillepedeSolver {
+
+  public:
+
+    //! Default constructor
+    EUTelMillepedeSolver();
+
+    //! Add a measurement to the current track
+    /*! Same signature and meaning as Mille::mille(). Derivatives
+     *  equal to zero are ignored.
+     */
+    void mille(int nLC, const float * derLC, int nGL, const float * derGL,
+               const int * label, float rMeas, float sigma);
+
+    //! Close the current track
+    /*! The local parameters of the track are eliminated and its
+     *  contribution is added to the global normal equations. Tracks
+     *  whose local parameters are not determined are rejected.
+     */
+    void end();
+
+    //! Discard the measurements of the current track
+    void kill();
+
+    //! Read the Parameter and Constraint sections of a pede steering file
+    /*! All the other keywords are ignored, in particular the input
+     *  files since the data are already in memory.
+     *
+     *  @return false if the file cannot be opened
+     */
+    bool readSteeringFile(const std::string & fileName);
+
+    //! Set start value and pre-sigma of a global parameter
+    void setParameter(int label, double start, double presigma);
+
+    //! Add the linear constraint sum_i factor[i] * global[label[i]] = value
+    void addConstraint(const std::vector<int> & labels,
+                       const std::vector<double> & factors, double value);
+
+    //! Solve the normal equations
+    /*! Labels of a constraint which are fixed or never measured stay
+     *  at their start value. Constraints without any free parameter
+     *  are skipped, see getNumberOfSkippedConstraints().
+     *
+     *  @return false if the system is singular
+     */
+    bool solve();
+
+    //! Write the results in the millepede.res format
+    /*! Each line contains label, value and pre-sigma, followed by the
+     *  correction and its error for the free parameters.
+     */
+    bool writeResultFile(const std::string & fileName) const;
+
+    //! Fitted value of a global parameter
+    double getValue(int label) const;
+
+    //! Error of a global parameter, zero if it is fixed
+    double getError(int label) const;
+
+    //! Number of tracks accumulated so far
+    inline int getNumberOfTracks() const { return _nTracks; }
+
+    //! Number of tracks rejected in end()
+    inline int getNumberOfRejectedTracks() const { return _nRejected; }
+
+    //! Chi2 of the global fit, available after solve()
+    inline double getChi2() const { return _chi2; }
+
+    //! Degrees of freedom of the global fit, available after solve()
+    inline int getNdf() const { return _ndf; }
+
+    //! Number of constraints without free parameters, available after solve()
+    inline int getNumberOfSkippedConstraints() const { return _nSkippedConstraints; }
+
+  private:
+
+    //! Index of a global parameter, creating it if needed
+    int parameterIndex(int label);
+
+    //! A linear constraint between global parameters
+    struct Constraint {
+      std::vector<int> labels;
+      std::vector<double> factors;
+      double value;
+    };
+
+    //! Global parameter label for each index
+    std::vector<int> _labels;
+
+    //! Index of each global parameter label
+    std::map<int, int> _labelIndex;
+
+    //! Start values by index
+    std::vector<double> _start;
+
+    //! Pre-sigmas by index, negative means fixed
+    std::vector<double> _presigma;
+
+    //! Fitted corrections by index
+    std::vector<double> _correction;
+
+    //! Fitted errors by index
+    std::vector<double> _error;
+
+    //! Linear constraints
+    std::vector<Constraint> _constraints;
+
+    //! Reduced normal matrix of the global parameters
+    Eigen::MatrixXd _matrix;
+
+    //! Reduced right hand side of the global parameters
+    Eigen::VectorXd _vector;
+
+    //! Weighted sum of squared residuals after local elimination
+    double _sumResidual2;
+
+    //! Number of accepted measurements
+    int _nMeasurements;
+
+    //! Number of local parameters summed over the accepted tracks
+    int _nLocal;
+
+    //! Number of accepted tracks
+    int _nTracks;
+
+    //! Number of rejected tracks
+    int _nRejected;
+
+    //! Chi2 of the global fit
+    double _chi2;
+
+    //! Degrees of freedom of the global fit
+    int _ndf;
+
+    //! Number of constraints skipped in solve()
+    int _nSkippedConstraints;
+
+    //! @name Buffers of the current track
+    //@{
+    int _trackNLC;
+    std::vector<double> _trackDerLC;
+    std::vector<int> _trackGlobalBegin;
+    std::vector<int> _trackGlobalIndex;
+    std::vector<double> _trackDerGL;
+    std::vector<double> _trackResidual;
+    std::vector<double> _trackWeight;
+    //@}
+  };
+
+}
+#endif
@@ -0,0 +1,209 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+#ifndef EUTELTRACKCLUSTERASSOCIATION_H
+#define EUTELTRACKCLUSTERASSOCIATION_H 1
+
+// system includes <>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace eutelescope {
+
+  //! Affine transformation of 3D positions
+  /*! out = M in + t, with M stored by rows.
+   *
+   *  Translations and rotations applied one after the other, as done
+   *  when removing several alignment collections and the sensor
+   *  rotation from a fitted hit, are affine as a whole. build()
+   *  evaluates such a chain once at four points and the chain is
+   *  then replaced by a single matrix multiplication per position.
+   *
+   *  Typical usage:
+   *  @code
+   *  EUTelAffineTransform3D toLocal;
+   *  toLocal.build( [&](const double * in, double * out) { removeAlignment(in, out); } );
+   *  toLocal.apply( global, local );
+   *  @endcode
+   */
+  class EUTelAffineTransform3D {
+
+  public:
+
+    //! Default constructor, the identity
+    EUTelAffineTransform3D();
+
+    //! Samples an affine function
+    /*! @param f callable as f(const double in[3], double out[3])
+     */
+    template <class F>
+    void build(F f) {
+      const double origin[3] = { 0., 0., 0. };
+      f( origin, _offset );
+      for ( int j = 0; j < 3; ++j ) {
+        double unit[3] = { 0., 0., 0. };
+        double out[3];
+        unit[j] = 1.;
+        f( unit, out );
+        for ( int i = 0; i < 3; ++i ) _matrix[3 * i + j] = out[i] - _offset[i];
+      }
+    }
+
+    //! Transforms a position
+    inline void apply(const double * in, double * out) const {
+      for ( int i = 0; i < 3; ++i ) {
+        out[i] = _matrix[3 * i] * in[0] + _matrix[3 * i + 1] * in[1] + _matrix[3 * i + 2] * in[2] + _offset[i];
+      }
+    }
+
+  private:
+
+    //! Linear part, by rows
+    double _matrix[9];
+
+    //! Translation
+    double _offset[3];
+  };
+
+  //! Bitmap of the masked pixels of a sensor
+  /*! Replaces the linear scans over lists of noisy, hot or dead
+   *  pixels when checking whether a track passes close to one of
+   *  them. Each row is stored in 64 bit words, so a query only looks
+   *  at the few pixels whose centers can be within the distance.
+   *
+   *  Pixels outside of the sensor are kept in a short list, so that
+   *  the queries give the same answer as a scan over all the masked
+   *  pixels.
+   */
+  class EUTelPixelMask {
+
+  public:
+
+    //! Default constructor, an empty mask
+    EUTelPixelMask();
+
+    //! Resizes and clears the mask
+    void reset(int nColumns, int nRows, double xPitch, double yPitch);
+
+    //! Masks a pixel
+    void mask(int x, int y);
+
+    //! Is a pixel masked?
+    bool isMasked(int x, int y) const;
+
+    //! Number of masked pixels
+    inline std::size_t size() const { return _nMasked; }
+
+    //! Is a masked pixel close to a local position?
+    /*! The pixel center of column x is at (x + 0.5) xPitch.
+     *
+     *  @return true if for a masked pixel |dx| < distance and |dy| < distance
+     */
+    bool isNearMaskedPixel(double x, double y, double distance) const;
+
+    //! Is a column with masked pixels close to a local position?
+    /*! @return true if for a masked pixel |dx| < distance
+     */
+    bool isNearMaskedColumn(double x, double distance) const;
+
+  private:
+
+    //! Is (x, y) inside the bitmap?
+    inline bool inside(int x, int y) const {
+      return x >= 0 && x < _nColumns && y >= 0 && y < _nRows;
+    }
+
+    int _nColumns;
+    int _nRows;
+    double _xPitch;
+    double _yPitch;
+
+    //! Number of 64 bit words per row
+    int _nWordsPerRow;
+
+    //! Bits of the masked pixels, by rows
+    std::vector<std::uint64_t> _bits;
+
+    //! Number of masked pixels of each column
+    std::vector<int> _columnCount;
+
+    //! Masked pixels outside of the sensor, x and y alternating
+    std::vector<int> _outside;
+
+    //! Number of masked pixels
+    std::size_t _nMasked;
+  };
+
+  //! Uniform grid of hits in a sensor plane
+  /*! Hits are added with a user index, typically their position in
+   *  the hit collection, and sorted into square cells by build(). A
+   *  query then returns the hits within a window around a track
+   *  impact point visiting only the cells overlapping the window,
+   *  instead of looping over all the hits of the event.
+   */
+  class EUTelHitGrid2D {
+
+  public:
+
+    //! Default constructor
+    EUTelHitGrid2D();
+
+    //! Removes all the hits
+    void clear();
+
+    //! Adds a hit
+    /*! Hits with a non finite position are ignored.
+     */
+    void add(double x, double y, int index);
+
+    //! Sorts the hits into the cells
+    /*! Must be called after the last add() and before query(). The
+     *  cells are enlarged if needed so that there are at most four
+     *  per hit, or 64 for a handful of hits.
+     *
+     *  @param cellSize Size of the cells, typically the association window
+     */
+    void build(double cellSize);
+
+    //! Hits close to a position
+    /*! @param indices filled with the indices of the hits with
+     *  |dx| <= distance and |dy| <= distance, in increasing order
+     */
+    void query(double x, double y, double distance, std::vector<int> & indices) const;
+
+    //! Number of hits
+    inline std::size_t size() const { return _hits.size(); }
+
+    //! Number of cells, available after build()
+    inline std::size_t getNumberOfCells() const { return static_cast<std::size_t>( _nCellsX ) * _nCellsY; }
+
+  private:
+
+    struct Hit {
+      double x;
+      double y;
+      int index;
+    };
+
+    //! Hits, ordered by cell after build()
+    std::vector<Hit> _hits;
+
+    //! First hit of each cell, one more entry than cells
+    std::vector<int> _cellBegin;
+
+    double _xMin;
+    double _yMin;
+    double _cellSize;
+    int _nCellsX;
+    int _nCellsY;
+  };
+
+}
+#endif
@@ -190,6 +190,12 @@ namespace eutelescope {
 
 	int cantorEncode(int X, int Y);
 	std::map<int, std::vector<int>> readNoisyPixelList(LCEvent* event, std::string const & noisyPixelCollectionName);
+
+	//! Writes the reference hit collection (DB) for the current geometry
+	/*! One EUTelReferenceHit per sensor plane is stored in a single event
+	 *  of the LCIO file fileName, in a collection named collectionName.
+	 */
+	void writeReferenceHitDB(std::string const & fileName, std::string const & collectionName);
 	
 	std::unique_ptr<EUTelClusterDataInterfacerBase> getClusterData(IMPL::TrackerDataImpl* const data, SparsePixelType type);
 	std::unique_ptr<EUTelClusterDataInterfacerBase> getClusterData(IMPL::TrackerDataImpl* const data, int type);
@@ -0,0 +1,105 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+#include "EUTelClusterFeatures.h"
+#include "EUTelVirtualCluster.h"
+
+// system includes <>
+#include <algorithm>
+#include <vector>
+
+using namespace eutelescope;
+
+EUTelClusterFeatures::EUTelClusterFeatures() :
+  _detectorID(-1), _totalCharge(0.), _seedCharge(0.), _quality(kGoodCluster),
+  _hasCoG(false), _xCoG(0.), _yCoG(0.),
+  _hasNoise(false), _clusterNoise(0.), _clusterSNR(0.), _seedSNR(0.),
+  _nChargeSize(), _nCharge(), _nxnChargeSize(), _nxnCharge(),
+  _nSNRSize(), _nSNR(), _nxnSNRSize(), _nxnSNR() {
+}
+
+void EUTelClusterFeatures::compute(const EUTelVirtualCluster & cluster, const EUTelClusterFeatureRequest & request) {
+
+  _detectorID  = cluster.getDetectorID();
+  _totalCharge = cluster.getTotalCharge();
+  _seedCharge  = cluster.getSeedCharge();
+  _quality     = cluster.getClusterQuality();
+
+  _hasCoG = request.centerOfGravity;
+  _xCoG = _yCoG = 0.;
+  if ( _hasCoG ) cluster.getCenterOfGravity( _xCoG, _yCoG );
+
+  // all the N pixel charges from a single sort of the pixel signals
+  _nChargeSize = request.nCharge;
+  _nCharge.clear();
+  if ( !_nChargeSize.empty() ) _nCharge = cluster.getClusterCharge( _nChargeSize );
+
+  _nxnChargeSize = request.nxnCharge;
+  _nxnCharge.resize( _nxnChargeSize.size() );
+  for ( size_t i = 0; i < _nxnChargeSize.size(); ++i ) {
+    _nxnCharge[i] = cluster.getClusterCharge( _nxnChargeSize[i], _nxnChargeSize[i] );
+  }
+
+  _hasNoise = request.noise;
+  _clusterNoise = _clusterSNR = _seedSNR = 0.;
+  _nSNRSize.clear();
+  _nSNR.clear();
+  _nxnSNRSize.clear();
+  _nxnSNR.clear();
+  if ( !_hasNoise ) return;
+
+  _clusterNoise = cluster.getClusterNoise();
+  _clusterSNR   = cluster.getClusterSNR();
+  _seedSNR      = cluster.getSeedSNR();
+
+  _nSNRSize = request.nSNR;
+  _nSNR.resize( _nSNRSize.size() );
+  for ( size_t i = 0; i < _nSNRSize.size(); ++i ) {
+    _nSNR[i] = cluster.getClusterSNR( _nSNRSize[i] );
+  }
+
+  _nxnSNRSize = request.nxnSNR;
+  _nxnSNR.resize( _nxnSNRSize.size() );
+  for ( size_t i = 0; i < _nxnSNRSize.size(); ++i ) {
+    _nxnSNR[i] = cluster.getClusterSNR( _nxnSNRSize[i], _nxnSNRSize[i] );
+  }
+}
+
+bool EUTelClusterFeatures::covers(const EUTelClusterFeatureRequest & request) const {
+  if ( _detectorID < 0 ) return false;
+  if ( request.centerOfGravity && !_hasCoG ) return false;
+  if ( request.noise && !_hasNoise ) return false;
+  return contains( _nChargeSize, request.nCharge ) && contains( _nxnChargeSize, request.nxnCharge )
+    && contains( _nSNRSize, request.nSNR ) && contains( _nxnSNRSize, request.nxnSNR );
+}
+
+void EUTelClusterFeatures::attach(EVENT::LCObject * pulse, EUTelClusterFeatures * features) {
+  EUTelClusterFeatures *& attached = pulse->ext<EUTelClusterFeaturesExtension>();
+  if ( attached == features ) return;
+  delete attached;
+  attached = features;
+}
+
+const EUTelClusterFeatures * EUTelClusterFeatures::get(EVENT::LCObject * pulse) {
+  return pulse->ext<EUTelClusterFeaturesExtension>();
+}
+
+float EUTelClusterFeatures::lookUp(const std::vector<int > & sizes, const std::vector<float > & values, int size) {
+  for ( size_t i = 0; i < sizes.size(); ++i ) {
+    if ( sizes[i] == size ) return values[i];
+  }
+  return 0.;
+}
+
+bool EUTelClusterFeatures::contains(const std::vector<int > & sizes, const std::vector<int > & requested) {
+  for ( size_t i = 0; i < requested.size(); ++i ) {
+    if ( std::find( sizes.begin(), sizes.end(), requested[i] ) == sizes.end() ) return false;
+  }
+  return true;
+}
@@ -0,0 +1,245 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+#include "EUTelFrameCache.h"
+
+// system includes <>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace eutelescope;
+
+namespace {
+
+  const char kFrameCacheMagic[8] = { 'E', 'U', 'T', 'F', 'R', 'M', 'S', '1' };
+  const std::uint32_t kFrameCacheVersion = 1;
+
+  //! Size of the blocks read from the ASCII files
+  const std::size_t kScannerBufferSize = 1 << 20;
+
+  //! Size and modification time of a file
+  bool sourceStat(const std::string & fileName, std::uint64_t & size, std::int64_t & time) {
+    struct stat fileStat;
+    if ( ::stat( fileName.c_str(), &fileStat ) != 0 ) return false;
+    size = fileStat.st_size;
+    time = fileStat.st_mtime;
+    return true;
+  }
+
+  inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+  }
+}
+
+EUTelAsciiNumberScanner::EUTelAsciiNumberScanner() :
+  _file(0), _buffer(), _position(0), _end(0) {
+}
+
+EUTelAsciiNumberScanner::~EUTelAsciiNumberScanner() {
+  close();
+}
+
+bool EUTelAsciiNumberScanner::open(const std::string & fileName) {
+  close();
+  _file = std::fopen( fileName.c_str(), "rb" );
+  if ( !_file ) return false;
+  _buffer.resize( kScannerBufferSize );
+  _position = _end = 0;
+  return true;
+}
+
+void EUTelAsciiNumberScanner::close() {
+  if ( _file ) std::fclose( _file );
+  _file = 0;
+  _position = _end = 0;
+}
+
+bool EUTelAsciiNumberScanner::fill() {
+  if ( !_file ) return false;
+  _position = 0;
+  _end = std::fread( &_buffer[0], 1, _buffer.size(), _file );
+  return _end > 0;
+}
+
+EUTelAsciiNumberScanner::Status EUTelAsciiNumberScanner::next(short & value) {
+
+  // skip the separators
+  while ( true ) {
+    if ( _position == _end && !fill() ) return kEnd;
+    if ( !isSpace( _buffer[_position] ) ) break;
+    ++_position;
+  }
+
+  bool negative = false;
+  if ( _buffer[_position] == '-' || _buffer[_position] == '+' ) {
+    negative = ( _buffer[_position] == '-' );
+    ++_position;
+  }
+
+  // the digits may continue in the next block
+  int result = 0;
+  int nDigits = 0;
+  while ( true ) {
+    if ( _position == _end && !fill() ) break;
+    const unsigned int digit = static_cast<unsigned char>( _buffer[_position] ) - '0';
+    if ( digit > 9 ) break;
+    result = 10 * result + static_cast<int>( digit );
+    if ( result > 32768 ) return kError;
+    ++nDigits;
+    ++_position;
+  }
+
+  if ( nDigits == 0 ) return kError;
+  if ( negative ) result = -result;
+  if ( result > 32767 ) return kError;
+  value = static_cast<short>( result );
+  return kValue;
+}
+
+EUTelAsciiNumberScanner::Status EUTelAsciiNumberScanner::next(short * values, std::size_t n, std::size_t & nRead) {
+  for ( nRead = 0; nRead < n; ++nRead ) {
+    const Status status = next( values[nRead] );
+    if ( status == kEnd && nRead == 0 ) return kEnd;
+    if ( status != kValue ) return kError;
+  }
+  return kValue;
+}
+
+EUTelFrameCacheWriter::EUTelFrameCacheWriter() :
+  _fileName(), _tmpFileName(), _file(0), _header() {
+}
+
+EUTelFrameCacheWriter::~EUTelFrameCacheWriter() {
+  discard();
+}
+
+bool EUTelFrameCacheWriter::open(const std::string & fileName, const std::string & sourceFileName, int nX, int nY) {
+
+  discard();
+
+  std::memset( &_header, 0, sizeof(_header) );
+  std::memcpy( _header.magic, kFrameCacheMagic, sizeof(kFrameCacheMagic) );
+  _header.version = kFrameCacheVersion;
+  _header.headerSize = sizeof(_header);
+  _header.nX = nX;
+  _header.nY = nY;
+  if ( nX <= 0 || nY <= 0 || !sourceStat( sourceFileName, _header.sourceSize, _header.sourceTime ) ) return false;
+
+  _fileName = fileName;
+  _tmpFileName = fileName + ".tmp";
+  _file = std::fopen( _tmpFileName.c_str(), "wb" );
+  if ( !_file ) return false;
+
+  // the header is written again with the number of frames in close()
+  if ( std::fwrite( &_header, sizeof(_header), 1, _file ) != 1 ) {
+    discard();
+    return false;
+  }
+  return true;
+}
+
+bool EUTelFrameCacheWriter::addFrame(const short * frame) {
+  if ( !_file ) return false;
+  const std::size_t frameSize = static_cast<std::size_t>( _header.nX ) * _header.nY;
+  if ( std::fwrite( frame, sizeof(short), frameSize, _file ) != frameSize ) {
+    discard();
+    return false;
+  }
+  ++_header.nFrames;
+  return true;
+}
+
+bool EUTelFrameCacheWriter::close() {
+
+  if ( !_file ) return false;
+
+  bool ok = std::fseek( _file, 0, SEEK_SET ) == 0
+    && std::fwrite( &_header, sizeof(_header), 1, _file ) == 1;
+  ok = ( std::fclose( _file ) == 0 ) && ok;
+  _file = 0;
+
+  ok = ok && std::rename( _tmpFileName.c_str(), _fileName.c_str() ) == 0;
+  if ( !ok ) std::remove( _tmpFileName.c_str() );
+  return ok;
+}
+
+void EUTelFrameCacheWriter::discard() {
+  if ( !_file ) return;
+  std::fclose( _file );
+  _file = 0;
+  std::remove( _tmpFileName.c_str() );
+}
+
+EUTelFrameCacheReader::EUTelFrameCacheReader() :
+  _data(0), _size(0), _header(0), _frames(0), _frameSize(0) {
+}
+
+EUTelFrameCacheReader::~EUTelFrameCacheReader() {
+  close();
+}
+
+bool EUTelFrameCacheReader::open(const std::string & fileName, const std::string & sourceFileName, int nX, int nY) {
+
+  close();
+
+  std::uint64_t sourceSize;
+  std::int64_t sourceTime;
+  if ( !sourceStat( sourceFileName, sourceSize, sourceTime ) ) return false;
+
+  const int fd = ::open( fileName.c_str(), O_RDONLY );
+  if ( fd < 0 ) return false;
+
+  struct stat fileStat;
+  if ( ::fstat( fd, &fileStat ) != 0 || static_cast<std::size_t>( fileStat.st_size ) < sizeof(EUTelFrameCacheHeader) ) {
+    ::close( fd );
+    return false;
+  }
+
+  void * mapped = ::mmap( 0, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+  // the mapping stays valid after closing the descriptor
+  ::close( fd );
+  if ( mapped == MAP_FAILED ) return false;
+
+  _data = static_cast<const char *>( mapped );
+  _size = fileStat.st_size;
+  _header = reinterpret_cast<const EUTelFrameCacheHeader *>( _data );
+  _frameSize = static_cast<std::uint64_t>( nX > 0 ? nX : 0 ) * ( nY > 0 ? nY : 0 );
+
+  // check the signature, the source and that all the frames are there
+  const bool valid = std::memcmp( _header->magic, kFrameCacheMagic, sizeof(kFrameCacheMagic) ) == 0
+    && _header->version == kFrameCacheVersion
+    && _header->headerSize == sizeof(EUTelFrameCacheHeader)
+    && _header->nX == nX && _header->nY == nY && _frameSize > 0
+    && _header->sourceSize == sourceSize && _header->sourceTime == sourceTime
+    && _header->headerSize + _header->nFrames * _frameSize * sizeof(short) <= _size;
+  if ( !valid ) {
+    close();
+    return false;
+  }
+
+  _frames = reinterpret_cast<const short *>( _data + _header->headerSize );
+  return true;
+}
+
+void EUTelFrameCacheReader::close() {
+  if ( _data ) ::munmap( const_cast<char *>( _data ), _size );
+  _data = 0;
+  _size = 0;
+  _header = 0;
+  _frames = 0;
+  _frameSize = 0;
+}
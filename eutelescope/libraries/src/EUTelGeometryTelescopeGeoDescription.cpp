@@ -9,6 +9,7 @@
 #include <string>
 #include <cstring>
 #include <cmath>
+#include <limits>
 #include <sstream>
 
 // MARLIN
@@ -55,74 +56,109 @@ EUTelGeometryTelescopeGeoDescription& EUTelGeometryTelescopeGeoDescription::getI
 	return instance;
 }
 
-//Note  that to determine these axis we MUST use the geometry class after initialisation. By this I mean directly from the root file create.
-TVector3 EUTelGeometryTelescopeGeoDescription::siPlaneNormal( int planeID )
+EUTelGeometrySnapshot::EUTelGeometrySnapshot(std::vector<Plane> planes):
+_planes(std::move(planes)),
+_index()
 {
-	std::map<int, TVector3>::iterator mapIt = _planeNormalMap.find(planeID);
-	if( mapIt != _planeNormalMap.end() ) {
-		return mapIt->second;
-	} else {
-		std::vector<int>::iterator it = std::find(_sensorIDVec.begin(), _sensorIDVec.end(), planeID);
-		if( it != _sensorIDVec.end() ) {
-			std::array<double,3> const zAxisLocal {{0,0,1}};
-			std::array<double,3> zAxisGlobal; 
-			local2MasterVec(planeID, zAxisLocal, zAxisGlobal); 
-			TVector3 normVec(zAxisGlobal.data());
-			_planeNormalMap[planeID] = normVec;
-			return normVec;
+	for(size_t i = 0; i < _planes.size(); i++) {
+		int sensorID = _planes[i].sensorID;
+		if( sensorID < 0 ) continue;
+		if( sensorID >= static_cast<int>(_index.size()) ) _index.resize(sensorID+1, -1);
+		_index[sensorID] = static_cast<int>(i);
+	}
+}
+
+EUTelGeometrySnapshot::Plane const & EUTelGeometrySnapshot::planeOfSensor(int sensorID) const {
+	int i = index(sensorID);
+	if( i < 0 ) {
+		std::stringstream ss;
+		ss << sensorID;
+		std::string errMsg = "EUTelGeometrySnapshot::planeOfSensor: Could not find planeID: " + ss.str();
+		throw InvalidGeometryException(errMsg);
+	}
+	return _planes[i];
+}
+
+void EUTelGeometrySnapshot::local2Master(size_t index, const double localPos[], double globalPos[]) const {
+	Plane const & p = _planes[index];
+	Eigen::Vector3d global = p.rotation*Eigen::Vector3d(localPos[0], localPos[1], localPos[2]) + p.offset;
+	globalPos[0] = global(0); globalPos[1] = global(1); globalPos[2] = global(2);
+}
+
+void EUTelGeometrySnapshot::master2Local(size_t index, const double globalPos[], double localPos[]) const {
+	Plane const & p = _planes[index];
+	Eigen::Vector3d local = p.rotation.transpose()*(Eigen::Vector3d(globalPos[0], globalPos[1], globalPos[2]) - p.offset);
+	localPos[0] = local(0); localPos[1] = local(1); localPos[2] = local(2);
+}
+
+EUTelPlane & EUTelGeometryTelescopeGeoDescription::planeForUpdate(int sensorID) {
+	if( sensorID < 0 ) {
+		throw std::out_of_range("EUTelGeometryTelescopeGeoDescription: negative sensor ID");
+	}
+	if( sensorID >= static_cast<int>(_planeIndex.size()) ) _planeIndex.resize(sensorID+1, -1);
+	if( _planeIndex[sensorID] < 0 ) {
+		_planeIndex[sensorID] = static_cast<int>(_planeSetup.size());
+		_planeSetup.push_back(EUTelPlane());
+	}
+	_isTGeoOutdated = _isGeoInitialized;
+	return _planeSetup[_planeIndex[sensorID]];
+}
+
+//Once the TGeo geometry is initialised the transformations are taken from it, so that they agree with local2Master.
+//Before that, or after a plane was changed, they are computed from the plane parameters.
+std::shared_ptr<const EUTelGeometrySnapshot> EUTelGeometryTelescopeGeoDescription::getSnapshot() {
+	if( _snapshot ) return _snapshot;
+
+	std::vector<EUTelGeometrySnapshot::Plane> planes;
+	planes.reserve(_sensorIDVec.size());
+
+	for(auto sensorID: _sensorIDVec) {
+		EUTelGeometrySnapshot::Plane p;
+		p.sensorID = sensorID;
+		p.setup = plane(sensorID);
+
+		std::map<int, std::string>::const_iterator pathIt = _planePath.find(sensorID);
+		if( _isGeoInitialized && !_isTGeoOutdated && pathIt != _planePath.end() ) {
+			_geoManager->cd( pathIt->second.c_str() );
+			TGeoHMatrix const * matrix = _geoManager->GetCurrentMatrix();
+			const double* rot = matrix->GetRotationMatrix();
+			const double* trans = matrix->GetTranslation();
+			p.rotation << rot[0], rot[1], rot[2], rot[3], rot[4], rot[5], rot[6], rot[7], rot[8];
+			p.offset << trans[0], trans[1], trans[2];
 		} else {
-			std::stringstream ss;
-			ss << planeID;
-			std::string errMsg = "EUTelGeometryTelescopeGeoDescription::siPlaneNormal: Could not find planeID: " + ss.str();
-			throw InvalidGeometryException(errMsg);
+			//same composition as in translateSiPlane2TGeo: the z axis is flipped with the determinant
+			Eigen::Matrix3d flipMat;
+			flipMat << 	p.setup.f1,	p.setup.f2,	0,
+					p.setup.f3,	p.setup.f4,	0,
+					0,		0,		p.setup.f1*p.setup.f4 - p.setup.f2*p.setup.f3;
+			p.rotation = rotationMatrixFromAngles(sensorID)*flipMat;
+			p.offset << p.setup.xPos, p.setup.yPos, p.setup.zPos;
 		}
+		p.xAxis = p.rotation.col(0);
+		p.yAxis = p.rotation.col(1);
+		p.normal = p.rotation.col(2);
+
+		planes.push_back(p);
 	}
+
+	_snapshot = std::make_shared<const EUTelGeometrySnapshot>(std::move(planes));
+	return _snapshot;
+}
+
+//The axes come from the snapshot: after initialisation they are taken from the TGeo node, before that from the flip matrix and the rotation angles.
+TVector3 EUTelGeometryTelescopeGeoDescription::siPlaneNormal( int planeID )
+{
+	return TVector3( getSnapshot()->planeOfSensor(planeID).normal.data() );
 }
 
 /**TODO: Replace me: NOP*/
 TVector3 EUTelGeometryTelescopeGeoDescription::siPlaneXAxis( int planeID ) {
-	std::map<int, TVector3>::iterator mapIt = _planeXMap.find(planeID);
-	if( mapIt != _planeXMap.end() ) {
-		return mapIt->second;
-	} else {
-		std::vector<int>::iterator it = std::find(_sensorIDVec.begin(), _sensorIDVec.end(), planeID);
-		if( it != _sensorIDVec.end() ) {
-			std::array<double,3> const xAxisLocal {{1,0,0}};
-			std::array<double,3> xAxisGlobal; 
-			local2MasterVec(planeID, xAxisLocal, xAxisGlobal); 
-			TVector3 xVec(xAxisGlobal.data());
-			_planeXMap[planeID] = xVec;
-			return xVec;
-		} else {
-			std::stringstream ss;
-			ss << planeID;
-			std::string errMsg = "EUTelGeometryTelescopeGeoDescription::siPlaneXAxis: Could not find planeID: " + ss.str();
-			throw InvalidGeometryException(errMsg);
-		}
-	}
+	return TVector3( getSnapshot()->planeOfSensor(planeID).xAxis.data() );
 }
 
 /**TODO: Replace me: NOP*/
 TVector3 EUTelGeometryTelescopeGeoDescription::siPlaneYAxis( int planeID ) {
-	std::map<int, TVector3>::iterator mapIt = _planeYMap.find(planeID);
-	if( mapIt != _planeYMap.end() ) {
-		return mapIt->second;
-	} else {
-		std::vector<int>::iterator it = std::find(_sensorIDVec.begin(), _sensorIDVec.end(), planeID);
-		if( it != _sensorIDVec.end() ) {
-			std::array<double,3> const yAxisLocal {{0,1,0}};
-			std::array<double,3> yAxisGlobal; 
-			local2MasterVec(planeID, yAxisLocal, yAxisGlobal); 
-			TVector3 yVec(yAxisGlobal.data());
-			_planeYMap[planeID] = yVec;
-			return yVec;
-		} else {
-			std::stringstream ss;
-			ss << planeID;
-			std::string errMsg = "EUTelGeometryTelescopeGeoDescription::siPlaneYAxis: Could not find planeID: " + ss.str(); 
-			throw InvalidGeometryException(errMsg);
-		}
-	}
+	return TVector3( getSnapshot()->planeOfSensor(planeID).yAxis.data() );
 }
 
 void EUTelGeometryTelescopeGeoDescription::readSiPlanesLayout() {
@@ -178,7 +214,7 @@ void EUTelGeometryTelescopeGeoDescription::readSiPlanesLayout() {
 		//GEAR uses mm wheras TGeo will use cm
 		thisPlane.radLength	= _siPlanesLayerLayout->getSensitiveRadLength(iPlane)/10;
 
-		_planeSetup[_siPlanesLayerLayout->getID(iPlane)] = thisPlane;
+		planeForUpdate(_siPlanesLayerLayout->getID(iPlane)) = thisPlane;
 	}
 
 	_sensorIDVec.clear();
@@ -285,7 +321,7 @@ void EUTelGeometryTelescopeGeoDescription::readTrackerPlanesLayout() {
 			//GEAR uses mm wheras TGeo will use cm
 			thisPlane.radLength	= 10;//sensitiveLayer.getRadLength()/10;
 
-			_planeSetup[sensorID] = thisPlane;
+			planeForUpdate(sensorID) = thisPlane;
 
 			_sensorIDVec.push_back(sensorID);
 
@@ -319,8 +355,17 @@ _trackerPlanesParameters(nullptr),
 _trackerPlanesLayerLayout(nullptr),
 _sensorIDVec(),
 _nPlanes(0),
+_planeSetup(),
+_planeIndex(),
+_snapshot(),
 _isGeoInitialized(false),
-_geoManager(nullptr)
+_isTGeoOutdated(false),
+_geoManager(nullptr),
+_planeRadMap(),
+_planeMaterial(),
+_materialBinsX(10),
+_materialBinsY(10),
+_fieldFree(-1)
 {
 	//Set ROOTs verbosity to only display error messages or higher (so info will not be streamed to stderr)
 	gErrorIgnoreLevel =  kError;  
@@ -356,6 +401,7 @@ void EUTelGeometryTelescopeGeoDescription::readGear() {
 		streamlog_out(ERROR5) << "Your GEAR file neither contains SiPlanes nor TrackerPlanes and thus is not valid" << std::endl;
 		throw eutelescope::InvalidGeometryException("GEAR file invalid, does not contain SiPlanes nor TrackerPlanes");
 	}
+	clearMemoizedValues();
 }
 
 EUTelGeometryTelescopeGeoDescription::~EUTelGeometryTelescopeGeoDescription() {
@@ -377,6 +423,8 @@ void EUTelGeometryTelescopeGeoDescription::initializeTGeoDescription( std::strin
     }
 
     _geoManager->CloseGeometry();
+    clearMemoizedValues();
+    buildMaterialMap();
 }
 
 /**
@@ -570,6 +618,8 @@ void EUTelGeometryTelescopeGeoDescription::initializeTGeoDescription( std::strin
    }
     _geoManager->CloseGeometry();
     _isGeoInitialized = true;
+    clearMemoizedValues();
+    buildMaterialMap();
     // Dump ROOT TGeo object into file
     if ( dumpRoot ) _geoManager->Export( geomName.c_str() );
     return;
@@ -771,6 +821,8 @@ double EUTelGeometryTelescopeGeoDescription::FindRad(Eigen::Vector3d const & sta
 
 double EUTelGeometryTelescopeGeoDescription::planeRadLengthGlobalIncidence(int planeID, Eigen::Vector3d incidenceDir) {
 	
+	if( hasMaterialMap() ) return planeRadLength(planeID, 0, 0, incidenceDir);
+
 	incidenceDir.normalize();
 	double normRad;
 	
@@ -800,7 +852,9 @@ double EUTelGeometryTelescopeGeoDescription::planeRadLengthLocalIncidence(int pl
 	double normRad;
 
 	std::map<int, double>::iterator mapIt = _planeRadMap.find(planeID);
-	if( mapIt != _planeRadMap.end() ) {
+	if( hasMaterialMap() ) {
+		normRad = materialOfSensor(planeID).at(0, 0);
+	} else if( mapIt != _planeRadMap.end() ) {
 		normRad = mapIt->second;
 	} else {
 		Eigen::Vector3d planePosition(siPlaneXPosition(planeID), siPlaneYPosition(planeID), siPlaneZPosition(planeID));
@@ -821,6 +875,336 @@ double EUTelGeometryTelescopeGeoDescription::planeRadLengthLocalIncidence(int pl
 
 
 
+double EUTelGeometryTelescopeGeoDescription::PlaneMaterial::at(double x, double y) const {
+	double fx = nBinsX > 1 ? std::min( std::max( (x - xFirst)/xStep, 0. ), nBinsX - 1. ) : 0.;
+	double fy = nBinsY > 1 ? std::min( std::max( (y - yFirst)/yStep, 0. ), nBinsY - 1. ) : 0.;
+	int ix = std::min( static_cast<int>(fx), std::max(nBinsX - 2, 0) );
+	int iy = std::min( static_cast<int>(fy), std::max(nBinsY - 2, 0) );
+	double tx = fx - ix;
+	double ty = fy - iy;
+	int ix1 = std::min( ix + 1, nBinsX - 1 );
+	int iy1 = std::min( iy + 1, nBinsY - 1 );
+
+	return	(1 - ty)*( (1 - tx)*radLength[iy*nBinsX + ix]  + tx*radLength[iy*nBinsX + ix1] ) +
+		ty*( (1 - tx)*radLength[iy1*nBinsX + ix] + tx*radLength[iy1*nBinsX + ix1] );
+}
+
+EUTelGeometryTelescopeGeoDescription::PlaneMaterial const & EUTelGeometryTelescopeGeoDescription::materialOfSensor(int planeID) {
+	int i = getSnapshot()->index(planeID);
+	if( i < 0 || i >= static_cast<int>(_planeMaterial.size()) ) {
+		std::stringstream ss;
+		ss << planeID;
+		std::string errMsg = "EUTelGeometryTelescopeGeoDescription::materialOfSensor: Could not find planeID: " + ss.str();
+		throw InvalidGeometryException(errMsg);
+	}
+	return _planeMaterial[i];
+}
+
+void EUTelGeometryTelescopeGeoDescription::buildMaterialMap() {
+	_planeMaterial.clear();
+
+	std::shared_ptr<const EUTelGeometrySnapshot> geometry = getSnapshot();
+	std::vector<EUTelGeometrySnapshot::Plane> const & planes = geometry->planes();
+
+	for(size_t i = 0; i < planes.size(); i++) {
+		EUTelGeometrySnapshot::Plane const & p = planes[i];
+		PlaneMaterial material;
+
+		material.nBinsX = std::max(_materialBinsX, 1);
+		material.nBinsY = std::max(_materialBinsY, 1);
+		material.xStep = p.setup.xSize/material.nBinsX;
+		material.yStep = p.setup.ySize/material.nBinsY;
+		material.xFirst = -0.5*p.setup.xSize + 0.5*material.xStep;
+		material.yFirst = -0.5*p.setup.ySize + 0.5*material.yStep;
+		material.radLength.resize(material.nBinsX*material.nBinsY);
+
+		//We have to propagate halfway to to front and halfway back + a minor safety margin
+		double halfDepth = 0.51*p.setup.zSize;
+		for(int iy = 0; iy < material.nBinsY; iy++) {
+			for(int ix = 0; ix < material.nBinsX; ix++) {
+				Eigen::Vector3d local(material.xFirst + ix*material.xStep, material.yFirst + iy*material.yStep, 0);
+				Eigen::Vector3d center = p.rotation*local + p.offset;
+				material.radLength[iy*material.nBinsX + ix] = FindRad(center - halfDepth*p.normal, center + halfDepth*p.normal);
+			}
+		}
+
+		material.gapRadLength = 0;
+		if( i + 1 < planes.size() ) {
+			EUTelGeometrySnapshot::Plane const & next = planes[i+1];
+			Eigen::Vector3d start = p.offset;
+			start(2) += halfDepth;
+			Eigen::Vector3d end = start;
+			end(2) = next.offset(2) - 0.51*next.setup.zSize;
+			if( end(2) > start(2) ) material.gapRadLength = FindRad(start, end);
+		}
+
+		streamlog_out(DEBUG5) << "Material map of sensor " << p.sensorID << ": X/X0 at center " << material.at(0, 0)
+				      << ", to the next plane " << material.gapRadLength << std::endl;
+
+		_planeMaterial.push_back(material);
+	}
+}
+
+double EUTelGeometryTelescopeGeoDescription::planeRadLength(int planeID, double localX, double localY, Eigen::Vector3d const & incidenceDir) {
+	if( !hasMaterialMap() ) return planeRadLengthGlobalIncidence(planeID, incidenceDir);
+
+	std::shared_ptr<const EUTelGeometrySnapshot> geometry = getSnapshot();
+	EUTelGeometrySnapshot::Plane const & p = geometry->planeOfSensor(planeID);
+	double scale = std::abs(incidenceDir.normalized().dot(p.normal));
+	return materialOfSensor(planeID).at(localX, localY)/scale;
+}
+
+double EUTelGeometryTelescopeGeoDescription::radLengthToNextPlane(int planeID, Eigen::Vector3d const & incidenceDir) {
+	std::shared_ptr<const EUTelGeometrySnapshot> geometry = getSnapshot();
+	int index = geometry->index(planeID);
+	if( index < 0 || index + 1 >= static_cast<int>(geometry->size()) ) return 0;
+
+	double gapRadLength = 0;
+	if( hasMaterialMap() ) {
+		gapRadLength = _planeMaterial[index].gapRadLength;
+	} else {
+		EUTelGeometrySnapshot::Plane const & p = geometry->plane(index);
+		EUTelGeometrySnapshot::Plane const & next = geometry->plane(index+1);
+		Eigen::Vector3d start = p.offset;
+		start(2) += 0.51*p.setup.zSize;
+		Eigen::Vector3d end = start;
+		end(2) = next.offset(2) - 0.51*next.setup.zSize;
+		if( end(2) > start(2) ) gapRadLength = FindRad(start, end);
+	}
+	return gapRadLength/std::abs(incidenceDir.normalized()(2));
+}
+
+float EUTelGeometryTelescopeGeoDescription::calculateTotalRadiationLengthAndWeights(const double startD[3], const double endD[3], std::map<const int,double>& mapSensor, std::map<const int,double>& mapAir) {
+	Eigen::Vector3d start(startD[0], startD[1], startD[2]);
+	Eigen::Vector3d end(endD[0], endD[1], endD[2]);
+	Eigen::Vector3d dir = end - start;
+	if( dir(2) == 0 ) return 0;
+
+	std::shared_ptr<const EUTelGeometrySnapshot> geometry = getSnapshot();
+	double zMin = std::min(start(2), end(2));
+	double zMax = std::max(start(2), end(2));
+
+	double total = 0;
+	int first = -1;
+	for(size_t i = 0; i < geometry->size(); i++) {
+		EUTelGeometrySnapshot::Plane const & p = geometry->plane(i);
+		double z = p.offset(2);
+		if( z < zMin || z > zMax ) continue;
+
+		double denom = p.normal.dot(dir);
+		if( denom == 0 ) continue;
+		Eigen::Vector3d crossing = start + ( p.normal.dot(p.offset - start)/denom )*dir;
+		Eigen::Vector3d local = p.rotation.transpose()*(crossing - p.offset);
+
+		double sensorRad = planeRadLength(p.sensorID, local(0), local(1), dir);
+		mapSensor[p.sensorID] = sensorRad;
+		total += sensorRad;
+
+		//air up to the next plane, or the part of it before the end of the line
+		double airRad = 0;
+		if( i + 1 < geometry->size() ) {
+			double zNext = geometry->plane(i+1).offset(2);
+			double fraction = zNext > zMax ? (zMax - z)/(zNext - z) : 1.;
+			airRad = fraction*radLengthToNextPlane(p.sensorID, dir);
+		}
+		//air from the beginning of the line to the first crossed plane
+		if( first < 0 ) {
+			first = static_cast<int>(i);
+			if( i > 0 ) {
+				EUTelGeometrySnapshot::Plane const & previous = geometry->plane(i-1);
+				double zPrevious = previous.offset(2);
+				double fraction = zPrevious < zMin ? (z - zMin)/(z - zPrevious) : 1.;
+				airRad += fraction*radLengthToNextPlane(previous.sensorID, dir);
+			}
+		}
+		mapAir[p.sensorID] = airRad;
+		total += airRad;
+	}
+
+	if( total > 0 ) {
+		for(auto& sensor: mapSensor) sensor.second /= total;
+		for(auto& air: mapAir) air.second /= total;
+	}
+	return static_cast<float>(total);
+}
+
+Eigen::Vector3d EUTelGeometryTelescopeGeoDescription::fieldAt(Eigen::Vector3d const & position) {
+	if( _gearManager == nullptr ) return Eigen::Vector3d::Zero();
+	try {
+		gear::Vector3D field = getMagneticField().at( gear::Vector3D(position(0), position(1), position(2)) );
+		return Eigen::Vector3d(field.x(), field.y(), field.z());
+	} catch(gear::UnknownParameterException& e) {
+		return Eigen::Vector3d::Zero();
+	}
+}
+
+bool EUTelGeometryTelescopeGeoDescription::isFieldFree() {
+	if( _fieldFree < 0 ) {
+		bool fieldFree = fieldAt(Eigen::Vector3d::Zero()).norm() < 1.E-9;
+		std::shared_ptr<const EUTelGeometrySnapshot> geometry = getSnapshot();
+		for(size_t i = 0; i < geometry->size() && fieldFree; i++) {
+			fieldFree = fieldAt(geometry->plane(i).offset).norm() < 1.E-9;
+		}
+		_fieldFree = fieldFree ? 1 : 0;
+		streamlog_out(DEBUG5) << "Tracks are propagated along " << (fieldFree ? "straight lines" : "helices") << std::endl;
+	}
+	return _fieldFree == 1;
+}
+
+void EUTelGeometryTelescopeGeoDescription::propagateHelix(Eigen::Vector3d const & position, Eigen::Vector3d const & momentum, double beamQ, 
+	Eigen::Vector3d const & field, double arcLength, Eigen::Vector3d& outputPosition, Eigen::Vector3d& outputMomentum) {
+	const double p = momentum.norm();
+	const double H = field.norm();
+	//curvature in 1/mm for p in GeV and H in Tesla
+	const double omega = ( p > 0 ) ? -0.299792458E-3*beamQ*H/p : 0;
+
+	if( std::abs(omega*arcLength) < 1.E-12 ) {
+		outputPosition = position + (arcLength/p)*momentum;
+		outputMomentum = momentum;
+		return;
+	}
+
+	const Eigen::Vector3d h = field/H;
+	const Eigen::Vector3d t = momentum/p;
+	const Eigen::Vector3d tParallel = t.dot(h)*h;
+	const Eigen::Vector3d tPerpendicular = t - tParallel;
+	const Eigen::Vector3d hCrossT = h.cross(tPerpendicular);
+	const double phi = omega*arcLength;
+
+	outputPosition = position + arcLength*tParallel + (std::sin(phi)/omega)*tPerpendicular + ((1 - std::cos(phi))/omega)*hCrossT;
+	outputMomentum = p*( tParallel + std::cos(phi)*tPerpendicular + std::sin(phi)*hCrossT );
+}
+
+bool EUTelGeometryTelescopeGeoDescription::arcLengthToPlane(EUTelGeometrySnapshot::Plane const & p, Eigen::Vector3d const & position,
+	Eigen::Vector3d const & momentum, double beamQ, Eigen::Vector3d const & field, double& arcLength) {
+	const double pMag = momentum.norm();
+	if( pMag == 0 ) return false;
+	const Eigen::Vector3d t = momentum/pMag;
+	const double c = p.normal.dot(position - p.offset);
+	const double b = p.normal.dot(t);
+	const double H = field.norm();
+	const double omega = -0.299792458E-3*beamQ*H/pMag;
+
+	//straight line, exact
+	if( H == 0 || omega == 0 ) {
+		if( std::abs(b) < 1.E-12 ) return false;
+		arcLength = -c/b;
+		return true;
+	}
+
+	//helix: start from the second order expansion a*s^2 + b*s + c = 0 ...
+	const double a = 0.5*omega*p.normal.dot( (field/H).cross(t) );
+	double s;
+	if( std::abs(a) < 1.E-15 ) {
+		if( std::abs(b) < 1.E-12 ) return false;
+		s = -c/b;
+	} else {
+		const double discriminant = b*b - 4*a*c;
+		if( discriminant < 0 ) return false;
+		const double s1 = (-b + std::sqrt(discriminant))/(2*a);
+		const double s2 = (-b - std::sqrt(discriminant))/(2*a);
+		s = std::abs(s1) < std::abs(s2) ? s1 : s2;
+	}
+
+	//... and refine it on the exact helix
+	Eigen::Vector3d x, m;
+	for(int iteration = 0; iteration < 10; iteration++) {
+		propagateHelix(position, momentum, beamQ, field, s, x, m);
+		const double slope = p.normal.dot(m)/pMag;
+		if( std::abs(slope) < 1.E-12 ) return false;
+		const double step = p.normal.dot(x - p.offset)/slope;
+		s -= step;
+		if( std::abs(step) < 1.E-9 ) break;
+	}
+	arcLength = s;
+	return true;
+}
+
+bool EUTelGeometryTelescopeGeoDescription::findIntersectionWithCertainID(float x0, float y0, float z0, float px, float py, float pz,
+	float beamQ, int nextPlaneID, float outputPosition[], TVector3& outputMomentum, float& arcLength, int& newNextPlaneID) {
+	newNextPlaneID = -999;
+
+	std::shared_ptr<const EUTelGeometrySnapshot> geometry = getSnapshot();
+	int index = geometry->index(nextPlaneID);
+	if( index < 0 ) return false;
+
+	const Eigen::Vector3d position(x0, y0, z0);
+	const Eigen::Vector3d momentum(px, py, pz);
+	const Eigen::Vector3d field = isFieldFree() ? Eigen::Vector3d::Zero() : fieldAt(position);
+
+	double s;
+	if( !arcLengthToPlane(geometry->plane(index), position, momentum, beamQ, field, s) ) return false;
+
+	Eigen::Vector3d newPosition, newMomentum;
+	propagateHelix(position, momentum, beamQ, field, s, newPosition, newMomentum);
+	for(int i = 0; i < 3; i++) outputPosition[i] = newPosition(i);
+	outputMomentum.SetXYZ(newMomentum(0), newMomentum(1), newMomentum(2));
+	arcLength = s;
+	newNextPlaneID = nextPlaneID;
+	return true;
+}
+
+int EUTelGeometryTelescopeGeoDescription::findIntersectionsWithPlane(int planeID, std::vector<double> const & positions,
+	std::vector<double> const & momenta, float beamQ, std::vector<double>& outputPositions, std::vector<double>& outputMomenta,
+	std::vector<double>& arcLengths) {
+	const size_t nTracks = std::min(positions.size(), momenta.size())/3;
+	outputPositions.assign(3*nTracks, 0);
+	outputMomenta.assign(3*nTracks, 0);
+	arcLengths.assign(nTracks, std::numeric_limits<double>::quiet_NaN());
+
+	std::shared_ptr<const EUTelGeometrySnapshot> geometry = getSnapshot();
+	int index = geometry->index(planeID);
+	if( index < 0 ) return 0;
+	EUTelGeometrySnapshot::Plane const & p = geometry->plane(index);
+
+	int nCrossing = 0;
+	if( isFieldFree() ) {
+		const double nx = p.normal(0), ny = p.normal(1), nz = p.normal(2);
+		const double planeDistance = p.normal.dot(p.offset);
+		for(size_t i = 0; i < nTracks; i++) {
+			const double* x = &positions[3*i];
+			const double* m = &momenta[3*i];
+			const double pMag = std::sqrt(m[0]*m[0] + m[1]*m[1] + m[2]*m[2]);
+			const double b = nx*m[0] + ny*m[1] + nz*m[2];
+			if( std::abs(b) < 1.E-12*pMag || pMag == 0 ) continue;
+			const double t = (planeDistance - nx*x[0] - ny*x[1] - nz*x[2])/b;
+			for(int j = 0; j < 3; j++) {
+				outputPositions[3*i+j] = x[j] + t*m[j];
+				outputMomenta[3*i+j] = m[j];
+			}
+			arcLengths[i] = t*pMag;
+			nCrossing++;
+		}
+	} else {
+		for(size_t i = 0; i < nTracks; i++) {
+			const Eigen::Vector3d position(positions[3*i], positions[3*i+1], positions[3*i+2]);
+			const Eigen::Vector3d momentum(momenta[3*i], momenta[3*i+1], momenta[3*i+2]);
+			const Eigen::Vector3d field = fieldAt(position);
+			double s;
+			if( !arcLengthToPlane(p, position, momentum, beamQ, field, s) ) continue;
+			Eigen::Vector3d newPosition, newMomentum;
+			propagateHelix(position, momentum, beamQ, field, s, newPosition, newMomentum);
+			for(int j = 0; j < 3; j++) {
+				outputPositions[3*i+j] = newPosition(j);
+				outputMomenta[3*i+j] = newMomentum(j);
+			}
+			arcLengths[i] = s;
+			nCrossing++;
+		}
+	}
+	return nCrossing;
+}
+
+TVector3 EUTelGeometryTelescopeGeoDescription::getXYZMomentumfromArcLength(TVector3 momentum, TVector3 globalPositionStart, float charge, float arcLength) {
+	const Eigen::Vector3d position(globalPositionStart.X(), globalPositionStart.Y(), globalPositionStart.Z());
+	const Eigen::Vector3d startMomentum(momentum.X(), momentum.Y(), momentum.Z());
+	if( isFieldFree() ) return momentum;
+
+	Eigen::Vector3d newPosition, newMomentum;
+	propagateHelix(position, startMomentum, charge, fieldAt(position), arcLength, newPosition, newMomentum);
+	return TVector3(newMomentum(0), newMomentum(1), newMomentum(2));
+}
+
 void EUTelGeometryTelescopeGeoDescription::updateSiPlanesLayout() {
 	gear::SiPlanesParameters* siplanesParameters = const_cast< gear::SiPlanesParameters*> (&( _gearManager->getSiPlanesParameters()));
 	gear::SiPlanesLayerLayout* siplanesLayerLayout = const_cast< gear::SiPlanesLayerLayout*> (&(_siPlanesParameters->getSiPlanesLayerLayout()));
@@ -0,0 +1,274 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+#include "EUTelHitCache.h"
+
+// system includes <>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace eutelescope;
+
+namespace {
+
+  const char kHitCacheMagic[8] = { 'E', 'U', 'T', 'H', 'I', 'T', 'S', '1' };
+  const std::uint32_t kHitCacheVersion = 1;
+
+  //! Rounds up to the next multiple of 8
+  std::uint64_t align8(std::uint64_t offset) {
+    return ( offset + 7 ) & ~static_cast<std::uint64_t>(7);
+  }
+
+  //! Size in bytes of the elements of a section
+  std::uint64_t elementSize(int iColumn) {
+    return iColumn == EUTelHitCacheHeader::kHitBegin ? sizeof(std::uint64_t) : 4;
+  }
+
+  //! Writes zeros up to the next multiple of 8
+  bool pad8(std::FILE * file, std::uint64_t & position) {
+    static const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    const std::uint64_t aligned = align8(position);
+    if ( aligned == position ) return true;
+    const bool ok = std::fwrite( zeros, 1, aligned - position, file ) == aligned - position;
+    position = aligned;
+    return ok;
+  }
+}
+
+EUTelHitCacheFileWriter::EUTelHitCacheFileWriter() :
+  _fileName(),
+  _runNumber(),
+  _eventNumber(),
+  _hitBegin(),
+  _nHits(0),
+  _columnFiles() {
+}
+
+EUTelHitCacheFileWriter::~EUTelHitCacheFileWriter() {
+  if ( !_columnFiles.empty() ) close();
+}
+
+bool EUTelHitCacheFileWriter::open(const std::string & fileName) {
+
+  if ( !_columnFiles.empty() ) close();
+
+  _fileName = fileName;
+  _runNumber.clear();
+  _eventNumber.clear();
+  _hitBegin.assign(1, 0);
+  _nHits = 0;
+
+  for ( int iColumn = EUTelHitCacheHeader::kX; iColumn < EUTelHitCacheHeader::kNColumns; ++iColumn ) {
+    std::FILE * file = std::tmpfile();
+    if ( !file ) {
+      for ( size_t i = 0; i < _columnFiles.size(); ++i ) std::fclose( _columnFiles[i] );
+      _columnFiles.clear();
+      return false;
+    }
+    _columnFiles.push_back( file );
+  }
+  return true;
+}
+
+void EUTelHitCacheFileWriter::addEvent(int runNumber, int eventNumber, const std::vector<EUTelCachedHit> & hits) {
+
+  _runNumber.push_back( runNumber );
+  _eventNumber.push_back( eventNumber );
+  _nHits += hits.size();
+  _hitBegin.push_back( _nHits );
+
+  if ( hits.empty() ) return;
+
+  // transpose the event into the columns
+  std::vector<std::int32_t> buffer( hits.size() );
+  for ( int iColumn = EUTelHitCacheHeader::kX; iColumn < EUTelHitCacheHeader::kNColumns; ++iColumn ) {
+    for ( size_t iHit = 0; iHit < hits.size(); ++iHit ) {
+      const EUTelCachedHit & hit = hits[iHit];
+      switch ( iColumn ) {
+      case EUTelHitCacheHeader::kX:           std::memcpy( &buffer[iHit], &hit.x, 4 ); break;
+      case EUTelHitCacheHeader::kY:           std::memcpy( &buffer[iHit], &hit.y, 4 ); break;
+      case EUTelHitCacheHeader::kZ:           std::memcpy( &buffer[iHit], &hit.z, 4 ); break;
+      case EUTelHitCacheHeader::kCovXX:       std::memcpy( &buffer[iHit], &hit.covXX, 4 ); break;
+      case EUTelHitCacheHeader::kCovYY:       std::memcpy( &buffer[iHit], &hit.covYY, 4 ); break;
+      case EUTelHitCacheHeader::kCharge:      std::memcpy( &buffer[iHit], &hit.charge, 4 ); break;
+      case EUTelHitCacheHeader::kSensorID:    buffer[iHit] = hit.sensorID; break;
+      case EUTelHitCacheHeader::kClusterSize: buffer[iHit] = hit.clusterSize; break;
+      case EUTelHitCacheHeader::kProperties:  buffer[iHit] = hit.properties; break;
+      case EUTelHitCacheHeader::kType:        buffer[iHit] = hit.type; break;
+      }
+    }
+    std::fwrite( &buffer[0], 4, hits.size(), _columnFiles[iColumn - EUTelHitCacheHeader::kX] );
+  }
+}
+
+bool EUTelHitCacheFileWriter::close() {
+
+  if ( _columnFiles.empty() ) return false;
+
+  EUTelHitCacheHeader header;
+  std::memset( &header, 0, sizeof(header) );
+  std::memcpy( header.magic, kHitCacheMagic, sizeof(kHitCacheMagic) );
+  header.version = kHitCacheVersion;
+  header.nColumns = EUTelHitCacheHeader::kNColumns;
+  header.nEvents = _eventNumber.size();
+  header.nHits = _nHits;
+
+  std::uint64_t offset = align8( sizeof(header) );
+  for ( int iColumn = 0; iColumn < EUTelHitCacheHeader::kNColumns; ++iColumn ) {
+    const std::uint64_t nEntries = ( iColumn < EUTelHitCacheHeader::kX ) ?
+      header.nEvents + ( iColumn == EUTelHitCacheHeader::kHitBegin ? 1 : 0 ) : header.nHits;
+    header.offset[iColumn] = offset;
+    offset = align8( offset + nEntries * elementSize(iColumn) );
+  }
+
+  std::FILE * output = std::fopen( _fileName.c_str(), "wb" );
+  bool ok = ( output != 0 );
+
+  if ( ok ) {
+    std::uint64_t position = 0;
+    ok = std::fwrite( &header, sizeof(header), 1, output ) == 1;
+    position += sizeof(header);
+    ok = ok && pad8( output, position );
+
+    // event index
+    ok = ok && std::fwrite( _runNumber.data(), 4, _runNumber.size(), output ) == _runNumber.size();
+    position += 4 * _runNumber.size();
+    ok = ok && pad8( output, position );
+    ok = ok && std::fwrite( _eventNumber.data(), 4, _eventNumber.size(), output ) == _eventNumber.size();
+    position += 4 * _eventNumber.size();
+    ok = ok && pad8( output, position );
+    ok = ok && std::fwrite( _hitBegin.data(), sizeof(std::uint64_t), _hitBegin.size(), output ) == _hitBegin.size();
+    position += sizeof(std::uint64_t) * _hitBegin.size();
+    ok = ok && pad8( output, position );
+
+    // hit columns
+    std::vector<char> buffer( 1 << 20 );
+    for ( size_t i = 0; i < _columnFiles.size() && ok; ++i ) {
+      std::rewind( _columnFiles[i] );
+      size_t n;
+      while ( ok && ( n = std::fread( &buffer[0], 1, buffer.size(), _columnFiles[i] ) ) > 0 ) {
+        ok = std::fwrite( &buffer[0], 1, n, output ) == n;
+        position += n;
+      }
+      ok = ok && pad8( output, position );
+    }
+
+    ok = ( std::fclose( output ) == 0 ) && ok;
+  }
+
+  for ( size_t i = 0; i < _columnFiles.size(); ++i ) std::fclose( _columnFiles[i] );
+  _columnFiles.clear();
+
+  return ok;
+}
+
+EUTelHitCacheFileReader::EUTelHitCacheFileReader() :
+  _data(0), _size(0), _header(0),
+  _runNumber(0), _eventNumber(0), _hitBegin(0),
+  _x(0), _y(0), _z(0), _covXX(0), _covYY(0), _charge(0),
+  _sensorID(0), _clusterSize(0), _properties(0), _type(0) {
+}
+
+EUTelHitCacheFileReader::~EUTelHitCacheFileReader() {
+  close();
+}
+
+bool EUTelHitCacheFileReader::open(const std::string & fileName) {
+
+  close();
+
+  const int fd = ::open( fileName.c_str(), O_RDONLY );
+  if ( fd < 0 ) return false;
+
+  struct stat fileStat;
+  if ( ::fstat( fd, &fileStat ) != 0 || static_cast<std::size_t>( fileStat.st_size ) < sizeof(EUTelHitCacheHeader) ) {
+    ::close( fd );
+    return false;
+  }
+
+  void * mapped = ::mmap( 0, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+  // the mapping stays valid after closing the descriptor
+  ::close( fd );
+  if ( mapped == MAP_FAILED ) return false;
+
+  _data = static_cast<const char *>( mapped );
+  _size = fileStat.st_size;
+  _header = reinterpret_cast<const EUTelHitCacheHeader *>( _data );
+
+  // check the signature and that all the sections are inside the file
+  bool valid = std::memcmp( _header->magic, kHitCacheMagic, sizeof(kHitCacheMagic) ) == 0
+    && _header->version == kHitCacheVersion
+    && _header->nColumns == static_cast<std::uint32_t>( EUTelHitCacheHeader::kNColumns );
+  for ( int iColumn = 0; iColumn < EUTelHitCacheHeader::kNColumns && valid; ++iColumn ) {
+    const std::uint64_t nEntries = ( iColumn < EUTelHitCacheHeader::kX ) ?
+      _header->nEvents + ( iColumn == EUTelHitCacheHeader::kHitBegin ? 1 : 0 ) : _header->nHits;
+    valid = _header->offset[iColumn] % 8 == 0
+      && _header->offset[iColumn] + nEntries * elementSize(iColumn) <= _size;
+  }
+  if ( !valid ) {
+    close();
+    return false;
+  }
+
+  _runNumber   = column<std::int32_t>( EUTelHitCacheHeader::kRunNumber );
+  _eventNumber = column<std::int32_t>( EUTelHitCacheHeader::kEventNumber );
+  _hitBegin    = column<std::uint64_t>( EUTelHitCacheHeader::kHitBegin );
+  _x           = column<float>( EUTelHitCacheHeader::kX );
+  _y           = column<float>( EUTelHitCacheHeader::kY );
+  _z           = column<float>( EUTelHitCacheHeader::kZ );
+  _covXX       = column<float>( EUTelHitCacheHeader::kCovXX );
+  _covYY       = column<float>( EUTelHitCacheHeader::kCovYY );
+  _charge      = column<float>( EUTelHitCacheHeader::kCharge );
+  _sensorID    = column<std::int32_t>( EUTelHitCacheHeader::kSensorID );
+  _clusterSize = column<std::int32_t>( EUTelHitCacheHeader::kClusterSize );
+  _properties  = column<std::int32_t>( EUTelHitCacheHeader::kProperties );
+  _type        = column<std::int32_t>( EUTelHitCacheHeader::kType );
+
+  if ( _hitBegin[_header->nEvents] != _header->nHits ) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void EUTelHitCacheFileReader::close() {
+
+  if ( _data ) ::munmap( const_cast<char *>( _data ), _size );
+  _data = 0;
+  _size = 0;
+  _header = 0;
+  _runNumber = _eventNumber = 0;
+  _hitBegin = 0;
+  _x = _y = _z = _covXX = _covYY = _charge = 0;
+  _sensorID = _clusterSize = _properties = _type = 0;
+}
+
+EUTelCachedHit EUTelHitCacheFileReader::getHit(std::uint64_t iHit) const {
+
+  EUTelCachedHit hit;
+  hit.x           = _x[iHit];
+  hit.y           = _y[iHit];
+  hit.z           = _z[iHit];
+  hit.covXX       = _covXX[iHit];
+  hit.covYY       = _covYY[iHit];
+  hit.charge      = _charge[iHit];
+  hit.sensorID    = _sensorID[iHit];
+  hit.clusterSize = _clusterSize[iHit];
+  hit.properties  = _properties[iHit];
+  hit.type        = _type[iHit];
+  return hit;
+}
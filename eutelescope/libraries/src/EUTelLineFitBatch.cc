@@ -0,0 +1,179 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+#include "EUTelLineFitBatch.h"
+
+// system includes <>
+#include <vector>
+
+using namespace eutelescope;
+
+EUTelLineFitBatch::EUTelLineFitBatch(int nPlanes) :
+  _nPlanes(0),
+  _nTracks(0),
+  _x(), _y(), _z(), _wx(), _wy(),
+  _interceptX(), _slopeX(), _chi2X(),
+  _interceptY(), _slopeY(), _chi2Y(),
+  _valid(),
+  _residualX(), _residualY(),
+  _sumW(), _sumWZ(), _sumWP(), _sumWZZ(), _sumWZP() {
+
+  reset(nPlanes);
+}
+
+void EUTelLineFitBatch::reset(int nPlanes) {
+
+  _nPlanes = nPlanes;
+
+  _x.assign(_nPlanes, std::vector<double>());
+  _y.assign(_nPlanes, std::vector<double>());
+  _z.assign(_nPlanes, std::vector<double>());
+  _wx.assign(_nPlanes, std::vector<double>());
+  _wy.assign(_nPlanes, std::vector<double>());
+  _residualX.assign(_nPlanes, std::vector<double>());
+  _residualY.assign(_nPlanes, std::vector<double>());
+
+  clear();
+}
+
+void EUTelLineFitBatch::clear() {
+
+  _nTracks = 0;
+
+  for ( int iPlane = 0; iPlane < _nPlanes; ++iPlane ) {
+    _x[iPlane].clear();
+    _y[iPlane].clear();
+    _z[iPlane].clear();
+    _wx[iPlane].clear();
+    _wy[iPlane].clear();
+  }
+}
+
+void EUTelLineFitBatch::reserve(int nTracks) {
+
+  for ( int iPlane = 0; iPlane < _nPlanes; ++iPlane ) {
+    _x[iPlane].reserve(nTracks);
+    _y[iPlane].reserve(nTracks);
+    _z[iPlane].reserve(nTracks);
+    _wx[iPlane].reserve(nTracks);
+    _wy[iPlane].reserve(nTracks);
+  }
+}
+
+int EUTelLineFitBatch::addTrack(const double * x, const double * y, const double * z,
+                                const double * ex, const double * ey) {
+
+  for ( int iPlane = 0; iPlane < _nPlanes; ++iPlane ) {
+    _x[iPlane].push_back( x[iPlane] );
+    _y[iPlane].push_back( y[iPlane] );
+    _z[iPlane].push_back( z[iPlane] );
+    _wx[iPlane].push_back( ex[iPlane] > 0. ? 1. / ( ex[iPlane] * ex[iPlane] ) : 0. );
+    _wy[iPlane].push_back( ey[iPlane] > 0. ? 1. / ( ey[iPlane] * ey[iPlane] ) : 0. );
+  }
+
+  return _nTracks++;
+}
+
+void EUTelLineFitBatch::fit() {
+
+  _valid.assign(_nTracks, 1);
+
+  fitProjection(_x, _wx, _interceptX, _slopeX, _chi2X, _residualX);
+  fitProjection(_y, _wy, _interceptY, _slopeY, _chi2Y, _residualY);
+}
+
+void EUTelLineFitBatch::fitProjection(const std::vector< std::vector<double> > & pos,
+                                      const std::vector< std::vector<double> > & weight,
+                                      std::vector<double> & intercept,
+                                      std::vector<double> & slope,
+                                      std::vector<double> & chi2,
+                                      std::vector< std::vector<double> > & residual) {
+
+  const int nTracks = _nTracks;
+
+  intercept.assign(nTracks, 0.);
+  slope.assign(nTracks, 0.);
+  chi2.assign(nTracks, 0.);
+
+  if ( nTracks == 0 ) return;
+
+  _sumW.assign(nTracks, 0.);
+  _sumWZ.assign(nTracks, 0.);
+  _sumWP.assign(nTracks, 0.);
+  _sumWZZ.assign(nTracks, 0.);
+  _sumWZP.assign(nTracks, 0.);
+
+  double * sW   = &_sumW[0];
+  double * sWZ  = &_sumWZ[0];
+  double * sWP  = &_sumWP[0];
+  double * sWZZ = &_sumWZZ[0];
+  double * sWZP = &_sumWZP[0];
+
+  // first pass: weighted mean of z and of the measured positions
+
+  for ( int iPlane = 0; iPlane < _nPlanes; ++iPlane ) {
+    const double * w = &weight[iPlane][0];
+    const double * z = &_z[iPlane][0];
+    const double * p = &pos[iPlane][0];
+    for ( int iTrack = 0; iTrack < nTracks; ++iTrack ) {
+      sW[iTrack]  += w[iTrack];
+      sWZ[iTrack] += w[iTrack] * z[iTrack];
+      sWP[iTrack] += w[iTrack] * p[iTrack];
+    }
+  }
+
+  for ( int iTrack = 0; iTrack < nTracks; ++iTrack ) {
+    if ( sW[iTrack] > 0. ) {
+      sWZ[iTrack] /= sW[iTrack];
+      sWP[iTrack] /= sW[iTrack];
+    }
+  }
+
+  // second pass: sums with respect to the mean z, this avoids the
+  // precision loss of the textbook formula for large z values
+
+  for ( int iPlane = 0; iPlane < _nPlanes; ++iPlane ) {
+    const double * w = &weight[iPlane][0];
+    const double * z = &_z[iPlane][0];
+    const double * p = &pos[iPlane][0];
+    for ( int iTrack = 0; iTrack < nTracks; ++iTrack ) {
+      const double dz = z[iTrack] - sWZ[iTrack];
+      sWZZ[iTrack] += w[iTrack] * dz * dz;
+      sWZP[iTrack] += w[iTrack] * dz * p[iTrack];
+    }
+  }
+
+  double * a = &intercept[0];
+  double * b = &slope[0];
+
+  for ( int iTrack = 0; iTrack < nTracks; ++iTrack ) {
+    if ( sWZZ[iTrack] > 0. ) {
+      b[iTrack] = sWZP[iTrack] / sWZZ[iTrack];
+      a[iTrack] = sWP[iTrack] - b[iTrack] * sWZ[iTrack];
+    } else {
+      _valid[iTrack] = 0;
+    }
+  }
+
+  // residuals and chi2
+
+  double * c = &chi2[0];
+
+  for ( int iPlane = 0; iPlane < _nPlanes; ++iPlane ) {
+    residual[iPlane].resize(nTracks);
+    double * r = &residual[iPlane][0];
+    const double * w = &weight[iPlane][0];
+    const double * z = &_z[iPlane][0];
+    const double * p = &pos[iPlane][0];
+    for ( int iTrack = 0; iTrack < nTracks; ++iTrack ) {
+      r[iTrack] = a[iTrack] + b[iTrack] * z[iTrack] - p[iTrack];
+      c[iTrack] += w[iTrack] * r[iTrack] * r[iTrack];
+    }
+  }
+}
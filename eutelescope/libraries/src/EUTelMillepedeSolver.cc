@@ -0,0 +1,395 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+#include "EUTelMillepedeSolver.h"
+
+// Eigen
+#include <Eigen/Core>
+#include <Eigen/LU>
+
+// system includes <>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace eutelescope;
+
+EUTelMillepedeSolver::EUTelMillepedeSolver() :
+  _labels(),
+  _labelIndex(),
+  _start(),
+  _presigma(),
+  _correction(),
+  _error(),
+  _constraints(),
+  _matrix(),
+  _vector(),
+  _sumResidual2(0.),
+  _nMeasurements(0),
+  _nLocal(0),
+  _nTracks(0),
+  _nRejected(0),
+  _chi2(0.),
+  _ndf(0),
+  _nSkippedConstraints(0),
+  _trackNLC(0),
+  _trackDerLC(),
+  _trackGlobalBegin(1, 0),
+  _trackGlobalIndex(),
+  _trackDerGL(),
+  _trackResidual(),
+  _trackWeight() {
+}
+
+int EUTelMillepedeSolver::parameterIndex(int label) {
+
+  std::map<int, int>::const_iterator found = _labelIndex.find(label);
+  if ( found != _labelIndex.end() ) return found->second;
+
+  const int index = static_cast<int>( _labels.size() );
+  _labelIndex[label] = index;
+  _labels.push_back(label);
+  _start.push_back(0.);
+  _presigma.push_back(0.);
+  _correction.push_back(0.);
+  _error.push_back(0.);
+
+  // grow the normal equations keeping what was already accumulated
+  _matrix.conservativeResize(index + 1, index + 1);
+  _matrix.row(index).setZero();
+  _matrix.col(index).setZero();
+  _vector.conservativeResize(index + 1);
+  _vector(index) = 0.;
+
+  return index;
+}
+
+void EUTelMillepedeSolver::mille(int nLC, const float * derLC, int nGL, const float * derGL,
+                                 const int * label, float rMeas, float sigma) {
+
+  if ( sigma <= 0. ) return;
+
+  // the local derivatives of all measurements of a track are stored
+  // with the largest number of local parameters seen so far
+  if ( nLC > _trackNLC ) {
+    const size_t nMeas = _trackResidual.size();
+    std::vector<double> resized(nMeas * nLC, 0.);
+    for ( size_t iMeas = 0; iMeas < nMeas; ++iMeas ) {
+      std::copy(_trackDerLC.begin() + iMeas * _trackNLC,
+                _trackDerLC.begin() + (iMeas + 1) * _trackNLC,
+                resized.begin() + iMeas * nLC);
+    }
+    _trackDerLC.swap(resized);
+    _trackNLC = nLC;
+  }
+
+  for ( int iLC = 0; iLC < _trackNLC; ++iLC ) {
+    _trackDerLC.push_back( iLC < nLC ? derLC[iLC] : 0. );
+  }
+
+  for ( int iGL = 0; iGL < nGL; ++iGL ) {
+    if ( derGL[iGL] == 0. || label[iGL] <= 0 ) continue;
+    _trackGlobalIndex.push_back( parameterIndex(label[iGL]) );
+    _trackDerGL.push_back( derGL[iGL] );
+  }
+  _trackGlobalBegin.push_back( static_cast<int>( _trackGlobalIndex.size() ) );
+
+  _trackResidual.push_back( rMeas );
+  _trackWeight.push_back( 1. / ( static_cast<double>(sigma) * sigma ) );
+}
+
+void EUTelMillepedeSolver::end() {
+
+  const int nMeas = static_cast<int>( _trackResidual.size() );
+  const int nLC = _trackNLC;
+
+  if ( nMeas == 0 ) {
+    kill();
+    return;
+  }
+
+  // global parameters touched by this track, in order of appearance
+  std::vector<int> touched;
+  std::vector<int> slot( _trackGlobalIndex.size() );
+  for ( size_t i = 0; i < _trackGlobalIndex.size(); ++i ) {
+    std::vector<int>::iterator it = std::find(touched.begin(), touched.end(), _trackGlobalIndex[i]);
+    slot[i] = static_cast<int>( it - touched.begin() );
+    if ( it == touched.end() ) touched.push_back( _trackGlobalIndex[i] );
+  }
+  const int nT = static_cast<int>( touched.size() );
+
+  // normal equations of the track: local block, mixed block and the
+  // direct global contribution
+  Eigen::MatrixXd gamma = Eigen::MatrixXd::Zero(nLC, nLC);
+  Eigen::VectorXd beta  = Eigen::VectorXd::Zero(nLC);
+  Eigen::MatrixXd mixed = Eigen::MatrixXd::Zero(nT, nLC);
+  Eigen::MatrixXd globalBlock = Eigen::MatrixXd::Zero(nT, nT);
+  Eigen::VectorXd globalVector = Eigen::VectorXd::Zero(nT);
+  double sumResidual2 = 0.;
+
+  for ( int iMeas = 0; iMeas < nMeas; ++iMeas ) {
+    const double w = _trackWeight[iMeas];
+    const double r = _trackResidual[iMeas];
+    Eigen::Map<const Eigen::VectorXd> dL( &_trackDerLC[iMeas * nLC], nLC );
+
+    gamma.noalias() += w * dL * dL.transpose();
+    beta += ( w * r ) * dL;
+    sumResidual2 += w * r * r;
+
+    for ( int i = _trackGlobalBegin[iMeas]; i < _trackGlobalBegin[iMeas + 1]; ++i ) {
+      const double wdi = w * _trackDerGL[i];
+      mixed.row(slot[i]) += wdi * dL.transpose();
+      globalVector(slot[i]) += wdi * r;
+      for ( int j = _trackGlobalBegin[iMeas]; j < _trackGlobalBegin[iMeas + 1]; ++j ) {
+        globalBlock(slot[i], slot[j]) += wdi * _trackDerGL[j];
+      }
+    }
+  }
+
+  // reject tracks whose local parameters are not determined
+  Eigen::FullPivLU<Eigen::MatrixXd> localLU(gamma);
+  if ( nMeas <= nLC || localLU.rank() < nLC ) {
+    ++_nRejected;
+    kill();
+    return;
+  }
+
+  // eliminate the local parameters
+  const Eigen::MatrixXd gammaInverse = localLU.inverse();
+  const Eigen::MatrixXd mixedGammaInverse = mixed * gammaInverse;
+  globalBlock.noalias() -= mixedGammaInverse * mixed.transpose();
+  globalVector.noalias() -= mixedGammaInverse * beta;
+  sumResidual2 -= beta.dot( gammaInverse * beta );
+
+  for ( int i = 0; i < nT; ++i ) {
+    _vector(touched[i]) += globalVector(i);
+    for ( int j = 0; j < nT; ++j ) {
+      _matrix(touched[i], touched[j]) += globalBlock(i, j);
+    }
+  }
+  _sumResidual2 += sumResidual2;
+  _nMeasurements += nMeas;
+  _nLocal += nLC;
+  ++_nTracks;
+
+  kill();
+}
+
+void EUTelMillepedeSolver::kill() {
+
+  _trackNLC = 0;
+  _trackDerLC.clear();
+  _trackGlobalBegin.assign(1, 0);
+  _trackGlobalIndex.clear();
+  _trackDerGL.clear();
+  _trackResidual.clear();
+  _trackWeight.clear();
+}
+
+void EUTelMillepedeSolver::setParameter(int label, double start, double presigma) {
+
+  const int index = parameterIndex(label);
+  _start[index] = start;
+  _presigma[index] = presigma;
+}
+
+void EUTelMillepedeSolver::addConstraint(const std::vector<int> & labels,
+                                         const std::vector<double> & factors, double value) {
+
+  Constraint constraint;
+  constraint.labels = labels;
+  constraint.factors = factors;
+  constraint.value = value;
+  for ( size_t i = 0; i < labels.size(); ++i ) parameterIndex( labels[i] );
+  _constraints.push_back( constraint );
+}
+
+bool EUTelMillepedeSolver::readSteeringFile(const std::string & fileName) {
+
+  std::ifstream steerFile( fileName.c_str() );
+  if ( !steerFile.is_open() ) return false;
+
+  enum { kNone, kParameter, kConstraint } section = kNone;
+
+  std::string line;
+  while ( std::getline( steerFile, line ) ) {
+
+    // everything after ! is a comment, lines starting with * too
+    const size_t comment = line.find('!');
+    if ( comment != std::string::npos ) line.erase(comment);
+    if ( !line.empty() && line[0] == '*' ) continue;
+
+    std::istringstream tokenizer( line );
+    std::string first;
+    if ( !( tokenizer >> first ) ) continue;
+
+    const char c = first[0];
+    const bool numeric = std::isdigit( static_cast<unsigned char>(c) ) || c == '-' || c == '+' || c == '.';
+
+    if ( !numeric ) {
+      std::transform( first.begin(), first.end(), first.begin(), ::tolower );
+      if ( first == "parameter" || first == "parameters" ) {
+        section = kParameter;
+      } else if ( first == "constraint" || first == "wconstraint" ) {
+        double value = 0.;
+        tokenizer >> value;
+        _constraints.push_back( Constraint() );
+        _constraints.back().value = value;
+        section = kConstraint;
+      } else {
+        section = kNone;
+      }
+      continue;
+    }
+
+    std::istringstream values( line );
+    if ( section == kParameter ) {
+      int label = 0;
+      double start = 0., presigma = 0.;
+      if ( !( values >> label ) ) continue;
+      values >> start >> presigma;
+      setParameter( label, start, presigma );
+    } else if ( section == kConstraint ) {
+      int label = 0;
+      double factor = 0.;
+      while ( values >> label >> factor ) {
+        parameterIndex( label );
+        _constraints.back().labels.push_back( label );
+        _constraints.back().factors.push_back( factor );
+      }
+    }
+  }
+
+  return true;
+}
+
+bool EUTelMillepedeSolver::solve() {
+
+  const int n = static_cast<int>( _labels.size() );
+
+  // free parameters; parameters never measured and without pre-sigma
+  // are left at their start value
+  std::vector<int> freeIndex;
+  std::vector<int> freeSlot( n, -1 );
+  for ( int i = 0; i < n; ++i ) {
+    _correction[i] = 0.;
+    _error[i] = 0.;
+    if ( _presigma[i] < 0. ) continue;
+    if ( _matrix(i, i) == 0. && _presigma[i] == 0. ) continue;
+    freeSlot[i] = static_cast<int>( freeIndex.size() );
+    freeIndex.push_back(i);
+  }
+  const int nFree = static_cast<int>( freeIndex.size() );
+
+  // labels which are not free are kept at their start value inside the
+  // constraints; a constraint left without any free parameter would
+  // give an empty row in the bordered system and is skipped
+  std::vector<int> activeConstraint;
+  for ( size_t k = 0; k < _constraints.size(); ++k ) {
+    const Constraint & constraint = _constraints[k];
+    for ( size_t m = 0; m < constraint.labels.size(); ++m ) {
+      if ( constraint.factors[m] != 0. && freeSlot[ _labelIndex[ constraint.labels[m] ] ] >= 0 ) {
+        activeConstraint.push_back( static_cast<int>(k) );
+        break;
+      }
+    }
+  }
+  const int nCon = static_cast<int>( activeConstraint.size() );
+  _nSkippedConstraints = static_cast<int>( _constraints.size() ) - nCon;
+
+  Eigen::VectorXd start( n );
+  for ( int i = 0; i < n; ++i ) start(i) = _start[i];
+  const Eigen::VectorXd startShift = _matrix * start;
+
+  // bordered system for the corrections to the start values
+  Eigen::MatrixXd system = Eigen::MatrixXd::Zero( nFree + nCon, nFree + nCon );
+  Eigen::VectorXd rhs = Eigen::VectorXd::Zero( nFree + nCon );
+
+  for ( int a = 0; a < nFree; ++a ) {
+    const int i = freeIndex[a];
+    for ( int b = 0; b < nFree; ++b ) system(a, b) = _matrix(i, freeIndex[b]);
+    if ( _presigma[i] > 0. ) system(a, a) += 1. / ( _presigma[i] * _presigma[i] );
+    rhs(a) = _vector(i) - startShift(i);
+  }
+
+  for ( int k = 0; k < nCon; ++k ) {
+    const Constraint & constraint = _constraints[ activeConstraint[k] ];
+    double value = constraint.value;
+    for ( size_t m = 0; m < constraint.labels.size(); ++m ) {
+      const int i = _labelIndex[ constraint.labels[m] ];
+      value -= constraint.factors[m] * _start[i];
+      if ( freeSlot[i] < 0 ) continue;
+      system(nFree + k, freeSlot[i]) += constraint.factors[m];
+      system(freeSlot[i], nFree + k) += constraint.factors[m];
+    }
+    rhs(nFree + k) = value;
+  }
+
+  Eigen::FullPivLU<Eigen::MatrixXd> lu( system );
+  if ( !lu.isInvertible() ) return false;
+
+  const Eigen::VectorXd solution = lu.solve( rhs );
+  const Eigen::MatrixXd covariance = lu.inverse();
+
+  Eigen::VectorXd global = start;
+  for ( int a = 0; a < nFree; ++a ) {
+    const int i = freeIndex[a];
+    _correction[i] = solution(a);
+    _error[i] = std::sqrt( std::fabs( covariance(a, a) ) );
+    global(i) += solution(a);
+  }
+
+  _chi2 = _sumResidual2 - 2. * global.dot( _vector ) + global.dot( _matrix * global );
+  _ndf = _nMeasurements - _nLocal - nFree + nCon;
+
+  return true;
+}
+
+bool EUTelMillepedeSolver::writeResultFile(const std::string & fileName) const {
+
+  FILE * resFile = std::fopen( fileName.c_str(), "w" );
+  if ( !resFile ) return false;
+
+  std::fprintf( resFile, "Parameter   ! first 3 elements per line are significant (if used as input)\n" );
+
+  // the map keeps the labels sorted, as pede does
+  for ( std::map<int, int>::const_iterator it = _labelIndex.begin(); it != _labelIndex.end(); ++it ) {
+    const int i = it->second;
+    const double value = _start[i] + _correction[i];
+    if ( _presigma[i] < 0. || _error[i] == 0. ) {
+      std::fprintf( resFile, "%10d %14.5e %12.5e\n", it->first, value, _presigma[i] < 0. ? _presigma[i] : -1. );
+    } else {
+      std::fprintf( resFile, "%10d %14.5e %12.5e %12.5e %12.5e\n", it->first, value, _presigma[i],
+                    _correction[i], _error[i] );
+    }
+  }
+
+  std::fclose( resFile );
+  return true;
+}
+
+double EUTelMillepedeSolver::getValue(int label) const {
+
+  std::map<int, int>::const_iterator found = _labelIndex.find(label);
+  if ( found == _labelIndex.end() ) return 0.;
+  return _start[found->second] + _correction[found->second];
+}
+
+double EUTelMillepedeSolver::getError(int label) const {
+
+  std::map<int, int>::const_iterator found = _labelIndex.find(label);
+  if ( found == _labelIndex.end() ) return 0.;
+  return _error[found->second];
+}
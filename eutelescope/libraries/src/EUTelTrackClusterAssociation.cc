@@ -0,0 +1,202 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+#include "EUTelTrackClusterAssociation.h"
+
+// system includes <>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+using namespace eutelescope;
+
+namespace {
+
+  //! First and last integer in [low, high], clamped to [0, n - 1]
+  /*! @return false if the range is empty or not a number
+   */
+  bool clampedRange(double low, double high, int n, int & first, int & last) {
+    if ( !( low <= high ) || n <= 0 ) return false;
+    low  = std::max( std::floor( low ), 0. );
+    high = std::min( std::ceil( high ), static_cast<double>( n - 1 ) );
+    if ( low > high ) return false;
+    first = static_cast<int>( low );
+    last  = static_cast<int>( high );
+    return true;
+  }
+}
+
+EUTelAffineTransform3D::EUTelAffineTransform3D() {
+  for ( int i = 0; i < 9; ++i ) _matrix[i] = ( i % 4 == 0 ) ? 1. : 0.;
+  for ( int i = 0; i < 3; ++i ) _offset[i] = 0.;
+}
+
+EUTelPixelMask::EUTelPixelMask() :
+  _nColumns(0), _nRows(0), _xPitch(0.), _yPitch(0.), _nWordsPerRow(0),
+  _bits(), _columnCount(), _outside(), _nMasked(0) {
+}
+
+void EUTelPixelMask::reset(int nColumns, int nRows, double xPitch, double yPitch) {
+  _nColumns = std::max( nColumns, 0 );
+  _nRows = std::max( nRows, 0 );
+  _xPitch = xPitch;
+  _yPitch = yPitch;
+  _nWordsPerRow = ( _nColumns + 63 ) / 64;
+  _bits.assign( static_cast<std::size_t>( _nWordsPerRow ) * _nRows, 0 );
+  _columnCount.assign( _nColumns, 0 );
+  _outside.clear();
+  _nMasked = 0;
+}
+
+void EUTelPixelMask::mask(int x, int y) {
+  if ( !inside( x, y ) ) {
+    _outside.push_back( x );
+    _outside.push_back( y );
+    ++_nMasked;
+    return;
+  }
+  std::uint64_t & word = _bits[ static_cast<std::size_t>( y ) * _nWordsPerRow + x / 64 ];
+  const std::uint64_t bit = static_cast<std::uint64_t>( 1 ) << ( x % 64 );
+  if ( word & bit ) return;
+  word |= bit;
+  ++_columnCount[x];
+  ++_nMasked;
+}
+
+bool EUTelPixelMask::isMasked(int x, int y) const {
+  if ( inside( x, y ) ) {
+    return ( _bits[ static_cast<std::size_t>( y ) * _nWordsPerRow + x / 64 ] >> ( x % 64 ) ) & 1;
+  }
+  for ( std::size_t i = 0; i < _outside.size(); i += 2 ) {
+    if ( _outside[i] == x && _outside[i + 1] == y ) return true;
+  }
+  return false;
+}
+
+bool EUTelPixelMask::isNearMaskedPixel(double x, double y, double distance) const {
+
+  int xFirst, xLast, yFirst, yLast;
+  if ( clampedRange( ( x - distance ) / _xPitch - 0.5, ( x + distance ) / _xPitch - 0.5, _nColumns, xFirst, xLast ) &&
+       clampedRange( ( y - distance ) / _yPitch - 0.5, ( y + distance ) / _yPitch - 0.5, _nRows, yFirst, yLast ) ) {
+    for ( int iY = yFirst; iY <= yLast; ++iY ) {
+      if ( !( std::abs( y - ( iY * _yPitch + _yPitch / 2. ) ) < distance ) ) continue;
+      const std::uint64_t * row = &_bits[ static_cast<std::size_t>( iY ) * _nWordsPerRow ];
+      for ( int iX = xFirst; iX <= xLast; ++iX ) {
+        if ( ( ( row[ iX / 64 ] >> ( iX % 64 ) ) & 1 ) &&
+             std::abs( x - ( iX * _xPitch + _xPitch / 2. ) ) < distance ) return true;
+      }
+    }
+  }
+
+  for ( std::size_t i = 0; i < _outside.size(); i += 2 ) {
+    if ( std::abs( x - ( _outside[i] * _xPitch + _xPitch / 2. ) ) < distance &&
+         std::abs( y - ( _outside[i + 1] * _yPitch + _yPitch / 2. ) ) < distance ) return true;
+  }
+  return false;
+}
+
+bool EUTelPixelMask::isNearMaskedColumn(double x, double distance) const {
+
+  int xFirst, xLast;
+  if ( clampedRange( ( x - distance ) / _xPitch - 0.5, ( x + distance ) / _xPitch - 0.5, _nColumns, xFirst, xLast ) ) {
+    for ( int iX = xFirst; iX <= xLast; ++iX ) {
+      if ( _columnCount[iX] > 0 && std::abs( x - ( iX * _xPitch + _xPitch / 2. ) ) < distance ) return true;
+    }
+  }
+
+  for ( std::size_t i = 0; i < _outside.size(); i += 2 ) {
+    if ( std::abs( x - ( _outside[i] * _xPitch + _xPitch / 2. ) ) < distance ) return true;
+  }
+  return false;
+}
+
+EUTelHitGrid2D::EUTelHitGrid2D() :
+  _hits(), _cellBegin(), _xMin(0.), _yMin(0.), _cellSize(1.), _nCellsX(0), _nCellsY(0) {
+}
+
+void EUTelHitGrid2D::clear() {
+  _hits.clear();
+  _cellBegin.clear();
+  _nCellsX = _nCellsY = 0;
+}
+
+void EUTelHitGrid2D::add(double x, double y, int index) {
+  if ( !std::isfinite( x ) || !std::isfinite( y ) ) return;
+  Hit hit;
+  hit.x = x;
+  hit.y = y;
+  hit.index = index;
+  _hits.push_back( hit );
+}
+
+void EUTelHitGrid2D::build(double cellSize) {
+
+  // limit the number of cells to a few per hit, also for hits spread
+  // far apart, so that the memory does not depend on their distance
+  const double maxCells = std::max( 4. * _hits.size(), 64. );
+
+  _cellBegin.clear();
+  _nCellsX = _nCellsY = 0;
+  if ( _hits.empty() ) return;
+
+  double xMax = _hits[0].x, yMax = _hits[0].y;
+  _xMin = xMax;
+  _yMin = yMax;
+  for ( std::size_t i = 1; i < _hits.size(); ++i ) {
+    _xMin = std::min( _xMin, _hits[i].x );
+    _yMin = std::min( _yMin, _hits[i].y );
+    xMax = std::max( xMax, _hits[i].x );
+    yMax = std::max( yMax, _hits[i].y );
+  }
+
+  _cellSize = cellSize > 0 ? cellSize : 1.;
+  while ( ( std::floor( ( xMax - _xMin ) / _cellSize ) + 1. ) * ( std::floor( ( yMax - _yMin ) / _cellSize ) + 1. ) > maxCells ) {
+    _cellSize *= 2.;
+  }
+  _nCellsX = static_cast<int>( ( xMax - _xMin ) / _cellSize ) + 1;
+  _nCellsY = static_cast<int>( ( yMax - _yMin ) / _cellSize ) + 1;
+
+  // counting sort, stable so that the hits of a cell keep their order
+  std::vector<int> cell( _hits.size() );
+  _cellBegin.assign( _nCellsX * _nCellsY + 1, 0 );
+  for ( std::size_t i = 0; i < _hits.size(); ++i ) {
+    const int iX = std::min( static_cast<int>( ( _hits[i].x - _xMin ) / _cellSize ), _nCellsX - 1 );
+    const int iY = std::min( static_cast<int>( ( _hits[i].y - _yMin ) / _cellSize ), _nCellsY - 1 );
+    cell[i] = iY * _nCellsX + iX;
+    ++_cellBegin[ cell[i] + 1 ];
+  }
+  for ( std::size_t iCell = 1; iCell < _cellBegin.size(); ++iCell ) _cellBegin[iCell] += _cellBegin[iCell - 1];
+
+  std::vector<Hit> sorted( _hits.size() );
+  std::vector<int> next( _cellBegin.begin(), _cellBegin.end() - 1 );
+  for ( std::size_t i = 0; i < _hits.size(); ++i ) sorted[ next[ cell[i] ]++ ] = _hits[i];
+  _hits.swap( sorted );
+}
+
+void EUTelHitGrid2D::query(double x, double y, double distance, std::vector<int> & indices) const {
+
+  indices.clear();
+
+  int xFirst, xLast, yFirst, yLast;
+  if ( !clampedRange( ( x - distance - _xMin ) / _cellSize, ( x + distance - _xMin ) / _cellSize, _nCellsX, xFirst, xLast ) ||
+       !clampedRange( ( y - distance - _yMin ) / _cellSize, ( y + distance - _yMin ) / _cellSize, _nCellsY, yFirst, yLast ) ) return;
+
+  for ( int iY = yFirst; iY <= yLast; ++iY ) {
+    for ( int iX = xFirst; iX <= xLast; ++iX ) {
+      const int iCell = iY * _nCellsX + iX;
+      for ( int i = _cellBegin[iCell]; i < _cellBegin[iCell + 1]; ++i ) {
+        if ( std::abs( _hits[i].x - x ) <= distance && std::abs( _hits[i].y - y ) <= distance ) {
+          indices.push_back( _hits[i].index );
+        }
+      }
+    }
+  }
+  std::sort( indices.begin(), indices.end() );
+}
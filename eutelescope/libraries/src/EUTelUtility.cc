@@ -14,9 +14,20 @@
 #include "EUTelDFFClusterImpl.h"
 #include "EUTelFFClusterImpl.h"
 #include "EUTelSparseClusterImpl.h"
+#include "EUTelReferenceHit.h"
+#include "EUTelGeometryTelescopeGeoDescription.h"
  
 // lcio includes <.h>
 #include <EVENT/LCEvent.h>
+#include <IMPL/LCEventImpl.h>
+#include <IMPL/LCRunHeaderImpl.h>
+#include <IO/LCWriter.h>
+#include <UTIL/LCTime.h>
+#include <lcio.h>
+
+// ROOT includes
+#include "TVector3.h"
+#include "TMath.h"
 
 #include <cstdio>
 
@@ -85,6 +96,78 @@ namespace eutelescope {
 		return noisyPixelMap;
 	}
 
+	void writeReferenceHitDB(std::string const & fileName, std::string const & collectionName) {
+		// create a reference hit collection file (DB)
+		lcio::LCWriter* lcWriter = lcio::LCFactory::getInstance()->createLCWriter();
+		try {
+			lcWriter->open( fileName, lcio::LCIO::WRITE_NEW );
+		} catch ( lcio::IOException& e ) {
+			streamlog_out ( ERROR4 ) << e.what() << std::endl;
+			exit(-1);
+		}
+
+		streamlog_out ( MESSAGE5 ) << "Writing to " << fileName << std::endl;
+
+		lcio::LCRunHeaderImpl * lcHeader  = new lcio::LCRunHeaderImpl;
+		lcHeader->setRunNumber( 0 );
+		lcWriter->writeRunHeader(lcHeader);
+		delete lcHeader;
+		lcio::LCEventImpl * event = new lcio::LCEventImpl;
+		event->setRunNumber( 0 );
+		event->setEventNumber( 0 );
+		lcio::LCTime * now = new lcio::LCTime;
+		event->setTimeStamp( now->timeStamp() );
+		delete now;
+
+		lcio::LCCollectionVec * referenceHitCollection = new lcio::LCCollectionVec( lcio::LCIO::LCGENERICOBJECT );
+
+		EVENT::IntVec sensorIDVec = geo::gGeometry().sensorIDsVec();
+
+		for(EVENT::IntVec::iterator it = sensorIDVec.begin(); it != sensorIDVec.end(); it++) {
+			EUTelReferenceHit* refhit = new EUTelReferenceHit();
+
+			int sensorID = *it;
+			refhit->setSensorID( sensorID );
+			refhit->setXOffset( geo::gGeometry().siPlaneXPosition( sensorID ) );
+			refhit->setYOffset( geo::gGeometry().siPlaneYPosition( sensorID ) );
+			refhit->setZOffset( geo::gGeometry().siPlaneZPosition( sensorID ) + 0.5*geo::gGeometry().siPlaneZSize( sensorID ) );
+
+			double gRotation[3] = { 0., 0., 0.}; // not rotated
+			gRotation[0] = geo::gGeometry().siPlaneZRotation(sensorID); // Euler alpha ;
+			gRotation[1] = geo::gGeometry().siPlaneYRotation(sensorID); // Euler alpha ;
+			gRotation[2] = geo::gGeometry().siPlaneXRotation(sensorID); // Euler alpha ;
+			streamlog_out( DEBUG5 ) << "GEAR rotations: " << gRotation[0] << " " << gRotation[1] << " " <<  gRotation[2] << std::endl;
+			gRotation[0] =  gRotation[0]*3.1415926/180.; //
+			gRotation[1] =  gRotation[1]*3.1415926/180.; //
+			gRotation[2] =  gRotation[2]*3.1415926/180.; //
+
+			TVector3 rotatedVector( 0., 0., 1. );
+			TVector3 xAxis( 1.0, 0.0, 0.0 );
+			TVector3 yAxis( 0.0, 1.0, 0.0 );
+			TVector3 zAxis( 0.0, 0.0, 1.0 );
+
+			if( TMath::Abs( gRotation[2]) > 1e-6 ) {
+				rotatedVector.Rotate( gRotation[2], xAxis ); // in ZY
+			}
+			if( TMath::Abs( gRotation[1]) > 1e-6 ) {
+				rotatedVector.Rotate( gRotation[1], yAxis ); // in ZX
+			}
+			if( TMath::Abs( gRotation[0]) > 1e-6 ) {
+				rotatedVector.Rotate( gRotation[0], zAxis ); // in XY
+			}
+
+			refhit->setAlpha( rotatedVector[0] );
+			refhit->setBeta( rotatedVector[1] );
+			refhit->setGamma( rotatedVector[2] );
+			referenceHitCollection->push_back( refhit );
+		}
+		event->addCollection( referenceHitCollection, collectionName );
+
+		lcWriter->writeEvent( event );
+		delete event;
+		lcWriter->close();
+	}
+
 	std::unique_ptr<EUTelTrackerDataInterfacer> getSparseData(IMPL::TrackerDataImpl* const data, int type) {
 		return getSparseData(data, static_cast<SparsePixelType>(type));
 	}
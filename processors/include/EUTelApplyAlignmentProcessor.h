@@ -192,6 +192,53 @@ namespace eutelescope {
     //! Perform Euler rotations backwards
     void _EulerRotationInverse(double* _telPos, double* _gRotation);
 
+    //! Rotation and translation applied to the hits of a sensor
+    /*! The output position is rotation * input + offset, the
+     *  rotation matrix being stored row by row.
+     */
+    struct SensorTransform {
+      double rotation[9];
+      double offset[3];
+      //! Center of the sensor the hits are rotated around
+      double center[3];
+    };
+
+    //! Alignment constants of a sensor and their rotation matrices
+    struct AlignmentRotation {
+      //! alpha, beta, gamma, x, y and z offsets the matrices are built from
+      double constants[6];
+      //! Rotation applied by Direct
+      double direct[9];
+      //! Rotation applied by Reverse
+      double reverse[9];
+    };
+
+    //! Rotation matrix of three successive rotations
+    /*! @param xFirst if true the rotation around x is applied first
+     *  and the one around z last, otherwise the other way round.
+     */
+    static void rotationMatrix(double * matrix, double angleX, double angleY, double angleZ, bool xFirst);
+
+    //! Applies a sensor transformation to a position
+    static void transformPosition(const SensorTransform & transform, const double * input, double * output);
+
+    //! Updates the cached rotations of the current alignment collection
+    /*! Only the sensors whose constants changed since the last call
+     *  are recomputed.
+     */
+    void updateAlignmentRotations();
+
+    //! Indexes the current reference hits by sensor ID
+    void fillReferenceHitMap(std::map< int, EUTelReferenceHit * > & referenceHitMap) const;
+
+    //! Transformation of the hits of a sensor in Direct or Reverse
+    SensorTransform alignmentHitTransform(int sensorID, bool reverse, const std::map< int, EUTelReferenceHit * > & referenceHitMap) const;
+
+    //! Cached GEAR rotation of a sensor, built on first use
+    /*! The offset holds the translation used by ApplyGear6D.
+     */
+    const SensorTransform & gearTransform(int sensorID, bool revert);
+
     //! Check event method
     /*! This method is called by the Marlin execution framework as
      *  soon as the processEvent is over. For the time being there is
@@ -358,6 +405,15 @@ namespace eutelescope {
     //    std::map< int, int > _lookUpTable;
     std::map< std::string, std::map< int, int > > _lookUpTable;
 
+    //! Rotations of each alignment collection, keyed by sensor ID
+    std::map< std::string, std::map< int, AlignmentRotation > > _alignmentRotations;
+
+    //! Cached GEAR transformations for ApplyGear6D, keyed by sensor ID
+    std::map< int, SensorTransform > _gearApplyTransforms;
+
+    //! Cached GEAR rotations for RevertGear6D, keyed by sensor ID
+    std::map< int, SensorTransform > _gearRevertTransforms;
+
     //! boolean to mark the first processed event
     bool _fevent;
 
@@ -11,6 +11,8 @@
 
 // eutelescope includes ".h"
 #include "EUTelPseudo1DHistogram.h"
+#include "EUTelEtaFunctionImpl.h"
+#include "EUTELESCOPE.h"
 
 // marlin includes ".h"
 #include "marlin/Processor.h"
@@ -21,11 +23,15 @@
 #endif
 
 // lcio includes <.h>
+#include <IMPL/TrackerPulseImpl.h>
 
 // system includes <>
 #include <string>
 #include <map>
+#include <memory>
 #include <set>
+#include <utility>
+#include <vector>
 
 
 #undef MARLIN_USE_HISTOGRAM
@@ -39,6 +45,8 @@
 
 namespace eutelescope {
 
+  class EUTelVirtualCluster;
+
   //! Eta function calculator for the EUTelescope
   /*! This processor is used to calculate the eta function of a set of
    *  detectors inside the telescope setup.
@@ -118,14 +126,33 @@ namespace eutelescope {
    *
    *  @param EtaXCollectionName This is the name of the collection of
    *  eta functions along the X axis. This collection is saved in the
-   *  output file and not made available to the current event.
+   *  output file and not made available to the current event. In
+   *  single pass mode it is added to the events following the
+   *  calculation.
    *
    *  @param EtaYCollectionName This is the name of the collection of
    *  eta functions along the Y axis. This collection is saved in the
-   *  output file and not made available to the current event.
+   *  output file and not made available to the current event. In
+   *  single pass mode it is added to the events following the
+   *  calculation.
    *
    *  @param OutputEtaFileName The name of the output file.
    *
+   *  @param SinglePassCorrection If true, the eta functions are not
+   *  only saved into the output file, but also used in the same job:
+   *  from the event following the calculation on, the eta collections
+   *  are added to every event as transient collections and each
+   *  cluster gets its eta corrected CoG shift attached as an
+   *  EUTelEtaCorrectedShift, which EUTelProcessorHitMaker uses in
+   *  place of the plain CoG. The CoG shifts of the clusters used in
+   *  the calculation are kept as well and corrected as soon as the
+   *  functions are available; those events have already been
+   *  processed, so their correction only goes into the eta corrected
+   *  CoG histograms. This avoids a second pass over the data.
+   *  The hits made from corrected clusters have the kEtaCorrectedHit
+   *  property set and the number of events left uncorrected is
+   *  printed at the end of the job.
+   *
    *  @author Antonio Bulgheroni, INFN <mailto:antonio.bulgheroni@gmail.com>
    *  @version $Id$
    *
@@ -209,6 +236,16 @@ namespace eutelescope {
      */
     virtual void end();
 
+    //! Eta correction of the clusters
+    /*! Used in single pass mode after the eta calculation: the eta
+     *  collections are added to the event and the eta corrected CoG
+     *  shift is attached to every cluster of a sensor with an eta
+     *  function.
+     *
+     *  @param evt The current event
+     */
+    void correctEvent(LCEvent * evt);
+
     //! Identifier of the last event to be used.
     /*! This method can be profitably used to identify which is the
      *  last event to be used for the eta calculation.
@@ -317,8 +354,51 @@ namespace eutelescope {
      */
     std::string _outputEtaFileName;
 
+    //! Use the eta functions in the same job
+    /*! If true, the eta functions are calculated from the first
+     *  EventNumber events and then applied to the following ones,
+     *  see the class description.
+     */
+    bool _singlePassCorrection;
+
   private:
 
+    //! Bin centers and values of an eta function
+    struct EtaFunctionBins {
+      std::vector<double > center;
+      std::vector<double > value;
+    };
+
+    //! Eta function from a CoG pseudo histogram
+    /*! The integral pseudo histogram is filled with the running
+     *  integral of the CoG one, which is then normalized and shifted
+     *  by half a pitch. Only the two pseudo histograms are used, so
+     *  different sensors and directions can be calculated at the same
+     *  time.
+     */
+    static EtaFunctionBins calculateEtaFunction(EUTelPseudo1DHistogram * cogHisto,
+                                                EUTelPseudo1DHistogram * integralHisto);
+
+    //! New cluster object for a pulse
+    /*! @throw UnknownDataTypeException if the cluster or the pixel
+     *  type is unknown
+     */
+    EUTelVirtualCluster * createCluster(LCEvent * evt, IMPL::TrackerPulseImpl * pulse, ClusterType type) const;
+
+    //! CoG shift of a cluster
+    /*! According to the cluster type selection
+     */
+    void getCoGShift(EUTelVirtualCluster * cluster, ClusterType type, float & xShift, float & yShift) const;
+
+    //! Is this a cluster to be rejected as single pixel cluster?
+    /*! According to RejectSinglePixelCluster
+     */
+    bool isSinglePixelCluster(ClusterType type, float xShift, float yShift) const;
+
+    //! Fills the eta corrected CoG histograms
+    void fillEtaCorrectedHisto(int detectorID, float xShift, float yShift);
+
+
     //! Boolean return value
     /*! This boolean is used as return value for conditional steering
      *  file. Eta function calculation requires to loop over a certain
@@ -360,6 +440,28 @@ namespace eutelescope {
      */
     std::map<int, EUTelPseudo1DHistogram* > _integralHistoY;
 
+    //! Eta functions along x used in single pass mode
+    /*! The key value is the sensor ID.
+     */
+    std::map<int, std::unique_ptr<EUTelEtaFunctionImpl> > _etaFunctionX;
+
+    //! Eta functions along y used in single pass mode
+    /*! The key value is the sensor ID.
+     */
+    std::map<int, std::unique_ptr<EUTelEtaFunctionImpl> > _etaFunctionY;
+
+    //! CoG shifts of the clusters used in the calculation
+    /*! Only in single pass mode, to correct them once the eta
+     *  functions are available. The key value is the sensor ID.
+     */
+    std::map<int, std::vector<std::pair<float, float > > > _cogShiftBuffer;
+
+    //! Events processed in single pass mode before the eta functions were available
+    int _nUncorrectedEvents;
+
+    //! Events corrected in single pass mode
+    int _nCorrectedEvents;
+
     //! Number of detector planes in the run
     /*! This is the total number of detector saved into this input
      *  file
@@ -409,6 +511,12 @@ namespace eutelescope {
     //! Base name for the Eta histogram along x
     static std::string _etaHistoYName;
 
+    //! Base name for the eta corrected CoG histogram along x
+    static std::string _etaCorrectedXName;
+
+    //! Base name for the eta corrected CoG histogram along y
+    static std::string _etaCorrectedYName;
+
 
     //! Reject singple pixel cluster from the eta calculation
     int _rejectsingplepixelcluster;
@@ -11,6 +11,7 @@
 
 // eutelescope includes ".h"
 #include "EUTelROI.h"
+#include "EUTelClusterFeatures.h"
 
 // marlin includes ".h"
 #include "marlin/Processor.h"
@@ -238,6 +239,17 @@ namespace eutelescope {
    *  processEvent will return leaving the output collection empty for
    *  the current event.
    *
+   *  @param AdaptiveCutOrdering Off by default. If set to true, a
+   *  cluster stops at the first cut it fails, the cluster based cuts
+   *  are periodically reordered by their rejection rates and the
+   *  cluster loop stops as soon as the event level cuts can no longer
+   *  be passed. The accepted clusters are the same, but the rejection
+   *  summary changes meaning: each rejected cluster is counted only
+   *  under the first cut it failed, and when the loop is stopped early
+   *  MinClusterNoCut is counted only for the planes that can no longer
+   *  reach the minimum, while MaxClusterNoCut and SameNumberOfHitCut
+   *  only see the clusters accepted so far.
+   *
    *  @author Antonio Bulgheroni, INFN <mailto:antonio.bulgheroni@gmail.com>
    *  @version $Id$
    *
@@ -342,11 +354,11 @@ namespace eutelescope {
      *  a per detector basis and stored into the
      *  _clusterMinTotalChargeVec.
      *
-     *  @param cluster The cluster under test.
+     *  @param features The quantities of the cluster under test.
      *  @return True if the @c cluster has a charge below its own threshold.
      *
      */
-    bool isAboveMinTotalCharge(EUTelVirtualCluster * cluster) const ;
+    bool isAboveMinTotalCharge(const EUTelClusterFeatures & features) const ;
 
 
     //! Check if the total cluster SNR is above a certain value
@@ -354,11 +366,11 @@ namespace eutelescope {
      *  certain value. This threshold value is given on a per detector
      *  basis and stored into the _minTotalSNRVec.
      *
-     *  @param cluster The cluster under test.
+     *  @param features The quantities of the cluster under test.
      *  @return True if the @c cluster has a SNR below its own
      *  threshold.
      */
-    bool isAboveMinTotalSNR(EUTelVirtualCluster * cluster) const;
+    bool isAboveMinTotalSNR(const EUTelClusterFeatures & features) const;
 
     //! Check if the total cluster charge is below a certain value
     /*! This is used to select clusters having a total integrated
@@ -369,7 +381,7 @@ namespace eutelescope {
      *  @return True if the @c cluster has a charge below its own threshold.
      *
      */
-    bool isBelowMaxTotalCharge(EUTelVirtualCluster * /* cluster */ ) const { return true; }
+    bool isBelowMaxTotalCharge(const EUTelClusterFeatures & /* features */ ) const { return true; }
 
 
     //! Check if the total cluster charge is above a certain value
@@ -378,10 +390,10 @@ namespace eutelescope {
      *  a per detector basis and stored into the
      *  _clusterMaxTotalChargeVec.    .
      *
-     *  @param cluster The cluster under test.
+     *  @param features The quantities of the cluster under test.
      *
      */
-    bool isAboveNumberOfHitPixel(EUTelVirtualCluster * cluster) const;
+    bool isAboveNumberOfHitPixel(const EUTelClusterFeatures & features) const;
 
 
     //! Check against the charge collected by N pixels
@@ -394,9 +406,9 @@ namespace eutelescope {
      *  considered.
      *
      *  @return True if the charge is above threshold
-     *  @param cluster The cluster under test.
+     *  @param features The quantities of the cluster under test.
      */
-    bool isAboveNMinCharge(EUTelVirtualCluster * cluster) const;
+    bool isAboveNMinCharge(const EUTelClusterFeatures & features) const;
 
     //! Check against the SNR of the N most significant pixels
     /*! The SNR of the cluster made by the first N significant pixels
@@ -407,45 +419,45 @@ namespace eutelescope {
      *  considered.
      *
      *  @return True if the SNR is above threshold
-     *  @param cluster The cluster under test.
+     *  @param features The quantities of the cluster under test.
      */
-    bool isAboveNMinSNR(EUTelVirtualCluster * cluster) const;
+    bool isAboveNMinSNR(const EUTelClusterFeatures & features) const;
 
     //! Check against the charge collected by N x N pixels
     /*! This cut is working on the charge collected by a subframe N x
      *  N pixels wide centered around the seed.
      *
-     *  @param cluster The cluster under test.
+     *  @param features The quantities of the cluster under test.
      *  @return True if the charge is above threshold.
      */
-    bool isAboveNxNMinCharge(EUTelVirtualCluster * cluster) const;
+    bool isAboveNxNMinCharge(const EUTelClusterFeatures & features) const;
 
     //! Check against the SNR collected by N x N pixels
     /*! This cut is working on the SNR collected by a subframe N x
      *  N pixels wide centered around the seed.
      *
-     *  @param cluster The cluster under test.
+     *  @param features The quantities of the cluster under test.
      *  @return True if the SNR is above threshold.
      */
-    bool isAboveNxNMinSNR(EUTelVirtualCluster * cluster) const;
+    bool isAboveNxNMinSNR(const EUTelClusterFeatures & features) const;
 
     //! Seed pixel cut
     /*! This is used to select clusters having a seed pixel charge
      *  above the specified threshold
      *
      *  @return True if the seed pixel charge is above threshold
-     *  @param cluster The cluster under test.
+     *  @param features The quantities of the cluster under test.
      */
-    bool isAboveMinSeedCharge(EUTelVirtualCluster * cluster) const;
+    bool isAboveMinSeedCharge(const EUTelClusterFeatures & features) const;
 
     //! Seed SNR cut
     /*! This is used to select clusters having a seed pixel SNR above
      *  the specified threshold
      *
      *  @return True if the seed SNR is above threshold
-     *  @param cluster The cluster under test.
+     *  @param features The quantities of the cluster under test.
      */
-    bool isAboveMinSeedSNR(EUTelVirtualCluster * cluster) const;
+    bool isAboveMinSeedSNR(const EUTelClusterFeatures & features) const;
 
     //! Quality cut
     /*! This is a selection cut based on the cluster quality. Only
@@ -456,9 +468,9 @@ namespace eutelescope {
      *  quality vector.
      *
      *  @return True if the quality is correct
-     *  @param cluster The cluster under test.
+     *  @param features The quantities of the cluster under test.
      */
-    bool hasQuality(EUTelVirtualCluster * cluster) const;
+    bool hasQuality(const EUTelClusterFeatures & features) const;
 
     //! Same number of hits
     /*! This selection criterion can be used to select events in which
@@ -500,29 +512,29 @@ namespace eutelescope {
      *  having the center within a certain ROI.
      *
      *  @return True if the cluster center is inside the ROI
-     *  @param cluster The cluster under test.
+     *  @param features The quantities of the cluster under test.
      *
      */
-    bool isInsideROI(EUTelVirtualCluster * cluster) const;
+    bool isInsideROI(const EUTelClusterFeatures & features) const;
 
     //! Outside the ROI
     /*! This selection criterion can be used to get only clusters
      *  having the center outside a certain ROI.
      *
      *  @return True if the cluster center is outside the ROI
-     *  @param cluster The cluster under test.
+     *  @param features The quantities of the cluster under test.
      *
      */
-    bool isOutsideROI(EUTelVirtualCluster * cluster) const;
+    bool isOutsideROI(const EUTelClusterFeatures & features) const;
 
     //! Below the maximum cluster noise
     /*! This selection criterion is based on the full cluster noise.
      *
      *  @return True if the cluster noise is below the maximum
      *  allowed.
-     *  @param cluster The cluster under test
+     *  @param features The quantities of the cluster under test
      */
-    bool isBelowMaxClusterNoise(EUTelVirtualCluster * cluster) const;
+    bool isBelowMaxClusterNoise(const EUTelClusterFeatures & features) const;
 
     //! Print the rejection summary
     /*! To better understand which cut is more important, a rejection
@@ -559,6 +571,59 @@ namespace eutelescope {
      */
     void checkCriteria() ;
 
+    //! Can the event still be accepted?
+    /*! The event level criteria are checked against the clusters
+     *  accepted so far and the ones not yet filtered on each plane,
+     *  so that the cluster loop is stopped as soon as the event is
+     *  lost whatever the remaining clusters give. No rejection is
+     *  counted here.
+     *
+     *  @param clusterVec The number of accepted clusters per plane
+     *  @param remainingVec The number of clusters still to be filtered per plane
+     *  @return True if the event can not pass the event level criteria
+     */
+    bool isEventLost(const std::vector<int > & clusterVec, const std::vector<int > & remainingVec) const;
+
+    //! A selection criterion working on a single cluster
+    /*! The criteria switched on are collected by checkCriteria() into
+     *  flat lists, one for the digital fixed frame clusters and one
+     *  for the others. A cluster is rejected by the first criterion it
+     *  fails.
+     */
+    struct ClusterCriterion {
+
+      //! The selection method
+      bool (EUTelClusterFilter::*predicate)(const EUTelClusterFeatures &) const;
+
+      //! Clusters tested since the last reordering
+      double nTested;
+
+      //! Clusters rejected since the last reordering
+      double nRejected;
+    };
+
+    //! An ordered list of cluster criteria
+    struct ClusterCriterionList {
+
+      //! The criteria in the order they are applied
+      std::vector<ClusterCriterion > criteria;
+
+      //! Clusters tested since the last reordering
+      int nClusters;
+    };
+
+    //! Applies a list of criteria to a cluster
+    /*! With the adaptive ordering on, the list stops at the first
+     *  failed criterion and is sorted every
+     *  _cutReorderPeriod clusters putting first the criteria rejecting
+     *  the largest fraction of the clusters they see.
+     *
+     *  @param features The quantities of the cluster under test
+     *  @param list The list of criteria
+     *  @return True if the cluster passes all the criteria
+     */
+    bool passCriteria(const EUTelClusterFeatures & features, ClusterCriterionList & list);
+
   protected:
 
     //! Input pulse collection name.
@@ -747,8 +812,26 @@ namespace eutelescope {
      */
     bool _skipEmptyEvent;
 
+    //! Switch for the adaptive ordering of the cluster criteria
+    /*! When true the cluster based criteria stop at the first failure
+     *  and are periodically reordered according to their rejection
+     *  rates, and the cluster loop stops when the event is lost. The
+     *  accepted clusters do not depend on it, but the rejection summary
+     *  does, see the AdaptiveCutOrdering parameter.
+     */
+    bool _adaptiveCutOrdering;
+
   private:
 
+    //! The cluster criteria for the digital fixed frame clusters
+    ClusterCriterionList _dffCriteria;
+
+    //! The cluster criteria for all the other cluster types
+    ClusterCriterionList _clusterCriteria;
+
+    //! Number of clusters between two reorderings of the criteria
+    static const int _cutReorderPeriod = 1000;
+
     //! A temporary vector for the inside ROI
     /*! The reason for this temporary array is that from the steering
      *  file the user can specify only values and not directly a
@@ -864,6 +947,13 @@ namespace eutelescope {
     //! Rejection summary map
     mutable std::map<std::string, std::vector<unsigned int > > _rejectionMap;
 
+    //! Cluster quantities needed by the selection criteria
+    /*! Filled by checkCriteria() with the N and N x N sizes of the
+     *  switched on cuts. The noise flag is set for each cluster, since
+     *  the noise values may not be available.
+     */
+    EUTelClusterFeatureRequest _featureRequest;
+
     //digital fixed frame cuts
     std::vector<int> _DFFNHitsCuts;
   public:
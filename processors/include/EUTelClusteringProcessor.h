@@ -30,6 +30,7 @@
 
 // lcio includes <.h>
 #include <IMPL/TrackerRawDataImpl.h>
+#include <IMPL/TrackerDataImpl.h>
 #include <IMPL/LCCollectionVec.h>
 
 // system includes <>
@@ -372,6 +373,25 @@ namespace eutelescope {
      */
     void resetStatus(IMPL::TrackerRawDataImpl * status);
 
+    //! Find the seed candidates of a full frame
+    /*! The pixels with a good status and a signal in excess of
+     *  _ffSeedCut times their noise are returned as (signal, index)
+     *  pairs, sorted by increasing signal as the clustering expects.
+     *
+     *  The frame is scanned in blocks of 64 pixels. For each block the
+     *  cut and the status check are first evaluated without branches
+     *  and packed into a 64 bit candidate mask; only the set bits of
+     *  the mask are then visited.
+     *
+     *  @param nzsData The calibrated full frame
+     *  @param noise The noise of the same sensor
+     *  @param status The status of the same sensor
+     *  @param seedCandidates The output seed candidates
+     */
+    void findSeedCandidates(IMPL::TrackerDataImpl * nzsData, IMPL::TrackerDataImpl * noise,
+                            IMPL::TrackerRawDataImpl * status,
+                            std::vector< std::pair<float, unsigned int> > & seedCandidates) const;
+
 #if defined(USE_AIDA) || defined(MARLIN_USE_AIDA)
     //! Book histograms
     /*! This method is used to prepare the needed directory structure
@@ -26,6 +26,7 @@
 // lcio includes <.h>
 #include <EVENT/LCRunHeader.h>
 #include <EVENT/LCEvent.h>
+#include <IMPL/LCCollectionVec.h>
 //#include <TrackerHitImpl2.h>
 #include <IMPL/TrackerHitImpl.h>
 
@@ -43,6 +44,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <utility>
 
 namespace eutelescope {
 
@@ -389,6 +391,42 @@ namespace eutelescope {
 
     std::vector<int> _sensorIDVec;
     std::map<int, int> _sensorIDtoZ;
+
+    //! Decodes all clusters of the event into _clusterX/Y/Charge
+    void decodeClusters(LCEvent * event);
+
+    //! Decodes all hits of the event into _hitPositions
+    void decodeHits(LCCollectionVec * inputHitCollection);
+
+#if defined(USE_AIDA) || defined(MARLIN_USE_AIDA)
+    //! Fills the cluster correlation histograms from _clusterX/Y/Charge
+    void fillClusterCorrelations();
+
+    //! Fills the hit correlation histograms from _hitPositions
+    void fillHitCorrelations();
+#endif
+
+    //! Cluster centres of the current event
+    /*! One vector per sensor, indexed by the sensor position in
+     *  _sensorIDVec. Each cluster is decoded once per event, the
+     *  vectors are reused from event to event.
+     */
+    std::vector< std::vector<float> > _clusterX;
+    std::vector< std::vector<float> > _clusterY;
+    std::vector< std::vector<float> > _clusterCharge;
+
+    //! Global hit positions of the current event
+    /*! One vector per sensor, indexed as _clusterX and sorted along x.
+     */
+    std::vector< std::vector< std::pair<double, double> > > _hitPositions;
+
+    //! Hits correlated to the current external hit
+    /*! _candidateBegin holds for each sensor the first index into
+     *  _candidateX/Y of its hits, plus one final entry.
+     */
+    std::vector<double> _candidateX;
+    std::vector<double> _candidateY;
+    std::vector<size_t> _candidateBegin;
   };
 
   //! A global instance of the processor
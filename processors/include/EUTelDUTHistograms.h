@@ -13,6 +13,7 @@
 
 // eutelescope includes ".h"
 #include "EUTELESCOPE.h"
+#include "EUTelTrackClusterAssociation.h"
 
 //#include "TrackerHitImpl2.h"
 #include "IMPL/TrackerHitImpl.h"
@@ -246,6 +247,19 @@ protected:
     std::vector<double> _bgmeasuredX;
     std::vector<double> _bgmeasuredY;
 
+    //! DUT hits of the current event sorted into cells of _distMax
+    /*! Only the hits in the cells around a fitted position are
+     *  compared to it when looking for the matching hit.
+     */
+    EUTelHitGrid2D _measuredGrid;
+
+    //! Hits already matched to a track, by index in the event
+    std::vector<char> _measuredUsed;
+
+    //! Candidate hits of a fitted position and their residuals
+    std::vector<int> _candidates;
+    std::vector<double> _candidateDist2;
+
     std::map< int, std::vector<double> >  _localX;   
     std::map< int, std::vector<double> >  _localY;   
 
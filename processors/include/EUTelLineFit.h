@@ -13,6 +13,7 @@
 // built only if GEAR is available
 #ifdef USE_GEAR
 // eutelescope includes ".h"
+#include "EUTelLineFitBatch.h"
 
 // marlin includes ".h"
 #include "marlin/Processor.h"
@@ -39,8 +40,8 @@
 namespace eutelescope {
 
   //! Straight line fit processor
-  /*!
-   *
+  /*! The fit itself is done by EUTelLineFitBatch, which can also be
+   *  used directly to fit many track candidates at once.
    */
 
   class EUTelLineFit : public marlin::Processor {
@@ -211,6 +212,9 @@ namespace eutelescope {
     double * _xFitPos;
     double * _yFitPos;
 
+    //! Straight line fitter
+    EUTelLineFitBatch _batchFitter;
+
     //! Fill histogram switch
     /*! Only for debug reason
      */
@@ -14,6 +14,7 @@
 #ifdef USE_GEAR
 // eutelescope includes ".h"
 #include "EUTelUtility.h"
+#include "EUTelMillepedeSolver.h"
 
 //#include "TrackerHitImpl2.h"
 #include "IMPL/TrackerHitImpl.h"
@@ -342,6 +343,13 @@ namespace eutelescope {
      */
     void bookHistos();
 
+    //! Reads back a millepede.res file and saves the alignment constants
+    /*! The constants are written into the collection
+     *  _alignmentConstantCollectionName of the LCIO file
+     *  _alignmentConstantLCIOFile.
+     */
+    void writeAlignmentConstants(const std::string & millepedeResFileName);
+
     TVector3 Line2Plane(int iplane, const TVector3& lpoint, const TVector3& lvector ); 
 
     virtual inline int getAllowedMissingHits(){return _allowedMissingHits;}
@@ -442,6 +450,7 @@ namespace eutelescope {
     int _generatePedeSteerfile;
     std::string _pedeSteerfileName;
     bool _runPede;
+    bool _useInternalSolver;
     int _usePedeUserStartValues;
     FloatVec _pedeUserStartValuesX;
     FloatVec _pedeUserStartValuesY;
@@ -490,6 +499,16 @@ namespace eutelescope {
     // Mille
     Mille * _mille;
 
+    //! Solver used instead of Mille and pede when UseInternalSolver is set
+    EUTelMillepedeSolver _milleSolver;
+
+    //! Passes a measurement to Mille or to the internal solver
+    void addMilleMeasurement(int nLC, float * derLC, int nGL, float * derGL,
+                             int * label, float residual, float sigma);
+
+    //! Closes the current track in Mille or in the internal solver
+    void endMilleTrack();
+
     //! Conversion ID map.
     /*! In the data file, each cluster is tagged with a detector ID
      *  identify the sensor it belongs to. In the geometry
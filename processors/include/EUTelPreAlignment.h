@@ -38,6 +38,7 @@
 #include <map>
 #include <cstdio>
 #include <vector>
+#include <utility>
 
 
 namespace eutelescope {
@@ -49,6 +50,7 @@ namespace eutelescope {
     float range;
     float zPos;
     int iden;
+    std::vector<float> queueX, queueY;
     float getMaxBin(std::vector<int>& histo){
       int maxBin(0), maxVal(0);
       for(size_t ii = 0; ii < histo.size(); ii++){
@@ -87,7 +89,7 @@ namespace eutelescope {
     PreAligner(float pitchX, float pitchY, float zPos, int iden): 
       pitchX(pitchX), pitchY(pitchY), 
       minX(-40.0), maxX(40), range(maxX - minX),
-      zPos(zPos), iden(iden){
+      zPos(zPos), iden(iden), queueX(), queueY(){
       histoX.assign( int( range / pitchX ), 0);
       histoY.assign( int( range / pitchY ), 0);
     }
@@ -96,13 +98,29 @@ namespace eutelescope {
     int getIden() const { return(iden); }
     void addPoint(float x, float y){
       //Add to histo if within bounds, throw away data that is out of bounds
-      try{
-	histoX.at( static_cast<int> ( (x - minX)/pitchX) ) += 1; 
-      } catch (std::out_of_range& e) {;}
-      try{
-	histoY.at( static_cast<int> ( (y - minX)/pitchY) ) += 1; 
-      } catch (std::out_of_range& e) {;}
+      int binX = static_cast<int> ( (x - minX)/pitchX);
+      if(binX >= 0 && binX < static_cast<int>(histoX.size())) histoX[binX] += 1;
+      int binY = static_cast<int> ( (y - minX)/pitchY);
+      if(binY >= 0 && binY < static_cast<int>(histoY.size())) histoY[binY] += 1;
     }
+    //! Keep a point to be added later by fillQueued()
+    void queuePoint(float x, float y){
+      queueX.push_back(x);
+      queueY.push_back(y);
+    }
+    //! Add all queued points to the histograms
+    /*! Only touches this PreAligner, so different PreAligners can be
+     *  filled concurrently.
+     */
+    void fillQueued(){
+      for(size_t ii = 0; ii < queueX.size(); ii++) addPoint(queueX[ii], queueY[ii]);
+    }
+    void clearQueue(){
+      queueX.clear();
+      queueY.clear();
+    }
+    std::vector<float> const & getQueuedX() const { return queueX; }
+    std::vector<float> const & getQueuedY() const { return queueY; }
     float getPeakX(){
       return( (getMaxBin(histoX) * pitchX) + minX) ;
     }
@@ -136,6 +154,12 @@ namespace eutelescope {
      */
     virtual void  FillHotPixelMap(LCEvent *event);
 
+    //! Adds the queued residuals to the PreAligners
+    /*! The PreAligner histograms are filled in parallel, one task per
+     *  plane, while the control histograms are filled here.
+     */
+    void flushPreAligners();
+
   private:
     //! Hot pixel collection name.
     /*! 
@@ -201,6 +225,23 @@ namespace eutelescope {
     gear::SiPlanesParameters * _siPlanesParameters;
     gear::SiPlanesLayerLayout * _siPlanesLayerLayout;
     std::vector<PreAligner> _preAligners;
+
+    //! Index into _preAligners for each sensor ID
+    std::map<int, size_t> _preAlignerIndexMap;
+
+    //! Hits of the current event on each PreAligner plane, sorted along x
+    std::vector< std::vector< std::pair<double, double> > > _planeHits;
+
+    //! Hits of the current event on the fixed plane
+    std::vector< std::pair<double, double> > _refHits;
+
+    //! Correlated hits found for the current reference hit
+    /*! Each entry holds the PreAligner index and the X and Y residuals.
+     */
+    std::vector< std::pair<size_t, std::pair<float, float> > > _candidates;
+
+    //! Number of residuals waiting in the PreAligner queues
+    size_t _queuedPoints;
     std::vector<int> _ExcludedPlanesXCoord;  
     std::vector<int> _ExcludedPlanesYCoord;  
     std::vector<int> _ExcludedPlanes;  
@@ -23,6 +23,7 @@
 #include "TProfile2D.h"
 #include "cluster.h"
 #include "CrossSection.hpp"
+#include "EUTelTrackClusterAssociation.h"
 
 class EUTelProcessorAnalysisPALPIDEfs : public marlin::Processor {
 public:
@@ -45,7 +46,11 @@ public:
 #endif
   virtual void end();
   bool emptyMiddle(std::vector<std::vector<int> > pixVector);
-  bool RemoveAlign(LCCollectionVec * preAlignmentCollectionVec, LCCollectionVec * alignmentCollectionVec, LCCollectionVec * alignmentPAlpideCollectionVec, double* fitpos, double& xposfit, double& yposfit);
+  //! Looks up the alignment constants of the DUT and rebuilds the composite transformation if they changed
+  /*! Returns false if the alignment or the prealignment of the DUT is missing. */
+  bool UpdateAlignTransform(LCCollectionVec * preAlignmentCollectionVec, LCCollectionVec * alignmentCollectionVec, LCCollectionVec * alignmentPAlpideCollectionVec);
+  //! Removes the alignment from a fitted hit, with the transformation of the last UpdateAlignTransform
+  bool RemoveAlign(double* fitpos, double& xposfit, double& yposfit);
 protected:
   //! Fill histogram switch
   /*! This boolean is used to switch on and off the filling of
@@ -124,8 +129,24 @@ private:
   int nNoPAlpideHit;
   int nWrongPAlpideHit;
   int nPlanesWithTooManyHits;
-  std::vector<int> noiseMaskX;
-  std::vector<int> noiseMaskY;
+  //! Masked, hot and dead pixels of the DUT
+  eutelescope::EUTelPixelMask _noiseMask;
+  eutelescope::EUTelPixelMask _hotPixelMask;
+  eutelescope::EUTelPixelMask _deadColumnMask;
+  //! Global hit position to (x, y, rotated z) on the DUT
+  eutelescope::EUTelAffineTransform3D _hitToLocal;
+  //! Fitted hit position to (x, y, rotated z) on the DUT, removing the alignment
+  eutelescope::EUTelAffineTransform3D _fitToLocal;
+  //! Alignment constants _fitToLocal was built with
+  std::vector<double> _fitToLocalConstants;
+  //! Are the alignment constants of the DUT available in this event?
+  bool _alignRemovable;
+  //! DUT hits of the event on the DUT, 3 values per hit of the input collection
+  std::vector<double> _dutHitLocal;
+  //! DUT hits of the event, indexed by their position in the input collection
+  eutelescope::EUTelHitGrid2D _dutHitGrid;
+  //! First cluster of the event for each time stamp
+  std::map<float, size_t> _clusterTimeIndex;
   double xZero;
   double yZero;
   double xPitch;
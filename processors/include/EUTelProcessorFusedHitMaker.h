@@ -0,0 +1,198 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+#ifndef EUTelProcessorFusedHitMaker_H
+#define EUTelProcessorFusedHitMaker_H 1
+
+// eutelescope includes ".h"
+#include "EUTelUtility.h"
+#include "EUTELESCOPE.h"
+
+// marlin includes ".h"
+#include "marlin/Processor.h"
+
+// lcio includes <.h>
+#include <EVENT/LCEvent.h>
+#include <EVENT/LCRunHeader.h>
+#include <IMPL/LCCollectionVec.h>
+#include <IMPL/TrackerDataImpl.h>
+
+// system includes <>
+#include <string>
+#include <map>
+#include <vector>
+
+namespace eutelescope {
+
+  //! Fused noisy pixel removal, sparse clustering and hit making
+  /*! This processor goes in one pass from the zero suppressed data
+   *  collection to a collection of TrackerHit. It replaces the chain
+   *  EUTelProcessorNoisyPixelRemover, EUTelProcessorSparseClustering
+   *  and EUTelProcessorHitMaker for sensors read out with
+   *  kEUTelGenericSparsePixel data.
+   *
+   *  The separate processors materialise a TrackerData / TrackerPulse
+   *  pair for every cluster which the next processor immediately
+   *  decodes again. Here the pixels are read directly from the charge
+   *  values of the input TrackerData into reusable buffers, clustered
+   *  and converted into hits without creating any intermediate LCIO
+   *  objects.
+   *
+   *  The results are the same as the ones of the separate chain:
+   *  pixels found in the noisy pixel collection are ignored, two pixels
+   *  belong to the same cluster if their squared distance in pixel
+   *  indices is not larger than SparseMinDistanceSquared and the hit
+   *  position is the charge weighted center of gravity, converted in
+   *  the global frame of reference unless local coordinates are
+   *  requested.
+   *
+   *  <h4>Input collections</h4>
+   *
+   *  <b>ZS data</b>: the zero suppressed TrackerData collection.
+   *
+   *  <b>Noisy pixels</b>: optionally, the noisy pixel collection as
+   *  written by EUTelProcessorNoisyPixelFinder, loaded as condition
+   *  file. It is read in the first event only.
+   *
+   *  <h4>Output collections</h4>
+   *
+   *  <b>Tracker hit</b>: a collection of TrackerHit. As with
+   *  EUTelProcessorHitMaker, the sparse cluster TrackerData is always
+   *  attached to each hit as its raw hit, kept in the
+   *  "original_zsdata" collection.
+   *
+   *  <b>Tracker pulse</b>: optionally, if PulseCollectionName is not
+   *  empty, the clusters are persisted exactly as the sparse clustering
+   *  would do, together with the "original_zsdata" collection. If it is
+   *  empty, no pulses are created and "original_zsdata" is transient,
+   *  so the raw hits are available to the processors of the same job
+   *  but are not written out.
+   *
+   *  No control histograms are filled, use the separate processors if
+   *  those are needed.
+   *
+   *  @param ZSDataCollectionName Name of the input zero suppressed data collection.
+   *  @param NoisyPixelCollectionName Name of the noisy pixel collection.
+   *  @param PulseCollectionName Name of the (optional) cluster collection.
+   *  @param HitCollectionName Name of the output hit collection.
+   *  @param SparseMinDistanceSquared Squared pixel distance for neighbours.
+   *  @param ExcludedPlanes Sensor IDs excluded from the clustering.
+   *  @param EnableLocalCoordidates Hits are kept in the local frame of reference.
+   *  @param ReferenceCollection Name of the reference hit collection.
+   *  @param ReferenceHitFile File where the reference hit collection is stored.
+   */
+  class EUTelProcessorFusedHitMaker : public marlin::Processor {
+
+  private:
+    DISALLOW_COPY_AND_ASSIGN(EUTelProcessorFusedHitMaker)
+
+  public:
+    //! Returns a new instance of EUTelProcessorFusedHitMaker
+    virtual Processor* newProcessor() {
+      return new EUTelProcessorFusedHitMaker;
+    }
+
+    //! Default constructor
+    EUTelProcessorFusedHitMaker();
+
+    //! Called at the job beginning.
+    /*! Initializes the geometry and, if global coordinates are
+     *  requested, writes the reference hit collection.
+     */
+    virtual void init();
+
+    //! Called for every run.
+    virtual void processRunHeader(LCRunHeader* run);
+
+    //! Called every event
+    /*! Removes the noisy pixels, clusters the remaining ones and
+     *  converts each cluster into a TrackerHit.
+     */
+    virtual void processEvent(LCEvent* evt);
+
+    //! Called after data processing.
+    /*! Prints the number of hits found on each sensor.
+     */
+    virtual void end();
+
+  protected:
+    //! A fired pixel decoded from the zero suppressed data
+    struct FusedPixel {
+      int x;
+      int y;
+      float signal;
+      float time;
+    };
+
+    //! Fills _pixelBuffer with the non noisy pixels of zsData
+    void readPixels(TrackerDataImpl* zsData, int sensorID);
+
+    //! Groups _pixelBuffer into clusters
+    /*! On return _clusterPixels contains the pixel indices of all
+     *  clusters one after the other and _clusterBegin the offset of
+     *  each cluster into it, plus one final entry with the total size.
+     */
+    void findClusters();
+
+    //! Input zero suppressed data collection name
+    std::string _zsDataCollectionName;
+
+    //! Noisy pixel collection name
+    std::string _noisyPixelCollectionName;
+
+    //! Output cluster collection name, empty if clusters are not stored
+    std::string _pulseCollectionName;
+
+    //! Output hit collection name
+    std::string _hitCollectionName;
+
+    //! Reference hit collection name
+    std::string _referenceHitCollectionName;
+
+    //! Reference hit file name
+    std::string _referenceHitLCIOFile;
+
+    //! Squared cut value for distance in pixel index count (integer!)
+    int _sparseMinDistanceSquared;
+
+    //! List of excluded planes.
+    std::vector<int> _ExcludedPlanes;
+
+    //! Keep the hits in the sensor local frame of reference
+    bool _wantLocalCoordinates;
+
+    //! Current run number
+    int _iRun;
+
+    //! Current event number
+    int _iEvt;
+
+    //! Noisy pixels per sensor, sorted cantor encoded pixel indices
+    std::map<int, std::vector<int>> _noisyPixelMap;
+
+    //! Total number of hits found per sensor
+    std::map<int, int> _totHitMap;
+
+    //! Pixels of the sensor being processed, sorted along x
+    std::vector<FusedPixel> _pixelBuffer;
+
+    //! Flags pixels already assigned to a cluster
+    std::vector<char> _usedBuffer;
+
+    //! Pixel indices of all the clusters of the current sensor
+    std::vector<size_t> _clusterPixels;
+
+    //! Offsets of the clusters into _clusterPixels
+    std::vector<size_t> _clusterBegin;
+  };
+
+  //! A global instance of the processor
+  EUTelProcessorFusedHitMaker gEUTelProcessorFusedHitMaker;
+}
+#endif
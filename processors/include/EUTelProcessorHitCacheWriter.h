@@ -0,0 +1,101 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+#ifndef EUTelProcessorHitCacheWriter_H
+#define EUTelProcessorHitCacheWriter_H 1
+
+// eutelescope includes ".h"
+#include "EUTelUtility.h"
+#include "EUTelHitCache.h"
+
+// marlin includes ".h"
+#include "marlin/Processor.h"
+
+// lcio includes <.h>
+#include <EVENT/LCEvent.h>
+#include <EVENT/LCRunHeader.h>
+
+// system includes <>
+#include <string>
+#include <vector>
+
+namespace eutelescope {
+
+  //! Writes the hits into a hit cache file
+  /*! To be run after EUTelProcessorHitMaker (or any other processor
+   *  making hits). For every event the position, diagonal covariance,
+   *  sensor ID, properties and type of the hits are appended to a
+   *  columnar, memory mappable file (see EUTelHitCacheHeader), with
+   *  the cluster size and charge taken from the attached cluster if
+   *  present. The file can be read back with the EUTelHitCacheReader
+   *  data source, avoiding to re-read the full LCIO files for
+   *  repeated fitting and analysis passes.
+   *
+   *  Events without the hit collection are stored as empty events,
+   *  so that the event index of the cache follows the input file.
+   *
+   *  @param HitCollectionName Name of the input hit collection.
+   *  @param HitCacheFileName Name of the output cache file.
+   */
+  class EUTelProcessorHitCacheWriter : public marlin::Processor {
+
+  private:
+    DISALLOW_COPY_AND_ASSIGN(EUTelProcessorHitCacheWriter)
+
+  public:
+    //! Returns a new instance of EUTelProcessorHitCacheWriter
+    virtual Processor* newProcessor() {
+      return new EUTelProcessorHitCacheWriter;
+    }
+
+    //! Default constructor
+    EUTelProcessorHitCacheWriter();
+
+    //! Called at the job beginning.
+    /*! Opens the cache file.
+     */
+    virtual void init();
+
+    //! Called for every run.
+    virtual void processRunHeader(LCRunHeader* run);
+
+    //! Called every event
+    /*! Appends the hits of the event to the cache.
+     */
+    virtual void processEvent(LCEvent* evt);
+
+    //! Called after data processing.
+    /*! Writes the cache file.
+     */
+    virtual void end();
+
+  protected:
+    //! Input hit collection name
+    std::string _hitCollectionName;
+
+    //! Output cache file name
+    std::string _hitCacheFileName;
+
+    //! Current run number
+    int _iRun;
+
+    //! Current event number
+    int _iEvt;
+
+    //! The cache writer
+    EUTelHitCacheFileWriter _writer;
+
+    //! Hits of the current event
+    std::vector<EUTelCachedHit> _eventHits;
+  };
+
+  //! A global instance of the processor
+  EUTelProcessorHitCacheWriter gEUTelProcessorHitCacheWriter;
+}
+#endif
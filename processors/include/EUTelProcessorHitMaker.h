@@ -13,6 +13,8 @@
 #ifdef USE_GEAR
 // eutelescope includes ".h"
 #include "EUTelUtility.h"
+#include "EUTelEventObjectPool.h"
+#include "EUTelSparseClusterImpl.h"
 
 // marlin includes ".h"
 #include "marlin/Processor.h"
@@ -352,6 +354,9 @@ namespace eutelescope {
     //! Event number
     int _iEvt;
 
+    //! Number of hits using the eta corrected CoG shift
+    long _nEtaCorrectedHits;
+
     //! Conversion ID map.
     /*! In the data file, each cluster is tagged with a detector ID
      *  identify the sensor it belongs to. In the geometry
@@ -370,6 +375,12 @@ namespace eutelescope {
      */
     std::set< int > _alreadyBookedSensorID;
 
+    //! Sparse clusters decoded in the current event
+    /*! Recycled at each event, so that the clusters and their pixel
+     *  vectors are allocated only once.
+     */
+    EUTelEventObjectPool< EUTelSparseClusterImpl<EUTelGenericSparsePixel> > _clusterPool;
+
 #if defined(USE_AIDA) || defined(MARLIN_USE_AIDA)
     //! AIDA histogram map
     /*! Instead of putting several pointers to AIDA histograms as
@@ -0,0 +1,188 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+#ifndef EUTelProcessorIterativeAlignment_H
+#define EUTelProcessorIterativeAlignment_H 1
+
+// eutelescope includes ".h"
+#include "EUTelUtility.h"
+#include "EUTELESCOPE.h"
+#include "EUTelLineFitBatch.h"
+
+// marlin includes ".h"
+#include "marlin/Processor.h"
+
+// lcio includes <.h>
+#include <EVENT/LCEvent.h>
+#include <EVENT/LCRunHeader.h>
+
+// system includes <>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace eutelescope {
+
+  //! Iterative telescope alignment on hits kept in memory
+  /*! The usual iterative alignment re-runs the whole chain (reading
+   *  the LCIO file, clustering, hit making, track finding and
+   *  Millepede) once per iteration only to feed the alignment
+   *  constants of the previous iteration to the next one. This
+   *  processor instead reads the hit collection once, keeping the
+   *  local hit positions in memory, and runs all the iterations in
+   *  end():
+   *
+   *  - the hits are moved in the global frame with the current plane
+   *    positions and rotations of EUTelGeometryTelescopeGeoDescription;
+   *  - tracks are searched following straight lines from the first
+   *    plane, and refitted with EUTelLineFitBatch;
+   *  - the accepted tracks are passed to an EUTelMillepedeSolver and
+   *    the solved corrections are applied to the geometry.
+   *
+   *  The iterations stop when all the corrections are smaller than
+   *  ConvergenceThreshold times their errors, or after MaxIterations.
+   *  The aligned geometry is written in a new GEAR file, as
+   *  EUTelPedeGEAR does.
+   *
+   *  Corrections are shifts in x and y and, for AlignMode 1, a
+   *  rotation around the z axis. The FixedPlanes (by default the
+   *  first and the last plane) define the frame of reference.
+   *
+   *  <h4>Input collections</h4>
+   *
+   *  <b>Hits</b>: a TrackerHit collection, in the local or in the
+   *  global frame of reference.
+   *
+   *  @param HitCollectionName Name of the input hit collection.
+   *  @param ExcludedPlanes Sensor IDs not used in the alignment.
+   *  @param FixedPlanes Sensor IDs kept fixed.
+   *  @param AlignMode 1 for x, y shifts and z rotation, 2 for shifts only.
+   *  @param ResidualCut Window (mm) in x and y for the track search.
+   *  @param MaxChi2 Maximum chi2 / ndf of the accepted tracks.
+   *  @param MaxIterations Maximum number of alignment iterations.
+   *  @param ConvergenceThreshold Corrections / errors below which the alignment stops.
+   *  @param NewGEARSuffix Suffix of the output GEAR file.
+   */
+  class EUTelProcessorIterativeAlignment : public marlin::Processor {
+
+  private:
+    DISALLOW_COPY_AND_ASSIGN(EUTelProcessorIterativeAlignment)
+
+  public:
+    //! Returns a new instance of EUTelProcessorIterativeAlignment
+    virtual Processor* newProcessor() {
+      return new EUTelProcessorIterativeAlignment;
+    }
+
+    //! Default constructor
+    EUTelProcessorIterativeAlignment();
+
+    //! Called at the job beginning.
+    /*! Initializes the geometry and orders the aligned planes along z.
+     */
+    virtual void init();
+
+    //! Called for every run.
+    virtual void processRunHeader(LCRunHeader* run);
+
+    //! Called every event
+    /*! Stores the local positions of the hits of the aligned planes.
+     */
+    virtual void processEvent(LCEvent* evt);
+
+    //! Called after data processing.
+    /*! Runs the alignment iterations and writes the GEAR file.
+     */
+    virtual void end();
+
+  protected:
+    //! Computes the global positions of all the stored hits
+    void moveHitsToGlobal();
+
+    //! Searches and fits the tracks of all the stored events
+    void findTracks();
+
+    //! Solves one alignment iteration and updates the geometry
+    /*! @param converged set to true if all the corrections are
+     *  below the convergence threshold
+     *  @return false if the alignment can not be solved
+     */
+    bool alignIteration(int iteration, bool & converged);
+
+    //! Input hit collection name
+    std::string _hitCollectionName;
+
+    //! Sensor IDs of the excluded planes
+    std::vector<int> _excludedPlanes;
+
+    //! Sensor IDs of the fixed planes
+    std::vector<int> _fixedPlanes;
+
+    //! Alignment mode
+    int _alignMode;
+
+    //! Track search window in mm
+    float _residualCut;
+
+    //! Maximum chi2 / ndf of the tracks
+    float _maxChi2;
+
+    //! Maximum number of iterations
+    int _maxIterations;
+
+    //! Convergence threshold on corrections / errors
+    float _convergenceThreshold;
+
+    //! Suffix of the aligned GEAR file
+    std::string _GEARFileSuffix;
+
+    //! Current run number
+    int _iRun;
+
+    //! Current event number
+    int _iEvt;
+
+    //! Aligned sensor IDs, ordered along z
+    std::vector<int> _planeSensorID;
+
+    //! Index into _planeSensorID of each aligned sensor ID
+    std::map<int, int> _planeIndexMap;
+
+    //! Hit resolutions of the aligned planes
+    std::vector<double> _resolutionX;
+    std::vector<double> _resolutionY;
+
+    //! @name Resident hits
+    /*! Only events with at least one hit on every aligned plane are
+     *  stored. The hits of plane p in the stored event e are the
+     *  entries from _planeBegin[e*n+p] to _planeBegin[e*n+p+1] of the
+     *  hit arrays, n being the number of aligned planes.
+     */
+    //@{
+    std::vector<size_t> _planeBegin;
+    std::vector<double> _hitLocalX;
+    std::vector<double> _hitLocalY;
+    //@}
+
+    //! Global hit positions for the current geometry
+    std::vector<double> _hitGlobalX;
+    std::vector<double> _hitGlobalY;
+    std::vector<double> _hitGlobalZ;
+
+    //! Hit indices of each found track, _planeSensorID.size() per track
+    std::vector<size_t> _trackHits;
+
+    //! Straight line fits of the found tracks
+    EUTelLineFitBatch _fitter;
+  };
+
+  //! A global instance of the processor
+  EUTelProcessorIterativeAlignment gEUTelProcessorIterativeAlignment;
+}
+#endif
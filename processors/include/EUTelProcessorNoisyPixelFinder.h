@@ -27,6 +27,7 @@
 
 // system includes <>
 #include <map>
+#include <vector>
 
 
 namespace eutelescope {
@@ -65,6 +66,14 @@ struct sensor {
  *  @param ExcludedPlanes Planes to be excluded from processing
  *
  *  @param HotPixelCollectionName The name of the collection in the output file
+ *
+ *  @param UpdateInterval If larger than zero, every UpdateInterval events an
+ *  intermediate noisy pixel collection, based on the events seen so far, is
+ *  added to the event. This allows EUTelProcessorNoisyPixelRemover to mask
+ *  pixels incrementally in the same job instead of a separate pre-pass.
+ *
+ *  @param UpdateCollectionName Name of the intermediate noisy pixel collection,
+ *  which is transient and not written to the output file
  */
 class EUTelProcessorNoisyPixelFinder : public marlin::Processor {
 
@@ -125,6 +134,20 @@ public:
 
     //! HotPixelFinder
     void noisyPixelFinder(EUTelEventImpl *input);
+
+    //! Apply the firing frequency cut to the hit counters
+    /*! The sensors are scanned in parallel, the result is stored in
+     *  _noisyPixelMap.
+     *
+     *  @param nEvents number of events the counters were filled with
+     */
+    void findNoisyPixels(int nEvents);
+
+    //! Apply the firing frequency cut to the hit counter of one sensor
+    std::vector<EUTelGenericSparsePixel> findNoisyPixels(int sensorID, int nEvents) const;
+
+    //! Add an intermediate noisy pixel collection to the event
+    void publishNoisyPixels(LCEvent* event);
     
     //! Check call back
     /*! This method is called every event just after the processEvent
@@ -191,12 +214,12 @@ protected:
     std::map<int, sensor> _sensorMap;
 
     //! Map holding the 2D-"array" which counts the hits
-    /*! The key is the sensorID and the array is implemented as
-     *  a vector of vectors. They are resized initially so there 
-     *  is no real overhead with using std::vectors instead of
-     * arrays.
+    /*! The key is the sensorID and the array is a contiguous
+     *  vector of sizeX*sizeY counters, the counter of pixel (x,y)
+     *  is found at index (x-offX)*sizeY + (y-offY). They are
+     *  resized initially and never reallocated.
      */
-    std::map<int, std::vector<std::vector<int>>> _hitVecMap;
+    std::map<int, std::vector<int>> _hitCountMap;
     
     //! Map for storing the hot pixels in a std::vector as a value
     /*! The key is once again the sensorID.
@@ -226,8 +249,17 @@ protected:
     //! write out the list of hot pixels
     void noisyPixelDBWriter();
 
+    //! Fill a TrackerData collection with the content of _noisyPixelMap
+    void fillNoisyPixelCollection(LCCollectionVec* noisyPixelCollection);
+
     //! Flag which will be set once we're done finding noisy pixels
     bool _finished;
+
+    //! Number of events between intermediate noisy pixel collections
+    int _updateInterval;
+
+    //! Name of the intermediate noisy pixel collection
+    std::string _updateCollectionName;
 };
 
 //! A global instance of the processor
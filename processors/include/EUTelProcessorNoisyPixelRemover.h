@@ -97,6 +97,13 @@ class EUTelProcessorNoisyPixelRemover : public marlin::Processor {
 	
 	//! Collection name for noisy pixel collection
 	std::string _noisyPixelCollectionName; 
+
+	//! Collection name for intermediate noisy pixel collections
+	/*! If this collection is found in an event, e.g. published by
+	 *  EUTelProcessorNoisyPixelFinder in update mode, the noisy pixel
+	 *  list is replaced by its content.
+	 */
+	std::string _noisyPixelUpdateCollectionName;
 	
 	std::map<int, std::vector<int>> _noisyPixelMap;
 	bool _firstEvent = true;
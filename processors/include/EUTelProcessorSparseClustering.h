@@ -13,6 +13,8 @@
 // eutelescope includes ".h"
 #include "EUTelExceptions.h"
 #include "EUTELESCOPE.h"
+#include "EUTelEventObjectPool.h"
+#include "EUTelSparseClusterImpl.h"
 
 // marlin includes ".h"
 #include "marlin/EventModifier.h"
@@ -288,6 +290,12 @@ private:
      */
     std::map< int, int > _totClusterMap;
 
+    //! Clusters decoded for the histograms of the current event
+    /*! Recycled at each event, so that the clusters and their pixel
+     *  vectors are allocated only once.
+     */
+    EUTelEventObjectPool< EUTelSparseClusterImpl<EUTelGenericSparsePixel> > _histoClusterPool;
+
     //! The number of detectors
     /*! The number of sensors in the telescope. This is retrieve from
      *  the run header
@@ -274,7 +274,9 @@ namespace eutelescope {
    *  \li Use nominal plane resolutions instead of cluster position
    *      errors (set \e UseNominalResolution to \e true ). For full
    *      tracks (without missing hits) matrix inversion is done only
-   *      once and not for each track hypothesis.
+   *      once and not for each track hypothesis. For tracks with
+   *      missing or skipped hits the inverted matrix is calculated
+   *      once for each hit pattern and cached.
    *
    *  \li Use beam constraint (set \e UseBeamConstraint to \e true ),
    *      even if beam spread is large. With beam
@@ -415,6 +417,15 @@ namespace eutelescope {
      */
     double NominalFit();
 
+    //! Find track in XZ and YZ using cached fit matrix
+    /*! When nominal position errors are used, the fit matrix depends
+     *  only on the set of planes with hits in the fit hypothesis.
+     *  The inverted matrix is calculated once for each hit pattern
+     *  and stored in _patternFitCache, so that each fit reduces to
+     *  two matrix-vector products.
+     */
+    double PatternFit();
+
     //! Fit particle track in one plane (XZ or YZ), taking into
     //! account beam slope
     int DoAnalFit(double * pos, double *err, double slope=0.);
@@ -598,6 +609,13 @@ namespace eutelescope {
     double * _nominalFitArrayY ;
     double * _nominalErrorY ;
 
+    //! Inverted fit matrices for nominal errors, indexed by hit pattern
+    /*! Key is the bit mask of planes used in the fit. Each entry
+     *  holds the inverted fit matrix (_nTelPlanes x _nTelPlanes)
+     *  followed by the expected position errors in all planes.
+     */
+    std::map<unsigned long long, std::vector<double> > _patternFitCache;
+
     // few counter to show the final summary
 
     //! Number of event w/o input hit
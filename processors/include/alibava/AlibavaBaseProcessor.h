@@ -28,6 +28,8 @@
 // system includes <>
 #include <string>
 #include <list>
+#include <map>
+#include <vector>
 
 namespace alibava {
 	
@@ -145,6 +147,14 @@ namespace alibava {
 		// to access the mask value of a channel		
 		bool isMasked(int chipnum, int ichan);
 		
+		//! Mask values of all the channels of a chip
+		/*! One byte per channel, 1 if the channel is masked, as
+		 *  returned by isMasked(). The values are computed once and
+		 *  kept until the chip selection or the channel masking
+		 *  change, so they can be used in the per event loops.
+		 */
+		const std::vector<unsigned char> & getMaskOfChip(int chipnum);
+		
 		//! Applies _channelsToBeUsed parameter
 		/*! Make sure you set _channelsToBeUsed parameter
 		 *  and _nChips before using this function
@@ -261,6 +271,9 @@ namespace alibava {
 		
 		void setAllMasksTo(bool abool);
 		
+		//! Masks returned by getMaskOfChip(), by chip number
+		std::map<int , std::vector<unsigned char> > _maskOfChip;
+		
 		
 		
 		// a map to store pedestal values for chips
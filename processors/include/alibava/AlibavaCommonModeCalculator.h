@@ -0,0 +1,127 @@
+/*
+ * Created by Thomas Eichhorn
+ *  (2014 DESY)
+ *
+ *  email:thomas.eichhorn@cern.ch
+ *
+ *  modified by: Eda Yildirim eda.yildirim@cern.ch
+ */
+
+#ifndef ALIBAVACOMMONMODECALCULATOR_H
+#define ALIBAVACOMMONMODECALCULATOR_H 1
+
+// alibava includes ".h"
+#include "ALIBAVA.h"
+
+// lcio includes <.h>
+#include <lcio.h>
+
+// system includes <>
+#include <string>
+#include <vector>
+
+namespace alibava {
+
+	//! Common mode calculation for the alibava chips
+	/*! The channel masks are passed as precomputed byte arrays, one
+	 *  byte per channel and 1 if the channel is masked, as returned by
+	 *  AlibavaBaseProcessor::getMaskOfChip(). The loops over the
+	 *  channels are written without branches, with masked sums in
+	 *  several partial accumulators.
+	 *
+	 *  Available methods:
+	 *  \li IterativeMean: the mean and RMS of the unmasked channels,
+	 *  recomputed for the given number of iterations excluding the
+	 *  channels deviating more than NoiseDeviation times the RMS from
+	 *  the mean. This is the original constant common mode.
+	 *  \li Median: the median of the unmasked channels, the error is
+	 *  the median absolute deviation scaled to a gaussian sigma.
+	 *  \li Group: the IterativeMean calculated separately for each
+	 *  group of GroupSize consecutive channels.
+	 *
+	 *  The common mode and its error are returned per channel, so they
+	 *  can be used as they are by AlibavaCommonModeSubtraction.
+	 *  The work buffers are kept between the calls.
+	 */
+	class AlibavaCommonModeCalculator {
+
+	public:
+
+		//! Common mode methods
+		enum Method {
+			kIterativeMean,
+			kMedian,
+			kGroup
+		};
+
+		//! Default constructor, IterativeMean with 3 iterations and 2.5 RMS
+		AlibavaCommonModeCalculator();
+
+		// setters and getters
+		void setMethod(Method method);
+		Method getMethod() const;
+
+		void setNIteration(int nIteration);
+		int getNIteration() const;
+
+		void setNoiseDeviation(float noiseDeviation);
+		float getNoiseDeviation() const;
+
+		void setGroupSize(int groupSize);
+		int getGroupSize() const;
+
+		//! Method from its name
+		/*! @return false if the name is not one of IterativeMean, Median
+		 *  or Group
+		 */
+		static bool getMethodFromName(std::string name, Method & method);
+
+		//! Calculates the common mode of a chip
+		/*! @param dataVec the pedestal subtracted data of the chip
+		 *  @param mask the channel masks of the chip, missing channels are not masked
+		 *  @param commonModeVec the common mode of each channel
+		 *  @param commonModeErrorVec the common mode error of each channel
+		 */
+		void calculate(const EVENT::FloatVec & dataVec, const std::vector<unsigned char> & mask,
+							EVENT::FloatVec & commonModeVec, EVENT::FloatVec & commonModeErrorVec);
+
+		//! Calculates the common mode of several chips in one call
+		/*! The vectors are indexed by chip, as in the input collection.
+		 *  The output vectors are resized if needed and reused.
+		 */
+		void calculate(const std::vector<const EVENT::FloatVec *> & dataVecs,
+							const std::vector<const std::vector<unsigned char> *> & masks,
+							std::vector<EVENT::FloatVec> & commonModeVecs,
+							std::vector<EVENT::FloatVec> & commonModeErrorVecs);
+
+		//! Subtracts the common mode from the data of a chip
+		/*! The masked channels are set to zero.
+		 */
+		static void subtract(const EVENT::FloatVec & dataVec, const EVENT::FloatVec & commonModeVec,
+									const std::vector<unsigned char> & mask, EVENT::FloatVec & newDataVec);
+
+	protected:
+
+		//! Iterative mean and RMS of the channels from begin to end
+		void iterativeMean(const float * data, const unsigned char * use, size_t begin, size_t end,
+								 double & mean, double & sigma) const;
+
+		//! Median and scaled median absolute deviation of the used channels
+		void median(const float * data, const unsigned char * use, size_t nChannels,
+						double & median, double & sigma);
+
+		Method _method;
+		int _nIteration;
+		float _noiseDeviation;
+		int _groupSize;
+
+		// 1 for the channels used in the calculation
+		std::vector<unsigned char> _use;
+
+		// values of the used channels for the median
+		std::vector<float> _values;
+	};
+
+}
+
+#endif
@@ -12,6 +12,7 @@
 
 // alibava includes ".h"
 #include "AlibavaBaseProcessor.h"
+#include "AlibavaCommonModeCalculator.h"
 
 // marlin includes ".h"
 #include "marlin/Processor.h"
@@ -26,6 +27,7 @@
 // system includes <>
 #include <string>
 #include <list>
+#include <vector>
 
 namespace alibava {
 	
@@ -155,6 +157,15 @@ namespace alibava {
 		 */
 		float _NoiseDeviation;
 		
+		//! Common mode method
+		/*! One of IterativeMean, Median or Group, see
+		 *  AlibavaCommonModeCalculator for the description
+		 */
+		std::string _commonModeMethodName;
+		
+		//! Number of consecutive channels in a group for the Group method
+		int _commonModeGroupSize;
+		
 		// getter and setter for _commonmodeCollectionName
 		void setCommonModeCollectionName(std::string CommonModeCollectionName);
 		std::string getCommonModeCollectionName();
@@ -163,14 +174,6 @@ namespace alibava {
 		void setCommonModeErrorCollectionName(std::string CommonModeErrorCollectionName);
 		std::string getCommonModeErrorCollectionName();
 
-		// getter and setter for _commonmode
-		void setCommonModeVec(EVENT::FloatVec common);
-		EVENT::FloatVec getCommonModeVec();
-		
-		// getter and setter for _commonmodeerror
-		void setCommonModeErrorVec(EVENT::FloatVec commonerror);
-		EVENT::FloatVec getCommonModeErrorVec();
-
 		
 	protected:
 										
@@ -184,13 +187,6 @@ namespace alibava {
 		 */
 		std::string _commonmodeerrorHistoName;
 		
-		//! Calculates common mode values
-		/*! Fills the histograms
-		 */
-
-		void calculateConstantCommonMode(TrackerDataImpl * trkdata);
-		
-
 		//! The function that returns name of the signal correction histo
 		/*!
 		 *  returns a name
@@ -198,11 +194,12 @@ namespace alibava {
 		std::string getCommonCorrectionName();
 		
 		
-		//! vector to store intermediate/final common mode value
-		EVENT::FloatVec _commonmode;
+		//! The common mode calculation shared with the other alibava processors
+		AlibavaCommonModeCalculator _commonModeCalculator;
 		
-		//! vector to store intermediate/final common mode error value
-		EVENT::FloatVec _commonmodeerror;
+		//! Common mode and its error of each chip of the current event
+		std::vector<EVENT::FloatVec> _chipCommonMode;
+		std::vector<EVENT::FloatVec> _chipCommonModeError;
 		
 		
 	};
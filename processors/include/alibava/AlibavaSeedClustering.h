@@ -27,6 +27,8 @@
 // system includes <>
 #include <string>
 #include <list>
+#include <vector>
+#include <cstdint>
 
 
 namespace alibava {
@@ -162,6 +164,18 @@ namespace alibava {
 		// to calculate Eta
 		float calculateEta(TrackerDataImpl * trkdata, int seedChan);
 		
+		//! Eta from the signals and the mask of the chip
+		float calculateEta(const EVENT::FloatVec & dataVec, const std::vector<unsigned char> & mask, int seedChan);
+		
+		//! Finds the seed channels of a chip
+		/*! The SNR of all the channels and the neighbour and seed cuts
+		 *  are first evaluated without branches into _snr and
+		 *  _channelCanBeUsed. The seed flags are packed into a bit mask, 64 channels per word, and
+		 *  only the set bits are turned into seed channels, which are
+		 *  left in _seedCandidates sorted by decreasing SNR.
+		 */
+		void findSeeds(const EVENT::FloatVec & dataVec, const EVENT::FloatVec & noiseVec, const std::vector<unsigned char> & mask);
+		
 	//	void convertAlibavaCluster(AlibavaCluster alibavaCluster, LCCollectionVec * clusterColVec, LCCollectionVec * sparseClusterColVec);
 		
 		/////////////////////
@@ -177,6 +191,25 @@ namespace alibava {
 		//
 		bool _isSensitiveAxisX;
 		
+		////////////////////////////////////////
+		// Work buffers, reused for each chip //
+		////////////////////////////////////////
+		
+		// signal/noise ratio of each channel, signal polarity applied
+		std::vector<float> _snr;
+		
+		// 1 if the channel can still be added to a cluster
+		std::vector<unsigned char> _channelCanBeUsed;
+		
+		// 1 if the channel passes the seed cut
+		std::vector<unsigned char> _isSeed;
+		
+		// seed flags packed in 64 bit words
+		std::vector<std::uint64_t> _seedMask;
+		
+		// seed channels, highest SNR first
+		std::vector<int> _seedCandidates;
+		
 	
 	};
 	
@@ -18,9 +18,9 @@
 #include <Eigen/Cholesky>
 
 #ifdef DOTHREAD
-#include <boost/thread.hpp>
-#include <boost/thread/detail/thread_group.hpp>
-#include <boost/bind.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #endif
 
 #include "EUTelDafTrackerSystem.h"
@@ -46,8 +46,12 @@ private:
   void multiVectToEst(gsl_vector* v1, std::vector<int>& indexVector, vector<FITTERTYPE>& dataVector, size_t& param);
   //newtons method
   FITTERTYPE stepVector(gsl_vector* vc, size_t index, FITTERTYPE value, bool doMSE, Minimizer* minimize);
-  //data
-  std::vector< std::vector<Measurement<FITTERTYPE> > > tracks;
+  //data, stored flat: the measurements of track t are [trackBegin[t], trackBegin[t+1])
+  std::vector<size_t> trackBegin;
+  std::vector<FITTERTYPE> measX, measY, measZ;
+  std::vector<int> measIden;
+  //index of the plane of each measurement in system.planes, -1 if not found, see indexTracks()
+  std::vector<int> measPlane;
 public:
   int fitCount;
   //parameters
@@ -84,7 +88,9 @@ public:
 
   //initialization
   void setPlane(int index, double sigmaX, double sigmaY, double radLength);
-  void addTrack( std::vector<Measurement<FITTERTYPE> > track);
+  void addTrack( const std::vector<Measurement<FITTERTYPE> >& track);
+  size_t nTracks() const { return( trackBegin.empty() ? 0 : trackBegin.size() - 1 ); }
+  void indexTracks();
   void movePlaneZ(int planeIndex, double deltaZ);
   
   void estToSystem( const gsl_vector* params, TrackerSystem<FITTERTYPE, 4>& system);
@@ -95,7 +101,9 @@ public:
   void readTrack(int track, TrackerSystem<FITTERTYPE,4>& system);
   void readTracksToArray(float** measX, float** measY, int nTracks, int nPlanes);
   void readTracksToDoubleArray(float** measX, int nTracks, int nPlanes);
-  void clear(){ tracks.clear(); }
+  void clear(){
+    trackBegin.clear(); measX.clear(); measY.clear(); measZ.clear(); measIden.clear(); measPlane.clear();
+  }
   void getExplicitEstimate(TrackEstimate<FITTERTYPE, 4>& estim);
   void printParams( std::string name, std::vector<FITTERTYPE>& params, bool plot, const char* valString);
   void printAllFreeParams();
@@ -109,19 +117,30 @@ public:
   size_t nThreads;
   FITTERTYPE result;
 #ifdef DOTHREAD
-  boost::mutex resultGurad;
+  std::mutex resultGurad;
 #endif
   vector<TrackerSystem<FITTERTYPE, 4> > systems;
   
   //Minimizer(EstMat& mat) : mat(mat) {;}
-  Minimizer(EstMat& mat) : inited(false), mat(mat), nThreads(4) {;}
-  virtual ~Minimizer(){;};
+  Minimizer(EstMat& mat);
+  virtual ~Minimizer();
 
   FITTERTYPE operator() (void);
   virtual void operator() (size_t offset, size_t stride) = 0;
   void prepareThreads();
   virtual void init ();
   virtual bool twoRetVals(){ return(false); }
+#ifdef DOTHREAD
+private:
+  //Persistent worker pool. Worker n runs operator()(n, nThreads) for every
+  //evaluation, the calling thread acts as worker 0.
+  std::vector<std::thread> workers;
+  std::mutex poolGuard;
+  std::condition_variable poolWake, poolDone;
+  size_t jobGeneration, jobsPending;
+  bool stopWorkers;
+  void workerLoop(size_t offset);
+#endif
 };
 
 class Chi2: public Minimizer {
@@ -136,6 +136,9 @@ EUTelApplyAlignmentProcessor::EUTelApplyAlignmentProcessor ()
   _iRun(0),
   _iEvt(0),
   _lookUpTable(),
+  _alignmentRotations(),
+  _gearApplyTransforms(),
+  _gearRevertTransforms(),
   _fevent(false),
   _aidaHistoMap(),
   _siPlanesParameters(NULL),
@@ -274,6 +277,9 @@ void EUTelApplyAlignmentProcessor::init() {
     _orderedSensorIDVec.push_back( _siPlanesLayerLayout->getID( iPlane ) );
   }
   _lookUpTable.clear();
+  _alignmentRotations.clear();
+  _gearApplyTransforms.clear();
+  _gearRevertTransforms.clear();
 }
 
 //..................................................................................
@@ -647,38 +653,8 @@ void EUTelApplyAlignmentProcessor::ApplyGear6D( LCEvent *event)
       // now we have to understand which layer this hit belongs to.
       int sensorID = hitDecoder(inputHit)["sensorID"];
 
-      if ( _conversionIdMap.size() != static_cast< unsigned >( _siPlanesParameters->getSiPlanesNumber()) ) 
-      {
-          // first of all try to see if this sensorID already belong to
-          if ( _conversionIdMap.find( sensorID ) == _conversionIdMap.end() ) 
-          {
-              // this means that this detector ID was not already inserted,
-              // so this is the right place to do that
-          
-              for ( int iLayer = 0; iLayer < _siPlanesLayerLayout->getNLayers(); iLayer++ ) 
-              {
-                  if ( _siPlanesLayerLayout->getID(iLayer) == sensorID ) 
-                  {
-                      _conversionIdMap.insert( make_pair( sensorID, iLayer ) );
-                      break;
-                  }
-              }
-          }
-      }
-
-      int layerIndex   = _conversionIdMap[sensorID];
-
-      // determine z position of the plane
-	  // 20 December 2010 @libov
-      float	z_sensor = 0;
-	  for ( int iPlane = 0 ; iPlane < _siPlanesLayerLayout->getNLayers(); ++iPlane ) 
-      {
-          if (sensorID == _siPlanesLayerLayout->getID( iPlane ) ) 
-          {
-              z_sensor = _siPlanesLayerLayout -> getSensitivePositionZ( iPlane ) + 0.5 * _siPlanesLayerLayout->getSensitiveThickness( iPlane );
-              break;
-          }
-      }
+      // rotation around the center of the sensor plane, computed once per sensor
+      const SensorTransform & transform = gearTransform( sensorID, false );
 
       // copy the input to the output, at least for the common part
       TrackerHitImpl   * outputHit  = new TrackerHitImpl;
@@ -688,95 +664,15 @@ void EUTelApplyAlignmentProcessor::ApplyGear6D( LCEvent *event)
       outputHit->setCellID1( inputHit->getCellID1() );
       outputHit->setTime( inputHit->getTime() );
 
-      double * inputPosition      = const_cast< double * > ( inputHit->getPosition() ) ;
+      const double * inputPosition = inputHit->getPosition();
       double   outputPosition[3]  = { 0., 0., 0. };
 
-      if ( 1==1 ) 
-      {
-
-          double telPos[3]    = {0., 0., 0.};
-          double gRotation[3] = { 0., 0., 0.}; // not rotated
-
-          if ( _debugSwitch )
-         {
-              telPos[0] = 0.;
-              telPos[1] = 0.;
-              telPos[2] = 0.; 
-              gRotation[0] = _alpha;
-              gRotation[1] = _beta ;
-              gRotation[2] = _gamma;
-          }
-          else
-          {
-              gRotation[0]    = _siPlanesLayerLayout->getLayerRotationXY(layerIndex); // Euler alpha ;
-              gRotation[1]    = _siPlanesLayerLayout->getLayerRotationZX(layerIndex); // Euler alpha ;
-              gRotation[2]    = _siPlanesLayerLayout->getLayerRotationZY(layerIndex); // Euler alpha ;
-
-              // input angles are in DEGREEs !!!
-              // translate into radians
-    
-              gRotation[0]  =   gRotation[0] *3.1415926/180.; // 
-              gRotation[1]  =   gRotation[1] *3.1415926/180.; //
-              gRotation[2]  =   gRotation[2] *3.1415926/180.; //
-
-              telPos[0]  =  _siPlanesLayerLayout->getSensitivePositionX(layerIndex); // mm
-              telPos[1]  =  _siPlanesLayerLayout->getSensitivePositionY(layerIndex); // mm
-              telPos[2]  =  _siPlanesLayerLayout->getSensitivePositionZ(layerIndex); // mm
-              
-          }
- 
-      
-          if( _iEvt < _printEvents )
-          {
-                if ( _debugSwitch ) 
-                {
-                    streamlog_out ( MESSAGE5 )  << "Debugmode ON " << endl;                                   
-                }
-                
-                streamlog_out ( DEBUG2 )  << "_applyGear6D " << endl;
-                streamlog_out ( DEBUG2 )  << " telPos[0] = " << telPos[0]  << endl;
-                streamlog_out ( DEBUG2 )  << " telPos[1] = " << telPos[1]  << endl;
-                streamlog_out ( DEBUG2 )  << " telPos[2] = " << telPos[2]  << endl;
-                streamlog_out ( DEBUG2 )  << " gRotation[0] = " << gRotation[0]  << endl;
-                streamlog_out ( DEBUG2 )  << " gRotation[1] = " << gRotation[1]  << endl;
-                streamlog_out ( DEBUG2 )  << " gRotation[2] = " << gRotation[2]  << endl;
-          }
-
-          // rotations first
- 
-          outputPosition[0] = inputPosition[0];
-          outputPosition[1] = inputPosition[1];
-          outputPosition[2] = inputPosition[2] - z_sensor;
-          
-          _EulerRotation(outputPosition, gRotation);
-
-          // then the shifts
-//          outputPosition[0]  = telPos[0];
-//          outputPosition[1]  = telPos[1];
-//          outputPosition[2]  = telPos[2];
-
-          outputPosition[2] += z_sensor;
-      }
-      else
-      {
-          // this hit belongs to a plane whose sensorID is not in the
-          // alignment constants. So the idea is to eventually advice
-          // the users if running in DEBUG and copy the not aligned hit
-          // in the new collection.
-//          streamlog_out ( DEBUG3 ) << "Sensor ID " << sensorID << " not found. Skipping alignment for hit "
-//                                    << iHit << endl;
-
-          for ( size_t i = 0; i < 3; ++i )
-          {
-              outputPosition[i] = inputPosition[i];
-          }
-          
-      }
+      transformPosition( transform, inputPosition, outputPosition );
 
       if ( _iEvt < _printEvents )
       {
-         streamlog_out ( DEBUG2 ) << "ApplyGear: INPUT: Sensor ID " << sensorID << " " << inputPosition[0] << " " << inputPosition[1] << " " << inputPosition[2] << " " << z_sensor << endl;                
-         streamlog_out ( DEBUG2 ) << "ApplyGear: OUTPUT:Sensor ID " << sensorID << " " << outputPosition[0] << " " << outputPosition[1] << " " << outputPosition[2] << " " << z_sensor << endl;                
+         streamlog_out ( DEBUG2 ) << "ApplyGear: INPUT: Sensor ID " << sensorID << " " << inputPosition[0] << " " << inputPosition[1] << " " << inputPosition[2] << endl;                
+         streamlog_out ( DEBUG2 ) << "ApplyGear: OUTPUT:Sensor ID " << sensorID << " " << outputPosition[0] << " " << outputPosition[1] << " " << outputPosition[2] << endl;                
       }
 
        outputHit->setPosition( outputPosition ) ;
@@ -832,6 +728,15 @@ void EUTelApplyAlignmentProcessor::RevertGear6D( LCEvent *event)
       return;
     }
 
+    // the reference hits are looked up once per sensor
+    map< int, EUTelReferenceHit * > referenceHitMap;
+    fillReferenceHitMap( referenceHitMap );
+    if( referenceHitMap.empty() )
+    {
+      // todo: is this case (no reference vector) treated correctly?
+      streamlog_out( MESSAGE5 ) << "_referenceHitVec is empty" << endl;
+    }
+
 // go-go
     for (size_t iHit = 0; iHit < _inputCollectionVec->size(); iHit++) 
     {
@@ -841,78 +746,14 @@ void EUTelApplyAlignmentProcessor::RevertGear6D( LCEvent *event)
       // now we have to understand which layer this hit belongs to.
       int sensorID = hitDecoder(inputHit)["sensorID"];
 
-      if ( _conversionIdMap.size() != static_cast< unsigned >( _siPlanesParameters->getSiPlanesNumber()) ) 
-      {
-          // first of all try to see if this sensorID already belong to
-          if ( _conversionIdMap.find( sensorID ) == _conversionIdMap.end() ) 
-          {
-              // this means that this detector ID was not already inserted,
-              // so this is the right place to do that
-          
-              for ( int iLayer = 0; iLayer < _siPlanesLayerLayout->getNLayers(); iLayer++ ) 
-              {
-                  if ( _siPlanesLayerLayout->getID(iLayer) == sensorID ) 
-                  {
-                      _conversionIdMap.insert( make_pair( sensorID, iLayer ) );
-                      break;
-                  }
-              }
-          }
-      }
-      
-      int layerIndex   = _conversionIdMap[sensorID];
-
-      // determine z position of the plane
-      // 20 December 2010 @libov
-/*      float	z_sensor = 0;
-      for ( int iPlane = 0 ; iPlane < _siPlanesLayerLayout->getNLayers(); ++iPlane ) 
-      {
-          if (sensorID == _siPlanesLayerLayout->getID( iPlane ) ) 
-          {
-              z_sensor = _siPlanesLayerLayout -> getSensitivePositionZ( iPlane ) + 0.5 * _siPlanesLayerLayout->getSensitiveThickness( iPlane );
-              break;
-          }
-      }
-*/
-
 // retrieve the refhit cooridantes (eventual offset of the sensor) 
-      double x_refhit = 0.; 
-      double y_refhit = 0.; 
-      double z_refhit = 0.; 
-      
-      if( !_applyToReferenceHitCollection || _referenceHitVec == 0 )
-      {
-	// todo: is this case (no reference vector) treated correctly?
-	  streamlog_out( MESSAGE5 ) << "_referenceHitVec is empty" << endl;
-      }
-      else
+      double refhit[3] = { 0., 0., 0. };
+      map< int, EUTelReferenceHit * >::const_iterator refhitIter = referenceHitMap.find( sensorID );
+      if( refhitIter != referenceHitMap.end() )
       {
-//        streamlog_out( MESSAGE5 ) << "reference Hit collection name : " << _referenceHitCollectionName << endl;
- 
-       for(size_t ii = 0 ; ii <  static_cast< size_t >(_referenceHitVec->getNumberOfElements()); ii++)
-       {
-        EUTelReferenceHit * refhit = static_cast< EUTelReferenceHit*> ( _referenceHitVec->getElementAt(ii) ) ;
-        if( sensorID != refhit->getSensorID() )
-        {
-       //   streamlog_out( MESSAGE5 ) << "Looping through a varity of sensor IDs" << endl;
-          continue;
-        }
-        else
-        {
-          x_refhit =  refhit->getXOffset();
-          y_refhit =  refhit->getYOffset();
-          z_refhit =  refhit->getZOffset();
-
-          if( _iEvt < _printEvents )
-          {
-            streamlog_out(DEBUG2) << "Sensor ID and Alignment plane ID match!" << endl;
-            streamlog_out(DEBUG2) << "x_refhit " << x_refhit  << endl; 
-            streamlog_out(DEBUG2) << "y_refhit " << y_refhit  << endl; 
-            streamlog_out(DEBUG2) << "z_refhit " << z_refhit  << endl; 
-          }
-          break;
-        }
-       }
+        refhit[0] = refhitIter->second->getXOffset();
+        refhit[1] = refhitIter->second->getYOffset();
+        refhit[2] = refhitIter->second->getZOffset();
       }
 
       // copy the input to the output, at least for the common part
@@ -923,115 +764,13 @@ void EUTelApplyAlignmentProcessor::RevertGear6D( LCEvent *event)
       outputHit->setCellID1( inputHit->getCellID1() );
       outputHit->setTime( inputHit->getTime() );
 
-      const double * inputPosition      = const_cast< const double * > ( inputHit->getPosition() ) ;
+      const double * inputPosition      = inputHit->getPosition();
       double   outputPosition[3]  = { 0., 0., 0. };
 
-   
-      if ( 1==1  ) 
-      {
-
-          double telPos[3]    = {0., 0., 0.};
-          double gRotation[3] = { 0., 0., 0.}; // not rotated
-
-
-          if ( _debugSwitch )
-          {
-              telPos[0] = 0.;
-              telPos[1] = 0.;
-              telPos[2] = 0.; 
-              gRotation[0] = _alpha;
-              gRotation[1] = _beta ;
-              gRotation[2] = _gamma;
-          }
-          else
-          {
-              gRotation[0]    = _siPlanesLayerLayout->getLayerRotationXY(layerIndex); // Euler alpha ;
-              gRotation[1]    = _siPlanesLayerLayout->getLayerRotationZX(layerIndex); // Euler alpha ;
-              gRotation[2]    = _siPlanesLayerLayout->getLayerRotationZY(layerIndex); // Euler alpha ;
-
-              // input angles are in DEGREEs !!!
-              // translate into radians
-    
-              gRotation[0]  =   gRotation[0] *3.1415926/180.; // 
-              gRotation[1]  =   gRotation[1] *3.1415926/180.; //
-              gRotation[2]  =   gRotation[2] *3.1415926/180.; //
-
-              telPos[0]  =  _siPlanesLayerLayout->getSensitivePositionX(layerIndex); // mm
-              telPos[1]  =  _siPlanesLayerLayout->getSensitivePositionY(layerIndex); // mm
-              telPos[2]  =  _siPlanesLayerLayout->getSensitivePositionZ(layerIndex)+0.5*_siPlanesLayerLayout->getSensitiveThickness(layerIndex) ; // mm
-              
-          }
-      
-          if( _iEvt < _printEvents )
-          {
-                if ( _debugSwitch ) 
-                {
-                    streamlog_out ( MESSAGE5 )  << "Debugmode ON " << endl;                                   
-                }
-                
-                streamlog_out ( DEBUG2 )  << "_revertGear6D " << endl;
-                streamlog_out ( DEBUG2 )  << " telPos[0] = " << telPos[0]  << endl;
-                streamlog_out ( DEBUG2 )  << " telPos[1] = " << telPos[1]  << endl;
-                streamlog_out ( DEBUG2 )  << " telPos[2] = " << telPos[2]  << endl;
-                streamlog_out ( DEBUG2 )  << " gRotation[0] = " << gRotation[0]  << endl;
-                streamlog_out ( DEBUG2 )  << " gRotation[1] = " << gRotation[1]  << endl;
-                streamlog_out ( DEBUG2 )  << " gRotation[2] = " << gRotation[2]  << endl;
-          }
-// new implmentation // Rubinskiy 11.11.11
-
 // undo the shifts = go back to the center of the sensor frame (rotations unchanged)
-      outputPosition[0] = inputPosition[0] - x_refhit;
-      outputPosition[1] = inputPosition[1] - y_refhit;
-      outputPosition[2] = inputPosition[2] - z_refhit;
-
-      if ( _iEvt < _printEvents )
-      {
-         streamlog_out ( DEBUG2 ) << "RevertGear: intermediate: "<<outputPosition[0] << " " <<outputPosition[1] << " " <<outputPosition[2] <<  endl;
-      } 
-      TVector3 iCenterOfSensorFrame( outputPosition[0], outputPosition[1], outputPosition[2] );
-
-      iCenterOfSensorFrame.RotateZ( -gRotation[0] );
-      iCenterOfSensorFrame.RotateY( -gRotation[1] );
-      iCenterOfSensorFrame.RotateX( -gRotation[2] ); // first rotaiton in ZY plane -> around X axis (gamma)
+      const double centered[3] = { inputPosition[0] - refhit[0], inputPosition[1] - refhit[1], inputPosition[2] - refhit[2] };
 
-      outputPosition[0] = iCenterOfSensorFrame(0);
-      outputPosition[1] = iCenterOfSensorFrame(1);
-      outputPosition[2] = iCenterOfSensorFrame(2);
-
-         
-          
-/* old implementation
-          // rotations first
- 
-          outputPosition[0] = inputPosition[0];
-          outputPosition[1] = inputPosition[1];
-          outputPosition[2] = inputPosition[2] - z_sensor;
-          
-          _EulerRotationInverse( sensorID,outputPosition, gRotation);
-
-          // then the shifts
-//          outputPosition[0] -= telPos[0];
-//          outputPosition[1] -= telPos[1];
-//          outputPosition[2] -= telPos[2];
-
-          outputPosition[2] += z_sensor;
-*/
-      }
-      else
-      {
-          // this hit belongs to a plane whose sensorID is not in the
-          // alignment constants. So the idea is to eventually advice
-          // the users if running in DEBUG and copy the not aligned hit
-          // in the new collection.
-          streamlog_out ( DEBUG5 ) << "Sensor ID " << sensorID << " not found. Skipping alignment for hit "
-                                    << iHit << endl;
-
-          for ( size_t i = 0; i < 3; ++i )
-          {
-              outputPosition[i] = inputPosition[i];
-          }
-          
-      }
+      transformPosition( gearTransform( sensorID, true ), centered, outputPosition );
 
       if ( _iEvt < _printEvents )
       {
@@ -1126,96 +865,31 @@ void EUTelApplyAlignmentProcessor::Direct(LCEvent *event) {
 
     streamlog_out ( DEBUG5 ) << "DIRECT:-----:-----: EUTelApplyAlignmentProcessor::Direct. going to proceeed with " <<  _inputCollectionVec->size() << " hits " << endl;
 
+    // the rotations are recomputed only when the constants change and
+    // the transformation of each sensor is built once per event
+    updateAlignmentRotations();
+
+    map< int, EUTelReferenceHit * > referenceHitMap;
+    fillReferenceHitMap( referenceHitMap );
+
+    map< int, SensorTransform > hitTransforms;
+
 // go-go
     for (size_t iHit = 0; iHit < _inputCollectionVec->size(); iHit++) {
 
-      streamlog_out ( DEBUG5 ) << "DIRECT:-----:-----: hit " << iHit << " of  " <<  _inputCollectionVec->size() << " hits " << endl;
-
       TrackerHitImpl* inputHit = dynamic_cast<TrackerHitImpl*>( _inputCollectionVec->getElementAt(iHit) );
 
       // now we have to understand which layer this hit belongs to.
       int sensorID = hitDecoder(inputHit)["sensorID"];
 
-      //find proper alignment colleciton:
-            double alpha = 0.;
-            double beta  = 0.;
-            double gamma = 0.;
-            double offsetX = 0.;
-            double offsetY = 0.;
-            double offsetZ = 0.;
- 
-      // now that we know at which sensor the hit belongs to, we can
-      // get the corresponding alignment constants
-      map< int , int >::iterator  positionIter = _lookUpTable[ _alignmentCollectionName ].find( sensorID );
-
-     streamlog_out( DEBUG5 ) << "DIRECT:-----:-----: iHit [" <<  iHit << "] for sensor  "<<  sensorID << endl;
-     if ( positionIter == _lookUpTable[ _alignmentCollectionName ].end() )
-         {
-          streamlog_out( DEBUG5 ) << "DIRECT:-----:-----: wrong sensorID : " <<  sensorID << " ?? " << endl;
-//          continue; //do nothing as if alignment == 0.
-         }
-      else
-         {
-           EUTelAlignmentConstant * alignment = static_cast< EUTelAlignmentConstant * >  ( _alignmentCollectionVec->getElementAt( positionIter->second ) );
-           streamlog_out( DEBUG5 ) << "DIRECT:-----:-----: iHit [" <<  iHit << "] at "<<  positionIter->second << " found at (EUTelAlignmentConstant*) " << alignment ;
-           streamlog_out( DEBUG5 ) << " with alignment collection name : " << _alignmentCollectionName << endl;
-           alpha   = alignment->getAlpha();
-           beta    = alignment->getBeta();
-           gamma   = alignment->getGamma();
-           offsetX = alignment->getXOffset();
-           offsetY = alignment->getYOffset();
-           offsetZ = alignment->getZOffset();
-         }  
-
-
-      // refhit = center-of-the-sensor coordinates:
-      double x_refhit = 0.; 
-      double y_refhit = 0.; 
-      double z_refhit = 0.; 
-      
-      if( !_applyToReferenceHitCollection || _referenceHitVec == 0 )
+      map< int, SensorTransform >::iterator transformIter = hitTransforms.find( sensorID );
+      if ( transformIter == hitTransforms.end() )
       {
-	// todo: is this case (no reference vector) treated correctly?
-        streamlog_out( DEBUG5 ) << "DIRECT:-----:-----: _referenceHitVec is empty" << endl;
+          transformIter = hitTransforms.insert( make_pair( sensorID, alignmentHitTransform( sensorID, false, referenceHitMap ) ) ).first;
+          streamlog_out( DEBUG5 ) << "DIRECT:-----:-----: transformation built for sensorID " << sensorID
+                                  << " with alignment collection name : " << _alignmentCollectionName << endl;
       }
-      else
-      {
-        streamlog_out( DEBUG5 ) << "DIRECT:-----:-----: reference Hit collection name : " << _referenceHitCollectionName << endl;
- 
-       for(size_t ii = 0 ; ii <  static_cast< size_t >(_referenceHitVec->getNumberOfElements()); ii++)
-       {
-        EUTelReferenceHit * refhit = static_cast< EUTelReferenceHit*> ( _referenceHitVec->getElementAt(ii) ) ;
-        if( sensorID != refhit->getSensorID() )
-        {
-//          streamlog_out( DEBUG5 ) << "DIRECT:-----:-----: Looping through a varity of sensor IDs" << endl;
-          continue;
-        }
-        else
-        {
-          streamlog_out( DEBUG5 ) << "DIRECT:-----:-----: Sensor ID and Alignment plane ID match!" << endl;
-          x_refhit =  refhit->getXOffset();
-          y_refhit =  refhit->getYOffset();
-          z_refhit =  refhit->getZOffset();
-
-          // possible source of inconsistency; Apply to reference hit collection flag should be enabled in steering file
-          // otherwise the following three lines (undo alignment shifts) makes no sense !!!
-          x_refhit += offsetX;
-          y_refhit += offsetY;
-          z_refhit += offsetZ;
-
-          break;
-        } 
-           streamlog_out( DEBUG5 ) << "DIRECT:-----:-----: sensorID "<<
-             refhit->getSensorID(   )  << " X: "   <<                
-             refhit->getXOffset(    )  << " Y: "   <<
-             refhit->getYOffset(    )  << " Z: "   <<
-             refhit->getZOffset(    )  << " X_REFHIT: "   <<
-             x_refhit << " Y_REFHIT: "   <<
-             y_refhit << " Z_REFHIT: "   <<
-             z_refhit << "  "   << endl;        
-       }
-      }
-      streamlog_out( DEBUG5 ) << "DIRECT:-----:-----: refhit found for sensorID " << sensorID << endl;
+      const SensorTransform & transform = transformIter->second;
 
       // copy the input to the output, at least for the common part
       TrackerHitImpl   * outputHit  = new TrackerHitImpl;
@@ -1226,36 +900,19 @@ void EUTelApplyAlignmentProcessor::Direct(LCEvent *event) {
       outputHit->setCellID1( inputHit->getCellID1() );
       outputHit->setTime( inputHit->getTime() );
 
-      // hit coordinates in the center-of-the sensor frame (axis coincide with the global frame)
-      const double *inputS = static_cast<const double*> ( inputHit->getPosition() ) ;
-
-      double inputPosition[3]      = { inputS[0], inputS[1], inputS[2] };
-      double inputPosition_orig[3] = { inputS[0], inputS[1], inputS[2] };
-
-      // calculate hit position on a sensor relative to its center (assuming that refhit is still without alignment corrections)
-      inputPosition[0] = inputPosition[0] - x_refhit;
-      inputPosition[1] = inputPosition[1] - y_refhit;
-      inputPosition[2] = inputPosition[2] - z_refhit;
-
-      // initial setting of the sensor = center-of-the sensor coordinates in the global frame
+      const double * inputPosition_orig = inputHit->getPosition();
       double   outputPosition[3]  = { 0., 0., 0. };
-      outputPosition[0] = x_refhit;
-      outputPosition[1] = y_refhit;
-      outputPosition[2] = z_refhit;
-/*
-        printf("PRE sensorID: %5d   [%5.2f %5.2f %5.2f]\n",
-                sensorID, x_refhit, y_refhit, z_refhit
-        );
-*/
-
 
-//      if ( positionIter != _lookUpTable[ _alignmentCollectionName ].end() ) {
+      transformPosition( transform, inputPosition_orig, outputPosition );
 
+      // hit position on a sensor relative to its center, for the control histograms
+      const double inputPosition[3] = { inputPosition_orig[0] - transform.center[0],
+                                        inputPosition_orig[1] - transform.center[1],
+                                        inputPosition_orig[2] - transform.center[2] };
 
 #if ( defined(USE_AIDA) || defined(MARLIN_USE_AIDA) )
-        string tempHistoName;
-//        AIDA::IHistogram3D *histo3D; 
         if ( _histogramSwitch ) {
+          string tempHistoName;
           {
             stringstream ss;
             ss  << _hitHistoBeforeAlignName << "_" << sensorID ;
@@ -1270,78 +927,9 @@ void EUTelApplyAlignmentProcessor::Direct(LCEvent *event) {
                                         << ".\nDisabling histogramming from now on " << endl;
               _histogramSwitch = false;
             }
-//          histo3D = dynamic_cast<AIDA::IHistogram3D*> (_aidaHistoMap[ _densityPlotBeforeAlignName ] );
-//          if ( histo3D ) histo3D->fill( inputPosition[0], inputPosition[1], inputPosition[2] );
-//          else {
-//            streamlog_out ( ERROR1 )  << "DIRECT:-----:-----: Not able to retrieve histogram pointer for " << _densityPlotBeforeAlignName
-//                                      << ".\nDisabling histogramming from now on " << endl;
-//            _histogramSwitch = false;
-//          }
-        }
-#endif
-
-        
-        if ( _correctionMethod == 0 ) 
-        {
-
-            // this is the shift only case
-            outputPosition[0] += inputPosition[0] - offsetX;                
-            outputPosition[1] += inputPosition[1] - offsetY; 
-            outputPosition[2] += inputPosition[2] - offsetZ;
-
-        } 
-        else if ( _correctionMethod == 1 ) 
-        {
-            if ( _debugSwitch )
-            {
-                alpha = _alpha;
-                beta  = _beta;
-                gamma = _gamma; 
-                offsetX = 0.;
-                offsetY = 0.;
-                offsetZ = 0.;
-            }
-            else
-            {
-            }
-
-            if( _iEvt < _printEvents )
-            {
-                if ( _debugSwitch ) 
-                {
-                    streamlog_out ( DEBUG5 )  << "DIRECT:-----:-----: Debugmode ON " << endl;                                   
-                }
-                streamlog_out ( DEBUG5 )  << "DIRECT:-----:-----: _correctionMethod == rotation first " << endl;
-                streamlog_out ( DEBUG5 )  << "DIRECT:-----:-----:  alignment->getAlpha() = " << alpha  << endl;
-                streamlog_out ( DEBUG5 )  << "DIRECT:-----:-----:  alignment->getBeta()  = " <<  beta  << endl;
-                streamlog_out ( DEBUG5 )  << "DIRECT:-----:-----:  alignment->getGamma() = " << gamma << endl;
-                streamlog_out ( DEBUG5 )  << "DIRECT:-----:-----:  alignment->getXOffest() = " << offsetX  << endl;
-                streamlog_out ( DEBUG5 )  << "DIRECT:-----:-----:  alignment->getYOffest() = " << offsetY  << endl;
-                streamlog_out ( DEBUG5 )  << "DIRECT:-----:-----:  alignment->getZOffest() = " << offsetZ  << endl;
-            }
-            // this is the rotation first
-            TVector3 iCenterOfSensorFrame(  inputPosition[0],  inputPosition[1],  inputPosition[2] );
-
-            iCenterOfSensorFrame.RotateX( -alpha );
-            iCenterOfSensorFrame.RotateY( -beta  );
-            iCenterOfSensorFrame.RotateZ( -gamma );
-
-            outputPosition[0] += iCenterOfSensorFrame(0);
-            outputPosition[1] += iCenterOfSensorFrame(1);
-            outputPosition[2] += iCenterOfSensorFrame(2);
-
-            // second the shift
-            outputPosition[0] -= offsetX; 
-            outputPosition[1] -= offsetY; 
-            outputPosition[2] -= offsetZ; 
-          
-        }
-        else if ( _correctionMethod == 2 ) 
-        {
         }
-
-#if ( defined(USE_AIDA) || defined(MARLIN_USE_AIDA) ) 
         if ( _histogramSwitch ) {
+          string tempHistoName;
           {
             stringstream ss;
             ss  << _hitHistoAfterAlignName << "_" << sensorID ;
@@ -1355,36 +943,9 @@ void EUTelApplyAlignmentProcessor::Direct(LCEvent *event) {
                                       << ".\nDisabling histogramming from now on " << endl;
             _histogramSwitch = false;
           }
-//          histo3D = dynamic_cast<AIDA::IHistogram3D*> (_aidaHistoMap[ _densityPlotAfterAlignName ] );
-//          if ( histo3D ) histo3D->fill( outputPosition[0], outputPosition[1], outputPosition[2] );
-//          else {
-//            streamlog_out ( ERROR1 )  << "DIRECT:-----:-----: Not able to retrieve histogram pointer for " << _densityPlotAfterAlignName
-//                                      << ".\nDisabling histogramming from now on " << endl;
-//            _histogramSwitch = false;
-//          }
         }
 #endif
 
-/*
-      } 
-      else 
-      {
-
-        // this hit belongs to a plane whose sensorID is not in the
-        // alignment constants. So the idea is to eventually advice
-        // the users if running in DEBUG and copy the not aligned hit
-        // in the new collection.
-//        streamlog_out ( DEBUG5 ) << "Sensor ID " << sensorID << " not found. Skipping alignment for hit "
-//                                << iHit << endl;
-
-        for ( size_t i = 0; i < 3; ++i )
-        {
-            outputPosition[i] = inputPosition[i];
-        }
-
-      }
-*/
-
       if ( _iEvt < _printEvents )
       {
          streamlog_out ( DEBUG1 ) << "DIRECT:-----:-----:" << _alignmentCollectionName.c_str() << " : ORIGI: Sensor ID " << sensorID << " " << inputPosition_orig[0] << " " << inputPosition_orig[1] << " " << inputPosition_orig[2] <<  endl;   
@@ -1474,87 +1035,32 @@ void EUTelApplyAlignmentProcessor::Reverse(LCEvent *event) {
       return;
     }
 
+    // the rotations are recomputed only when the constants change and
+    // the transformation of each sensor is built once per event
+    updateAlignmentRotations();
+
+    map< int, EUTelReferenceHit * > referenceHitMap;
+    fillReferenceHitMap( referenceHitMap );
+
+    map< int, SensorTransform > hitTransforms;
+
 // go-go
-        for (size_t iHit = 0; iHit < _inputCollectionVec->size(); iHit++) 
-        {
+    for (size_t iHit = 0; iHit < _inputCollectionVec->size(); iHit++) {
 
-	TrackerHitImpl* inputHit  = dynamic_cast<TrackerHitImpl*>( _inputCollectionVec->getElementAt(iHit) );
+      TrackerHitImpl* inputHit = dynamic_cast<TrackerHitImpl*>( _inputCollectionVec->getElementAt(iHit) );
 
-	// now we have to understand which layer this hit belongs to.
-	int sensorID = hitDecoder(inputHit)["sensorID"];
+      // now we have to understand which layer this hit belongs to.
+      int sensorID = hitDecoder(inputHit)["sensorID"];
 
-      //find proper alignment colleciton:
-      double alpha = 0.;
-      double beta  = 0.;
-      double gamma = 0.;
-      double offsetX = 0.;
-      double offsetY = 0.;
-      double offsetZ = 0.;
- 
-      // now that we know at which sensor the hit belongs to, we can
-      // get the corresponding alignment constants
-      map< int , int >::iterator  positionIter = _lookUpTable[ _alignmentCollectionName ].find( sensorID );
-
-      if ( positionIter == _lookUpTable[ _alignmentCollectionName ].end() )
-         {
-           streamlog_out( DEBUG5 ) <<  "REVERSE: wrong sensorId " << sensorID  << endl;
-	   // continue; do nothing as if alignment == 0.
-         }
-      else
-         {
-           streamlog_out( DEBUG5 ) << "REVERSE: FOUND alignment collection "<< _alignmentCollectionName.c_str() <<" record for sensorId " << sensorID  << endl;
-           EUTelAlignmentConstant * alignment = static_cast< EUTelAlignmentConstant * >  ( _alignmentCollectionVec->getElementAt( positionIter->second ) );
-
-           alpha   = alignment->getAlpha();
-           beta    = alignment->getBeta();
-           gamma   = alignment->getGamma();
-           offsetX = alignment->getXOffset();
-           offsetY = alignment->getYOffset();
-           offsetZ = alignment->getZOffset();
-         }  
-
-      // refhit = center-of-the-sensor coordinates:
-      double x_refhit = 0.; 
-      double y_refhit = 0.; 
-      double z_refhit = 0.; 
-
-      if( !_applyToReferenceHitCollection || _referenceHitVec == 0 )
+      map< int, SensorTransform >::iterator transformIter = hitTransforms.find( sensorID );
+      if ( transformIter == hitTransforms.end() )
       {
-	// todo: is this case (no reference vector) treated correctly?
-        // streamlog_out( MESSAGE5 ) << "_referenceHitVec is empty" << endl;
+          transformIter = hitTransforms.insert( make_pair( sensorID, alignmentHitTransform( sensorID, true, referenceHitMap ) ) ).first;
+          streamlog_out( DEBUG5 ) << "REVERSE: transformation built for sensorID " << sensorID
+                                  << " with alignment collection name : " << _alignmentCollectionName << endl;
       }
-      else
-      {
-        if(_fevent) streamlog_out( MESSAGE5 ) << "REVERSE: reference Hit collection name : " << _referenceHitCollectionName << " at " << _referenceHitVec  << endl;
+      const SensorTransform & transform = transformIter->second;
 
-        for(size_t ii = 0 ; ii <  static_cast< size_t >(_referenceHitVec->getNumberOfElements()); ii++)
-        {
-          EUTelReferenceHit * refhit = static_cast< EUTelReferenceHit*> ( _referenceHitVec->getElementAt(ii) ) ;
-          if( sensorID != refhit->getSensorID() )
-          {
-            // Looping through a varity of sensor IDs
-            continue;
-          }
-          else
-          {
-	    // Sensor ID and Alignment plane ID match!
-            x_refhit =  refhit->getXOffset();
-            y_refhit =  refhit->getYOffset();
-            z_refhit =  refhit->getZOffset();
-
-// do not apply this part: refhits should be just as they where befre the alignment has been applied
-// = it means the anti-apply alignment should have been applied already in the AlignReferenceHit
-//---//
-//          x_refhit -= offsetX;
-//          y_refhit -= offsetY;
-//          z_refhit -= offsetZ;
-//---//
-
-            break;
-          } 
-        }
-      }
- 
       // copy the input to the output, at least for the common part
       TrackerHitImpl   * outputHit  = new TrackerHitImpl;
       outputHit->setType( inputHit->getType() );
@@ -1563,196 +1069,62 @@ void EUTelApplyAlignmentProcessor::Reverse(LCEvent *event) {
       outputHit->setCellID1( inputHit->getCellID1() );
       outputHit->setTime( inputHit->getTime() );
 
-      // now that we know at which sensor the hit belongs to, we can
-      // get the corresponding alignment constants
-      // map< int , int >::iterator  positionIter = _lookUpTable[ _alignmentCollectionName ].find( sensorID );
-
-      // hit coordinates in the center-of-the sensor frame (axis coincide with the global frame)
-      const double *inputS = static_cast<const double*> ( inputHit->getPosition() ) ;
-
-      double inputPosition[3]      = { inputS[0], inputS[1], inputS[2] };
-      double inputPosition_orig[3] = { inputS[0], inputS[1], inputS[2] };
-
-      inputPosition[0] = inputPosition[0] - x_refhit;
-      inputPosition[1] = inputPosition[1] - y_refhit;
-      inputPosition[2] = inputPosition[2] - z_refhit;
-
-
-//            const double * inputPosition = const_cast< const double * > ( inputHit->getPosition() ) ;
-//            double   outputPosition[3]   = { 0., 0., 0. };
-  
-      // initial setting of the sensor = center-of-the sensor coordinates in the global frame
+      const double * inputPosition_orig = inputHit->getPosition();
       double   outputPosition[3]  = { 0., 0., 0. };
-      outputPosition[0] = x_refhit;
-      outputPosition[1] = y_refhit;
-      outputPosition[2] = z_refhit;
 
-//            if ( positionIter != _lookUpTable[ _alignmentCollectionName ].end() ) 
-//            {
+      transformPosition( transform, inputPosition_orig, outputPosition );
 
-#if ( defined(USE_AIDA) || defined(MARLIN_USE_AIDA) )
-                string tempHistoName;
-//                AIDA::IHistogram3D *histo3D; 
-                if ( _histogramSwitch ) 
-                {
-                    {
-                        stringstream ss;
-                        ss  << _hitHistoBeforeAlignName << "_" << sensorID ;
-                        tempHistoName = ss.str();
-                    }
-                    if ( AIDA::IHistogram2D * histo = dynamic_cast<AIDA::IHistogram2D*> ( _aidaHistoMap[ tempHistoName ] )) 
-                    {
-                        histo->fill( inputPosition[0], inputPosition[1] );
-                    }
-                    else
-                    {
-                        streamlog_out ( ERROR1 )  << "Not able to retrieve histogram pointer for " << tempHistoName
-                                                  << ".\nDisabling histogramming from now on " << endl;
-                        _histogramSwitch = false;
-                    }
-                    
-//                    histo3D = dynamic_cast<AIDA::IHistogram3D*> (_aidaHistoMap[ _densityPlotBeforeAlignName ] );
-//                    if ( histo3D ) 
-//                    {
-//                        histo3D->fill( inputPosition[0], inputPosition[1], inputPosition[2] );
-//                    }
-//                    else 
-//                    {
-//                        streamlog_out ( ERROR1 )  << "Not able to retrieve histogram pointer for " << _densityPlotBeforeAlignName
-//                                                  << ".\nDisabling histogramming from now on " << endl;
-//                       _histogramSwitch = false;
-//                    }
-                }
-#endif
+      // hit position on a sensor relative to its center, for the control histograms
+      const double inputPosition[3] = { inputPosition_orig[0] - transform.center[0],
+                                        inputPosition_orig[1] - transform.center[1],
+                                        inputPosition_orig[2] - transform.center[2] };
 
-       
-                if ( _correctionMethod == 0 ) 
-                {                   
-
-                    // this is the shift only case
-
-                    outputPosition[0] = inputPosition[0] + offsetX ;
-                    outputPosition[1] = inputPosition[1] + offsetY ;
-                    outputPosition[2] = inputPosition[2] + offsetZ ;
-
-                }
-                else
-                    if ( _correctionMethod == 1 ) 
-                    {
-                        // this is the rotation first
-                        if ( _debugSwitch )
-                        {
-                          alpha = _alpha;
-                          beta  = _beta;
-                          gamma = _gamma; 
-                          offsetX = 0.;
-                          offsetY = 0.;
-                          offsetZ = 0.;
-                        }
-                        else
-                        {
-                        }
-
-            if( _iEvt < _printEvents )
+#if ( defined(USE_AIDA) || defined(MARLIN_USE_AIDA) )
+        if ( _histogramSwitch ) {
+          string tempHistoName;
+          {
+            stringstream ss;
+            ss  << _hitHistoBeforeAlignName << "_" << sensorID ;
+            tempHistoName = ss.str();
+          }
+          if ( AIDA::IHistogram2D * histo = dynamic_cast<AIDA::IHistogram2D*> ( _aidaHistoMap[ tempHistoName ] )) {
+            histo->fill( inputPosition[0], inputPosition[1] );
+          }
+          else
             {
-                if ( _debugSwitch ) 
-                {
-                    streamlog_out ( DEBUG1 )  << "Debugmode ON " << endl;                                   
-                }
-                
-                streamlog_out ( DEBUG1 )  << "_correctionMethod == rotation first " << endl;
-                streamlog_out ( DEBUG1 )  << " alignment->getAlpha() = " << alpha  << endl;
-                streamlog_out ( DEBUG1 )  << " alignment->getBeta()  = " <<  beta  << endl;
-                streamlog_out ( DEBUG1 )  << " alignment->getGamma() = " << gamma << endl;
-                streamlog_out ( DEBUG1 )  << " alignment->getXOffest() = " << offsetX  << endl;
-                streamlog_out ( DEBUG1 )  << " alignment->getYOffest() = " << offsetY  << endl;
-                streamlog_out ( DEBUG1 )  << " alignment->getZOffest() = " << offsetZ  << endl;
+              streamlog_out ( ERROR1 )  << "Not able to retrieve histogram pointer for " << tempHistoName
+                                        << ".\nDisabling histogramming from now on " << endl;
+              _histogramSwitch = false;
             }
-        
-            // this is the rotation first
-            TVector3 iCenterOfSensorFrame(  inputPosition[0],  inputPosition[1],  inputPosition[2] );
-
-            iCenterOfSensorFrame.RotateZ( +gamma );
-            iCenterOfSensorFrame.RotateY( +beta  );
-            iCenterOfSensorFrame.RotateX( +alpha );
-
-            outputPosition[0] += iCenterOfSensorFrame(0);
-            outputPosition[1] += iCenterOfSensorFrame(1);
-            outputPosition[2] += iCenterOfSensorFrame(2);
-
-            // second the shift
-            outputPosition[0] += offsetX; 
-            outputPosition[1] += offsetY; 
-            outputPosition[2] += offsetZ; 
-
-                    }
-                    else
-                        if ( _correctionMethod == 2 ) 
-                        {
-                        }
-
-#if ( defined(USE_AIDA) || defined(MARLIN_USE_AIDA) ) 
-
-                if ( _histogramSwitch ) 
-                {
-                    {
-                        stringstream ss;
-                        ss  << _hitHistoAfterAlignName << "_" << sensorID ;
-                        tempHistoName = ss.str();
-                    }
-                    if ( AIDA::IHistogram2D * histo = dynamic_cast<AIDA::IHistogram2D*> ( _aidaHistoMap[ tempHistoName ] )) 
-                    {
-                        histo->fill( outputPosition[0], outputPosition[1] );
-                    }
-                    else 
-                    {
-                        streamlog_out ( ERROR1 )  << "Not able to retrieve histogram pointer for " << tempHistoName
-                                                  << ".\nDisabling histogramming from now on " << endl;
-                        _histogramSwitch = false;
-                    }
-                    
-//                    histo3D = dynamic_cast<AIDA::IHistogram3D*> (_aidaHistoMap[ _densityPlotAfterAlignName ] );
-//                    if ( histo3D )
-//                    {
-//                        histo3D->fill( outputPosition[0], outputPosition[1], outputPosition[2] );
-//                    }
-//                    else 
-//                    {
-//                        streamlog_out ( ERROR1 )  << "Not able to retrieve histogram pointer for " << _densityPlotAfterAlignName
-//                                                  << ".\nDisabling histogramming from now on " << endl;
-//                        _histogramSwitch = false;
-//                    }
-                }
+        }
+        if ( _histogramSwitch ) {
+          string tempHistoName;
+          {
+            stringstream ss;
+            ss  << _hitHistoAfterAlignName << "_" << sensorID ;
+            tempHistoName = ss.str();
+          }
+          if ( AIDA::IHistogram2D * histo = dynamic_cast<AIDA::IHistogram2D*> ( _aidaHistoMap[ tempHistoName ] )) {
+            histo->fill( outputPosition[0], outputPosition[1] );
+          }
+          else {
+            streamlog_out ( ERROR1 )  << "Not able to retrieve histogram pointer for " << tempHistoName
+                                      << ".\nDisabling histogramming from now on " << endl;
+            _histogramSwitch = false;
+          }
+        }
 #endif
-/*
-            }
-            else 
-            {
-
-                // this hit belongs to a plane whose sensorID is not in the
-                // alignment constants. So the idea is to eventually advice
-                // the users if running in DEBUG and copy the not aligned hit
-                // in the new collection.
 
-                streamlog_out ( DEBUG5 ) << "Sensor ID " << sensorID << " not found. Skipping alignment for hit "
-                                          << iHit << endl;
-                
-                for ( size_t i = 0; i < 3; ++i )
-                {
-                    outputPosition[i] = inputPosition[i];
-                }
-            }
-*/
       if ( _iEvt < _printEvents )
       {
-         streamlog_out ( DEBUG0 ) <<_alignmentCollectionName.c_str() << " REVERT: ORIGI: Sensor ID " << sensorID << " " << inputPosition_orig[0] << " " << inputPosition_orig[1] << " " << inputPosition_orig[2] <<  endl;   
-         streamlog_out ( DEBUG0 ) <<_alignmentCollectionName.c_str() << " REVERT: INPUT: Sensor ID " << sensorID << " " << inputPosition[0] << " " << inputPosition[1] << " " << inputPosition[2] <<  endl;   
-         streamlog_out ( DEBUG0 ) <<_alignmentCollectionName.c_str() << " REVERT: OUTPUT:Sensor ID " << sensorID << " " << outputPosition[0] << " " << outputPosition[1] << " " << outputPosition[2]  << endl;
+         streamlog_out ( DEBUG0 ) << _alignmentCollectionName.c_str() << " REVERT: ORIGI: Sensor ID " << sensorID << " " << inputPosition_orig[0] << " " << inputPosition_orig[1] << " " << inputPosition_orig[2] <<  endl;   
+         streamlog_out ( DEBUG0 ) << _alignmentCollectionName.c_str() << " REVERT: INPUT: Sensor ID " << sensorID << " " << inputPosition[0] << " " << inputPosition[1] << " " << inputPosition[2] <<  endl;   
+         streamlog_out ( DEBUG0 ) << _alignmentCollectionName.c_str() << " REVERT: OUTPUT:Sensor ID " << sensorID << " " << outputPosition[0] << " " << outputPosition[1] << " " << outputPosition[2]  << endl;
       }
 
-            outputHit->setPosition( outputPosition ) ;
-            _outputCollectionVec->push_back( outputHit );
-        }
+      outputHit->setPosition( outputPosition ) ;
+      _outputCollectionVec->push_back( outputHit );
+    }
 }
 
 void EUTelApplyAlignmentProcessor::bookHistos() {
@@ -2180,6 +1552,201 @@ void EUTelApplyAlignmentProcessor::revertAlignment(double & x, double & y, doubl
 
 
 
+void EUTelApplyAlignmentProcessor::rotationMatrix(double * matrix, double angleX, double angleY, double angleZ, bool xFirst)
+{
+    // same conventions as TVector3::RotateX, RotateY and RotateZ
+    const double cx = cos( angleX ), sx = sin( angleX );
+    const double cy = cos( angleY ), sy = sin( angleY );
+    const double cz = cos( angleZ ), sz = sin( angleZ );
+
+    const double rx[9] = { 1.,  0.,  0.,   0.,  cx, -sx,   0.,  sx,  cx };
+    const double ry[9] = { cy,  0.,  sy,   0.,  1.,  0.,  -sy,  0.,  cy };
+    const double rz[9] = { cz, -sz,  0.,   sz,  cz,  0.,   0.,  0.,  1. };
+
+    // the first rotation is the rightmost factor
+    const double * first = xFirst ? rx : rz;
+    const double * last  = xFirst ? rz : rx;
+
+    double temp[9];
+    for ( int i = 0; i < 3; ++i )
+      for ( int j = 0; j < 3; ++j )
+        temp[3*i+j] = ry[3*i] * first[j] + ry[3*i+1] * first[3+j] + ry[3*i+2] * first[6+j];
+
+    for ( int i = 0; i < 3; ++i )
+      for ( int j = 0; j < 3; ++j )
+        matrix[3*i+j] = last[3*i] * temp[j] + last[3*i+1] * temp[3+j] + last[3*i+2] * temp[6+j];
+}
+
+void EUTelApplyAlignmentProcessor::transformPosition(const SensorTransform & transform, const double * input, double * output)
+{
+    const double * r = transform.rotation;
+    for ( int i = 0; i < 3; ++i )
+      output[i] = r[3*i] * input[0] + r[3*i+1] * input[1] + r[3*i+2] * input[2] + transform.offset[i];
+}
+
+void EUTelApplyAlignmentProcessor::updateAlignmentRotations()
+{
+    map< int, AlignmentRotation > & rotations = _alignmentRotations[ _alignmentCollectionName ];
+
+    for ( size_t iPos = 0; iPos < _alignmentCollectionVec->size(); ++iPos )
+    {
+        EUTelAlignmentConstant * alignment = static_cast< EUTelAlignmentConstant * > ( _alignmentCollectionVec->getElementAt( iPos ) );
+
+        const double constants[6] = { alignment->getAlpha(), alignment->getBeta(), alignment->getGamma(),
+                                      alignment->getXOffset(), alignment->getYOffset(), alignment->getZOffset() };
+
+        map< int, AlignmentRotation >::iterator rotationIter = rotations.find( alignment->getSensorID() );
+        if ( rotationIter != rotations.end() && equal( constants, constants + 6, rotationIter->second.constants ) ) continue;
+
+        AlignmentRotation & rotation = rotations[ alignment->getSensorID() ];
+        copy( constants, constants + 6, rotation.constants );
+        rotationMatrix( rotation.direct,  -constants[0], -constants[1], -constants[2], true  );
+        rotationMatrix( rotation.reverse,  constants[0],  constants[1],  constants[2], false );
+
+        streamlog_out ( DEBUG2 ) << "Rotation of sensor " << alignment->getSensorID() << " updated for the alignment collection "
+                                 << _alignmentCollectionName << endl;
+    }
+}
+
+void EUTelApplyAlignmentProcessor::fillReferenceHitMap(map< int, EUTelReferenceHit * > & referenceHitMap) const
+{
+    referenceHitMap.clear();
+    if ( !_applyToReferenceHitCollection || _referenceHitVec == 0 ) return;
+
+    for ( size_t ii = 0 ; ii < static_cast< size_t >( _referenceHitVec->getNumberOfElements() ); ii++ )
+    {
+        EUTelReferenceHit * refhit = static_cast< EUTelReferenceHit * > ( _referenceHitVec->getElementAt(ii) );
+        // keep the first reference hit of each sensor
+        referenceHitMap.insert( make_pair( refhit->getSensorID(), refhit ) );
+    }
+}
+
+EUTelApplyAlignmentProcessor::SensorTransform EUTelApplyAlignmentProcessor::alignmentHitTransform(int sensorID, bool reverse,
+                                                                                                 const map< int, EUTelReferenceHit * > & referenceHitMap) const
+{
+    static const double identity[9] = { 1., 0., 0.,  0., 1., 0.,  0., 0., 1. };
+
+    // sensors without constants are not corrected
+    const double * constants = 0;
+    const double * rotation  = identity;
+
+    map< string, map< int, AlignmentRotation > >::const_iterator collectionIter = _alignmentRotations.find( _alignmentCollectionName );
+    if ( collectionIter != _alignmentRotations.end() )
+    {
+        map< int, AlignmentRotation >::const_iterator rotationIter = collectionIter->second.find( sensorID );
+        if ( rotationIter != collectionIter->second.end() )
+        {
+            constants = rotationIter->second.constants;
+            rotation  = reverse ? rotationIter->second.reverse : rotationIter->second.direct;
+        }
+    }
+
+    double offset[3] = { 0., 0., 0. };
+    if ( constants ) copy( constants + 3, constants + 6, offset );
+
+    SensorTransform transform;
+
+    // refhit = center-of-the-sensor coordinates
+    double * refhit = transform.center;
+    fill( refhit, refhit + 3, 0. );
+    map< int, EUTelReferenceHit * >::const_iterator refhitIter = referenceHitMap.find( sensorID );
+    if ( refhitIter != referenceHitMap.end() )
+    {
+        refhit[0] = refhitIter->second->getXOffset();
+        refhit[1] = refhitIter->second->getYOffset();
+        refhit[2] = refhitIter->second->getZOffset();
+
+        // Direct expects the reference hits without the alignment shifts
+        if ( !reverse ) for ( int i = 0; i < 3; ++i ) refhit[i] += offset[i];
+    }
+
+    const double sign = reverse ? 1. : -1.;
+
+    if ( _correctionMethod == 0 )
+    {
+        // shifts only; Reverse does not move back to the sensor center
+        copy( identity, identity + 9, transform.rotation );
+        for ( int i = 0; i < 3; ++i ) transform.offset[i] = sign * offset[i] - ( reverse ? refhit[i] : 0. );
+    }
+    else if ( _correctionMethod == 1 )
+    {
+        // rotation around the sensor center first, then the shifts
+        double debugRotation[9];
+        if ( _debugSwitch )
+        {
+            rotationMatrix( debugRotation, sign * _alpha, sign * _beta, sign * _gamma, !reverse );
+            rotation = debugRotation;
+            offset[0] = offset[1] = offset[2] = 0.;
+        }
+
+        copy( rotation, rotation + 9, transform.rotation );
+        for ( int i = 0; i < 3; ++i )
+          transform.offset[i] = refhit[i] + sign * offset[i]
+            - ( rotation[3*i] * refhit[0] + rotation[3*i+1] * refhit[1] + rotation[3*i+2] * refhit[2] );
+    }
+    else
+    {
+        // nothing is applied, the hits are moved to the sensor center
+        fill( transform.rotation, transform.rotation + 9, 0. );
+        copy( refhit, refhit + 3, transform.offset );
+    }
+
+    return transform;
+}
+
+const EUTelApplyAlignmentProcessor::SensorTransform & EUTelApplyAlignmentProcessor::gearTransform(int sensorID, bool revert)
+{
+    map< int, SensorTransform > & transforms = revert ? _gearRevertTransforms : _gearApplyTransforms;
+
+    map< int, SensorTransform >::iterator transformIter = transforms.find( sensorID );
+    if ( transformIter != transforms.end() ) return transformIter->second;
+
+    // the GEAR description does not change during the job
+    int  layerIndex = 0;
+    bool layerFound = false;
+    for ( int iLayer = 0; iLayer < _siPlanesLayerLayout->getNLayers(); iLayer++ )
+    {
+        if ( _siPlanesLayerLayout->getID(iLayer) == sensorID )
+        {
+            layerIndex = iLayer;
+            layerFound = true;
+            break;
+        }
+    }
+
+    double gRotation[3] = { _alpha, _beta, _gamma };
+    if ( !_debugSwitch )
+    {
+        // input angles are in DEGREEs !!!
+        gRotation[0] = _siPlanesLayerLayout->getLayerRotationXY(layerIndex) * 3.1415926/180.;
+        gRotation[1] = _siPlanesLayerLayout->getLayerRotationZX(layerIndex) * 3.1415926/180.;
+        gRotation[2] = _siPlanesLayerLayout->getLayerRotationZY(layerIndex) * 3.1415926/180.;
+    }
+
+    SensorTransform & transform = transforms[ sensorID ];
+    fill( transform.offset, transform.offset + 3, 0. );
+    fill( transform.center, transform.center + 3, 0. );
+
+    if ( revert )
+    {
+        rotationMatrix( transform.rotation, -gRotation[2], -gRotation[1], -gRotation[0], false );
+    }
+    else
+    {
+        // rotation around the sensor plane center in z
+        rotationMatrix( transform.rotation, gRotation[2], gRotation[1], gRotation[0], true );
+
+        const double z_sensor = layerFound ?
+          _siPlanesLayerLayout->getSensitivePositionZ( layerIndex ) + 0.5 * _siPlanesLayerLayout->getSensitiveThickness( layerIndex ) : 0.;
+        for ( int i = 0; i < 3; ++i ) transform.offset[i] = - transform.rotation[3*i+2] * z_sensor;
+        transform.offset[2] += z_sensor;
+    }
+
+    streamlog_out ( DEBUG2 ) << "GEAR rotation of sensor " << sensorID << " : " << gRotation[0] << " " << gRotation[1] << " " << gRotation[2] << endl;
+
+    return transform;
+}
+
 void EUTelApplyAlignmentProcessor::_EulerRotation(double* _telPos, double* _gRotation) {
 
     TVector3 _RotatedSensorHit( _telPos[0], _telPos[1], _telPos[2] );
@@ -60,6 +60,8 @@
 #include <memory>
 #include <cstdlib>
 #include <map>
+#include <algorithm>
+#include <future>
 
 using namespace std;
 using namespace lcio;
@@ -74,11 +76,35 @@ string EUTelCalculateEtaProcessor::_cogIntegralYName  = "Integral_CoG_Y";
 string EUTelCalculateEtaProcessor::_etaHistoXName     = "EtaProfile_X";
 string EUTelCalculateEtaProcessor::_etaHistoYName     = "EtaProfile_Y";
 string EUTelCalculateEtaProcessor::_cogHisto2DName    = "CoG_Histo2D";
+string EUTelCalculateEtaProcessor::_etaCorrectedXName = "EtaCorrected_CoG_X";
+string EUTelCalculateEtaProcessor::_etaCorrectedYName = "EtaCorrected_CoG_Y";
 #endif
 
 const double EUTelCalculateEtaProcessor::_min = -0.5;
 const double EUTelCalculateEtaProcessor::_max =  0.5;
 
+namespace {
+
+  //! Adds to the event a subset collection of the eta functions
+  /*! The functions stay owned by the processor and the collection is
+   *  not written out. Nothing is done if a collection with the same
+   *  name is already there.
+   */
+  void addEtaCollection(LCEvent * evt, const map<int, unique_ptr<EUTelEtaFunctionImpl> > & etaFunctions, const string & name) {
+    const StringVec * names = evt->getCollectionNames();
+    if ( find( names->begin(), names->end(), name ) != names->end() ) return;
+
+    LCCollectionVec * etaCollection = new LCCollectionVec(LCIO::LCGENERICOBJECT);
+    etaCollection->setSubset( true );
+    etaCollection->setTransient( true );
+    for ( map<int, unique_ptr<EUTelEtaFunctionImpl> >::const_iterator iter = etaFunctions.begin(); iter != etaFunctions.end(); ++iter ) {
+      etaCollection->push_back( iter->second.get() );
+    }
+    evt->addCollection( etaCollection, name );
+  }
+
+}
+
 EUTelCalculateEtaProcessor::EUTelCalculateEtaProcessor () : Processor("EUTelCalculateEtaProcessor") {
 
   // modify processor description
@@ -135,6 +161,10 @@ EUTelCalculateEtaProcessor::EUTelCalculateEtaProcessor () : Processor("EUTelCalc
 
   registerOptionalParameter("RejectSinglePixelCluster","reject single pixel cluster. 1=reject, 0=keep, 2=reject clusters with two pixels, where the second pixel is not diagonal to the seed. ",_rejectsingplepixelcluster, static_cast <int> (0));
 
+  registerOptionalParameter("SinglePassCorrection",
+                            "Apply the eta functions to the following events of the same job, without a second pass",
+                            _singlePassCorrection, static_cast<bool> ( false ));
+
 
 
 }
@@ -154,6 +184,11 @@ void EUTelCalculateEtaProcessor::init () {
   _cogHistogramY.clear();
   _integralHistoX.clear();
   _integralHistoY.clear();
+  _etaFunctionX.clear();
+  _etaFunctionY.clear();
+  _cogShiftBuffer.clear();
+  _nUncorrectedEvents = 0;
+  _nCorrectedEvents = 0;
 
   if(_rejectsingplepixelcluster != 0 && _rejectsingplepixelcluster != 1 && _rejectsingplepixelcluster != 2)
     {
@@ -252,6 +287,15 @@ void EUTelCalculateEtaProcessor::processEvent (LCEvent * event) {
                                << " is of unknown type. Continue considering it as a normal Data Event." << endl;
   }
 
+  if ( _singlePassCorrection ) {
+    if ( _isEtaCalculationFinished ) {
+      correctEvent( evt );
+      ++_nCorrectedEvents;
+    } else {
+      ++_nUncorrectedEvents;
+    }
+  }
+
   if ( !_isEtaCalculationFinished ) {
 
     try {
@@ -266,53 +310,7 @@ void EUTelCalculateEtaProcessor::processEvent (LCEvent * event) {
 
         // all clusters have to inherit from the virtual cluster (that is
         // a TrackerDataImpl with some utility methods).
-        EUTelVirtualCluster    * cluster;
-        if ( type == kEUTelDFFClusterImpl ) {
-
-          // digital fixed cluster implementation. Remember it can come from
-          // both RAW and ZS data
-          cluster = new EUTelDFFClusterImpl( static_cast<TrackerDataImpl*> (pulse->getTrackerData()) );
-
-        } else if ( type == kEUTelFFClusterImpl ) {
-
-          // fixed cluster implementation. Remember it can come from
-          // both RAW and ZS data
-          cluster = new EUTelFFClusterImpl( static_cast<TrackerDataImpl*> (pulse->getTrackerData()) );
-          //streamlog_out ( MESSAGE2 ) <<  "seen a kEUTelFFClusterImpl" << endl; //!HACK TAKI
-
-        } else if ( type == kEUTelBrickedClusterImpl ) {
-
-          // bricked cluster implementation
-          // Remember it can come from both RAW and ZS data
-          cluster = new EUTelBrickedClusterImpl( static_cast<TrackerDataImpl*> (pulse->getTrackerData()) ); //!HACK TAKI
-          //streamlog_out ( MESSAGE2 ) <<  "seen a kEUTelBrickedClusterImpl" << endl; //!HACK TAKI
-
-        } else if ( type == kEUTelSparseClusterImpl ) {
-
-          // ok the cluster is of sparse type, but we also need to know
-          // the kind of pixel description used. This information is
-          // stored in the corresponding original data collection.
-
-          LCCollectionVec * sparseClusterCollectionVec = dynamic_cast < LCCollectionVec * > (evt->getCollection("original_zsdata"));
-          TrackerDataImpl * oneCluster = dynamic_cast<TrackerDataImpl*> (sparseClusterCollectionVec->getElementAt( 0 ));
-          CellIDDecoder<TrackerDataImpl > anotherDecoder(sparseClusterCollectionVec);
-          SparsePixelType pixelType = static_cast<SparsePixelType> ( static_cast<int> ( anotherDecoder( oneCluster )["sparsePixelType"] ));
-
-          // now we know the pixel type. So we can properly create a new
-          // instance of the sparse cluster
-          if ( pixelType == kEUTelGenericSparsePixel ) {
-            cluster = new EUTelSparseClusterImpl< EUTelGenericSparsePixel >
-              ( static_cast<TrackerDataImpl *> ( pulse->getTrackerData()  ) );
-          } else {
-            streamlog_out ( ERROR4 ) << "Unknown pixel type.  Sorry for quitting." << endl;
-            throw UnknownDataTypeException("Pixel type unknown");
-          }
-          //streamlog_out ( MESSAGE2 ) <<  "seen a kEUTelSparseClusterImpl" << endl; //!HACK TAKI
-
-        } else {
-          streamlog_out ( ERROR4 ) <<  "Unknown cluster type. Sorry for quitting" << endl;
-          throw UnknownDataTypeException("Cluster type unknown");
-        }
+        EUTelVirtualCluster    * cluster = createCluster( evt, pulse, type );
 
         int detectorID = cluster->getDetectorID();
         float xShift, yShift;
@@ -322,65 +320,7 @@ void EUTelCalculateEtaProcessor::processEvent (LCEvent * event) {
         if ( cluster->getClusterQuality() == static_cast<ClusterQuality> (_clusterQuality) )
           {
 
-            EUTelBrickedClusterImpl* p_tmpBrickedCluster = NULL;
-            if ( type == kEUTelBrickedClusterImpl )
-              {
-                p_tmpBrickedCluster = dynamic_cast< EUTelBrickedClusterImpl* >(cluster);
-                //Static of cluster to EUTelBrickedClusterImpl* was done for sure in the case of
-                //( type == kEUTelBrickedClusterImpl ).
-                //So this cast must work as well!
-                //This is just a (different) pointer to the same memory as "cluster". So no additional delete needed.
-              }
-
-            if ( _clusterTypeSelection == "FULL" ) {
-
-              if (p_tmpBrickedCluster)
-                {
-                  //streamlog_out ( MESSAGE2 ) <<  "DEBUG: doing eta FULL on a bricked cluster!" << endl;
-                  p_tmpBrickedCluster->getCenterOfGravityShiftWithOutGlobalSeedCoordinateCorrection(xShift, yShift);
-                }
-              else
-                {
-                  cluster->getCenterOfGravityShift(xShift, yShift);
-                }
-
-            } else if ( _clusterTypeSelection == "NxMPixel" ) {
-
-              if (p_tmpBrickedCluster)
-                {
-                  streamlog_out ( WARNING4 ) <<  "NxM not applicable for a bricked cluster!! Doing FULL!" << endl;
-                  p_tmpBrickedCluster->getCenterOfGravityShiftWithOutGlobalSeedCoordinateCorrection(xShift, yShift);
-                }
-              else
-                {
-                  cluster->getCenterOfGravityShift(xShift, yShift, _xyCluSize[0], _xyCluSize[1]);
-                }
-
-            } else if ( _clusterTypeSelection == "NPixel" ) {
-
-              if (p_tmpBrickedCluster)
-                {
-                  //streamlog_out ( MESSAGE2 ) <<  "DEBUG: doing eta NPixel on a bricked cluster!" << endl;
-                  p_tmpBrickedCluster->getCenterOfGravityShiftWithOutGlobalSeedCoordinateCorrection(xShift, yShift, _nPixel);
-                }
-              else
-                {
-                  cluster->getCenterOfGravityShift(xShift, yShift, _nPixel);
-                }
-
-            }
-
-
-            //#define TAKI_DEBUG_ETA 1
-#ifdef TAKI_DEBUG_ETA
-            if (p_tmpBrickedCluster)
-              {
-                streamlog_out ( MESSAGE2 ) << endl;
-                streamlog_out ( MESSAGE2 ) <<  "Just done ETA on a BrickedCluster!" << endl;
-                p_tmpBrickedCluster->debugOutput();
-              }
-#endif //TAKI_DEBUG_ETA
-
+            getCoGShift( cluster, type, xShift, yShift );
 
             // look for the proper pseudo histogram before filling
             // it. In case the corresponding pseudo histogram is not yet
@@ -395,24 +335,15 @@ void EUTelCalculateEtaProcessor::processEvent (LCEvent * event) {
             }
             //is this a single pixel cluster? 
        
-            bool spc_cut = false;
-            if( _rejectsingplepixelcluster == 2)
-              {
-                spc_cut = type != kEUTelDFFClusterImpl &&
-                  (abs(static_cast<double>(xShift)) < numeric_limits< double >::min()  ||
-                   abs(static_cast<double>(yShift)) <  numeric_limits< double >::min());
-              }
-            else if(_rejectsingplepixelcluster == 1)
-              {
-                spc_cut = type != kEUTelDFFClusterImpl &&
-                  abs(static_cast<double>(xShift)) < numeric_limits< double >::min()  &&
-                  abs(static_cast<double>(yShift)) <  numeric_limits< double >::min(); 
-              }
+            bool spc_cut = isSinglePixelCluster( type, xShift, yShift );
 
             if(!spc_cut)
               {
                 _cogHistogramX[detectorID]->fill(static_cast<double>(xShift), 1.0);
                 _cogHistogramY[detectorID]->fill(static_cast<double>(yShift), 1.0);
+
+                // kept to be corrected once the eta functions are there
+                if ( _singlePassCorrection ) _cogShiftBuffer[detectorID].push_back( make_pair( xShift, yShift ) );
               }
 #if defined(USE_AIDA) || defined(MARLIN_USE_AIDA)
             {
@@ -481,6 +412,24 @@ void EUTelCalculateEtaProcessor::processEvent (LCEvent * event) {
                 cogHisto2D->setTitle(title.c_str());
                 _aidaHistoMap.insert( make_pair(name, cogHisto2D) );
 
+                if ( _singlePassCorrection ) {
+                  // Eta corrected CoG along x
+                  name  = _etaCorrectedXName + "_" + to_string( detectorID );
+                  title = "Eta corrected CoG shift along X on detector " + to_string( detectorID );
+                  AIDA::IHistogram1D * etaCorrectedX =
+                    AIDAProcessor::histogramFactory(this)->createHistogram1D( (path + name).c_str(), _noOfBin[0], _min, _max);
+                  etaCorrectedX->setTitle(title.c_str());
+                  _aidaHistoMap.insert( make_pair(name, etaCorrectedX) );
+
+                  // Eta corrected CoG along y
+                  name  = _etaCorrectedYName + "_" + to_string( detectorID );
+                  title = "Eta corrected CoG shift along Y on detector " + to_string( detectorID );
+                  AIDA::IHistogram1D * etaCorrectedY =
+                    AIDAProcessor::histogramFactory(this)->createHistogram1D( (path + name).c_str(), _noOfBin[1], _min, _max);
+                  etaCorrectedY->setTitle(title.c_str());
+                  _aidaHistoMap.insert( make_pair(name, etaCorrectedY) );
+                }
+
                 _alreadyBookedSensorID.insert( detectorID ) ;
               }
            
@@ -526,6 +475,227 @@ void EUTelCalculateEtaProcessor::processEvent (LCEvent * event) {
 
 
 
+EUTelVirtualCluster * EUTelCalculateEtaProcessor::createCluster(LCEvent * evt, TrackerPulseImpl * pulse, ClusterType type) const {
+
+  EUTelVirtualCluster    * cluster;
+  if ( type == kEUTelDFFClusterImpl ) {
+
+    // digital fixed cluster implementation. Remember it can come from
+    // both RAW and ZS data
+    cluster = new EUTelDFFClusterImpl( static_cast<TrackerDataImpl*> (pulse->getTrackerData()) );
+
+  } else if ( type == kEUTelFFClusterImpl ) {
+
+    // fixed cluster implementation. Remember it can come from
+    // both RAW and ZS data
+    cluster = new EUTelFFClusterImpl( static_cast<TrackerDataImpl*> (pulse->getTrackerData()) );
+    //streamlog_out ( MESSAGE2 ) <<  "seen a kEUTelFFClusterImpl" << endl; //!HACK TAKI
+
+  } else if ( type == kEUTelBrickedClusterImpl ) {
+
+    // bricked cluster implementation
+    // Remember it can come from both RAW and ZS data
+    cluster = new EUTelBrickedClusterImpl( static_cast<TrackerDataImpl*> (pulse->getTrackerData()) ); //!HACK TAKI
+    //streamlog_out ( MESSAGE2 ) <<  "seen a kEUTelBrickedClusterImpl" << endl; //!HACK TAKI
+
+  } else if ( type == kEUTelSparseClusterImpl ) {
+
+    // ok the cluster is of sparse type, but we also need to know
+    // the kind of pixel description used. This information is
+    // stored in the corresponding original data collection.
+
+    LCCollectionVec * sparseClusterCollectionVec = dynamic_cast < LCCollectionVec * > (evt->getCollection("original_zsdata"));
+    TrackerDataImpl * oneCluster = dynamic_cast<TrackerDataImpl*> (sparseClusterCollectionVec->getElementAt( 0 ));
+    CellIDDecoder<TrackerDataImpl > anotherDecoder(sparseClusterCollectionVec);
+    SparsePixelType pixelType = static_cast<SparsePixelType> ( static_cast<int> ( anotherDecoder( oneCluster )["sparsePixelType"] ));
+
+    // now we know the pixel type. So we can properly create a new
+    // instance of the sparse cluster
+    if ( pixelType == kEUTelGenericSparsePixel ) {
+      cluster = new EUTelSparseClusterImpl< EUTelGenericSparsePixel >
+        ( static_cast<TrackerDataImpl *> ( pulse->getTrackerData()  ) );
+    } else {
+      streamlog_out ( ERROR4 ) << "Unknown pixel type.  Sorry for quitting." << endl;
+      throw UnknownDataTypeException("Pixel type unknown");
+    }
+    //streamlog_out ( MESSAGE2 ) <<  "seen a kEUTelSparseClusterImpl" << endl; //!HACK TAKI
+
+  } else {
+    streamlog_out ( ERROR4 ) <<  "Unknown cluster type. Sorry for quitting" << endl;
+    throw UnknownDataTypeException("Cluster type unknown");
+  }
+
+  return cluster;
+}
+
+
+void EUTelCalculateEtaProcessor::getCoGShift(EUTelVirtualCluster * cluster, ClusterType type, float & xShift, float & yShift) const {
+
+  EUTelBrickedClusterImpl* p_tmpBrickedCluster = NULL;
+  if ( type == kEUTelBrickedClusterImpl )
+    {
+      p_tmpBrickedCluster = dynamic_cast< EUTelBrickedClusterImpl* >(cluster);
+      //Static of cluster to EUTelBrickedClusterImpl* was done for sure in the case of
+      //( type == kEUTelBrickedClusterImpl ).
+      //So this cast must work as well!
+      //This is just a (different) pointer to the same memory as "cluster". So no additional delete needed.
+    }
+
+  if ( _clusterTypeSelection == "FULL" ) {
+
+    if (p_tmpBrickedCluster)
+      {
+        //streamlog_out ( MESSAGE2 ) <<  "DEBUG: doing eta FULL on a bricked cluster!" << endl;
+        p_tmpBrickedCluster->getCenterOfGravityShiftWithOutGlobalSeedCoordinateCorrection(xShift, yShift);
+      }
+    else
+      {
+        cluster->getCenterOfGravityShift(xShift, yShift);
+      }
+
+  } else if ( _clusterTypeSelection == "NxMPixel" ) {
+
+    if (p_tmpBrickedCluster)
+      {
+        streamlog_out ( WARNING4 ) <<  "NxM not applicable for a bricked cluster!! Doing FULL!" << endl;
+        p_tmpBrickedCluster->getCenterOfGravityShiftWithOutGlobalSeedCoordinateCorrection(xShift, yShift);
+      }
+    else
+      {
+        cluster->getCenterOfGravityShift(xShift, yShift, _xyCluSize[0], _xyCluSize[1]);
+      }
+
+  } else if ( _clusterTypeSelection == "NPixel" ) {
+
+    if (p_tmpBrickedCluster)
+      {
+        //streamlog_out ( MESSAGE2 ) <<  "DEBUG: doing eta NPixel on a bricked cluster!" << endl;
+        p_tmpBrickedCluster->getCenterOfGravityShiftWithOutGlobalSeedCoordinateCorrection(xShift, yShift, _nPixel);
+      }
+    else
+      {
+        cluster->getCenterOfGravityShift(xShift, yShift, _nPixel);
+      }
+
+  }
+
+
+  //#define TAKI_DEBUG_ETA 1
+#ifdef TAKI_DEBUG_ETA
+  if (p_tmpBrickedCluster)
+    {
+      streamlog_out ( MESSAGE2 ) << endl;
+      streamlog_out ( MESSAGE2 ) <<  "Just done ETA on a BrickedCluster!" << endl;
+      p_tmpBrickedCluster->debugOutput();
+    }
+#endif //TAKI_DEBUG_ETA
+}
+
+
+bool EUTelCalculateEtaProcessor::isSinglePixelCluster(ClusterType type, float xShift, float yShift) const {
+
+  bool spc_cut = false;
+  if( _rejectsingplepixelcluster == 2)
+    {
+      spc_cut = type != kEUTelDFFClusterImpl &&
+        (abs(static_cast<double>(xShift)) < numeric_limits< double >::min()  ||
+         abs(static_cast<double>(yShift)) <  numeric_limits< double >::min());
+    }
+  else if(_rejectsingplepixelcluster == 1)
+    {
+      spc_cut = type != kEUTelDFFClusterImpl &&
+        abs(static_cast<double>(xShift)) < numeric_limits< double >::min()  &&
+        abs(static_cast<double>(yShift)) <  numeric_limits< double >::min(); 
+    }
+  return spc_cut;
+}
+
+
+void EUTelCalculateEtaProcessor::correctEvent(LCEvent * evt) {
+
+  // publish the eta functions to the following processors
+  addEtaCollection( evt, _etaFunctionX, _etaXCollectionName );
+  addEtaCollection( evt, _etaFunctionY, _etaYCollectionName );
+
+  LCCollectionVec * clusterCollectionVec;
+  try {
+    clusterCollectionVec = dynamic_cast < LCCollectionVec * > (evt->getCollection(_clusterCollectionName));
+  } catch ( lcio::DataNotAvailableException & e) {
+    return ;
+  }
+  CellIDDecoder<TrackerPulseImpl> cellDecoder(clusterCollectionVec);
+
+  for (int iCluster = 0; iCluster < clusterCollectionVec->getNumberOfElements() ; iCluster++) {
+
+    TrackerPulseImpl   * pulse = dynamic_cast<TrackerPulseImpl *>  ( clusterCollectionVec->getElementAt(iCluster) );
+    int temp = cellDecoder(pulse)["type"];
+    ClusterType type = static_cast<ClusterType>( temp );
+
+    // for bricked clusters the global seed coordinate correction has
+    // to be applied on top of the eta correction, they are left to
+    // the hit maker
+    if ( type == kEUTelBrickedClusterImpl ) continue;
+
+    unique_ptr<EUTelVirtualCluster> cluster( createCluster( evt, pulse, type ) );
+    int detectorID = cluster->getDetectorID();
+
+    map< int, unique_ptr<EUTelEtaFunctionImpl> >::iterator etaX = _etaFunctionX.find( detectorID );
+    map< int, unique_ptr<EUTelEtaFunctionImpl> >::iterator etaY = _etaFunctionY.find( detectorID );
+    if ( etaX == _etaFunctionX.end() || etaY == _etaFunctionY.end() ) continue;
+
+    float xShift, yShift;
+    getCoGShift( cluster.get(), type, xShift, yShift );
+
+    EUTelEtaCorrectedShift * correctedShift = new EUTelEtaCorrectedShift;
+    correctedShift->x = static_cast<float>( etaX->second->getEtaFromCoG( xShift ) );
+    correctedShift->y = static_cast<float>( etaY->second->getEtaFromCoG( yShift ) );
+
+    // the pulse takes the ownership
+    EUTelEtaCorrectedShift *& attached = pulse->ext<EUTelEtaCorrectedShiftExtension>();
+    delete attached;
+    attached = correctedShift;
+
+    if ( cluster->getClusterQuality() == static_cast<ClusterQuality> (_clusterQuality)
+         && !isSinglePixelCluster( type, xShift, yShift ) ) {
+      fillEtaCorrectedHisto( detectorID, correctedShift->x, correctedShift->y );
+    }
+  }
+}
+
+
+void EUTelCalculateEtaProcessor::fillEtaCorrectedHisto(int detectorID, float xShift, float yShift) {
+#if defined(USE_AIDA) || defined(MARLIN_USE_AIDA)
+  string name = _etaCorrectedXName + "_" + to_string( detectorID );
+  if ( AIDA::IHistogram1D * histo = dynamic_cast< AIDA::IHistogram1D* > (_aidaHistoMap[name]) ) histo->fill(xShift);
+
+  name = _etaCorrectedYName + "_" + to_string( detectorID );
+  if ( AIDA::IHistogram1D * histo = dynamic_cast< AIDA::IHistogram1D* > (_aidaHistoMap[name]) ) histo->fill(yShift);
+#else
+  (void) detectorID; (void) xShift; (void) yShift;
+#endif
+}
+
+
+EUTelCalculateEtaProcessor::EtaFunctionBins EUTelCalculateEtaProcessor::calculateEtaFunction(EUTelPseudo1DHistogram * cogHisto,
+                                                                                            EUTelPseudo1DHistogram * integralHisto) {
+
+  // running integral, the bins are added in the same order as
+  // EUTelPseudo1DHistogram::integral(1, iBin) would do for each bin
+  double integral = 0;
+  for (int iBin = 1; iBin <= cogHisto->getNumberOfBins(); iBin++ ) {
+    integral += cogHisto->getBinContent(iBin);
+    integralHisto->fill(cogHisto->getBinCenter(iBin), integral);
+  }
+
+  EtaFunctionBins eta;
+  for (int iBin = 1; iBin <= integralHisto->getNumberOfBins(); iBin++) {
+    eta.center.push_back( integralHisto->getBinCenter(iBin) );
+    eta.value.push_back(  integralHisto->getBinContent(iBin) / integral - 0.5 );
+  }
+  return eta;
+}
+
+
 void EUTelCalculateEtaProcessor::check (LCEvent * /* evt */ ) {
   // nothing to check here - could be used to fill check plots in reconstruction processor
 }
@@ -560,53 +730,44 @@ void EUTelCalculateEtaProcessor::finalizeProcessor() {
   LCCollectionVec * etaXCollection = new LCCollectionVec(LCIO::LCGENERICOBJECT);
   LCCollectionVec * etaYCollection = new LCCollectionVec(LCIO::LCGENERICOBJECT);
 
+  // the sensors and the two directions are independent, so each eta
+  // function is calculated in its own task
+  map< int, future< EtaFunctionBins > > etaXTasks;
+  map< int, future< EtaFunctionBins > > etaYTasks;
+  for ( map< int, EUTelPseudo1DHistogram * >::iterator iter = _cogHistogramX.begin(); iter != _cogHistogramX.end(); ++iter ) {
+    int iDetector = iter->first;
+    etaXTasks[iDetector] = async( launch::async, &EUTelCalculateEtaProcessor::calculateEtaFunction,
+                                  _cogHistogramX[iDetector], _integralHistoX[iDetector] );
+    etaYTasks[iDetector] = async( launch::async, &EUTelCalculateEtaProcessor::calculateEtaFunction,
+                                  _cogHistogramY[iDetector], _integralHistoY[iDetector] );
+  }
+
   map< int, EUTelPseudo1DHistogram * >::iterator iter = _cogHistogramX.begin();
   while ( iter != _cogHistogramX.end() ) {
 
     int iDetector = iter->first;
 
-    for (int iBin = 1; iBin <= _cogHistogramX[iDetector]->getNumberOfBins(); iBin++ ) {
-      double x = _cogHistogramX[iDetector]->getBinCenter(iBin);
-      integral = _cogHistogramX[iDetector]->integral(1, iBin);
-      _integralHistoX[iDetector]->fill(x, integral);
-
-    }
-
-    vector<double > etaBinCenter;
-    vector<double > etaBinValue;
-
-    for (int iBin = 1; iBin <= _integralHistoX[iDetector]->getNumberOfBins(); iBin++) {
-      etaBinCenter.push_back( _integralHistoX[iDetector]->getBinCenter(iBin) );
-      etaBinValue.push_back(  _integralHistoX[iDetector]->getBinContent(iBin) / integral - 0.5 ); // - 0.5);
-    }
-
-
-    EUTelEtaFunctionImpl * etaX = new EUTelEtaFunctionImpl(etaBinCenter.size(), etaBinCenter, etaBinValue);
+    EtaFunctionBins etaXBins = etaXTasks[iDetector].get();
+    EUTelEtaFunctionImpl * etaX = new EUTelEtaFunctionImpl(etaXBins.center.size(), etaXBins.center, etaXBins.value);
 #if ETA_VERSION >= 2
     etaX->setSensorID( iDetector ) ;
 #endif
     etaXCollection->push_back(etaX);
 
-    etaBinCenter.clear();
-    etaBinValue.clear();
-
-    for (int iBin = 1; iBin <= _cogHistogramY[iDetector]->getNumberOfBins(); iBin++ ) {
-      double y = _cogHistogramY[iDetector]->getBinCenter(iBin);
-      integral = _cogHistogramY[iDetector]->integral(1, iBin);
-      _integralHistoY[iDetector]->fill(y, integral);
-    }
-
-    for (int iBin = 1; iBin <= _integralHistoY[iDetector]->getNumberOfBins(); iBin++) {
-      etaBinCenter.push_back( _integralHistoY[iDetector]->getBinCenter(iBin) );
-      etaBinValue.push_back(  _integralHistoY[iDetector]->getBinContent(iBin) / integral - 0.5 ); // 0.5);
-    }
-
-    EUTelEtaFunctionImpl * etaY = new EUTelEtaFunctionImpl(etaBinCenter.size(), etaBinCenter, etaBinValue);
+    EtaFunctionBins etaYBins = etaYTasks[iDetector].get();
+    EUTelEtaFunctionImpl * etaY = new EUTelEtaFunctionImpl(etaYBins.center.size(), etaYBins.center, etaYBins.value);
 #if ETA_VERSION >= 2
     etaY->setSensorID( iDetector ) ;
 #endif
     etaYCollection->push_back(etaY);
 
+    // the written collections are deleted with the event, a copy is
+    // kept for the following events
+    if ( _singlePassCorrection ) {
+      _etaFunctionX[iDetector].reset( new EUTelEtaFunctionImpl(iDetector, etaXBins.center.size(), etaXBins.center, etaXBins.value) );
+      _etaFunctionY[iDetector].reset( new EUTelEtaFunctionImpl(iDetector, etaYBins.center.size(), etaYBins.center, etaYBins.value) );
+    }
+
 
 #if defined(USE_AIDA) || defined(MARLIN_USE_AIDA)
     integral = 0;
@@ -668,6 +829,25 @@ void EUTelCalculateEtaProcessor::finalizeProcessor() {
   lcWriter->close();
 
 
+  if ( _singlePassCorrection ) {
+
+    // the clusters used in the calculation belong to events already
+    // processed, only their corrected CoG can still be histogrammed
+    for ( map< int, vector< pair<float, float > > >::iterator buffer = _cogShiftBuffer.begin(); buffer != _cogShiftBuffer.end(); ++buffer ) {
+      const EUTelEtaFunctionImpl * etaX = _etaFunctionX[buffer->first].get();
+      const EUTelEtaFunctionImpl * etaY = _etaFunctionY[buffer->first].get();
+      for ( size_t iShift = 0; iShift < buffer->second.size(); ++iShift ) {
+        fillEtaCorrectedHisto( buffer->first,
+                               static_cast<float>( etaX->getEtaFromCoG( buffer->second[iShift].first ) ),
+                               static_cast<float>( etaY->getEtaFromCoG( buffer->second[iShift].second ) ) );
+      }
+    }
+    _cogShiftBuffer.clear();
+
+    streamlog_out ( MESSAGE4 ) << "Eta functions available for " << _etaFunctionX.size()
+                               << " sensors, correcting the following events" << endl;
+  }
+
   _isEtaCalculationFinished = true;
   setReturnValue( "isEtaCalculationFinished" , _isEtaCalculationFinished);
   //  throw RewindDataFilesException(this);
@@ -682,6 +862,14 @@ void EUTelCalculateEtaProcessor::end() {
     finalizeProcessor();
   }
 
+  if ( _singlePassCorrection ) {
+    // the output mixes events with and without the correction, the
+    // corrected hits are flagged as kEtaCorrectedHit by the hit maker
+    streamlog_out ( MESSAGE4 ) << "Single pass eta correction: " << _nUncorrectedEvents
+                               << " events used for the eta calculation left uncorrected, "
+                               << _nCorrectedEvents << " events corrected" << endl;
+  }
+
   streamlog_out ( MESSAGE2 ) <<  "Successfully finished" << endl;
 }
 
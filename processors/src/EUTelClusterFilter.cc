@@ -12,6 +12,7 @@
 // eutelescope includes ".h"
 #include "EUTELESCOPE.h"
 #include "EUTelVirtualCluster.h"
+#include "EUTelClusterFeatures.h"
 #include "EUTelFFClusterImpl.h"
 #include "EUTelDFFClusterImpl.h"
 #include "EUTelBrickedClusterImpl.h"
@@ -54,7 +55,9 @@ EUTelClusterFilter::EUTelClusterFilter () :Processor("EUTelClusterFilter") {
   // modify processor description
   _description = "EUTelClusterFilter is a very powerful tool. It allows to select among an input collection of TrackerPulse\n"
     "only the clusters fulfilling a certain set of selection criteria.\n"
-    "The user can modify the switch on and off each selection cut and set the proper value for that via the processor parameter.";
+    "The user can modify the switch on and off each selection cut and set the proper value for that via the processor parameter.\n"
+    "With AdaptiveCutOrdering on, a cluster is only counted in the rejection summary under the first cut it failed, and\n"
+    "the event level cuts are only counted for the planes failing them when the cluster loop was stopped.";
 
 
   // first of all we need to register the input collection
@@ -232,6 +235,13 @@ EUTelClusterFilter::EUTelClusterFilter () :Processor("EUTelClusterFilter") {
                             "there are no cluster left.",
                             _skipEmptyEvent, static_cast<bool > ( false ) );
 
+  registerOptionalParameter("AdaptiveCutOrdering","If true, a cluster stops at the first cut it fails, the cluster based cuts are\n"
+                            "periodically reordered applying first the ones rejecting more clusters, and the cluster loop\n"
+                            "stops as soon as the event level cuts can no longer be passed. The selection does not change,\n"
+                            "but each rejected cluster is counted in the summary only for the first cut it failed, and the\n"
+                            "MinClusterNo, MaxClusterNo and SameNumberOfHit counts only cover the clusters looked at.",
+                            _adaptiveCutOrdering, static_cast<bool > ( false ) );
+
   // set the global noise switch to on
   _noiseRelatedCuts = true;
 
@@ -691,6 +701,70 @@ void EUTelClusterFilter::checkCriteria() {
     _rejectionMap.insert( make_pair("SameNumberOfHitCut", rejectedCounter ));
   }
 
+  // the cluster quantities needed by the criteria switched on. The
+  // first number of each group in the N and N x N vectors is the
+  // number of pixels
+  _featureRequest = EUTelClusterFeatureRequest();
+  const size_t module = _noOfDetectors + 1;
+  if ( _minNChargeSwitch ) {
+    for ( size_t i = 0; i < _minNChargeVec.size(); i += module ) _featureRequest.nCharge.push_back( static_cast<int > ( _minNChargeVec[i] ));
+  }
+  if ( _minNSNRSwitch ) {
+    for ( size_t i = 0; i < _minNSNRVec.size(); i += module ) _featureRequest.nSNR.push_back( static_cast<int > ( _minNSNRVec[i] ));
+  }
+  if ( _minNxNChargeSwitch ) {
+    for ( size_t i = 0; i < _minNxNChargeVec.size(); i += module ) _featureRequest.nxnCharge.push_back( static_cast<int > ( _minNxNChargeVec[i] ));
+  }
+  if ( _minNxNSNRSwitch ) {
+    for ( size_t i = 0; i < _minNxNSNRVec.size(); i += module ) _featureRequest.nxnSNR.push_back( static_cast<int > ( _minNxNSNRVec[i] ));
+  }
+  _featureRequest.centerOfGravity = _insideROISwitch || _outsideROISwitch;
+
+  // the cluster based criteria switched on, in the order used until
+  // the first reordering. Those depending on the noise are checking
+  // by themselves if the noise is available
+  _dffCriteria.criteria.clear();
+  _dffCriteria.nClusters = 0;
+  _clusterCriteria.criteria.clear();
+  _clusterCriteria.nClusters = 0;
+
+  ClusterCriterion criterion;
+  criterion.nTested = criterion.nRejected = 0;
+  if ( _dffnhitsswitch ) {
+    criterion.predicate = &EUTelClusterFilter::isAboveNumberOfHitPixel;
+    _dffCriteria.criteria.push_back( criterion );
+  }
+
+  const std::pair<bool, bool (EUTelClusterFilter::*)(const EUTelClusterFeatures &) const> clusterCriteria[] = {
+    std::make_pair( _minTotalChargeSwitch,  &EUTelClusterFilter::isAboveMinTotalCharge ),
+    std::make_pair( _minTotalSNRSwitch,     &EUTelClusterFilter::isAboveMinTotalSNR ),
+    std::make_pair( _minNChargeSwitch,      &EUTelClusterFilter::isAboveNMinCharge ),
+    std::make_pair( _minNSNRSwitch,         &EUTelClusterFilter::isAboveNMinSNR ),
+    std::make_pair( _minNxNChargeSwitch,    &EUTelClusterFilter::isAboveNxNMinCharge ),
+    std::make_pair( _minNxNSNRSwitch,       &EUTelClusterFilter::isAboveNxNMinSNR ),
+    std::make_pair( _minSeedChargeSwitch,   &EUTelClusterFilter::isAboveMinSeedCharge ),
+    std::make_pair( _minSeedSNRSwitch,      &EUTelClusterFilter::isAboveMinSeedSNR ),
+    std::make_pair( _maxClusterNoiseSwitch, &EUTelClusterFilter::isBelowMaxClusterNoise )
+  };
+  for ( size_t i = 0; i < sizeof( clusterCriteria ) / sizeof( clusterCriteria[0] ); ++i ) {
+    if ( !clusterCriteria[i].first ) continue;
+    criterion.predicate = clusterCriteria[i].second;
+    _clusterCriteria.criteria.push_back( criterion );
+  }
+
+  // these are common to all cluster types
+  const std::pair<bool, bool (EUTelClusterFilter::*)(const EUTelClusterFeatures &) const> commonCriteria[] = {
+    std::make_pair( _clusterQualitySwitch,  &EUTelClusterFilter::hasQuality ),
+    std::make_pair( _insideROISwitch,       &EUTelClusterFilter::isInsideROI ),
+    std::make_pair( _outsideROISwitch,      &EUTelClusterFilter::isOutsideROI )
+  };
+  for ( size_t i = 0; i < sizeof( commonCriteria ) / sizeof( commonCriteria[0] ); ++i ) {
+    if ( !commonCriteria[i].first ) continue;
+    criterion.predicate = commonCriteria[i].second;
+    _dffCriteria.criteria.push_back( criterion );
+    _clusterCriteria.criteria.push_back( criterion );
+  }
+
 }
 
 
@@ -742,10 +816,25 @@ void EUTelClusterFilter::processEvent (LCEvent * event) {
         vector<int > acceptedClusterVec;
         vector<int > clusterNoVec(_noOfDetectors, 0);
 
+        // the clusters per plane still to be filtered: together with
+        // the accepted ones they tell whether the event level criteria
+        // can still be passed
+        const int nPulse = pulseCollectionVec->getNumberOfElements();
+        vector<int > pulseDetectorPos( nPulse );
+        vector<int > remainingNoVec(_noOfDetectors, 0);
+        for ( int iPulse = 0; iPulse < nPulse; iPulse++ )
+        {
+            TrackerPulseImpl * pulse = dynamic_cast<TrackerPulseImpl* > (pulseCollectionVec->getElementAt(iPulse));
+            pulseDetectorPos[ iPulse ] = _ancillaryIndexMap[ inputDecoder(pulse)["sensorID"] ];
+            remainingNoVec[ pulseDetectorPos[ iPulse ] ]++;
+            _totalClusterCounter[ pulseDetectorPos[ iPulse ] ]++;
+        }
+        bool isEventLostTemp = _adaptiveCutOrdering && isEventLost( clusterNoVec, remainingNoVec );
+
         // CLUSTER BASED CUTS
-        for ( int iPulse = 0; iPulse < pulseCollectionVec->getNumberOfElements(); iPulse++ )
+        for ( int iPulse = 0; ( iPulse < nPulse ) && !isEventLostTemp; iPulse++ )
         {
-            streamlog_out ( DEBUG1 ) << "Filtering cluster " << iPulse + 1  << " / " << pulseCollectionVec->getNumberOfElements() << endl;
+            streamlog_out ( DEBUG1 ) << "Filtering cluster " << iPulse + 1  << " / " << nPulse << endl;
             TrackerPulseImpl * pulse = dynamic_cast<TrackerPulseImpl* > (pulseCollectionVec->getElementAt(iPulse));
             ClusterType type         = static_cast<ClusterType> (static_cast<int> ( inputDecoder(pulse)["type"] ));
             EUTelVirtualCluster * cluster;
@@ -970,51 +1059,39 @@ void EUTelClusterFilter::processEvent (LCEvent * event) {
                 throw UnknownDataTypeException("Cluster type unknown");
             }
 
-            // increment the event counter
-            _totalClusterCounter[ _ancillaryIndexMap[ cluster->getDetectorID() ] ]++;
+            // compute once all the quantities used by the criteria, the
+            // record is attached to the pulse for the next processors
+            _featureRequest.noise = _noiseRelatedCuts && ( type != kEUTelDFFClusterImpl ) &&
+              ( _minTotalSNRSwitch || _minNSNRSwitch || _minNxNSNRSwitch || _minSeedSNRSwitch || _maxClusterNoiseSwitch );
+            EUTelClusterFeatures * features = new EUTelClusterFeatures;
+            features->compute( *cluster, _featureRequest );
+            delete cluster;
 
-            bool isAccepted = true;
+            bool isAccepted = passCriteria( *features, ( type == kEUTelDFFClusterImpl ) ? _dffCriteria : _clusterCriteria );
 
-            if ( type == kEUTelDFFClusterImpl )
-            {
-                isAccepted &= isAboveNumberOfHitPixel(cluster);
-            }
-            else
+            EUTelClusterFeatures::attach( pulse, features );
+
+            const int detectorPos = pulseDetectorPos[ iPulse ];
+            remainingNoVec[ detectorPos ]--;
+            if ( isAccepted )
             {
-                isAccepted &= isAboveMinTotalCharge(cluster);
-                isAccepted &= isAboveMinTotalSNR(cluster);
-                isAccepted &= isAboveNMinCharge(cluster);
-                isAccepted &= isAboveNMinSNR(cluster);
-                isAccepted &= isAboveNxNMinCharge(cluster);
-                isAccepted &= isAboveNxNMinSNR(cluster);
-                isAccepted &= isAboveMinSeedCharge(cluster);
-                isAccepted &= isAboveMinSeedSNR(cluster);
-                isAccepted &= isBelowMaxClusterNoise(cluster);
+                acceptedClusterVec.push_back(iPulse);
+                clusterNoVec[ detectorPos ]++;
             }
-            isAccepted &= hasQuality(cluster);
-            isAccepted &= isInsideROI(cluster);
-            isAccepted &= isOutsideROI(cluster);
-
-            if ( isAccepted )  acceptedClusterVec.push_back(iPulse);
-
-            delete cluster;
 
+            isEventLostTemp = _adaptiveCutOrdering && isEventLost( clusterNoVec, remainingNoVec );
         }
 
-        vector<int >::iterator cluIter = acceptedClusterVec.begin();
-        while ( cluIter != acceptedClusterVec.end() )
-        {
-            TrackerPulseImpl * pulse = dynamic_cast<TrackerPulseImpl* > (pulseCollectionVec->getElementAt(*cluIter));
-            int detectorID  = inputDecoder(pulse)["sensorID"];
-            clusterNoVec[ _ancillaryIndexMap[ detectorID ] ]++;
-            ++cluIter;
-        }
+        // if the loop was stopped early, the minimum number of clusters
+        // is checked against the number they could still reach
+        vector<int > reachableNoVec( clusterNoVec );
+        for ( size_t iDetector = 0; iDetector < _noOfDetectors; iDetector++ ) reachableNoVec[ iDetector ] += remainingNoVec[ iDetector ];
 
-        bool areClusterEnoughTemp     = areClusterEnough(clusterNoVec);
+        bool areClusterEnoughTemp     = areClusterEnough(reachableNoVec);
         bool areClusterTooManyTemp    = areClusterTooMany(clusterNoVec);
         bool hasSameNumberOfHitTemp   = hasSameNumberOfHit(clusterNoVec);
         bool isEventAccepted = areClusterEnoughTemp && !areClusterTooManyTemp;
-        isEventAccepted &= hasSameNumberOfHitTemp;
+        isEventAccepted &= hasSameNumberOfHitTemp && !isEventLostTemp;
 
         if ( ! isEventAccepted ) acceptedClusterVec.clear();
 
@@ -1067,6 +1144,7 @@ void EUTelClusterFilter::processEvent (LCEvent * event) {
                 accepted->setCharge(  pulse->getCharge()  );
                 accepted->setQuality( pulse->getQuality() );
                 accepted->setTrackerData( pulse->getTrackerData() );
+                EUTelClusterFeatures::attach( accepted, new EUTelClusterFeatures( *EUTelClusterFeatures::get( pulse ) ) );
                 filteredCollectionVec->push_back(accepted);
                 _acceptedClusterCounter[ _ancillaryIndexMap[ inputDecoder(pulse)["sensorID"] ] ]++;
                 ++iter;
@@ -1153,18 +1231,69 @@ bool EUTelClusterFilter::hasSameNumberOfHit(std::vector<int > clusterNoVec) cons
   return hasSameNumber;
 }
 
-bool EUTelClusterFilter::isAboveNumberOfHitPixel(EUTelVirtualCluster * cluster) const {
+bool EUTelClusterFilter::isEventLost(const std::vector<int > & clusterNoVec, const std::vector<int > & remainingNoVec) const {
+
+  if ( !_minClusterNoSwitch && !_maxClusterNoSwitch && !_sameNumberOfHitSwitch ) return false;
+
+  int maxAccepted  = 0;
+  int minReachable = numeric_limits<int >::max();
+  for ( size_t iDetector = 0; iDetector < _noOfDetectors; iDetector++ ) {
+    int reachable = clusterNoVec[iDetector] + remainingNoVec[iDetector];
+    if ( _minClusterNoSwitch && ( reachable < _minClusterNoVec[iDetector] ) ) return true;
+    if ( _maxClusterNoSwitch && ( clusterNoVec[iDetector] > _maxClusterNoVec[iDetector] ) ) return true;
+    maxAccepted  = max( maxAccepted, clusterNoVec[iDetector] );
+    minReachable = min( minReachable, reachable );
+  }
+
+  // one plane has already more clusters than another one can reach
+  return _sameNumberOfHitSwitch && ( maxAccepted > minReachable );
+}
+
+bool EUTelClusterFilter::passCriteria(const EUTelClusterFeatures & features, ClusterCriterionList & list) {
+
+  bool isAccepted = true;
+  for ( size_t iCriterion = 0; iCriterion < list.criteria.size(); ++iCriterion ) {
+    ClusterCriterion & criterion = list.criteria[iCriterion];
+    criterion.nTested++;
+    if ( !(this->*criterion.predicate)( features ) ) {
+      criterion.nRejected++;
+      isAccepted = false;
+      // otherwise every cut is applied, so that the rejection summary
+      // counts all the cuts a cluster fails
+      if ( _adaptiveCutOrdering ) break;
+    }
+  }
+
+  if ( !_adaptiveCutOrdering || ( ++list.nClusters < _cutReorderPeriod ) ) return isAccepted;
+
+  // put first the criteria rejecting the largest fraction of what they
+  // test. The counters are halved so that the order follows changes in
+  // the running conditions
+  stable_sort( list.criteria.begin(), list.criteria.end(),
+               [] ( const ClusterCriterion & a, const ClusterCriterion & b ) {
+                 return a.nRejected * ( b.nTested + 1 ) > b.nRejected * ( a.nTested + 1 );
+               } );
+  for ( size_t iCriterion = 0; iCriterion < list.criteria.size(); ++iCriterion ) {
+    list.criteria[iCriterion].nTested   /= 2;
+    list.criteria[iCriterion].nRejected /= 2;
+  }
+  list.nClusters = 0;
+
+  return isAccepted;
+}
+
+bool EUTelClusterFilter::isAboveNumberOfHitPixel(const EUTelClusterFeatures & features) const {
   if ( !_dffnhitsswitch ) {
     return true;
   }
   streamlog_out ( DEBUG1 ) << "Filtering against number of hit pixel inside a cluster " << endl;
 
-  int detectorID = cluster->getDetectorID();
+  int detectorID = features.getDetectorID();
   int detectorPos = _ancillaryIndexMap[ detectorID ];
 
-  if ( static_cast< int >(cluster->getTotalCharge()) >= _DFFNHitsCuts[detectorPos] ) return true;
+  if ( static_cast< int >(features.getTotalCharge()) >= _DFFNHitsCuts[detectorPos] ) return true;
   else {
-    streamlog_out ( DEBUG2 )  << "Rejected cluster because the number of hit pixel is " << static_cast< int >(cluster->getTotalCharge())
+    streamlog_out ( DEBUG2 )  << "Rejected cluster because the number of hit pixel is " << static_cast< int >(features.getTotalCharge())
                               << " and the threshold is " << _DFFNHitsCuts[detectorPos] << endl;
     _rejectionMap["MinHitPixel"][detectorPos]++;
     return false;
@@ -1173,55 +1302,55 @@ bool EUTelClusterFilter::isAboveNumberOfHitPixel(EUTelVirtualCluster * cluster)
 
 
 
-bool EUTelClusterFilter::isAboveMinTotalCharge(EUTelVirtualCluster * cluster) const {
+bool EUTelClusterFilter::isAboveMinTotalCharge(const EUTelClusterFeatures & features) const {
 
   if ( !_minTotalChargeSwitch ) {
     return true;
   }
   streamlog_out ( DEBUG1 ) << "Filtering against the total charge " << endl;
 
-  int detectorID  = cluster->getDetectorID();
+  int detectorID  = features.getDetectorID();
   int detectorPos = _ancillaryIndexMap[ detectorID ];
 
-  if ( cluster->getTotalCharge() > _minTotalChargeVec[detectorPos] ) return true;
+  if ( features.getTotalCharge() > _minTotalChargeVec[detectorPos] ) return true;
   else {
-    streamlog_out ( DEBUG2 )  << "Rejected cluster because its charge is " << cluster->getTotalCharge()
+    streamlog_out ( DEBUG2 )  << "Rejected cluster because its charge is " << features.getTotalCharge()
                               << " and the threshold is " << _minTotalChargeVec[detectorPos] << endl;
     _rejectionMap["MinTotalChargeCut"][detectorPos]++;
     return false;
   }
 }
 
-bool EUTelClusterFilter::isAboveMinTotalSNR(EUTelVirtualCluster * cluster) const {
+bool EUTelClusterFilter::isAboveMinTotalSNR(const EUTelClusterFeatures & features) const {
 
   if ( !_noiseRelatedCuts   ) return true;
   if ( !_minTotalSNRSwitch  ) return true;
 
-  int detectorID  = cluster->getDetectorID();
+  int detectorID  = features.getDetectorID();
   int detectorPos = _ancillaryIndexMap [ detectorID ];
 
   streamlog_out ( DEBUG1 ) << "Filtering against the minimum total SNR " << endl;
-  if  ( cluster->getClusterSNR() > _minTotalSNRVec[ detectorPos ] ) return true;
+  if  ( features.getClusterSNR() > _minTotalSNRVec[ detectorPos ] ) return true;
   else {
-    streamlog_out ( DEBUG2 )  << "Rejected cluster because its SNR is " << cluster->getClusterSNR()
+    streamlog_out ( DEBUG2 )  << "Rejected cluster because its SNR is " << features.getClusterSNR()
                               << " and the threshold is " << _minTotalSNRVec[ detectorPos ] << endl;
     _rejectionMap["MinTotalSNRCut"][detectorPos]++;
     return false;
   }
 }
 
-bool EUTelClusterFilter::isAboveNMinCharge(EUTelVirtualCluster * cluster) const {
+bool EUTelClusterFilter::isAboveNMinCharge(const EUTelClusterFeatures & features) const {
 
   if ( !_minNChargeSwitch ) return true;
 
   streamlog_out ( DEBUG1 ) << "Filtering against the N Pixel charge " << endl;
 
-  int detectorID = cluster->getDetectorID();
+  int detectorID = features.getDetectorID();
   int detectorPos = _ancillaryIndexMap [ detectorID ];
   vector<float >::const_iterator iter = _minNChargeVec.begin();
   while ( iter != _minNChargeVec.end() ) {
     int nPixel      = static_cast<int > (*iter);
-    float charge    = cluster->getClusterCharge(nPixel);
+    float charge    = features.getNCharge(nPixel);
     float threshold = (* (iter + detectorPos + 1) );
     if ( charge > threshold ) {
       iter += _noOfDetectors + 1;
@@ -1236,19 +1365,19 @@ bool EUTelClusterFilter::isAboveNMinCharge(EUTelVirtualCluster * cluster) const
 }
 
 
-bool EUTelClusterFilter::isAboveNMinSNR(EUTelVirtualCluster * cluster) const {
+bool EUTelClusterFilter::isAboveNMinSNR(const EUTelClusterFeatures & features) const {
 
   if ( !_noiseRelatedCuts ) return true;
   if ( !_minNSNRSwitch    ) return true;
 
   streamlog_out ( DEBUG1 ) << "Filtering against the N pixel SNR " << endl;
 
-  int detectorID = cluster->getDetectorID();
+  int detectorID = features.getDetectorID();
   int detectorPos = _ancillaryIndexMap [ detectorID ];
   vector<float >::const_iterator iter = _minNSNRVec.begin();
   while ( iter !=  _minNSNRVec.end() ) {
     int nPixel      = static_cast<int > (*iter);
-    float SNR       = cluster->getClusterSNR(nPixel);
+    float SNR       = features.getNSNR(nPixel);
     float threshold = (* (iter + detectorPos + 1 ) );
     if ( SNR > threshold ) {
       iter += _noOfDetectors + 1;
@@ -1265,18 +1394,18 @@ bool EUTelClusterFilter::isAboveNMinSNR(EUTelVirtualCluster * cluster) const {
 
 
 
-bool EUTelClusterFilter::isAboveNxNMinCharge(EUTelVirtualCluster * cluster) const {
+bool EUTelClusterFilter::isAboveNxNMinCharge(const EUTelClusterFeatures & features) const {
 
   if ( !_minNxNChargeSwitch ) return true;
 
   streamlog_out ( DEBUG1 ) << "Filtering against the N x N pixel charge" << endl;
 
-  int detectorID = cluster->getDetectorID();
+  int detectorID = features.getDetectorID();
   int detectorPos = _ancillaryIndexMap [ detectorID ];
   vector<float >::const_iterator iter = _minNxNChargeVec.begin();
   while ( iter != _minNxNChargeVec.end() ) {
     int nxnPixel    = static_cast<int > ( *iter ) ;
-    float charge    = cluster->getClusterCharge(nxnPixel, nxnPixel);
+    float charge    = features.getNxNCharge(nxnPixel);
     float threshold = (* ( iter + detectorPos + 1 )) ;
     if ( ( threshold <= 0) || (charge > threshold) ) {
       iter += _noOfDetectors + 1;
@@ -1291,19 +1420,19 @@ bool EUTelClusterFilter::isAboveNxNMinCharge(EUTelVirtualCluster * cluster) cons
 }
 
 
-bool EUTelClusterFilter::isAboveNxNMinSNR(EUTelVirtualCluster * cluster) const {
+bool EUTelClusterFilter::isAboveNxNMinSNR(const EUTelClusterFeatures & features) const {
 
   if ( !_noiseRelatedCuts  ) return true;
   if ( !_minNxNSNRSwitch   ) return true;
 
   streamlog_out ( DEBUG1 ) << "Filtering against the N x N pixel charge" << endl;
 
-  int detectorID = cluster->getDetectorID();
+  int detectorID = features.getDetectorID();
   int detectorPos = _ancillaryIndexMap [ detectorID ];
   vector<float >::const_iterator iter = _minNxNSNRVec.begin();
   while ( iter != _minNxNSNRVec.end() ) {
     int nxnPixel    = static_cast<int > ( *iter ) ;
-    float snr       = cluster->getClusterSNR(nxnPixel, nxnPixel);
+    float snr       = features.getNxNSNR(nxnPixel);
     float threshold = (* ( iter + detectorPos + 1 )) ;
     if ( ( threshold <= 0) || (snr > threshold) ) {
       iter += _noOfDetectors + 1;
@@ -1318,35 +1447,35 @@ bool EUTelClusterFilter::isAboveNxNMinSNR(EUTelVirtualCluster * cluster) const {
 
 }
 
-bool EUTelClusterFilter::isAboveMinSeedCharge(EUTelVirtualCluster * cluster) const {
+bool EUTelClusterFilter::isAboveMinSeedCharge(const EUTelClusterFeatures & features) const {
 
   if ( !_minSeedChargeSwitch ) return true;
 
   streamlog_out ( DEBUG1 ) << "Filtering against the seed charge " << endl;
 
-  int detectorID = cluster->getDetectorID();
+  int detectorID = features.getDetectorID();
   int detectorPos = _ancillaryIndexMap [ detectorID ];
-  if ( cluster->getSeedCharge() > _minSeedChargeVec[detectorPos] ) return true;
+  if ( features.getSeedCharge() > _minSeedChargeVec[detectorPos] ) return true;
   else {
-    streamlog_out ( DEBUG2 )  << "Rejected cluster because its seed charge is " << cluster->getSeedCharge()
+    streamlog_out ( DEBUG2 )  << "Rejected cluster because its seed charge is " << features.getSeedCharge()
                               << " and the threshold is " <<  _minSeedChargeVec[detectorPos] << endl;
     _rejectionMap["MinSeedChargeCut"][detectorPos]++;
     return false;
   }
 }
 
-bool EUTelClusterFilter::isAboveMinSeedSNR(EUTelVirtualCluster * cluster) const {
+bool EUTelClusterFilter::isAboveMinSeedSNR(const EUTelClusterFeatures & features) const {
 
   if ( !_noiseRelatedCuts  ) return true;
   if ( !_minSeedSNRSwitch  ) return true;
 
   streamlog_out ( DEBUG1 ) << "Filtering against the seed SNR " << endl;
 
-  int detectorID = cluster->getDetectorID();
+  int detectorID = features.getDetectorID();
   int detectorPos = _ancillaryIndexMap [ detectorID ];
-  if ( cluster->getSeedSNR() > _minSeedSNRVec[detectorPos] ) return true;
+  if ( features.getSeedSNR() > _minSeedSNRVec[detectorPos] ) return true;
   else {
-    streamlog_out ( DEBUG2 ) << "Rejected cluster because its seed charge is " << cluster->getSeedSNR()
+    streamlog_out ( DEBUG2 ) << "Rejected cluster because its seed charge is " << features.getSeedSNR()
                              << " and the threshold is " <<  _minSeedSNRVec[detectorPos] << endl;
     _rejectionMap["MinSeedSNRCut"][detectorPos]++;
     return false;
@@ -1355,15 +1484,15 @@ bool EUTelClusterFilter::isAboveMinSeedSNR(EUTelVirtualCluster * cluster) const
 
 
 
-bool EUTelClusterFilter::hasQuality(EUTelVirtualCluster * cluster) const {
+bool EUTelClusterFilter::hasQuality(const EUTelClusterFeatures & features) const {
 
   if ( !_clusterQualitySwitch ) return true;
 
-  int detectorID = cluster->getDetectorID();
+  int detectorID = features.getDetectorID();
   int detectorPos = _ancillaryIndexMap [ detectorID ];
   if ( _clusterQualityVec[detectorID] < 0 ) return true;
 
-  ClusterQuality actual = cluster->getClusterQuality();
+  ClusterQuality actual = features.getClusterQuality();
   ClusterQuality needed = static_cast<ClusterQuality> ( _clusterQualityVec[detectorPos] );
 
   if ( actual == needed ) return true;
@@ -1375,18 +1504,18 @@ bool EUTelClusterFilter::hasQuality(EUTelVirtualCluster * cluster) const {
   }
 }
 
-bool EUTelClusterFilter::isBelowMaxClusterNoise(EUTelVirtualCluster * cluster) const {
+bool EUTelClusterFilter::isBelowMaxClusterNoise(const EUTelClusterFeatures & features) const {
 
   if ( !_noiseRelatedCuts       ) return true;
   if ( !_maxClusterNoiseSwitch  ) return true;
 
   streamlog_out ( DEBUG1 ) << "Filtering against the maximum cluster noise"  << endl;
-  int detectorID = cluster->getDetectorID();
+  int detectorID = features.getDetectorID();
   int detectorPos = _ancillaryIndexMap [ detectorID ];
-  if (  ( cluster->getClusterNoise() < _maxClusterNoiseVec[detectorPos] ) ||
+  if (  ( features.getClusterNoise() < _maxClusterNoiseVec[detectorPos] ) ||
         ( _maxClusterNoiseVec[detectorID] < 0 ) ) return true;
   else {
-    streamlog_out ( DEBUG2 )  << "Rejected cluster because its noise is " << cluster->getClusterNoise()
+    streamlog_out ( DEBUG2 )  << "Rejected cluster because its noise is " << features.getClusterNoise()
                               << " and the threshold is " <<  _maxClusterNoiseVec[detectorPos] << endl;
     _rejectionMap["MaxClusterNoiseCut"][detectorPos]++;
     return false;
@@ -1394,14 +1523,14 @@ bool EUTelClusterFilter::isBelowMaxClusterNoise(EUTelVirtualCluster * cluster) c
 }
 
 
-bool EUTelClusterFilter::isInsideROI(EUTelVirtualCluster * cluster) const {
+bool EUTelClusterFilter::isInsideROI(const EUTelClusterFeatures & features) const {
 
   if ( !_insideROISwitch ) return true;
 
-  int detectorID = cluster->getDetectorID();
+  int detectorID = features.getDetectorID();
   int detectorPos = _ancillaryIndexMap [ detectorID ];
   float x, y;
-  cluster->getCenterOfGravity(x, y);
+  features.getCenterOfGravity(x, y);
 
   bool tempAccepted = true;
   vector<EUTelROI>::const_iterator iter = _insideROIVec.begin();
@@ -1425,14 +1554,14 @@ bool EUTelClusterFilter::isInsideROI(EUTelVirtualCluster * cluster) const {
 
 }
 
-bool EUTelClusterFilter::isOutsideROI(EUTelVirtualCluster * cluster) const {
+bool EUTelClusterFilter::isOutsideROI(const EUTelClusterFeatures & features) const {
 
   if ( !_outsideROISwitch ) return true;
 
-  int detectorID = cluster->getDetectorID();
+  int detectorID = features.getDetectorID();
   int detectorPos = _ancillaryIndexMap [ detectorID ];
   float x, y;
-  cluster->getCenterOfGravity(x, y);
+  features.getCenterOfGravity(x, y);
 
   bool tempAccepted = true;
   vector<EUTelROI>::const_iterator iter = _outsideROIVec.begin();
@@ -29,6 +29,7 @@
 #include "EUTelMatrixDecoder.h"
 #include "EUTelTrackerDataInterfacerImpl.h"
 #include "EUTelSparseClusterImpl.h"
+#include "EUTelBitScan.h"
 
 // marlin includes ".h"
 #include "marlin/Processor.h"
@@ -60,6 +61,7 @@
 #include <cstdio>
 #include <stdio.h>
 #include <iostream>
+#include <cstdint>
 
 using namespace std;
 using namespace lcio;
@@ -2240,18 +2242,8 @@ void EUTelClusteringProcessor::fixedFrameClustering(LCEvent * evt, LCCollectionV
         short clusterCounter = 0;
         short limitExceed    = 0;
 
-        _seedCandidateMap.clear();
-
-        for (unsigned int iPixel = 0; iPixel < nzsData->getChargeValues().size(); iPixel++)
-        {
-            if (status->getADCValues()[iPixel] == EUTELESCOPE::GOODPIXEL)
-            {
-                if ( nzsData->getChargeValues()[iPixel] > _ffSeedCut * noise->getChargeValues()[iPixel])
-                {
-                    _seedCandidateMap.push_back(make_pair( nzsData->getChargeValues()[iPixel], iPixel));
-                }
-            }
-        }
+        // the candidates come sorted from the smallest to the largest seed signal
+        findSeedCandidates(nzsData, noise, status, _seedCandidateMap);
 
         // continue only if seed candidate map is not empty!
         if ( !_seedCandidateMap.empty() ) {
@@ -2259,8 +2251,6 @@ void EUTelClusteringProcessor::fixedFrameClustering(LCEvent * evt, LCCollectionV
             streamlog_out ( DEBUG0 ) << "There are << " << _seedCandidateMap.size() << " seed candidates." << endl;
 
             // now built up a cluster for each seed candidate
-            //Start by sorting the vector in order of smallest to largest seed signal
-            std::sort(_seedCandidateMap.begin(),_seedCandidateMap.end());
             vector< pair< float, unsigned int > >::iterator mapIter = _seedCandidateMap.end();
             while ( mapIter != _seedCandidateMap.begin() ) {
                 --mapIter;
@@ -2494,45 +2484,37 @@ void EUTelClusteringProcessor::nzsBrickedClustering(LCEvent * evt, LCCollectionV
         // reset the status
         resetStatus(status);
 
-        // prepare a multimap for the seed candidates
-        vector< pair <float, int> > seedCandidateMap;
+        // fill the seed candidate map, sorted by increasing signal
+        vector< pair <float, unsigned int> > seedCandidateMap;
+        findSeedCandidates(nzsData, noise, status, seedCandidateMap);
 
-        // fill the seed candidate map
-        for (unsigned int iPixel = 0; iPixel < nzsData->getChargeValues().size(); iPixel++)
+        for ( size_t iCandidate = 0; iCandidate < seedCandidateMap.size(); iCandidate++ )
         {
-            if (status->getADCValues()[iPixel] == EUTELESCOPE::GOODPIXEL)
-            {
-                //! CUT 1
-                if ( nzsData->getChargeValues()[iPixel] > _ffSeedCut * noise->getChargeValues()[iPixel])
-                {
-                    seedCandidateMap.push_back(make_pair( nzsData->getChargeValues()[iPixel], iPixel));
-                    streamlog_out ( MESSAGE2 )
-                        << "Added pixel at (index=" << iPixel
-                        << ") with signal " << nzsData->getChargeValues()[iPixel]
-                        << " to the seedCandidateMap" << endl;
+            unsigned int iPixel = seedCandidateMap[ iCandidate ].second;
+            streamlog_out ( MESSAGE2 )
+                << "Added pixel at (index=" << iPixel
+                << ") with signal " << seedCandidateMap[ iCandidate ].first
+                << " to the seedCandidateMap" << endl;
 
-                    if ( noise->getChargeValues()[ iPixel ] < 0.01 )
-                    {
-                        streamlog_out ( ERROR2 )    << "ZERO NOISE SEED PIXEL ADDED (nszBrickedClustering)!"
-                                                    << "\n index=" << iPixel
-                                                    << "\n amp=" << nzsData->getChargeValues()[ iPixel ]
-                                                    << "\n status=" << status->getADCValues()[ iPixel ]
-                                                    <<    " GOODP   =  0,"
-                                                    <<    " BAD     =  1,"
-                                                    <<    " HIT     = -1,"
-                                                    <<    " MISSING =  2,"
-                                                    <<    " FIRING  =  3.";
-                    }
-                }
+            if ( noise->getChargeValues()[ iPixel ] < 0.01 )
+            {
+                streamlog_out ( ERROR2 )    << "ZERO NOISE SEED PIXEL ADDED (nszBrickedClustering)!"
+                                            << "\n index=" << iPixel
+                                            << "\n amp=" << nzsData->getChargeValues()[ iPixel ]
+                                            << "\n status=" << status->getADCValues()[ iPixel ]
+                                            <<    " GOODP   =  0,"
+                                            <<    " BAD     =  1,"
+                                            <<    " HIT     = -1,"
+                                            <<    " MISSING =  2,"
+                                            <<    " FIRING  =  3.";
             }
         }
 
         streamlog_out ( DEBUG0 ) << "The number of seed candidates is: " << seedCandidateMap.size() << endl;
-        std::sort(seedCandidateMap.begin(),seedCandidateMap.end());
         if ( !seedCandidateMap.empty() )
         {
             // now build up a cluster for each seed candidate
-            vector< pair<float, int> >::iterator rMapIter = seedCandidateMap.end();
+            vector< pair<float, unsigned int> >::iterator rMapIter = seedCandidateMap.end();
             while ( rMapIter != seedCandidateMap.begin() )
             {
                 rMapIter--;
@@ -2829,6 +2811,47 @@ void EUTelClusteringProcessor::resetStatus(IMPL::TrackerRawDataImpl * status) {
     }
 }
 
+void EUTelClusteringProcessor::findSeedCandidates(IMPL::TrackerDataImpl * nzsData, IMPL::TrackerDataImpl * noise,
+                                                  IMPL::TrackerRawDataImpl * status,
+                                                  vector< pair<float, unsigned int> > & seedCandidates) const {
+
+    seedCandidates.clear();
+
+    const FloatVec & signalValues = nzsData->getChargeValues();
+    const FloatVec & noiseValues  = noise->getChargeValues();
+    const ShortVec & statusValues = status->getADCValues();
+    const size_t nPixels = signalValues.size();
+    const float seedCut = _ffSeedCut;
+
+    unsigned char isCandidate[64];
+    for ( size_t blockBegin = 0; blockBegin < nPixels; blockBegin += 64 )
+    {
+        const size_t blockSize = std::min<size_t>( 64, nPixels - blockBegin );
+        const float * signal = &signalValues[ blockBegin ];
+        const float * noiseValue = &noiseValues[ blockBegin ];
+        const short * pixelStatus = &statusValues[ blockBegin ];
+
+        // signal over noise cut and good status, without branches
+        for ( size_t j = 0; j < blockSize; ++j )
+        {
+            isCandidate[ j ] = ( signal[ j ] > seedCut * noiseValue[ j ] ) & ( pixelStatus[ j ] == EUTELESCOPE::GOODPIXEL );
+        }
+
+        uint64_t candidateMask = 0;
+        for ( size_t j = 0; j < blockSize; ++j )
+        {
+            candidateMask |= static_cast<uint64_t>( isCandidate[ j ] ) << j;
+        }
+
+        // visit only the set bits
+        Utility::forEachSetBit( candidateMask, [&]( int bit ) {
+            seedCandidates.push_back( make_pair( signal[ bit ], static_cast<unsigned int>( blockBegin + bit ) ) );
+        } );
+    }
+
+    std::sort( seedCandidates.begin(), seedCandidates.end() );
+}
+
 
 
 
@@ -65,6 +65,8 @@
 #include <iostream>
 #include <iomanip>
 #include <cstdio>
+#include <algorithm>
+#include <limits>
 
 using namespace std;
 using namespace marlin;
@@ -87,7 +89,14 @@ std::string EUTelCorrelator::_hitYCorrShiftProjectionHistoName   = "HitYCorrShif
 
 EUTelCorrelator::EUTelCorrelator () : Processor("EUTelCorrelator"), 
 _histoInfoFileName("histoinfo.xml"),
-_sensorIDVec()
+_sensorIDVec(),
+_clusterX(),
+_clusterY(),
+_clusterCharge(),
+_hitPositions(),
+_candidateX(),
+_candidateY(),
+_candidateBegin()
 {
 
   // modify processor description
@@ -149,6 +158,11 @@ void EUTelCorrelator::init() {
 	_sensorIDtoZ.insert( std::make_pair( *it, static_cast<int>(it - _sensorIDVec.begin())) );
   } 
 
+  _clusterX.assign( _sensorIDVec.size(), std::vector<float>() );
+  _clusterY.assign( _sensorIDVec.size(), std::vector<float>() );
+  _clusterCharge.assign( _sensorIDVec.size(), std::vector<float>() );
+  _hitPositions.assign( _sensorIDVec.size(), std::vector< std::pair<double, double> >() );
+
   // clear the sensor ID map
   _sensorIDVecMap.clear();
   _sensorIDtoZOrderMap.clear();
@@ -298,292 +312,247 @@ void EUTelCorrelator::processEvent (LCEvent * event) {
      }
 
 
-//  try {
-
     if ( _hasClusterCollection && !_hasHitCollection) {
+      decodeClusters( event );
+      fillClusterCorrelations();
+    }
 
-      for( size_t eCol = 0; eCol < _clusterCollectionVec.size() ; eCol++ )
-      {
-         std::string _ExternalInputClusterCollectionName = _clusterCollectionVec[eCol];
+    if ( _hasHitCollection ) {
+      LCCollectionVec* inputHitCollection = static_cast<LCCollectionVec*>( event->getCollection(_inputHitCollectionName) );
+      streamlog_out  ( MESSAGE2 ) << "inputHitCollection " << _inputHitCollectionName.c_str() << endl;
 
-         LCCollectionVec * externalInputClusterCollection   = static_cast<LCCollectionVec*>   (event->getCollection( _ExternalInputClusterCollectionName ));
-         CellIDDecoder<TrackerPulseImpl>  pulseCellDecoder( externalInputClusterCollection );
+      decodeHits( inputHitCollection );
+      fillHitCorrelations();
+    }
 
-      // we have an external detector where we consider a cluster each
-      // time (external cluster) that is correlated with another
-      // detector's clusters (internal cluster)
+#endif
 
-      for ( size_t iExt = 0 ; iExt < externalInputClusterCollection->size() ; ++iExt ) {
+}
 
-        TrackerPulseImpl * externalPulse = static_cast< TrackerPulseImpl * >   ( externalInputClusterCollection->getElementAt( iExt ) );
+void EUTelCorrelator::decodeClusters(LCEvent * event) {
 
-        EUTelVirtualCluster  * externalCluster;
+  for( size_t iz = 0; iz < _clusterX.size(); iz++ ) {
+    _clusterX[iz].clear();
+    _clusterY[iz].clear();
+    _clusterCharge[iz].clear();
+  }
 
-        ClusterType type = static_cast<ClusterType>  (static_cast<int>((pulseCellDecoder(externalPulse)["type"])));
+  for( size_t iCol = 0; iCol < _clusterCollectionVec.size() ; iCol++ )
+  {
+    LCCollectionVec * inputClusterCollection = static_cast<LCCollectionVec*> (event->getCollection( _clusterCollectionVec[iCol] ));
+    CellIDDecoder<TrackerPulseImpl>  pulseCellDecoder( inputClusterCollection );
 
-        // we check that the type of cluster is ok
-        
-        if ( type == kEUTelDFFClusterImpl ) 
-        {
-          externalCluster = new EUTelDFFClusterImpl( static_cast<TrackerDataImpl*>     ( externalPulse->getTrackerData()) );
-        }
-        else if ( type == kEUTelBrickedClusterImpl ) 
-        {
-          externalCluster = new EUTelBrickedClusterImpl( static_cast<TrackerDataImpl*> ( externalPulse->getTrackerData()) );
-        }
-        else if ( type == kEUTelFFClusterImpl ) 
-        {
-          externalCluster = new EUTelFFClusterImpl( static_cast<TrackerDataImpl*>      ( externalPulse->getTrackerData()) );
-            
-        }
-        else if ( type == kEUTelSparseClusterImpl ) 
-        {
-           externalCluster = new EUTelSparseClusterImpl< EUTelGenericSparsePixel > ( static_cast<TrackerDataImpl *> ( externalPulse->getTrackerData()  ) );
-
-           if( externalCluster != 0 && externalCluster->getTotalCharge() < _clusterChargeMin ) 
-           {
-              delete externalCluster; 
-              continue;
-           }
-        }
-	else  continue;
+    for ( size_t iClu = 0 ; iClu < inputClusterCollection->size() ; ++iClu ) 
+    {
+      TrackerPulseImpl * pulse = static_cast< TrackerPulseImpl * > ( inputClusterCollection->getElementAt( iClu ) );
+      TrackerDataImpl * data = static_cast<TrackerDataImpl*> ( pulse->getTrackerData() );
 
-        int externalSensorID = pulseCellDecoder( externalPulse ) [ "sensorID" ] ;
- 
-        streamlog_out ( DEBUG1 ) << "externalSensorID : " << externalSensorID << " externalCluster=" << externalCluster << std::endl;
+      ClusterType type = static_cast<ClusterType> (static_cast<int>((pulseCellDecoder(pulse)["type"])));
+      int sensorID = pulseCellDecoder( pulse ) [ "sensorID" ] ;
 
-        float externalXCenter = 0.;
-        float externalYCenter = 0.;
+      std::map<int, int>::const_iterator zIt = _sensorIDtoZ.find( sensorID );
+      if( zIt == _sensorIDtoZ.end() ) continue;
 
-        // we catch the coordinates of the external seed
+      float xCenter = 0.;
+      float yCenter = 0.;
+      float charge  = 0.;
 
-        externalCluster->getCenterOfGravity( externalXCenter, externalYCenter ) ;
-        if( externalCluster->getTotalCharge() <= _clusterChargeMin ) 
-        {
-            delete externalCluster; 
-            continue;
+      if ( type == kEUTelSparseClusterImpl ) 
+      {
+        // read the EUTelGenericSparsePixel (x, y, signal, time) directly
+        // instead of building an EUTelSparseClusterImpl for it
+        FloatVec const & values = data->getChargeValues();
+        float xPos = 0., yPos = 0.;
+        for( size_t i = 0; i + 3 < values.size(); i += 4 ) {
+          xPos   += values[i]   * values[i+2];
+          yPos   += values[i+1] * values[i+2];
+          charge += values[i+2];
         }
+        xCenter = xPos / charge;
+        yCenter = yPos / charge;
+      }
+      else if ( type == kEUTelDFFClusterImpl ) 
+      {
+        EUTelDFFClusterImpl cluster( data );
+        cluster.getCenterOfGravity( xCenter, yCenter );
+        charge = cluster.getTotalCharge();
+      }
+      else if ( type == kEUTelBrickedClusterImpl ) 
+      {
+        EUTelBrickedClusterImpl cluster( data );
+        cluster.getCenterOfGravity( xCenter, yCenter );
+        charge = cluster.getTotalCharge();
+      }
+      else if ( type == kEUTelFFClusterImpl ) 
+      {
+        EUTelFFClusterImpl cluster( data );
+        cluster.getCenterOfGravity( xCenter, yCenter );
+        charge = cluster.getTotalCharge();
+      }
+      else continue;
 
-        for( size_t iCol = 0; iCol < _clusterCollectionVec.size() ; iCol++ )
-        {
-          std::string _InternalInputClusterCollectionName = _clusterCollectionVec[iCol];
-
-          LCCollectionVec * internalInputClusterCollection   = static_cast<LCCollectionVec*>   (event->getCollection( _InternalInputClusterCollectionName ));
-          CellIDDecoder<TrackerPulseImpl>  pulseCellDecoder( internalInputClusterCollection );
-
-
-        for ( size_t iInt = 0;  iInt <  internalInputClusterCollection->size() ; ++iInt ) 
-        {
-
-          TrackerPulseImpl * internalPulse = static_cast< TrackerPulseImpl * >  ( internalInputClusterCollection->getElementAt( iInt ) );
-
-          EUTelVirtualCluster  * internalCluster;
-
-          ClusterType type = static_cast<ClusterType>  (static_cast<int>((pulseCellDecoder(internalPulse)["type"])));
-
-          // we check that the type of cluster is ok
-          if ( type == kEUTelDFFClusterImpl ) {
-            internalCluster = new EUTelDFFClusterImpl( static_cast<TrackerDataImpl*>
-                                                       (internalPulse->getTrackerData()) );
-
-          } else if ( type == kEUTelBrickedClusterImpl ) {
-            internalCluster = new EUTelBrickedClusterImpl( static_cast<TrackerDataImpl*>
-                                                       (internalPulse->getTrackerData()) );
-
-          } else if ( type == kEUTelFFClusterImpl ) {
-            internalCluster = new EUTelFFClusterImpl( static_cast<TrackerDataImpl*>
-                                                      (internalPulse->getTrackerData()) );
-
-          } else if ( type == kEUTelSparseClusterImpl ) {
-
-            internalCluster = new EUTelSparseClusterImpl< EUTelGenericSparsePixel > ( static_cast<TrackerDataImpl *> ( internalPulse->getTrackerData()  ) );
-
-            if( internalCluster != 0 && internalCluster->getTotalCharge() < _clusterChargeMin )
-            {
-                delete internalCluster;
-                continue;
-            }
- 
-          }
-	   else  continue;
+      // clusters below the cut can neither be external nor internal ones
+      if( charge < _clusterChargeMin ) continue;
 
-          if( internalCluster->getTotalCharge() < _clusterChargeMin )
-          {
-             delete internalCluster;
-             continue;
-          }
-          
+      _clusterX[ zIt->second ].push_back( xCenter );
+      _clusterY[ zIt->second ].push_back( yCenter );
+      _clusterCharge[ zIt->second ].push_back( charge );
+    }
+  }
+}
 
-          int internalSensorID = pulseCellDecoder( internalPulse ) [ "sensorID" ] ;
+void EUTelCorrelator::decodeHits(LCCollectionVec * inputHitCollection) {
 
+  for( size_t iz = 0; iz < _hitPositions.size(); iz++ ) _hitPositions[iz].clear();
 
-          if ( ( internalSensorID != getFixedPlaneID() && externalSensorID == getFixedPlaneID() )
-                  ||
-                  (  _sensorIDtoZ.at(internalSensorID) == _sensorIDtoZ.at(externalSensorID) + 1 )
-                  ) 
-          {
+  UTIL::CellIDDecoder<TrackerHitImpl> hitDecoder ( EUTELESCOPE::HITENCODING );
 
-              float internalXCenter = 0. ;
-              float internalYCenter = 0. ;
+  for ( size_t iHit = 0 ; iHit < inputHitCollection->size(); ++iHit ) {
 
-            // we catch the coordinates of the internal seed
+    TrackerHitImpl* hit = static_cast<TrackerHitImpl*>( inputHitCollection->getElementAt(iHit) );
+    const double* position = hit->getPosition();
+    int sensorID = hitDecoder( hit )["sensorID"]; 
 
-            internalCluster->getCenterOfGravity( internalXCenter, internalYCenter ) ;
+    std::map<int, int>::const_iterator zIt = _sensorIDtoZ.find( sensorID );
+    if( zIt == _sensorIDtoZ.end() ) continue;
 
-            streamlog_out ( DEBUG5 ) << "Filling histo " << externalSensorID << " " << internalSensorID << endl;
+    double trackPointLocal[]  = { position[0], position[1], position[2] };
+    double trackPointGlobal[] = { position[0], position[1], position[2] };
 
+    if ( hitDecoder( hit )["properties"] != kHitInGlobalCoord ) {
+      geo::gGeometry().local2Master( sensorID, trackPointLocal, trackPointGlobal );
+    } else {
+      // do nothing, already in global telescope frame 
+    }
 
-            // we input the coordinates in the correlation matrix, one
-            // for each type of coordinate: X and Y
+    streamlog_out  ( MESSAGE2 ) << "plane:"  << sensorID << " loc: "  << trackPointLocal[0]  << " "<< trackPointLocal[1]  << " "
+                                << " glo: "  << trackPointGlobal[0] << " "<< trackPointGlobal[1] << " " << endl;
 
-            
-            streamlog_out( MESSAGE1 )  << " ex " << externalSensorID <<" = [" << externalXCenter << ":" << externalYCenter << "]"
-                                       << " in " << internalSensorID <<" = [" << internalXCenter << ":" << internalYCenter << "]" << std::endl;
+    _hitPositions[ zIt->second ].push_back( std::make_pair( trackPointGlobal[0], trackPointGlobal[1] ) );
+  }
 
-            _clusterXCorrelationMatrix[ externalSensorID ][ internalSensorID ]->fill( externalXCenter, internalXCenter );
-            _clusterYCorrelationMatrix[ externalSensorID ][ internalSensorID ]->fill( externalYCenter, internalYCenter );
+  // sorted along x, the residual cut becomes a window search
+  for( size_t iz = 0; iz < _hitPositions.size(); iz++ ) {
+    std::sort( _hitPositions[iz].begin(), _hitPositions[iz].end() );
+  }
+}
 
-          } // endif
+#if defined(USE_AIDA) || defined(MARLIN_USE_AIDA)
+void EUTelCorrelator::fillClusterCorrelations() {
 
-          delete internalCluster;
+  for( size_t ez = 0; ez < _sensorIDVec.size(); ez++ )
+  {
+    int externalSensorID = _sensorIDVec[ez];
+    if( _clusterX[ez].empty() ) continue;
 
-        } // internal loop
-        } // internal loop of collections 
+    for( size_t iz = 0; iz < _sensorIDVec.size(); iz++ )
+    {
+      int internalSensorID = _sensorIDVec[iz];
 
-        delete externalCluster; 
-      } // external loop
-      } // external loop of collections
+      if ( !( ( internalSensorID != getFixedPlaneID() && externalSensorID == getFixedPlaneID() ) || iz == ez + 1 ) ) continue;
+      if( _clusterX[iz].empty() ) continue;
 
-    } // endif hasCluster
+      streamlog_out ( DEBUG5 ) << "Filling histo " << externalSensorID << " " << internalSensorID << endl;
 
-    if ( _hasHitCollection ) {
+      // look the histograms up once per sensor pair
+      AIDA::IHistogram2D * histoX = _clusterXCorrelationMatrix[ externalSensorID ][ internalSensorID ];
+      AIDA::IHistogram2D * histoY = _clusterYCorrelationMatrix[ externalSensorID ][ internalSensorID ];
 
+      for( size_t iExt = 0; iExt < _clusterX[ez].size(); iExt++ )
+      {
+        // external clusters have to be strictly above the charge cut
+        if( _clusterCharge[ez][iExt] <= _clusterChargeMin ) continue;
 
-      LCCollectionVec* inputHitCollection = static_cast<LCCollectionVec*>( event->getCollection(_inputHitCollectionName) );
-      UTIL::CellIDDecoder<TrackerHitImpl> hitDecoder ( EUTELESCOPE::HITENCODING );
+        float externalXCenter = _clusterX[ez][iExt];
+        float externalYCenter = _clusterY[ez][iExt];
 
-      streamlog_out  ( MESSAGE2 ) << "inputHitCollection " << _inputHitCollectionName.c_str() << endl;
+        for( size_t iInt = 0; iInt < _clusterX[iz].size(); iInt++ )
+        {
+          histoX->fill( externalXCenter, _clusterX[iz][iInt] );
+          histoY->fill( externalYCenter, _clusterY[iz][iInt] );
+        }
+      }
+    }
+  }
+}
 
+void EUTelCorrelator::fillHitCorrelations() {
 
-      for ( size_t iExt = 0 ; iExt < inputHitCollection->size(); ++iExt ) {
-        std::vector<double> trackX;
-        std::vector<double> trackY;
-        std::vector<int  > iplane;
+  size_t const nPlanes = _sensorIDVec.size();
 
-        trackX.clear();
-        trackY.clear();
-        iplane.clear();
+  for( size_t ez = 0; ez < nPlanes; ez++ )
+  {
+    int externalSensorID = _sensorIDVec[ez];
 
-        // this is the external hit
+    for( size_t iExt = 0; iExt < _hitPositions[ez].size(); iExt++ )
+    {
+      double externalX = _hitPositions[ez][iExt].first;
+      double externalY = _hitPositions[ez][iExt].second;
 
-        TrackerHitImpl* externalHit = static_cast<TrackerHitImpl*>( inputHitCollection->getElementAt(iExt) );
-        
-	double* externalPosition = const_cast<double*>( externalHit->getPosition() );
+      _candidateX.clear();
+      _candidateY.clear();
+      _candidateBegin.clear();
 
-        int externalSensorID = hitDecoder( externalHit )["sensorID"]; 
+      for( size_t iz = 0; iz < nPlanes; iz++ )
+      {
+        _candidateBegin.push_back( _candidateX.size() );
 
-        double etrackPointLocal[]  = { externalPosition[0], externalPosition[1], externalPosition[2] };
-        double etrackPointGlobal[] = { externalPosition[0], externalPosition[1], externalPosition[2] };
+        int internalSensorID = _sensorIDVec[iz];
+        if ( !( ( internalSensorID != getFixedPlaneID() && externalSensorID == getFixedPlaneID() ) || iz == ez + 1 ) ) continue;
 
-        if ( hitDecoder( externalHit) ["properties"] != kHitInGlobalCoord ) {
-           geo::gGeometry().local2Master( externalSensorID, etrackPointLocal, etrackPointGlobal );
-        } else {
-           // do nothing, already in global telescope frame 
-        }
- 
-          
- 
-        trackX.push_back( etrackPointGlobal[0]);
-        trackY.push_back( etrackPointGlobal[1]);
+        std::vector< std::pair<double, double> > const & hits = _hitPositions[iz];
 
-        iplane.push_back( externalSensorID);
+        // only hits with externalX - x inside the residual band can pass
+        double xLow  = externalX - _residualsXMax[iz];
+        double xHigh = externalX - _residualsXMin[iz];
 
-        streamlog_out  ( MESSAGE2 ) << "eplane:"  << externalSensorID << " loc: "  << etrackPointLocal[0]  << " "<< etrackPointLocal[1]  << " "
-                                                                      << " glo: "  << etrackPointGlobal[0] << " "<< etrackPointGlobal[1] << " " << endl;
+        std::vector< std::pair<double, double> >::const_iterator hitIt =
+          std::lower_bound( hits.begin(), hits.end(), std::make_pair( xLow, -std::numeric_limits<double>::max() ) );
 
-        for ( size_t iInt = 0; iInt < inputHitCollection->size(); ++iInt ) 
+        for( ; hitIt != hits.end() && hitIt->first < xHigh; ++hitIt )
         {
+          double residualX = externalX - hitIt->first;
+          double residualY = externalY - hitIt->second;
 
-
-          TrackerHitImpl* internalHit = static_cast<TrackerHitImpl*>( inputHitCollection->getElementAt(iInt) );
-
-          double* internalPosition = const_cast<double*>( internalHit->getPosition() );
-
-          int internalSensorID = hitDecoder( internalHit )["sensorID"]; 
-
-          double itrackPointLocal[]  = { internalPosition[0], internalPosition[1], internalPosition[2] };
-          double itrackPointGlobal[] = { internalPosition[0], internalPosition[1], internalPosition[2] };
-
-          if ( hitDecoder( internalHit )["properties"] != kHitInGlobalCoord ) {
-             geo::gGeometry().local2Master( internalSensorID, itrackPointLocal, itrackPointGlobal );
-          } else {
-             // do nothing, already in global telescope frame 
+          if( ( residualX < _residualsXMax[iz] ) && ( _residualsXMin[iz] < residualX )
+              &&
+              ( residualY < _residualsYMax[iz] ) && ( _residualsYMin[iz] < residualY ) )
+          {
+            _candidateX.push_back( hitIt->first );
+            _candidateY.push_back( hitIt->second );
           }
+        }
+      }
+      _candidateBegin.push_back( _candidateX.size() );
 
-          if ( 
-                  ( internalSensorID != getFixedPlaneID() && externalSensorID == getFixedPlaneID() )
-                   ||
-                  (  _sensorIDtoZ.at(internalSensorID) == _sensorIDtoZ.at(externalSensorID) + 1 )
-              ) 
-            {
-
-            int iz = _sensorIDtoZ.at( internalSensorID ) ;
-
-            if(
-               ((etrackPointGlobal[0]-itrackPointGlobal[0] ) < _residualsXMax[iz]) && (_residualsXMin[iz] < (etrackPointGlobal[0]-itrackPointGlobal[0] ))   
-               &&
-               ((etrackPointGlobal[1]-itrackPointGlobal[1] ) < _residualsYMax[iz]) && (_residualsYMin[iz] < (etrackPointGlobal[1]-itrackPointGlobal[1] ))
-              )
-               {
-
-        trackX.push_back(itrackPointGlobal[0]);
-        trackY.push_back(itrackPointGlobal[1]);
-        iplane.push_back(internalSensorID);
+      // the external hit counts as one of the correlated hits
+      if( static_cast< int >( _candidateX.size() + 1 ) <= _minNumberOfCorrelatedHits ) continue;
 
-        streamlog_out  ( MESSAGE2 ) << "iplane:"  << internalSensorID << " loc: "  << itrackPointLocal[0]  << " "<< itrackPointLocal[1]  << " "
-                                                                      << " glo: "  << itrackPointGlobal[0] << " "<< itrackPointGlobal[1] << " " << endl;
+      for( size_t iz = 0; iz < nPlanes; iz++ )
+      {
+        if( _candidateBegin[iz] == _candidateBegin[iz+1] ) continue;
 
-               }
-            }
+        int internalSensorID = _sensorIDVec[iz];
 
-        }
+        // look the histograms up once per sensor pair
+        AIDA::IHistogram2D * histoX      = _hitXCorrelationMatrix[ externalSensorID ][ internalSensorID ];
+        AIDA::IHistogram2D * histoY      = _hitYCorrelationMatrix[ externalSensorID ][ internalSensorID ];
+        AIDA::IHistogram2D * histoShiftX = _hitXCorrShiftMatrix[ externalSensorID ][ internalSensorID ];
+        AIDA::IHistogram2D * histoShiftY = _hitYCorrShiftMatrix[ externalSensorID ][ internalSensorID ];
 
-        vector<int>  iplane_unique = iplane;
-        vector<int>::iterator p, p_end;
- 
-        p_end = unique( iplane_unique.begin(), iplane_unique.end());       // remove duplicates
-  
-        if( static_cast< int >(iplane_unique.size()) > _minNumberOfCorrelatedHits && trackX.size() == trackY.size())
+        for( size_t i = _candidateBegin[iz]; i < _candidateBegin[iz+1]; i++ )
         {
-          int indexPlane = 0;
- 
-          indexPlane = 0; // should be always the first element, as it's filled in the externalID loop
- 
-          if( indexPlane >= 0 ) {
-            for(int i = 0; i < (int)trackX.size();i++)
-            {
-              if( i == indexPlane ) continue; // skip as this one is not booked
-              _hitXCorrelationMatrix[ iplane[ indexPlane ]        ] [ iplane[i]        ] -> fill ( trackX[ indexPlane ]          , trackX[i]           ) ;
-              _hitYCorrelationMatrix[ iplane[ indexPlane ]        ] [ iplane[i]        ] -> fill ( trackY[ indexPlane ]          , trackY[i]           ) ;
-              // assume all rotations have been done in the hitmaker processor:
-              _hitXCorrShiftMatrix[ iplane[ indexPlane ]        ][ iplane[i]        ]->fill( trackX[ indexPlane ]          , trackX[ indexPlane ]          - trackX[i]          );
-              _hitYCorrShiftMatrix[ iplane[ indexPlane ]        ][ iplane[i]        ]->fill( trackY[ indexPlane ]          , trackY[ indexPlane ]          - trackY[i]         );
-            }
-          }
-        }else{
+          histoX->fill( externalX, _candidateX[i] );
+          histoY->fill( externalY, _candidateY[i] );
+          // assume all rotations have been done in the hitmaker processor:
+          histoShiftX->fill( externalX, externalX - _candidateX[i] );
+          histoShiftY->fill( externalY, externalY - _candidateY[i] );
         }
- 
       }
     }
-//  } catch (DataNotAvailableException& e  ) {
-//
-//    streamlog_out  ( MESSAGE2 ) <<  "No input collection found on event " << event->getEventNumber()
-//                                << " in run " << event->getRunNumber() << endl;
-//  }
-
-#endif
-
+  }
 }
+#endif
 
 void EUTelCorrelator::end() {
 
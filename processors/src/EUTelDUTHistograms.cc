@@ -116,6 +116,10 @@ EUTelDUTHistograms::EUTelDUTHistograms()
   _measuredY(),
   _bgmeasuredX(),
   _bgmeasuredY(),
+  _measuredGrid(),
+  _measuredUsed(),
+  _candidates(),
+  _candidateDist2(),
   _localX(),
   _localY(),
   _fittedX(),
@@ -384,12 +388,25 @@ void EUTelDUTHistograms::processEvent( LCEvent * event ) {
   int nMatch=0;
   double distmin;
 
+  // Bucket the DUT hits so that each fitted position is only compared
+  // to the hits within the residual window. Matched hits are flagged
+  // by their index in the event; below they are still erased from
+  // _measuredX/Y, so the index into these is the event index minus
+  // the number of matched hits in front of it.
+
+  _measuredGrid.clear();
+  for(int ihit=0; ihit< static_cast<int>(_measuredX.size()) ; ihit++)
+    _measuredGrid.add(_measuredX[ihit], _measuredY[ihit], ihit);
+  _measuredGrid.build(_distMax);
+  _measuredUsed.assign(_measuredX.size(), 0);
+
   for(int itrack=0; itrack< _maptrackid; itrack++)
   {
     int bestfit=-1;
     int besthit=-1;
 
-    distmin = _distMax*_distMax + 10. ;
+    // only pairs closer than _distMax are accepted as a match
+    distmin = _distMax*_distMax ;
  
     if( static_cast<int>(_fittedX[itrack].size()) < 1 ) continue;
  
@@ -397,31 +414,56 @@ void EUTelDUTHistograms::processEvent( LCEvent * event ) {
     {
       if( _measuredX.empty() ) continue;
 
-      for(int ihit=0; ihit< static_cast<int>(_measuredX.size()) ; ihit++)
+      const double fitX = _fittedX[itrack][ifit];
+      const double fitY = _fittedY[itrack][ifit];
+
+      // candidates in increasing order, as the hits were scanned before
+      _measuredGrid.query(fitX, fitY, _distMax, _candidates);
+      int nCandidates = 0;
+      for(size_t icand=0; icand< _candidates.size(); icand++)
+        if( !_measuredUsed[ _candidates[icand] ] ) _candidates[nCandidates++] = _candidates[icand];
+
+      _candidateDist2.resize(nCandidates);
+      const int * cand = nCandidates > 0 ? &_candidates[0] : 0;
+      double * dist2 = nCandidates > 0 ? &_candidateDist2[0] : 0;
+      // _bgmeasuredX/Y keep all the hits of the event, in event order
+      const double * hitX = &_bgmeasuredX[0];
+      const double * hitY = &_bgmeasuredY[0];
+      for(int icand=0; icand< nCandidates; icand++)
         {
+          const double dx = hitX[ cand[icand] ] - fitX;
+          const double dy = hitY[ cand[icand] ] - fitY;
+          dist2[icand] = dx*dx + dy*dy;
+        }
 
-          double dist2rd=
-            (_measuredX[ihit]-_fittedX[itrack][ifit])*(_measuredX[ihit]-_fittedX[itrack][ifit])
-            + (_measuredY[ihit]-_fittedY[itrack][ifit])*(_measuredY[ihit]-_fittedY[itrack][ifit]);
-
+      for(int icand=0; icand< nCandidates; icand++)
+        {
 	  if(streamlog_level(DEBUG5)){
-	    message<DEBUG5> ( log() << "Fit ["<< itrack << ":" << _maptrackid <<"], ifit= " << ifit << " ["<< _fittedX[itrack][ifit] << ":" << _fittedY[itrack][ifit] << "]" << endl) ;
-	    message<DEBUG5> ( log() << "rec " << ihit << " ["<< _measuredX[ihit] << ":" << _measuredY[ihit] << "]" << endl) ;
-	    message<DEBUG5> ( log() << "distance : " << TMath::Sqrt( dist2rd )  << endl) ;
+	    message<DEBUG5> ( log() << "Fit ["<< itrack << ":" << _maptrackid <<"], ifit= " << ifit << " ["<< fitX << ":" << fitY << "]" << endl) ;
+	    message<DEBUG5> ( log() << "rec " << cand[icand] << " ["<< hitX[ cand[icand] ] << ":" << hitY[ cand[icand] ] << "]" << endl) ;
+	    message<DEBUG5> ( log() << "distance : " << TMath::Sqrt( dist2[icand] )  << endl) ;
 	  }
-          if(dist2rd<distmin)
+          if(dist2[icand]<distmin)
             {
-              distmin = dist2rd;
-              besthit = ihit;
+              distmin = dist2[icand];
+              besthit = cand[icand];
               bestfit = ifit;
             }
         }
  
     }
+
+    if( besthit >= 0 )
+      {
+        _measuredUsed[besthit] = 1;
+        int nUsedBefore = 0;
+        for(int ihit=0; ihit< besthit; ihit++) nUsedBefore += _measuredUsed[ihit];
+        besthit -= nUsedBefore;
+      }
  
     // Match found:
 
-    if( distmin < _distMax*_distMax  )
+    if( besthit >= 0 )
       {
 
         nMatch++;
@@ -1729,6 +1771,9 @@ int EUTelDUTHistograms::getClusterSize(int sensorID, TrackerHit * hit, int& size
     return -1;
   }
 
+  // hits without cluster, e.g. read from a hit cache
+  if( hit->getRawHits().empty() ) return -1;
+
         try
         {
             TrackerDataImpl* clusterVector = static_cast<TrackerDataImpl*>( hit->getRawHits()[0]);
@@ -13,6 +13,7 @@
 #include "EUTelEventImpl.h"
 #include "EUTelRunHeaderImpl.h"
 #include "EUTelVirtualCluster.h"
+#include "EUTelClusterFeatures.h"
 #include "EUTelFFClusterImpl.h"
 #include "EUTelDFFClusterImpl.h"
 #include "EUTelBrickedClusterImpl.h"
@@ -246,6 +247,13 @@ void EUTelHistogramMaker::processEvent (LCEvent * evt) {
     LCCollectionVec * pulseCollectionVec = dynamic_cast<LCCollectionVec*>  (evt->getCollection(_pulseCollectionName));
     CellIDDecoder<TrackerPulseImpl> cellDecoder(pulseCollectionVec);
 
+    // the cluster quantities histogrammed here, taken from the record
+    // attached by the cluster filter when available
+    EUTelClusterFeatureRequest featureRequest;
+    featureRequest.nCharge   = _clusterSpectraNVector;
+    featureRequest.nxnCharge = _clusterSpectraNxNVector;
+    EUTelClusterFeatures localFeatures;
+
     // prepare and reset the hit counter
     map<int, int> eventCounterMap;
     for ( int iPulse = 0; iPulse < pulseCollectionVec->getNumberOfElements(); iPulse++ ) {
@@ -287,32 +295,38 @@ void EUTelHistogramMaker::processEvent (LCEvent * evt) {
 
       }
 
+      const EUTelClusterFeatures * features = EUTelClusterFeatures::get( pulse );
+      if ( !features || !features->covers( featureRequest ) ) {
+        localFeatures.compute( *cluster, featureRequest );
+        features = &localFeatures;
+      }
+
       int detectorID = cluster->getDetectorID();
       // increment of one unit the event counter for this plane
       eventCounterMap[detectorID]++;
 
       string tempHistoName = _clusterSignalHistoName + "_d" + to_string( detectorID );
-      (dynamic_cast<AIDA::IHistogram1D*> (_aidaHistoMap[tempHistoName]))->fill(cluster->getTotalCharge());
+      (dynamic_cast<AIDA::IHistogram1D*> (_aidaHistoMap[tempHistoName]))->fill(features->getTotalCharge());
 
       if(type == kEUTelDFFClusterImpl ) {
         tempHistoName = _clusterNumberOfHitPixelName + "_d" + to_string( detectorID );
-        (dynamic_cast<AIDA::IHistogram1D*> (_aidaHistoMap[tempHistoName]))->fill(cluster->getTotalCharge());
+        (dynamic_cast<AIDA::IHistogram1D*> (_aidaHistoMap[tempHistoName]))->fill(features->getTotalCharge());
       }
 
       tempHistoName = _seedSignalHistoName + "_d" + to_string( detectorID );
-      (dynamic_cast<AIDA::IHistogram1D*> (_aidaHistoMap[tempHistoName]))->fill(cluster->getSeedCharge());
+      (dynamic_cast<AIDA::IHistogram1D*> (_aidaHistoMap[tempHistoName]))->fill(features->getSeedCharge());
 
       vector<int >::iterator iter = _clusterSpectraNVector.begin();
       while ( iter != _clusterSpectraNVector.end() ) {
         tempHistoName = _clusterSignalHistoName + to_string( *iter ) + "_d" + to_string( detectorID ) ;
-        (dynamic_cast<AIDA::IHistogram1D*> (_aidaHistoMap[tempHistoName]))->fill(cluster->getClusterCharge((*iter)));
+        (dynamic_cast<AIDA::IHistogram1D*> (_aidaHistoMap[tempHistoName]))->fill(features->getNCharge((*iter)));
         ++iter;
       }
 
       iter = _clusterSpectraNxNVector.begin();
       while ( iter != _clusterSpectraNxNVector.end() ) {
         tempHistoName = _clusterSignalHistoName + to_string(*iter) + "x" + to_string(*iter) + "_d" + to_string(detectorID);
-        (dynamic_cast<AIDA::IHistogram1D*> (_aidaHistoMap[tempHistoName]))->fill(cluster->getClusterCharge((*iter), (*iter)));
+        (dynamic_cast<AIDA::IHistogram1D*> (_aidaHistoMap[tempHistoName]))->fill(features->getNxNCharge((*iter)));
         ++iter;
       }
 
@@ -21,6 +21,7 @@
 #include "EUTelFFClusterImpl.h"
 #include "EUTelSparseClusterImpl.h"
 #include "EUTelExceptions.h"
+#include "EUTelLineFitBatch.h"
 
 // marlin includes ".h"
 #include "marlin/Processor.h"
@@ -189,6 +190,8 @@ void EUTelLineFit::init() {
   _intrResolX = new double[_nPlanes];
   _intrResolY = new double[_nPlanes];
 
+  _batchFitter.reset(_nPlanes);
+
 }
 
 void EUTelLineFit::processRunHeader (LCRunHeader * rdr) {
@@ -363,100 +366,29 @@ void EUTelLineFit::processEvent (LCEvent * event) {
       }
     }
 
-    // ++++++++++++++++++++++++++++++++++++++++++++++++++++++
-    // ++++++++++++ See Blobel Page 226 !!! +++++++++++++++++
-    // ++++++++++++++++++++++++++++++++++++++++++++++++++++++
-
-    int counter;
-
-    float S1[2]   = {0,0};
-    float Sx[2]   = {0,0};
-    float Xbar[2] = {0,0};
+    // Straight line fit in XZ and YZ, done by the batch fitter.
+    // The event contains a single track candidate, with one hit per
+    // plane.
 
-    float * Zbar_X = new float[_nPlanes];
-    float * Zbar_Y = new float[_nPlanes];
-    for (counter = 0; counter < _nPlanes; counter++){
-      Zbar_X[counter] = 0.;
-      Zbar_Y[counter] = 0.;
-    }
+    _batchFitter.clear();
+    _batchFitter.addTrack(_xPos, _yPos, _zPos, _intrResolX, _intrResolY);
+    _batchFitter.fit();
 
-    float Sy[2]     = {0,0};
-    float Ybar[2]   = {0,0};
-    float Sxybar[2] = {0,0};
-    float Sxxbar[2] = {0,0};
-    float A2[2]     = {0,0};
     float Chiquare[2] = {0,0};
     float angle[2] = {0,0};
 
-    // define S1
-    for( counter = 0; counter < _nPlanes; counter++ ){
-      S1[0] = S1[0] + 1/pow(_intrResolX[counter],2);
-      S1[1] = S1[1] + 1/pow(_intrResolY[counter],2);
-    }
-
-    // define Sx
-    for( counter = 0; counter < _nPlanes; counter++ ){
-      Sx[0] = Sx[0] + _zPos[counter]/pow(_intrResolX[counter],2);
-      Sx[1] = Sx[1] + _zPos[counter]/pow(_intrResolY[counter],2);
-    }
-
-    // define Xbar
-    Xbar[0]=Sx[0]/S1[0];
-    Xbar[1]=Sx[1]/S1[1];
-
-    // coordinate transformation !! -> bar
-    for( counter=0; counter < _nPlanes; counter++ ){
-      Zbar_X[counter] = _zPos[counter]-Xbar[0];
-      Zbar_Y[counter] = _zPos[counter]-Xbar[1];
-    }
-
-    // define Sy
-    for( counter = 0; counter < _nPlanes; counter++ ){
-      Sy[0] = Sy[0] + _xPos[counter]/pow(_intrResolX[counter],2);
-      Sy[1] = Sy[1] + _yPos[counter]/pow(_intrResolY[counter],2);
-    }
-
-    // define Ybar
-    Ybar[0]=Sy[0]/S1[0];
-    Ybar[1]=Sy[1]/S1[1];
-
-    // define Sxybar
-    for( counter = 0; counter < _nPlanes; counter++ ){
-      Sxybar[0] = Sxybar[0] + Zbar_X[counter] * _xPos[counter]/pow(_intrResolX[counter],2);
-      Sxybar[1] = Sxybar[1] + Zbar_Y[counter] * _yPos[counter]/pow(_intrResolY[counter],2);
-    }
-
-    // define Sxxbar
-    for( counter = 0; counter < _nPlanes; counter++ ){
-      Sxxbar[0] = Sxxbar[0] + Zbar_X[counter] * Zbar_X[counter]/pow(_intrResolX[counter],2);
-      Sxxbar[1] = Sxxbar[1] + Zbar_Y[counter] * Zbar_Y[counter]/pow(_intrResolX[counter],2);
-    }
-
-    // define A2
+    Chiquare[0] = _batchFitter.getChi2X(0);
+    Chiquare[1] = _batchFitter.getChi2Y(0);
 
-    A2[0]=Sxybar[0]/Sxxbar[0];
-    A2[1]=Sxybar[1]/Sxxbar[1];
-
-    // Calculate chi sqaured
-    // Chi^2 for X and Y coordinate for hits in all planes
-
-    for( counter = 0; counter < _nPlanes; counter++ ){
-      Chiquare[0] += pow(-_zPos[counter]*A2[0]
-                         +_xPos[counter]-Ybar[0]+Xbar[0]*A2[0],2)/pow(_intrResolX[counter],2);
-      Chiquare[1] += pow(-_zPos[counter]*A2[1]
-                         +_yPos[counter]-Ybar[1]+Xbar[1]*A2[1],2)/pow(_intrResolY[counter],2);
-    }
-
-    for( counter = 0; counter < _nPlanes; counter++ ){
-      _waferResidX[counter] = (Ybar[0]-Xbar[0]*A2[0]+_zPos[counter]*A2[0])-_xPos[counter];
-      _waferResidY[counter] = (Ybar[1]-Xbar[1]*A2[1]+_zPos[counter]*A2[1])-_yPos[counter];
+    for( int counter = 0; counter < _nPlanes; counter++ ){
+      _waferResidX[counter] = _batchFitter.getResidualX(counter, 0);
+      _waferResidY[counter] = _batchFitter.getResidualY(counter, 0);
     }
 
     // define angle
 
-
-    angle[0] = atan(A2[0]);
-    angle[1] = atan(A2[1]);
+    angle[0] = atan(_batchFitter.getSlopeX(0));
+    angle[1] = atan(_batchFitter.getSlopeY(0));
 
 
     // Define output track and hit collections
@@ -493,10 +425,10 @@ void EUTelLineFit::processEvent (LCEvent * event) {
 
     // Calculate positions of fitted track in every plane
 
-    for( counter = 0; counter < _nPlanes; counter++ ){
+    for( int counter = 0; counter < _nPlanes; counter++ ){
 
-      _xFitPos[counter] = Ybar[0]-Xbar[0]*A2[0]+_zPos[counter]*A2[0];
-      _yFitPos[counter] = Ybar[1]-Xbar[1]*A2[1]+_zPos[counter]*A2[1];
+      _xFitPos[counter] = _batchFitter.getFitX(counter, 0);
+      _yFitPos[counter] = _batchFitter.getFitY(counter, 0);
 
       TrackerHitImpl * fitpoint = new TrackerHitImpl;
 
@@ -619,9 +551,6 @@ void EUTelLineFit::processEvent (LCEvent * event) {
 
 #endif
 
-    delete [] Zbar_X;
-    delete [] Zbar_Y;
-
 
   } catch (DataNotAvailableException& e) {
 
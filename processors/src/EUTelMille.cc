@@ -273,6 +273,8 @@ EUTelMille::EUTelMille () : Processor("EUTelMille") {
 
   registerOptionalParameter("RunPede","Execute the pede program using the generated steering file.",_runPede, static_cast <bool> (true));
 
+  registerOptionalParameter("UseInternalSolver","Solve the alignment in memory instead of writing the binary file and running pede. The generated steering file is still used for the parameter definitions.",_useInternalSolver, static_cast <bool> (false));
+
   registerOptionalParameter("UsePedeUserStartValues","Give start values for pede by hand (0 - automatic calculation of start values, 1 - start values defined by user).", _usePedeUserStartValues, static_cast <int> (0));
 
   registerOptionalParameter("PedeUserStartValuesX","Start values for the alignment for shifts in the X direction.",_pedeUserStartValuesX,PedeUserStartValuesX);
@@ -538,8 +540,13 @@ void EUTelMille::init() {
   // booking histograms
   bookHistos();
 
-  streamlog_out ( MESSAGE5 ) << "Initialising Mille..." << endl;
-  _mille = new Mille(_binaryFilename.c_str());
+  if ( _useInternalSolver ) {
+    streamlog_out ( MESSAGE5 ) << "Using the internal Millepede solver, no binary file is written" << endl;
+    _mille = 0;
+  } else {
+    streamlog_out ( MESSAGE5 ) << "Initialising Mille..." << endl;
+    _mille = new Mille(_binaryFilename.c_str());
+  }
 
   _xPos.clear();
   _yPos.clear();
@@ -1910,7 +1917,7 @@ void EUTelMille::processEvent (LCEvent * event) {
               derLC[2] = _zPosHere[help];
               residual = _waferResidX[help];
               sigma    = _resolutionX[help];
-              _mille->mille(nLC,derLC,nGL,derGL,label,residual,sigma);
+              addMilleMeasurement(nLC,derLC,nGL,derGL,label,residual,sigma);
 
               derGL[((helphelp * 2) + 0)] = 0;
               derLC[0] = 0;
@@ -1921,7 +1928,7 @@ void EUTelMille::processEvent (LCEvent * event) {
               derLC[3] = _zPosHere[help];
               residual = _waferResidY[help];
               sigma    = _resolutionY[help];
-              _mille->mille(nLC,derLC,nGL,derGL,label,residual,sigma);
+              addMilleMeasurement(nLC,derLC,nGL,derGL,label,residual,sigma);
 
               derGL[((helphelp * 2) + 1)] = 0;
               derLC[1] = 0;
@@ -1997,7 +2004,7 @@ void EUTelMille::processEvent (LCEvent * event) {
               derLC[2] = _zPosHere[help];
               residual = _waferResidX[help];
               sigma    = _resolutionX[help];
-              _mille->mille(nLC,derLC,nGL,derGL,label,residual,sigma);
+              addMilleMeasurement(nLC,derLC,nGL,derGL,label,residual,sigma);
 
               derGL[((helphelp * 3) + 0)] = 0;
               derGL[((helphelp * 3) + 2)] = 0;
@@ -2010,7 +2017,7 @@ void EUTelMille::processEvent (LCEvent * event) {
               derLC[3] = _zPosHere[help];
               residual = _waferResidY[help];
               sigma    = _resolutionY[help];
-              _mille->mille(nLC,derLC,nGL,derGL,label,residual,sigma);
+              addMilleMeasurement(nLC,derLC,nGL,derGL,label,residual,sigma);
 
               derGL[((helphelp * 3) + 1)] = 0;
               derGL[((helphelp * 3) + 2)] = 0;
@@ -2152,7 +2159,7 @@ else
             
                   residual = _waferResidX[help];
                  
-                  _mille->mille(nLC,derLC,nGL,derGL,label,residual,sigmax);
+                  addMilleMeasurement(nLC,derLC,nGL,derGL,label,residual,sigmax);
 
              
                   // shift in Y
@@ -2171,7 +2178,7 @@ else
             
                   residual = _waferResidY[help];
                   
-                  _mille->mille(nLC,derLC,nGL,derGL,label,residual,sigmay);
+                  addMilleMeasurement(nLC,derLC,nGL,derGL,label,residual,sigmay);
               
               
                   // shift in Z
@@ -2190,7 +2197,7 @@ else
             
                   residual = _waferResidZ[help];
                  
-                  _mille->mille(nLC,derLC,nGL,derGL,label,residual,sigmaz);
+                  addMilleMeasurement(nLC,derLC,nGL,derGL,label,residual,sigmaz);
                   _nMilleDataPoints++;
 
                 } // end if plane is not excluded
@@ -2214,7 +2221,7 @@ else
         _nGoodTracks++;
 
         // end local fit
-        _mille->end();
+        endMilleTrack();
 
         _nMilleTracks++;
 
@@ -2406,6 +2413,9 @@ bool EUTelMille::hitContainsHotPixels( TrackerHitImpl   * hit)
       try{
 	LCObjectVec clusterVector = hit->getRawHits();
 
+	// hits without cluster, e.g. read from a hit cache
+	if ( clusterVector.empty() ) return false;
+
 	if ( hit->getType() == kEUTelSparseClusterImpl ) 
 	  {
       
@@ -2764,7 +2774,45 @@ void EUTelMille::end() {
   if (_runPede == 1) {
 
     // check if steering file exists
-    if (_generatePedeSteerfile == 1) {
+    if (_generatePedeSteerfile == 1 && _useInternalSolver) {
+
+      streamlog_out ( MESSAGE5 ) << "Solving the alignment with the internal solver using " << _pedeSteerfileName << endl;
+
+      if ( !_milleSolver.readSteeringFile( _pedeSteerfileName ) ) {
+        streamlog_out ( ERROR5 ) << "Unable to read the steering file " << _pedeSteerfileName << endl;
+        return;
+      }
+
+      if ( !_milleSolver.solve() ) {
+        streamlog_out ( ERROR5 ) << "The alignment normal equations are singular, no constants are saved" << endl;
+        return;
+      }
+
+      if ( _milleSolver.getNumberOfSkippedConstraints() > 0 ) {
+        streamlog_out ( WARNING5 ) << _milleSolver.getNumberOfSkippedConstraints()
+                                   << " constraint(s) without any measured or free parameter skipped" << endl;
+      }
+
+      streamlog_out ( MESSAGE7 ) << "Internal solver successfully finished: "
+                                 << _milleSolver.getNumberOfTracks() << " tracks used, "
+                                 << _milleSolver.getNumberOfRejectedTracks() << " rejected" << endl;
+      if ( _milleSolver.getNdf() > 0 ) {
+        const double chi2ndf = _milleSolver.getChi2() / _milleSolver.getNdf();
+        // monitor the chi2/ndf in CDash when running tests
+        CDashMeasurement meas_chi2ndf("chi2_ndf",chi2ndf);
+        streamlog_out ( MESSAGE6 ) << "Final Sum(Chi^2)/Sum(Ndf) = " << chi2ndf << endl;
+      }
+
+      // write the same result file as pede so that it can be inspected
+      // or used as input for a following iteration
+      if ( !_milleSolver.writeResultFile( "millepede.res" ) ) {
+        streamlog_out ( ERROR5 ) << "Unable to write millepede.res" << endl;
+        return;
+      }
+
+      writeAlignmentConstants( "millepede.res" );
+
+    } else if (_generatePedeSteerfile == 1) {
 
       std::string command = "pede " + _pedeSteerfileName;
 
@@ -2866,185 +2914,199 @@ void EUTelMille::end() {
 	  return; // does fine for now
 	}
 
-        // reading back the millepede.res file and getting the
-        // results.
-        string millepedeResFileName = "millepede.res";
+        writeAlignmentConstants( "millepede.res" );
 
-        streamlog_out ( MESSAGE6 ) << "Reading back the " << millepedeResFileName << endl
-                                   << "Saving the alignment constant into " << _alignmentConstantLCIOFile << endl;
+      }
+    } else {
 
-        // open the millepede ASCII output file
-        ifstream millepede( millepedeResFileName.c_str() );
+      streamlog_out ( ERROR2 ) << "Unable to run pede. No steering file has been generated." << endl;
 
+    }
 
-        // reopen the LCIO file this time in append mode
-        LCWriter * lcWriter = LCFactory::getInstance()->createLCWriter();
 
-        try 
-        {
-          lcWriter->open( _alignmentConstantLCIOFile, LCIO::WRITE_NEW );
-        }
-        catch ( IOException& e ) 
-        {
-          streamlog_out ( ERROR4 ) << e.what() << endl
-                                   << "Sorry for quitting. " << endl;
-          exit(-1);
-        }
+  } // end if running pede using the generated steering file
 
+  streamlog_out ( MESSAGE2 ) << endl;
+  streamlog_out ( MESSAGE2 ) << "Successfully finished" << endl;
+}
 
-        // write an almost empty run header
-        LCRunHeaderImpl * lcHeader  = new LCRunHeaderImpl;
-        lcHeader->setRunNumber( 0 );
+void EUTelMille::addMilleMeasurement(int nLC, float * derLC, int nGL, float * derGL,
+                                     int * label, float residual, float sigma) {
+  if ( _useInternalSolver ) _milleSolver.mille(nLC,derLC,nGL,derGL,label,residual,sigma);
+  else _mille->mille(nLC,derLC,nGL,derGL,label,residual,sigma);
+}
 
-        lcWriter->writeRunHeader(lcHeader);
+void EUTelMille::endMilleTrack() {
+  if ( _useInternalSolver ) _milleSolver.end();
+  else _mille->end();
+}
 
-        delete lcHeader;
+void EUTelMille::writeAlignmentConstants(const std::string & millepedeResFileName) {
 
-        LCEventImpl * event = new LCEventImpl;
-        event->setRunNumber( 0 );
-        event->setEventNumber( 0 );
+  // reading back the millepede.res file and getting the
+  // results.
+  streamlog_out ( MESSAGE6 ) << "Reading back the " << millepedeResFileName << endl
+                             << "Saving the alignment constant into " << _alignmentConstantLCIOFile << endl;
 
-        LCTime * now = new LCTime;
-        event->setTimeStamp( now->timeStamp() );
-        delete now;
+  // open the millepede ASCII output file
+  ifstream millepede( millepedeResFileName.c_str() );
 
-        LCCollectionVec * constantsCollection = new LCCollectionVec( LCIO::LCGENERICOBJECT );
 
+  // reopen the LCIO file this time in append mode
+  LCWriter * lcWriter = LCFactory::getInstance()->createLCWriter();
 
-        if ( millepede.bad() || !millepede.is_open() ) 
-        {
-          streamlog_out ( ERROR4 ) << "Error opening the " << millepedeResFileName << endl
-                                   << "The alignment slcio file cannot be saved" << endl;
-        }
-        else 
-        {
-          vector<double > tokens;
-          stringstream tokenizer;
-          string line;
+  try 
+  {
+    lcWriter->open( _alignmentConstantLCIOFile, LCIO::WRITE_NEW );
+  }
+  catch ( IOException& e ) 
+  {
+    streamlog_out ( ERROR4 ) << e.what() << endl
+                             << "Sorry for quitting. " << endl;
+    exit(-1);
+  }
 
-          // get the first line and throw it away since it is a
-          // comment!
-          getline( millepede, line );
 
-          int counter = 0;
+  // write an almost empty run header
+  LCRunHeaderImpl * lcHeader  = new LCRunHeaderImpl;
+  lcHeader->setRunNumber( 0 );
 
-          while ( ! millepede.eof() ) {
+  lcWriter->writeRunHeader(lcHeader);
 
-            EUTelAlignmentConstant * constant = new EUTelAlignmentConstant;
+  delete lcHeader;
 
-            bool goodLine = true;
-            unsigned int numpars = 0;
-            if(_alignMode != 3)
-              numpars = 3;
-            else
-              numpars = 6;
+  LCEventImpl * event = new LCEventImpl;
+  event->setRunNumber( 0 );
+  event->setEventNumber( 0 );
 
-            for ( unsigned int iParam = 0 ; iParam < numpars ; ++iParam ) 
-            {
-              getline( millepede, line );
+  LCTime * now = new LCTime;
+  event->setTimeStamp( now->timeStamp() );
+  delete now;
 
-              if ( line.empty() ) {
-                goodLine = false;
-                continue;
-              }
+  LCCollectionVec * constantsCollection = new LCCollectionVec( LCIO::LCGENERICOBJECT );
 
-              tokens.clear();
-              tokenizer.clear();
-              tokenizer.str( line );
 
-	      double buffer;
-              // // check that all parts of the line are non zero
-              while ( tokenizer >> buffer ) {
-                tokens.push_back( buffer ) ;
-              }
+  if ( millepede.bad() || !millepede.is_open() ) 
+  {
+    streamlog_out ( ERROR4 ) << "Error opening the " << millepedeResFileName << endl
+                             << "The alignment slcio file cannot be saved" << endl;
+  }
+  else 
+  {
+    vector<double > tokens;
+    stringstream tokenizer;
+    string line;
 
-              if ( ( tokens.size() == 3 ) || ( tokens.size() == 6 ) || (tokens.size() == 5) ) {
-                goodLine = true;
-              } else goodLine = false;
+    // get the first line and throw it away since it is a
+    // comment!
+    getline( millepede, line );
 
-              bool isFixed = ( tokens.size() == 3 );
-              if(_alignMode != 3)
-                {
-                 if ( iParam == 0 ) {
-                    constant->setXOffset( tokens[1] / 1000. );
-                    if ( ! isFixed ) constant->setXOffsetError( tokens[4] / 1000. ) ;
-                  }
-                  if ( iParam == 1 ) {
-                    constant->setYOffset( tokens[1] / 1000. ) ;
-                    if ( ! isFixed ) constant->setYOffsetError( tokens[4] / 1000. ) ;
-                  }
-                  if ( iParam == 2 ) {
-                    constant->setGamma( tokens[1]  ) ;
-                    if ( ! isFixed ) constant->setGammaError( tokens[4] ) ;
-                  }
-                }
-              else
-                {
-                 if ( iParam == 0 ) {
-                    constant->setXOffset( tokens[1] / 1000. );
-                    if ( ! isFixed ) constant->setXOffsetError( tokens[4] / 1000. ) ;                    
-                  }
-                  if ( iParam == 1 ) {
-                    constant->setYOffset( tokens[1] / 1000. ) ;
-                    if ( ! isFixed ) constant->setYOffsetError( tokens[4] / 1000. ) ;
-                  }
-                  if ( iParam == 2 ) {
-                    constant->setZOffset( tokens[1] / 1000. ) ;
-                    if ( ! isFixed ) constant->setZOffsetError( tokens[4] / 1000. ) ;
-                  }
-                  if ( iParam == 3 ) {
-                    constant->setAlpha( tokens[1]  ) ;
-                    if ( ! isFixed ) constant->setAlphaError( tokens[4] ) ;
-                  } 
-                  if ( iParam == 4 ) {
-                    constant->setBeta( tokens[1]  ) ;
-                    if ( ! isFixed ) constant->setBetaError( tokens[4] ) ;
-                  } 
-                  if ( iParam == 5 ) {
-                    constant->setGamma( tokens[1]  ) ;
-                    if ( ! isFixed ) constant->setGammaError( tokens[4] ) ;
-                  } 
+    int counter = 0;
 
-                }
-              
-            }
+    while ( ! millepede.eof() ) {
 
+      EUTelAlignmentConstant * constant = new EUTelAlignmentConstant;
 
-            // right place to add the constant to the collection
-            if ( goodLine  ) {
-//               constant->setSensorID( _orderedSensorID_wo_excluded.at( counter ) );
-              constant->setSensorID( _orderedSensorID.at( counter ) );
-              ++ counter;
-              constantsCollection->push_back( constant );
-              streamlog_out ( MESSAGE0 ) << (*constant) << endl;
-            }
-            else delete constant;
-          }
+      bool goodLine = true;
+      unsigned int numpars = 0;
+      if(_alignMode != 3)
+        numpars = 3;
+      else
+        numpars = 6;
 
-        }
+      for ( unsigned int iParam = 0 ; iParam < numpars ; ++iParam ) 
+      {
+        getline( millepede, line );
 
+        if ( line.empty() ) {
+          goodLine = false;
+          continue;
+        }
 
+        tokens.clear();
+        tokenizer.clear();
+        tokenizer.str( line );
 
-        event->addCollection( constantsCollection, _alignmentConstantCollectionName );
-        lcWriter->writeEvent( event );
-        delete event;
+	      double buffer;
+        // // check that all parts of the line are non zero
+        while ( tokenizer >> buffer ) {
+          tokens.push_back( buffer ) ;
+        }
 
-        lcWriter->close();
+        if ( ( tokens.size() == 3 ) || ( tokens.size() == 6 ) || (tokens.size() == 5) ) {
+          goodLine = true;
+        } else goodLine = false;
 
-        millepede.close();
+        bool isFixed = ( tokens.size() == 3 );
+        if(_alignMode != 3)
+          {
+           if ( iParam == 0 ) {
+              constant->setXOffset( tokens[1] / 1000. );
+              if ( ! isFixed ) constant->setXOffsetError( tokens[4] / 1000. ) ;
+            }
+            if ( iParam == 1 ) {
+              constant->setYOffset( tokens[1] / 1000. ) ;
+              if ( ! isFixed ) constant->setYOffsetError( tokens[4] / 1000. ) ;
+            }
+            if ( iParam == 2 ) {
+              constant->setGamma( tokens[1]  ) ;
+              if ( ! isFixed ) constant->setGammaError( tokens[4] ) ;
+            }
+          }
+        else
+          {
+           if ( iParam == 0 ) {
+              constant->setXOffset( tokens[1] / 1000. );
+              if ( ! isFixed ) constant->setXOffsetError( tokens[4] / 1000. ) ;                    
+            }
+            if ( iParam == 1 ) {
+              constant->setYOffset( tokens[1] / 1000. ) ;
+              if ( ! isFixed ) constant->setYOffsetError( tokens[4] / 1000. ) ;
+            }
+            if ( iParam == 2 ) {
+              constant->setZOffset( tokens[1] / 1000. ) ;
+              if ( ! isFixed ) constant->setZOffsetError( tokens[4] / 1000. ) ;
+            }
+            if ( iParam == 3 ) {
+              constant->setAlpha( tokens[1]  ) ;
+              if ( ! isFixed ) constant->setAlphaError( tokens[4] ) ;
+            } 
+            if ( iParam == 4 ) {
+              constant->setBeta( tokens[1]  ) ;
+              if ( ! isFixed ) constant->setBetaError( tokens[4] ) ;
+            } 
+            if ( iParam == 5 ) {
+              constant->setGamma( tokens[1]  ) ;
+              if ( ! isFixed ) constant->setGammaError( tokens[4] ) ;
+            } 
 
+          }
+        
       }
-    } else {
 
-      streamlog_out ( ERROR2 ) << "Unable to run pede. No steering file has been generated." << endl;
 
+      // right place to add the constant to the collection
+      if ( goodLine  ) {
+//               constant->setSensorID( _orderedSensorID_wo_excluded.at( counter ) );
+        constant->setSensorID( _orderedSensorID.at( counter ) );
+        ++ counter;
+        constantsCollection->push_back( constant );
+        streamlog_out ( MESSAGE0 ) << (*constant) << endl;
+      }
+      else delete constant;
     }
 
+  }
 
-  } // end if running pede using the generated steering file
 
-  streamlog_out ( MESSAGE2 ) << endl;
-  streamlog_out ( MESSAGE2 ) << "Successfully finished" << endl;
+
+  event->addCollection( constantsCollection, _alignmentConstantCollectionName );
+  lcWriter->writeEvent( event );
+  delete event;
+
+  lcWriter->close();
+
+  millepede.close();
 }
 
 void EUTelMille::bookHistos() {
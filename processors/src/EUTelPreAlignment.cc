@@ -43,6 +43,7 @@
 #include <algorithm>
 #include <memory>
 #include <cstdio>
+#include <future>
 
 using namespace std;
 using namespace lcio;
@@ -50,7 +51,12 @@ using namespace marlin;
 using namespace eutelescope;
 using namespace gear;
 
-EUTelPreAlign::EUTelPreAlign(): Processor("EUTelPreAlign")
+EUTelPreAlign::EUTelPreAlign(): Processor("EUTelPreAlign"),
+  _preAlignerIndexMap(),
+  _planeHits(),
+  _refHits(),
+  _candidates(),
+  _queuedPoints(0)
 {
   _description = "Apply alignment constants to hit collection";
 
@@ -109,8 +115,11 @@ void EUTelPreAlign::init () {
 					       			geo::gGeometry().siPlaneYPitch(sensorID)/10.,
 								geo::gGeometry().siPlaneZPosition(sensorID),
 								sensorID ) );	
+			_preAlignerIndexMap[sensorID] = _preAligners.size()-1;
 		}
 	}
+	_planeHits.assign( _preAligners.size(), std::vector< std::pair<double, double> >() );
+	_queuedPoints = 0;
 
 	#if defined(USE_AIDA) || defined(MARLIN_USE_AIDA)
 	std::string tempHistoName = "";
@@ -210,83 +219,82 @@ void EUTelPreAlign::processEvent(LCEvent* event)
 				LCCollectionVec * inputCollectionVec = dynamic_cast < LCCollectionVec * > (evt->getCollection(_inputHitCollectionName));
 				UTIL::CellIDDecoder<TrackerHitImpl> hitDecoder ( EUTELESCOPE::HITENCODING );
 
-				std::vector<float> residX;
-				std::vector<float> residY;
-				std::vector<PreAligner*> prealign;
+				_refHits.clear();
+				for( size_t ii = 0; ii < _planeHits.size(); ii++ ) _planeHits[ii].clear();
 
-				//Loop over hits in fixed plane:
-				for( size_t ref = 0; ref < inputCollectionVec->size(); ref++ )
+				//Sort the hits by plane, hot pixels are checked only once per hit
+				for( size_t iHit = 0; iHit < inputCollectionVec->size(); iHit++ )
 				{
+						TrackerHitImpl* hit = dynamic_cast<TrackerHitImpl*>( inputCollectionVec->getElementAt(iHit) );
+						const double* pos = hit->getPosition();
+						int sensorID = hitDecoder(hit)["sensorID"];
 
-						TrackerHitImpl* refHit = dynamic_cast<TrackerHitImpl*>( inputCollectionVec->getElementAt(ref) );
-						const double* refPos = refHit->getPosition();
-
-						int sensorID = hitDecoder(refHit)["sensorID"];
-
-						// identify fixed plane
-						if( sensorID != _fixedID ) continue;
+						if( sensorID == _fixedID ) {
+								_refHits.push_back( std::make_pair(pos[0], pos[1]) );
+								continue;
+						}
 
-						residX.clear();
-						residY.clear();
-						prealign.clear();
+						//Hits with a hot pixel are ignored
+						if( hitContainsHotPixels(hit) ) continue;
 
-						for( size_t iHit = 0; iHit < inputCollectionVec->size(); iHit++)
-						{
-
-								TrackerHitImpl* hit = dynamic_cast<TrackerHitImpl*>( inputCollectionVec->getElementAt(iHit) );
-								//Hits with a hot pixel are ignored
-								if( hitContainsHotPixels(hit) ) continue;
+						std::map<int, size_t>::const_iterator paIt = _preAlignerIndexMap.find( sensorID );
+						if( paIt == _preAlignerIndexMap.end() ) {
+								streamlog_out ( ERROR5 ) << "Mismatched hit at " << pos[2] << endl;
+								continue;
+						}
+						_planeHits[paIt->second].push_back( std::make_pair(pos[0], pos[1]) );
+				}
 
-								const double * pos = hit->getPosition();
-								int iHitID = hitDecoder(hit)["sensorID"]; 
+				for( size_t ii = 0; ii < _planeHits.size(); ii++ ) {
+						std::sort( _planeHits[ii].begin(), _planeHits[ii].end() );
+				}
 
-								if( iHitID == _fixedID ) continue;
-								bool gotIt(false);
+				//Loop over hits in fixed plane:
+				for( size_t ref = 0; ref < _refHits.size(); ref++ )
+				{
+						double refX = _refHits[ref].first;
+						double refY = _refHits[ref].second;
 
-								for(size_t ii = 0; ii < _preAligners.size(); ii++)
-								{
+						_candidates.clear();
 
-										PreAligner& pa = _preAligners.at(ii);
+						for( size_t ii = 0; ii < _preAligners.size(); ii++ )
+						{
+								std::vector< std::pair<double, double> > const & hits = _planeHits[ii];
+								if( hits.empty() ) continue;
 
-										if( pa.getIden() != iHitID  ) { continue; }
+								int idZ = _sensorIDtoZOrderMap[ _preAligners[ii].getIden() ];
 
-										gotIt = true;
+								//Only hits with refX - x inside the residual band can be correlated
+								double xLow  = refX - _residualsXMax[idZ];
+								double xHigh = refX - _residualsXMin[idZ];
 
-										double correlationX =  refPos[0] - pos[0] ;
-										double correlationY =  refPos[1] - pos[1] ;
+								std::vector< std::pair<double, double> >::const_iterator hitIt =
+										std::lower_bound( hits.begin(), hits.end(), std::make_pair(xLow, -std::numeric_limits<double>::max()) );
 
-										int idZ = _sensorIDtoZOrderMap[ iHitID ];
+								for( ; hitIt != hits.end() && hitIt->first < xHigh; ++hitIt )
+								{
+										double correlationX =  refX - hitIt->first ;
+										double correlationY =  refY - hitIt->second ;
 
 										if( 
 														(_residualsXMin[idZ] < correlationX ) && ( correlationX < _residualsXMax[idZ]) &&
 														(_residualsYMin[idZ] < correlationY ) && ( correlationY < _residualsYMax[idZ]) 
 										  ) {
-												residX.push_back( correlationX );
-												residY.push_back( correlationY );
-												prealign.push_back(&pa);
+												_candidates.push_back( std::make_pair(ii, std::make_pair(static_cast<float>(correlationX), static_cast<float>(correlationY))) );
 										}
-										break;
-								}
-								if( not gotIt ) 
-								{
-										streamlog_out ( ERROR5 ) << "Mismatched hit at " << pos[2] << endl;
 								}
 						}
 
-						if( prealign.size() > static_cast< unsigned int >(_minNumberOfCorrelatedHits) && residX.size() == residY.size() ) {
-								for( unsigned int ii = 0 ;ii < prealign.size(); ii++ ) {
-
-										prealign[ii]->addPoint( residX[ii], residY[ii] );
-
-#if defined(USE_AIDA) || defined(MARLIN_USE_AIDA)
-										if( _fillHistos ) {
-												( dynamic_cast<AIDA::IHistogram1D*> (_hitXCorr[ prealign[ii]->getIden() ] ) )->fill( residX[ii] );
-												( dynamic_cast<AIDA::IHistogram1D*> (_hitYCorr[ prealign[ii]->getIden() ] ) )->fill( residY[ii] );
-										}
-#endif
+						if( _candidates.size() > static_cast< unsigned int >(_minNumberOfCorrelatedHits) ) {
+								for( size_t ii = 0; ii < _candidates.size(); ii++ ) {
+										_preAligners[_candidates[ii].first].queuePoint( _candidates[ii].second.first, _candidates[ii].second.second );
 								}
+								_queuedPoints += _candidates.size();
 						}
 				}
+
+				//Fill in large batches, or when this was the last event used
+				if( _queuedPoints > 100000 || _iEvt == _events ) flushPreAligners();
 		}
 		catch( DataNotAvailableException& e) { 
 				streamlog_out  ( WARNING2 ) <<  "No input collection " << _inputHitCollectionName << " found on event " << event->getEventNumber()
@@ -297,6 +305,35 @@ void EUTelPreAlign::processEvent(LCEvent* event)
 
 }
 
+void EUTelPreAlign::flushPreAligners()
+{
+		if( _queuedPoints == 0 ) return;
+
+		std::vector< std::future<void> > tasks;
+		for( size_t ii = 0; ii < _preAligners.size(); ii++ ) {
+				tasks.push_back( std::async( std::launch::async, &PreAligner::fillQueued, &_preAligners[ii] ) );
+		}
+
+#if defined(USE_AIDA) || defined(MARLIN_USE_AIDA)
+		if( _fillHistos ) {
+				for( size_t ii = 0; ii < _preAligners.size(); ii++ ) {
+						AIDA::IHistogram1D* histoX = dynamic_cast<AIDA::IHistogram1D*> ( _hitXCorr[ _preAligners[ii].getIden() ] );
+						AIDA::IHistogram1D* histoY = dynamic_cast<AIDA::IHistogram1D*> ( _hitYCorr[ _preAligners[ii].getIden() ] );
+						std::vector<float> const & queueX = _preAligners[ii].getQueuedX();
+						std::vector<float> const & queueY = _preAligners[ii].getQueuedY();
+						for( size_t jj = 0; jj < queueX.size(); jj++ ) {
+								histoX->fill( queueX[jj] );
+								histoY->fill( queueY[jj] );
+						}
+				}
+		}
+#endif
+
+		for( size_t ii = 0; ii < tasks.size(); ii++ ) tasks[ii].get();
+		for( size_t ii = 0; ii < _preAligners.size(); ii++ ) _preAligners[ii].clearQueue();
+		_queuedPoints = 0;
+}
+
 bool EUTelPreAlign::hitContainsHotPixels( TrackerHitImpl   * hit) 
 {
 
@@ -307,6 +344,9 @@ bool EUTelPreAlign::hitContainsHotPixels( TrackerHitImpl   * hit)
     {
       LCObjectVec clusterVector = hit->getRawHits();
 
+      // hits without cluster, e.g. read from a hit cache
+      if ( clusterVector.empty() ) return false;
+
       if ( hit->getType() == kEUTelSparseClusterImpl ) 
 	{
 	  TrackerDataImpl * clusterFrame = static_cast<TrackerDataImpl*> ( clusterVector[0] );
@@ -381,6 +421,9 @@ bool EUTelPreAlign::hitContainsHotPixels( TrackerHitImpl   * hit)
       
 void EUTelPreAlign::end()
 {
+		//Residuals of the last events might still be queued
+		flushPreAligners();
+
 		LCCollectionVec * constantsCollection = new LCCollectionVec( LCIO::LCGENERICOBJECT );
 
 		for(size_t ii=0; ii<_sensorIDVec.size(); ii++)
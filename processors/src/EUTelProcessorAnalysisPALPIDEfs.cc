@@ -88,6 +88,16 @@ EUTelProcessorAnalysisPALPIDEfs::EUTelProcessorAnalysisPALPIDEfs()
   nNoPAlpideHit(0),
   nWrongPAlpideHit(0),
   nPlanesWithTooManyHits(0),
+  _noiseMask(),
+  _hotPixelMask(),
+  _deadColumnMask(),
+  _hitToLocal(),
+  _fitToLocal(),
+  _fitToLocalConstants(),
+  _alignRemovable(false),
+  _dutHitLocal(),
+  _dutHitGrid(),
+  _clusterTimeIndex(),
   xZero(0),
   yZero(0),
   xPitch(0),
@@ -227,6 +237,14 @@ void EUTelProcessorAnalysisPALPIDEfs::init() {
       gRotation[0] =  gRotation[0]*3.1415926/180.; //
       gRotation[1] =  gRotation[1]*3.1415926/180.; //
       gRotation[2] =  gRotation[2]*3.1415926/180.; //
+
+      // DUT hits: shift to the plane center and undo the sensor rotations, as one affine transformation
+      _hitToLocal.build( [this](const double* in, double* out) {
+        double pos[3] = { in[0] - xZero, in[1] - yZero, in[2] };
+        _EulerRotationBack( pos, gRotation );
+        _LayerRotationBack( pos, out[0], out[1] );
+        out[2] = pos[2];
+      } );
     }
   float chi2MaxTemp[1] = {30};
   for (size_t i=0; i<chi2Max.size(); i++)
@@ -308,7 +326,9 @@ void EUTelProcessorAnalysisPALPIDEfs::processEvent(LCEvent *evt)
       hotData = dynamic_cast< TrackerDataImpl * > ( hotPixelCollectionVec->getElementAt( layerIndex ) );
       auto sparseData = std::make_unique<EUTelTrackerDataInterfacerImpl<EUTelGenericSparsePixel> >(hotData);
       auto& pixelVec = sparseData->getPixels();
+      _hotPixelMask.reset(xPixel,yPixel,xPitch,yPitch);
       for(auto& sparsePixel: pixelVec) {
+        _hotPixelMask.mask(sparsePixel.getXCoord(),sparsePixel.getYCoord());
         hotpixelHisto->Fill(sparsePixel.getXCoord()*xPitch+xPitch/2.,sparsePixel.getYCoord()*yPitch+yPitch/2.);
       }
     }
@@ -319,12 +339,12 @@ void EUTelProcessorAnalysisPALPIDEfs::processEvent(LCEvent *evt)
     {
       streamlog_out ( MESSAGE4 ) << "Running with noise mask: " << _noiseMaskFileName.c_str() << endl;
       int region, doubleColumn, address;
+      _noiseMask.reset(xPixel,yPixel,xPitch,yPitch);
       while (noiseMaskFile >> region >> doubleColumn >> address)
       {
         int x = AddressToColumn(region,doubleColumn,address);
         int y = AddressToRow(address);
-        noiseMaskX.push_back(x);
-        noiseMaskY.push_back(y);
+        _noiseMask.mask(x,y);
         hotpixelHisto->Fill(x*xPitch+xPitch/2.,y*yPitch+yPitch/2.);
       }
     }
@@ -346,7 +366,9 @@ void EUTelProcessorAnalysisPALPIDEfs::processEvent(LCEvent *evt)
       deadColumn = dynamic_cast< TrackerDataImpl * > ( deadColumnCollectionVec->getElementAt( layerIndex ) );
       auto sparseData = std::make_unique<EUTelTrackerDataInterfacerImpl<EUTelGenericSparsePixel> >(deadColumn);
       auto& pixelVec = sparseData->getPixels();
+      _deadColumnMask.reset(xPixel,yPixel,xPitch,yPitch);
       for(auto& sparsePixel: pixelVec) {
+        _deadColumnMask.mask(sparsePixel.getXCoord(),sparsePixel.getYCoord());
         deadColumnHisto->Fill(sparsePixel.getXCoord()*xPitch+xPitch/2.,sparsePixel.getYCoord()*yPitch+yPitch/2.);
       }
     }
@@ -466,8 +488,12 @@ void EUTelProcessorAnalysisPALPIDEfs::processEvent(LCEvent *evt)
   }
   if (_oneAlignmentCollection) stats->Fill(kOnlyOneAlignAvailable);
 
+  // the alignment is removed from all fitted hits with one transformation per event
+  UpdateAlignTransform(preAlignmentCollectionVec,alignmentCollectionVec,alignmentPAlpideCollectionVec);
+
   // Clusters -------------------------------------------------------------------------------------
   _clusterAvailable = true;
+  _clusterTimeIndex.clear();
   try {
     zsInputDataCollectionVec = dynamic_cast< LCCollectionVec * > ( evt->getCollection( _zsDataCollectionName ) ) ;
     streamlog_out ( DEBUG4 ) << "zsInputDataCollectionVec: " << _zsDataCollectionName.c_str() << " found " << endl;
@@ -484,6 +510,8 @@ void EUTelProcessorAnalysisPALPIDEfs::processEvent(LCEvent *evt)
     {
       TrackerDataImpl * zsData = dynamic_cast< TrackerDataImpl * > ( zsInputDataCollectionVec->getElementAt(iCluster) );
       if((int)cellDecoder(zsData)["sensorID"] == _dutID) nClusterPerEvent++;
+      // the first cluster with a given time is the one associated to a hit
+      if (zsData->getTime() == zsData->getTime()) _clusterTimeIndex.insert(make_pair(zsData->getTime(),iCluster));
     }
   }
 
@@ -508,6 +536,22 @@ void EUTelProcessorAnalysisPALPIDEfs::processEvent(LCEvent *evt)
   std::vector< std::vector<double> > pT;
   std::vector< std::vector<double> > pH;
 
+  // DUT hits on the DUT, computed once per event and sorted in a grid ---------------------------
+  int nHitEvent = col->getNumberOfElements();
+  _dutHitLocal.assign(3*nHitEvent, 0.);
+  _dutHitGrid.clear();
+  for(int ihit=0; ihit<nHitEvent; ihit++)
+  {
+    TrackerHit *hit = dynamic_cast<TrackerHit*>( col->getElementAt(ihit) ) ;
+    if (!hit) continue;
+    const double *pos = hit->getPosition();
+    if (!(pos[2] >= dutZ-zDistance && pos[2] <= dutZ+zDistance)) continue;
+    _hitToLocal.apply(pos, &_dutHitLocal[3*ihit]);
+    _dutHitGrid.add(_dutHitLocal[3*ihit], _dutHitLocal[3*ihit+1], ihit);
+  }
+  _dutHitGrid.build(limit);
+  vector<int> nearbyHits;
+
 
   // Evaluating fake efficiency ===================================================================
   if(_showFake)
@@ -579,7 +623,7 @@ void EUTelProcessorAnalysisPALPIDEfs::processEvent(LCEvent *evt)
       double yposfit=0;
 
       // Applying alignment
-      bool alignSuccess = RemoveAlign(preAlignmentCollectionVec,alignmentCollectionVec,alignmentPAlpideCollectionVec,fitpos,xposfit,yposfit);
+      bool alignSuccess = RemoveAlign(fitpos,xposfit,yposfit);
       //streamlog_out( MESSAGE4 ) << "Removed align position: x=" << xposfit << ", y=" << yposfit << ", z="  << fitpos[2]  << " for event " << _nEvents+1 << "." << endl; // Debug output
       if (alignSuccess) stats->Fill(kAlignmentRemoved);
       else stats->Fill(kAlignmentRemovalFailed);
@@ -615,17 +659,7 @@ void EUTelProcessorAnalysisPALPIDEfs::processEvent(LCEvent *evt)
         // reject tracks too close to hot pixels
         if (_hotpixelAvailable)
         {
-          auto sparseData = std::make_unique<EUTelTrackerDataInterfacerImpl<EUTelGenericSparsePixel> >(hotData);
-          bool hotpixel = false;
-          auto& pixelVec = sparseData->getPixels();
-          for(auto& sparsePixel: pixelVec) {
-            if (abs(xposfit-(sparsePixel.getXCoord()*xPitch+xPitch/2.)) < limit && abs(yposfit-(sparsePixel.getYCoord()*yPitch+yPitch/2.)) < limit)
-            {
-              hotpixel = true;
-              break;
-            }
-          }
-          if (hotpixel) {
+          if (_hotPixelMask.isNearMaskedPixel(xposfit,yposfit,limit)) {
             stats->Fill(kHotPixel);
             continue;
           }
@@ -634,16 +668,7 @@ void EUTelProcessorAnalysisPALPIDEfs::processEvent(LCEvent *evt)
         // reject tracks too close to masked pixels
         if (_noiseMaskAvailable)
         {
-          bool noisePixel = false;
-          for (size_t iNoise=0; iNoise<noiseMaskX.size(); iNoise++)
-          {
-            if (abs(xposfit-(noiseMaskX[iNoise]*xPitch+xPitch/2.)) < limit && abs(yposfit-(noiseMaskY[iNoise]*yPitch+yPitch/2.)) < limit)
-            {
-              noisePixel = true;
-              break;
-            }
-          }
-          if (noisePixel) {
+          if (_noiseMask.isNearMaskedPixel(xposfit,yposfit,limit)) {
             stats->Fill(kMaskedPixel);
             continue;
           }
@@ -652,17 +677,7 @@ void EUTelProcessorAnalysisPALPIDEfs::processEvent(LCEvent *evt)
         // reject tracks too close to dead columns
         if (_deadColumnAvailable)
         {
-          auto sparseData = std::make_unique<EUTelTrackerDataInterfacerImpl<EUTelGenericSparsePixel> >(deadColumn);
-          bool dead = false;
-          auto& pixelVec = sparseData->getPixels();
-          for(auto& sparsePixel: pixelVec) {
-            if (abs(xposfit-(sparsePixel.getXCoord()*xPitch+xPitch/2.)) < limit)
-            {
-              dead = true;
-              break;
-            }
-          }
-          if (dead) {
+          if (_deadColumnMask.isNearMaskedColumn(xposfit,limit)) {
             stats->Fill(kDeadColumn);
             continue;
           }
@@ -745,14 +760,11 @@ void EUTelProcessorAnalysisPALPIDEfs::processEvent(LCEvent *evt)
               nPAlpideHits++;
               stats->Fill(kHitInDUT);
 
-              // Determine position of the hit on the DUT
-              pos[0]    -= xZero;
-              pos[1]    -= yZero;
-              _EulerRotationBack( pos, gRotation );
-
-              double xpos =0.;
-              double ypos =0.;
-              _LayerRotationBack(pos, xpos, ypos);
+              // Position of the hit on the DUT, computed once per event
+              const double *posLocal = &_dutHitLocal[3*ihit];
+              double xpos = posLocal[0];
+              double ypos = posLocal[1];
+              pos[2] = posLocal[2];
 
 #if defined(USE_AIDA) || defined(MARLIN_USE_AIDA)
               if (!hitmapFilled) hitmapHisto->Fill(xpos,ypos);
@@ -774,39 +786,26 @@ void EUTelProcessorAnalysisPALPIDEfs::processEvent(LCEvent *evt)
               {
                 nAssociatedhits++;
                 stats->Fill(kAssociatedHitInDUT);
-                for (int jhit=ihit+1; jhit< nHit ; jhit++)
+                // the other DUT hits within the window, in the order of the collection
+                _dutHitGrid.query(xposfit, yposfit, limit, nearbyHits);
+                for (vector<int>::const_iterator itNext = upper_bound(nearbyHits.begin(), nearbyHits.end(), ihit); itNext != nearbyHits.end(); ++itNext)
                 {
-                  TrackerHit * hitNext = dynamic_cast<TrackerHit*>( col->getElementAt(jhit) ) ;
-                  double posNext[3]={0.,0.,0.};
-                  if( hitNext != 0 )
+                  int jhit = *itNext;
+                  const double *posNextLocal = &_dutHitLocal[3*jhit];
+                  double xposNext = posNextLocal[0];
+                  double yposNext = posNextLocal[1];
+                  nAssociatedhits++;
+                  if ((xpos-xposfit)*(xpos-xposfit)+(ypos-yposfit)*(ypos-yposfit)<(xposNext-xposfit)*(xposNext-xposfit)+(yposNext-yposfit)*(yposNext-yposfit))
                   {
-                    const double *pos0Next = hitNext->getPosition();
-                    posNext[0] = pos0Next[0];
-                    posNext[1] = pos0Next[1];
-                    posNext[2] = pos0Next[2];
-                    if (posNext[2] < dutZ-zDistance || posNext[2] > dutZ+zDistance ) continue;
-                    posNext[0]    -= xZero;
-                    posNext[1]    -= yZero;
-
-                    _EulerRotationBack( posNext, gRotation );
-
-                    double xposNext, yposNext;
-                    _LayerRotationBack(posNext, xposNext, yposNext);
-
-                    if (abs(xposNext-xposfit) > limit || abs(yposNext-yposfit) > limit) continue;
-                    nAssociatedhits++;
-                    if ((xpos-xposfit)*(xpos-xposfit)+(ypos-yposfit)*(ypos-yposfit)<(xposNext-xposfit)*(xposNext-xposfit)+(yposNext-yposfit)*(yposNext-yposfit))
-                    {
-                      ihit = jhit;
-                    }
-                    else
-                    {
-                      xpos = xposNext;
-                      ypos = yposNext;
-                      pos[2] = posNext[2];
-                      hit = hitNext;
-                      ihit = jhit;
-                    }
+                    ihit = jhit;
+                  }
+                  else
+                  {
+                    xpos = xposNext;
+                    ypos = yposNext;
+                    pos[2] = posNextLocal[2];
+                    hit = dynamic_cast<TrackerHit*>( col->getElementAt(jhit) ) ;
+                    ihit = jhit;
                   }
                 }
                 if (nDUThitsEvent > 1 && nAssociatedhits == 1) {tmpHist->Fill(xposfitPrev,yposfitPrev); nWrongPAlpideHit--;}
@@ -814,89 +813,87 @@ void EUTelProcessorAnalysisPALPIDEfs::processEvent(LCEvent *evt)
                   streamlog_out ( DEBUG )  << nAssociatedhits << " points for one track in DUT in event " << evt->getEventNumber() << "\t" << xposPrev << "\t" << yposPrev << "\t" << xpos << "\t" << ypos << " Fit: " << xposfit << "\t" << yposfit << " Number of planes with more than one hit: " << nPlanesWithMoreHits << endl;
                 if (_clusterAvailable)
                 {
-                  for ( size_t idetector=0 ; idetector<zsInputDataCollectionVec->size(); idetector++)
+                  // the first cluster with the time of the hit
+                  map<float, size_t>::const_iterator clusterIt = _clusterTimeIndex.find(hit->getTime());
+                  if (hit->getTime() == hit->getTime() && clusterIt != _clusterTimeIndex.end())
                   {
                     CellIDDecoder<TrackerDataImpl> cellDecoder( zsInputDataCollectionVec );
-                    TrackerDataImpl * zsData = dynamic_cast< TrackerDataImpl * > ( zsInputDataCollectionVec->getElementAt(idetector) );
+                    TrackerDataImpl * zsData = dynamic_cast< TrackerDataImpl * > ( zsInputDataCollectionVec->getElementAt(clusterIt->second) );
                     SparsePixelType   type   = static_cast<SparsePixelType> ( static_cast<int> (cellDecoder( zsData )["sparsePixelType"]) );
-                    if (hit->getTime() == zsData->getTime())
+                    nClusterAssociatedToTrackPerEvent++;
+                    clusterAssosiatedToTrack.push_back(zsData->getTime());
+                    int clusterSize = zsData->getChargeValues().size()/4;
+                    vector<int> X(clusterSize);
+                    vector<int> Y(clusterSize);
+                    Cluster cluster;
+                    if ( type == kEUTelGenericSparsePixel )
                     {
-                      nClusterAssociatedToTrackPerEvent++;
-                      clusterAssosiatedToTrack.push_back(zsData->getTime());
-                      int clusterSize = zsData->getChargeValues().size()/4;
-                      vector<int> X(clusterSize);
-                      vector<int> Y(clusterSize);
-                      Cluster cluster;
-                      if ( type == kEUTelGenericSparsePixel )
+                      vector<vector<int> > pixVector;
+                      auto sparseData = EUTelTrackerDataInterfacerImpl<EUTelGenericSparsePixel>(zsData);
+                      for(size_t iPixel = 0; iPixel < sparseData.size(); iPixel++ ) {
+                        auto& pixel = sparseData.at( iPixel );
+                        X[iPixel] = pixel.getXCoord();
+                        Y[iPixel] = pixel.getYCoord();
+                        vector<int> pix;
+                        pix.push_back(X[iPixel]);
+                        pix.push_back(Y[iPixel]);
+                        pixVector.push_back(pix);
+                      }
+                      cluster.set_values(clusterSize,X,Y);
+                      clusterSizeHisto[index]->Fill(clusterSize);
+                      int xMin = *min_element(X.begin(), X.end());
+                      int xMax = *max_element(X.begin(), X.end());
+                      int yMin = *min_element(Y.begin(), Y.end());
+                      int yMax = *max_element(Y.begin(), Y.end());
+                      int clusterWidthX = xMax - xMin + 1;
+                      int clusterWidthY = yMax - yMin + 1;
+
+                      if ((clusterWidthX > 3 || clusterWidthY > 3) && !emptyMiddle(pixVector))
+                        for (size_t iPixel=0; iPixel<pixVector.size(); iPixel++)
+                          largeClusterHistos->Fill(pixVector[iPixel][0],pixVector[iPixel][1]);
+                      if (emptyMiddle(pixVector))
                       {
-                        vector<vector<int> > pixVector;
-                        auto sparseData = EUTelTrackerDataInterfacerImpl<EUTelGenericSparsePixel>(zsData);
-                        for(size_t iPixel = 0; iPixel < sparseData.size(); iPixel++ ) {
-                          auto& pixel = sparseData.at( iPixel );
-                          X[iPixel] = pixel.getXCoord();
-                          Y[iPixel] = pixel.getYCoord();
-                          vector<int> pix;
-                          pix.push_back(X[iPixel]);
-                          pix.push_back(Y[iPixel]);
-                          pixVector.push_back(pix);
-                        }
-                        cluster.set_values(clusterSize,X,Y);
-                        clusterSizeHisto[index]->Fill(clusterSize);
-                        int xMin = *min_element(X.begin(), X.end());
-                        int xMax = *max_element(X.begin(), X.end());
-                        int yMin = *min_element(Y.begin(), Y.end());
-                        int yMax = *max_element(Y.begin(), Y.end());
-                        int clusterWidthX = xMax - xMin + 1;
-                        int clusterWidthY = yMax - yMin + 1;
-
-                        if ((clusterWidthX > 3 || clusterWidthY > 3) && !emptyMiddle(pixVector))
-                          for (size_t iPixel=0; iPixel<pixVector.size(); iPixel++)
-                            largeClusterHistos->Fill(pixVector[iPixel][0],pixVector[iPixel][1]);
-                        if (emptyMiddle(pixVector))
-                        {
-                          for (size_t iPixel=0; iPixel<pixVector.size(); iPixel++)
-                            circularClusterHistos->Fill(pixVector[iPixel][0],pixVector[iPixel][1]);
-                        }
-
-                        clusterWidthXHisto[index]->Fill(clusterWidthX);
-                        clusterWidthYHisto[index]->Fill(clusterWidthY);
-                        clusterWidthXVsXHisto[index]->Fill(fmod(xposfit,xPitch),clusterWidthX);
-                        clusterWidthXVsXAverageHisto[index]->Fill(fmod(xposfit,xPitch),clusterWidthX);
-                        clusterWidthYVsYHisto[index]->Fill(fmod(yposfit,yPitch),clusterWidthY);
-                        clusterWidthYVsYAverageHisto[index]->Fill(fmod(yposfit,yPitch),clusterWidthY);
-                        //if (yposfit > _holesizeY[0] && yposfit < _holesizeY[1] && xposfit < _holesizeX[1] && xposfit > _holesizeX[0])
-                        clusterSize2DHisto[index]->Fill(fmod(xposfit,xPitch),fmod(yposfit,yPitch),clusterSize);
-                        //if (yposfit > _holesizeY[0] && yposfit < _holesizeY[1] && xposfit < _holesizeX[1] && xposfit > _holesizeX[0])
-                        clusterSize2D2by2Histo[index]->Fill(fmod(xposfit,2*xPitch),fmod(yposfit,2*yPitch),clusterSize);
-                        //if (yposfit > _holesizeY[0] && yposfit < _holesizeY[1] && xposfit < _holesizeX[1] && xposfit > _holesizeX[0])
-                        clusterSize2DAverageHisto[index]->Fill(fmod(xposfit,xPitch),fmod(yposfit,yPitch),clusterSize);
-                        //if (yposfit > _holesizeY[0] && yposfit < _holesizeY[1] && xposfit < _holesizeX[1] && xposfit > _holesizeX[0])
-                        clusterSize2DAverage2by2Histo[index]->Fill(fmod(xposfit,2*xPitch),fmod(yposfit,2*yPitch),clusterSize);
-                        nClusterVsXHisto[index]->Fill(fmod(xposfit,xPitch));
-                        nClusterVsYHisto[index]->Fill(fmod(yposfit,yPitch));
-                        //if (yposfit > _holesizeY[0] && yposfit < _holesizeY[1] && xposfit < _holesizeX[1] && xposfit > _holesizeX[0])
-                        nClusterSizeHisto[index]->Fill(fmod(xposfit,xPitch),fmod(yposfit,yPitch));
-                        //if (yposfit > _holesizeY[0] && yposfit < _holesizeY[1] && xposfit < _holesizeX[1] && xposfit > _holesizeX[0])
-                        nClusterSize2by2Histo[index]->Fill(fmod(xposfit,2*xPitch),fmod(yposfit,2*yPitch));
-                        int clusterShape = cluster.WhichClusterShape(cluster, clusterVec);
-                        if (clusterShape>=0)
-                        {
-                          clusterShapeHisto->Fill(clusterShape);
-                          clusterShapeHistoSector[index]->Fill(clusterShape);
-                          clusterShapeX[clusterShape]->Fill(xMin);
-                          clusterShapeY[clusterShape]->Fill(yMin);
-                          clusterShape2D2by2[clusterShape]->Fill(fmod(xposfit,2*xPitch),fmod(yposfit,2*yPitch));
-                          for (size_t iGroup=0; iGroup<symmetryGroups.size(); iGroup++)
-                            for (size_t iMember=0; iMember<symmetryGroups[iGroup].size(); iMember++)
-                              if (symmetryGroups[iGroup][iMember] == clusterShape) clusterShape2DGrouped2by2[iGroup]->Fill(fmod(xposfit,2*xPitch),fmod(yposfit,2*yPitch));
-                        }
-                        else 
+                        for (size_t iPixel=0; iPixel<pixVector.size(); iPixel++)
+                          circularClusterHistos->Fill(pixVector[iPixel][0],pixVector[iPixel][1]);
+                      }
+
+                      clusterWidthXHisto[index]->Fill(clusterWidthX);
+                      clusterWidthYHisto[index]->Fill(clusterWidthY);
+                      clusterWidthXVsXHisto[index]->Fill(fmod(xposfit,xPitch),clusterWidthX);
+                      clusterWidthXVsXAverageHisto[index]->Fill(fmod(xposfit,xPitch),clusterWidthX);
+                      clusterWidthYVsYHisto[index]->Fill(fmod(yposfit,yPitch),clusterWidthY);
+                      clusterWidthYVsYAverageHisto[index]->Fill(fmod(yposfit,yPitch),clusterWidthY);
+                      //if (yposfit > _holesizeY[0] && yposfit < _holesizeY[1] && xposfit < _holesizeX[1] && xposfit > _holesizeX[0])
+                      clusterSize2DHisto[index]->Fill(fmod(xposfit,xPitch),fmod(yposfit,yPitch),clusterSize);
+                      //if (yposfit > _holesizeY[0] && yposfit < _holesizeY[1] && xposfit < _holesizeX[1] && xposfit > _holesizeX[0])
+                      clusterSize2D2by2Histo[index]->Fill(fmod(xposfit,2*xPitch),fmod(yposfit,2*yPitch),clusterSize);
+                      //if (yposfit > _holesizeY[0] && yposfit < _holesizeY[1] && xposfit < _holesizeX[1] && xposfit > _holesizeX[0])
+                      clusterSize2DAverageHisto[index]->Fill(fmod(xposfit,xPitch),fmod(yposfit,yPitch),clusterSize);
+                      //if (yposfit > _holesizeY[0] && yposfit < _holesizeY[1] && xposfit < _holesizeX[1] && xposfit > _holesizeX[0])
+                      clusterSize2DAverage2by2Histo[index]->Fill(fmod(xposfit,2*xPitch),fmod(yposfit,2*yPitch),clusterSize);
+                      nClusterVsXHisto[index]->Fill(fmod(xposfit,xPitch));
+                      nClusterVsYHisto[index]->Fill(fmod(yposfit,yPitch));
+                      //if (yposfit > _holesizeY[0] && yposfit < _holesizeY[1] && xposfit < _holesizeX[1] && xposfit > _holesizeX[0])
+                      nClusterSizeHisto[index]->Fill(fmod(xposfit,xPitch),fmod(yposfit,yPitch));
+                      //if (yposfit > _holesizeY[0] && yposfit < _holesizeY[1] && xposfit < _holesizeX[1] && xposfit > _holesizeX[0])
+                      nClusterSize2by2Histo[index]->Fill(fmod(xposfit,2*xPitch),fmod(yposfit,2*yPitch));
+                      int clusterShape = cluster.WhichClusterShape(cluster, clusterVec);
+                      if (clusterShape>=0)
+                      {
+                        clusterShapeHisto->Fill(clusterShape);
+                        clusterShapeHistoSector[index]->Fill(clusterShape);
+                        clusterShapeX[clusterShape]->Fill(xMin);
+                        clusterShapeY[clusterShape]->Fill(yMin);
+                        clusterShape2D2by2[clusterShape]->Fill(fmod(xposfit,2*xPitch),fmod(yposfit,2*yPitch));
+                        for (size_t iGroup=0; iGroup<symmetryGroups.size(); iGroup++)
+                          for (size_t iMember=0; iMember<symmetryGroups[iGroup].size(); iMember++)
+                            if (symmetryGroups[iGroup][iMember] == clusterShape) clusterShape2DGrouped2by2[iGroup]->Fill(fmod(xposfit,2*xPitch),fmod(yposfit,2*yPitch));
+                      }
+                      else 
 			  {
 			    clusterShapeHisto->Fill(clusterVec.size());
 			    clusterShapeHistoSector[index]->Fill(clusterShape);
 			  }
-                      }
-                      break;
                     }
                   }
                 }
@@ -1210,7 +1207,7 @@ void EUTelProcessorAnalysisPALPIDEfs::processEvent(LCEvent *evt)
             if (fitpos[2] >= dutZ-zDistance && fitpos[2] <= dutZ+zDistance )
             {
               double xposfit=0, yposfit=0;
-              RemoveAlign(preAlignmentCollectionVec,alignmentCollectionVec,alignmentPAlpideCollectionVec,fitpos,xposfit,yposfit);
+              RemoveAlign(fitpos,xposfit,yposfit);
 
               if (abs(xposfit-(double)xCenter/xPixel*xSize)<limit && abs(yposfit-(double)yCenter/yPixel*ySize)<limit )
               {
@@ -1918,77 +1915,103 @@ bool EUTelProcessorAnalysisPALPIDEfs::emptyMiddle(vector<vector<int> > pixVector
 	else return false;
 }
 
-bool EUTelProcessorAnalysisPALPIDEfs::RemoveAlign(LCCollectionVec * preAlignmentCollectionVec, LCCollectionVec * alignmentCollectionVec, LCCollectionVec * alignmentPAlpideCollectionVec, double* fitpos, double& xposfit, double& yposfit)
-{
-  //Remove the alignment in the same way it was applied by the EUTelProcessorApplyAlignment.cc
-  double xPlaneCenter    = geo::gGeometry().siPlaneXPosition(_dutID);
-  double yPlaneCenter    = geo::gGeometry().siPlaneYPosition(_dutID);
-  double zPlaneThickness = geo::gGeometry().siPlaneZSize(_dutID);
-  double zPlaneCenter    = geo::gGeometry().siPlaneZPosition(_dutID) + zPlaneThickness / 2.;
-  TVector3 inputVec( fitpos[0] - xPlaneCenter, fitpos[1] - yPlaneCenter, fitpos[2] - zPlaneCenter);
-  //cerr << zPlaneThickness << "\t" << zPlaneCenter << endl;
-  EUTelAlignmentConstant * alignment = 0;
-  bool alignExist = false;
-  EUTelAlignmentConstant * preAlignment = 0;
-  bool prealignExist = false;
-  EUTelAlignmentConstant * alignmentPAlpide = 0;
-  bool alignPAlpideExist = false;
-  if (!_oneAlignmentCollection)
+namespace {
+  //! Alignment constant of a sensor, 0 if it is not in the collection
+  EUTelAlignmentConstant * FindAlignConstant(LCCollectionVec * collection, int sensorID)
   {
-    for (int iAlign=0; iAlign<alignmentPAlpideCollectionVec->getNumberOfElements(); iAlign++)
+    for (int iAlign=0; iAlign<collection->getNumberOfElements(); iAlign++)
     {
-      alignmentPAlpide = static_cast< EUTelAlignmentConstant* > (alignmentPAlpideCollectionVec->getElementAt(iAlign));
-      if (alignmentPAlpide->getSensorID() == _dutID)
-      {
-        alignPAlpideExist = true;
-        inputVec[0] += alignmentPAlpide->getXOffset();
-        inputVec[1] += alignmentPAlpide->getYOffset();
-        inputVec[2] += alignmentPAlpide->getZOffset();
-        inputVec.RotateZ( alignmentPAlpide->getGamma() );
-        inputVec.RotateY( alignmentPAlpide->getBeta() );
-        inputVec.RotateX( alignmentPAlpide->getAlpha() );
-        break;
-      }
+      EUTelAlignmentConstant * constant = static_cast< EUTelAlignmentConstant* > (collection->getElementAt(iAlign));
+      if (constant->getSensorID() == sensorID) return constant;
     }
-    if (!alignPAlpideExist && _isFirstEvent) cerr << "No second alignment correction applied to the pAlpide!" << endl;
+    return 0;
   }
-  for (int iAlign=0; iAlign<alignmentCollectionVec->getNumberOfElements(); iAlign++)
+}
+
+bool EUTelProcessorAnalysisPALPIDEfs::UpdateAlignTransform(LCCollectionVec * preAlignmentCollectionVec, LCCollectionVec * alignmentCollectionVec, LCCollectionVec * alignmentPAlpideCollectionVec)
+{
+  EUTelAlignmentConstant * alignmentPAlpide = 0;
+  if (!_oneAlignmentCollection)
   {
-    alignment = static_cast< EUTelAlignmentConstant* > (alignmentCollectionVec->getElementAt(iAlign));
-    if (alignment->getSensorID() == _dutID)
-    {
-      alignExist = true;
-      inputVec[0] += alignment->getXOffset();
-      inputVec[1] += alignment->getYOffset();
-      inputVec[2] += alignment->getZOffset();
-      inputVec.RotateZ( alignment->getGamma() );
-      inputVec.RotateY( alignment->getBeta() );
-      inputVec.RotateX( alignment->getAlpha() );
-      break;
-    }
+    alignmentPAlpide = FindAlignConstant(alignmentPAlpideCollectionVec,_dutID);
+    if (!alignmentPAlpide && _isFirstEvent) cerr << "No second alignment correction applied to the pAlpide!" << endl;
   }
-  if (!alignExist) return false;//cerr << "No alignment correction applied!" << endl;
-  for (int iAlign=0; iAlign<preAlignmentCollectionVec->getNumberOfElements(); iAlign++)
+  EUTelAlignmentConstant * alignment = FindAlignConstant(alignmentCollectionVec,_dutID);
+  EUTelAlignmentConstant * preAlignment = alignment ? FindAlignConstant(preAlignmentCollectionVec,_dutID) : 0;
+  _alignRemovable = (alignment != 0 && preAlignment != 0);
+  if (!_alignRemovable) return false;
+
+  // rebuild the transformation only if the constants changed
+  vector<double> constants;
+  constants.reserve(16);
+  constants.push_back(alignmentPAlpide ? 1. : 0.);
+  EUTelAlignmentConstant * rotated[2] = { alignmentPAlpide, alignment };
+  for (int iRotated=0; iRotated<2; iRotated++)
   {
-    preAlignment = static_cast< EUTelAlignmentConstant * > (preAlignmentCollectionVec->getElementAt(iAlign));
-    if (preAlignment->getSensorID() == _dutID)
+    EUTelAlignmentConstant * constant = rotated[iRotated];
+    constants.push_back(constant ? constant->getXOffset() : 0.);
+    constants.push_back(constant ? constant->getYOffset() : 0.);
+    constants.push_back(constant ? constant->getZOffset() : 0.);
+    constants.push_back(constant ? constant->getAlpha()   : 0.);
+    constants.push_back(constant ? constant->getBeta()    : 0.);
+    constants.push_back(constant ? constant->getGamma()   : 0.);
+  }
+  constants.push_back(preAlignment->getXOffset());
+  constants.push_back(preAlignment->getYOffset());
+  constants.push_back(preAlignment->getZOffset());
+  if (constants == _fitToLocalConstants) return true;
+  _fitToLocalConstants = constants;
+
+  //Remove the alignment in the same way it was applied by the EUTelProcessorApplyAlignment.cc
+  double xPlaneCenter    = geo::gGeometry().siPlaneXPosition(_dutID);
+  double yPlaneCenter    = geo::gGeometry().siPlaneYPosition(_dutID);
+  double zPlaneThickness = geo::gGeometry().siPlaneZSize(_dutID);
+  double zPlaneCenter    = geo::gGeometry().siPlaneZPosition(_dutID) + zPlaneThickness / 2.;
+
+  // all the steps are affine, they are sampled once into a single transformation
+  _fitToLocal.build( [&](const double* in, double* out) {
+    TVector3 inputVec( in[0] - xPlaneCenter, in[1] - yPlaneCenter, in[2] - zPlaneCenter);
+    if (alignmentPAlpide)
     {
-      prealignExist = true;
-      inputVec[0] += preAlignment->getXOffset();
-      inputVec[1] += preAlignment->getYOffset();
-      inputVec[2] += preAlignment->getZOffset();
-      break;
+      inputVec[0] += alignmentPAlpide->getXOffset();
+      inputVec[1] += alignmentPAlpide->getYOffset();
+      inputVec[2] += alignmentPAlpide->getZOffset();
+      inputVec.RotateZ( alignmentPAlpide->getGamma() );
+      inputVec.RotateY( alignmentPAlpide->getBeta() );
+      inputVec.RotateX( alignmentPAlpide->getAlpha() );
     }
-  }
-  if (!prealignExist) return false;//cerr << "No prealignment correction applied!" << endl;
+    inputVec[0] += alignment->getXOffset();
+    inputVec[1] += alignment->getYOffset();
+    inputVec[2] += alignment->getZOffset();
+    inputVec.RotateZ( alignment->getGamma() );
+    inputVec.RotateY( alignment->getBeta() );
+    inputVec.RotateX( alignment->getAlpha() );
+    inputVec[0] += preAlignment->getXOffset();
+    inputVec[1] += preAlignment->getYOffset();
+    inputVec[2] += preAlignment->getZOffset();
+
+    double fitpos[3];
+    fitpos[0] = inputVec.X();
+    fitpos[1] = inputVec.Y();
+    fitpos[2] = inputVec.Z() + zPlaneCenter; //since _EulerRotationBack removes the zPlaneCenter again (and adds it at the end)
+
+    _EulerRotationBack( fitpos, gRotation );
+    _LayerRotationBack( fitpos, out[0], out[1] );
+    out[2] = fitpos[2];
+  } );
+
+  return true;
+}
 
-  fitpos[0] = inputVec.X();
-  fitpos[1] = inputVec.Y();
-  fitpos[2] = inputVec.Z() + zPlaneCenter; //since _EulerRotationBack removes the zPlaneCenter again (and adds it at the end)
-  //cerr << fitpos[0] << "\t"  << fitpos[1] << "\t" << fitpos[2] << endl;
+bool EUTelProcessorAnalysisPALPIDEfs::RemoveAlign(double* fitpos, double& xposfit, double& yposfit)
+{
+  if (!_alignRemovable) return false;//cerr << "No (pre)alignment correction applied!" << endl;
 
-  _EulerRotationBack( fitpos, gRotation );
-  _LayerRotationBack(fitpos, xposfit, yposfit);
+  double local[3];
+  _fitToLocal.apply( fitpos, local );
+  xposfit   = local[0];
+  yposfit   = local[1];
+  fitpos[2] = local[2];
 
   return 1;
 }
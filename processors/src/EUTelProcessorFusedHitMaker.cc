@@ -0,0 +1,382 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+// eutelescope includes ".h"
+#include "EUTelProcessorFusedHitMaker.h"
+
+#include "EUTELESCOPE.h"
+#include "EUTelExceptions.h"
+#include "EUTelRunHeaderImpl.h"
+#include "EUTelEventImpl.h"
+#include "EUTelGeometryTelescopeGeoDescription.h"
+
+// marlin includes ".h"
+#include "marlin/Processor.h"
+#include "marlin/Exceptions.h"
+
+// lcio includes <.h>
+#include <IMPL/LCCollectionVec.h>
+#include <IMPL/TrackerDataImpl.h>
+#include <IMPL/TrackerPulseImpl.h>
+#include <IMPL/TrackerHitImpl.h>
+#include <UTIL/CellIDEncoder.h>
+#include <UTIL/CellIDDecoder.h>
+
+// system includes <>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+using namespace lcio;
+using namespace marlin;
+using namespace eutelescope;
+
+EUTelProcessorFusedHitMaker::EUTelProcessorFusedHitMaker():
+  Processor("EUTelProcessorFusedHitMaker"),
+  _zsDataCollectionName(""),
+  _noisyPixelCollectionName(""),
+  _pulseCollectionName(""),
+  _hitCollectionName(""),
+  _referenceHitCollectionName("referenceHit"),
+  _referenceHitLCIOFile("reference.slcio"),
+  _sparseMinDistanceSquared(2),
+  _ExcludedPlanes(),
+  _wantLocalCoordinates(false),
+  _iRun(0),
+  _iEvt(0),
+  _noisyPixelMap(),
+  _totHitMap(),
+  _pixelBuffer(),
+  _usedBuffer(),
+  _clusterPixels(),
+  _clusterBegin()
+{
+  // modify processor description
+  _description = "EUTelProcessorFusedHitMaker removes noisy pixels, clusters the zero suppressed data and converts the clusters into hits in a single pass";
+
+  registerInputCollection(LCIO::TRACKERDATA, "ZSDataCollectionName", "Input of Zero Suppressed data",
+                          _zsDataCollectionName, std::string("zsdata") );
+
+  registerOptionalParameter("NoisyPixelCollectionName", "Name of the noisy pixel collection",
+                            _noisyPixelCollectionName, std::string("") );
+
+  registerOptionalParameter("PulseCollectionName", "Cluster (output) collection name, leave empty to not store the clusters",
+                            _pulseCollectionName, std::string("") );
+
+  registerOutputCollection(LCIO::TRACKERHIT, "HitCollectionName", "Output hit collection name",
+                           _hitCollectionName, std::string("hit") );
+
+  registerProcessorParameter("SparseMinDistanceSquared", "Minimum distance squared between sparsified pixel ( touching == 2) ",
+                             _sparseMinDistanceSquared, static_cast<int>(2) );
+
+  registerOptionalParameter("ExcludedPlanes", "The list of sensor ids that have to be excluded from the clustering.",
+                            _ExcludedPlanes, std::vector<int>() );
+
+  registerOptionalParameter("EnableLocalCoordidates", "Hit coordinates are calculated in local reference frame of sensor",
+                            _wantLocalCoordinates, static_cast<bool>(false) );
+
+  registerOptionalParameter("ReferenceCollection", "This is the name of the reference hit collection initialized in this processor. This collection provides the reference vector to correctly determine a plane corresponding to a global hit coordiante.",
+                            _referenceHitCollectionName, std::string("referenceHit") );
+
+  registerOptionalParameter("ReferenceHitFile", "This is the file where the reference hit collection is stored",
+                            _referenceHitLCIOFile, std::string("reference.slcio") );
+}
+
+void EUTelProcessorFusedHitMaker::init() {
+  printParameters();
+
+  // set to zero the run and event counters
+  _iRun = 0;
+  _iEvt = 0;
+
+  geo::gGeometry().initializeTGeoDescription(EUTELESCOPE::GEOFILENAME, EUTELESCOPE::DUMPGEOROOT);
+
+  //only for global coord we need a refhit collection
+  if( !_wantLocalCoordinates ) {
+    Utility::writeReferenceHitDB( _referenceHitLCIOFile, _referenceHitCollectionName );
+  }
+}
+
+void EUTelProcessorFusedHitMaker::processRunHeader(LCRunHeader* rdr) {
+  std::unique_ptr<EUTelRunHeaderImpl> runHeader = std::make_unique<EUTelRunHeaderImpl>(rdr);
+  runHeader->addProcessor(type());
+  ++_iRun;
+}
+
+void EUTelProcessorFusedHitMaker::readPixels(TrackerDataImpl* zsData, int sensorID) {
+
+  _pixelBuffer.clear();
+
+  std::vector<int> const * noiseVector = nullptr;
+  auto noiseIt = _noisyPixelMap.find( sensorID );
+  if( noiseIt != _noisyPixelMap.end() && !noiseIt->second.empty() ) noiseVector = &(noiseIt->second);
+
+  // a kEUTelGenericSparsePixel is stored as x, y, signal, time
+  FloatVec const & charges = zsData->getChargeValues();
+  for( size_t i = 0; i + 3 < charges.size(); i += 4 ) {
+    FusedPixel pixel;
+    pixel.x      = static_cast<int>( charges[i] );
+    pixel.y      = static_cast<int>( charges[i+1] );
+    pixel.signal = charges[i+2];
+    pixel.time   = charges[i+3];
+
+    if( noiseVector && std::binary_search( noiseVector->begin(), noiseVector->end(), Utility::cantorEncode(pixel.x, pixel.y) ) ) {
+      continue;
+    }
+    _pixelBuffer.push_back( pixel );
+  }
+
+  // sorting along x allows to restrict the neighbour search to a window
+  std::stable_sort( _pixelBuffer.begin(), _pixelBuffer.end(),
+                    [](FusedPixel const & a, FusedPixel const & b) { return a.x < b.x; } );
+}
+
+void EUTelProcessorFusedHitMaker::findClusters() {
+
+  _usedBuffer.assign( _pixelBuffer.size(), 0 );
+  _clusterPixels.clear();
+  _clusterBegin.clear();
+
+  // pixels further apart than this along x can never be neighbours
+  int const maxDX = static_cast<int>( std::sqrt( static_cast<double>( std::max(_sparseMinDistanceSquared, 0) ) ) );
+
+  for( size_t seed = 0; seed < _pixelBuffer.size(); ++seed ) {
+    if( _usedBuffer[seed] ) continue;
+
+    _clusterBegin.push_back( _clusterPixels.size() );
+    _clusterPixels.push_back( seed );
+    _usedBuffer[seed] = 1;
+
+    // _clusterPixels doubles as the work list: every newly added pixel
+    // is checked against all the not yet clustered ones in its window
+    for( size_t k = _clusterBegin.back(); k < _clusterPixels.size(); ++k ) {
+      FusedPixel const current = _pixelBuffer[ _clusterPixels[k] ];
+
+      auto first = std::lower_bound( _pixelBuffer.begin(), _pixelBuffer.end(), current.x - maxDX,
+                                     [](FusedPixel const & p, int x) { return p.x < x; } );
+
+      for( size_t j = first - _pixelBuffer.begin(); j < _pixelBuffer.size() && _pixelBuffer[j].x <= current.x + maxDX; ++j ) {
+        if( _usedBuffer[j] ) continue;
+        int dX = current.x - _pixelBuffer[j].x;
+        int dY = current.y - _pixelBuffer[j].y;
+        if( dX*dX + dY*dY <= _sparseMinDistanceSquared ) {
+          _usedBuffer[j] = 1;
+          _clusterPixels.push_back( j );
+        }
+      }
+    }
+  }
+  _clusterBegin.push_back( _clusterPixels.size() );
+}
+
+void EUTelProcessorFusedHitMaker::processEvent(LCEvent* event) {
+
+  ++_iEvt;
+
+  if( isFirstEvent() ) {
+    //The noisy pixel collection stores all hot pixels in event #1
+    _noisyPixelMap = Utility::readNoisyPixelList( event, _noisyPixelCollectionName );
+  }
+
+  EUTelEventImpl* evt = static_cast<EUTelEventImpl*>(event);
+  if( evt->getEventType() == kEORE ) {
+    streamlog_out ( DEBUG4 ) << "EORE found: nothing else to do." << std::endl;
+    return;
+  } else if( evt->getEventType() == kUNKNOWN ) {
+    streamlog_out ( WARNING2 ) << "Event number " << evt->getEventNumber() << " in run " << evt->getRunNumber()
+                               << " is of unknown type. Continue considering it as a normal Data Event." << std::endl;
+  }
+
+  LCCollectionVec* zsInputDataCollectionVec = nullptr;
+  try {
+    zsInputDataCollectionVec = dynamic_cast<LCCollectionVec*>( event->getCollection(_zsDataCollectionName) );
+  } catch( lcio::DataNotAvailableException& e ) {
+    streamlog_out ( MESSAGE2 ) << "The current event doesn't contain nZS data collections: skip # " << event->getEventNumber() << std::endl;
+    throw SkipEventException(this);
+  }
+
+  LCCollectionVec* hitCollection = nullptr;
+  bool hitCollectionExists = false;
+  try {
+    hitCollection = dynamic_cast<LCCollectionVec*>( event->getCollection(_hitCollectionName) );
+    hitCollectionExists = true;
+  } catch( lcio::DataNotAvailableException& e ) {
+    hitCollection = new LCCollectionVec(LCIO::TRACKERHIT);
+  }
+
+  // the cluster TrackerData is always attached to the hits as raw hit,
+  // the pulses and the persistency are only for users asking for them
+  bool const storeClusters = !_pulseCollectionName.empty();
+  LCCollectionVec* pulseCollection = nullptr;
+  LCCollectionVec* sparseClusterCollectionVec = nullptr;
+  bool pulseCollectionExists = false;
+  bool isDummyAlreadyExisting = false;
+  if( storeClusters ) {
+    try {
+      pulseCollection = dynamic_cast<LCCollectionVec*>( event->getCollection(_pulseCollectionName) );
+      pulseCollectionExists = true;
+    } catch( lcio::DataNotAvailableException& e ) {
+      pulseCollection = new LCCollectionVec(LCIO::TRACKERPULSE);
+    }
+  }
+  try {
+    sparseClusterCollectionVec = dynamic_cast<LCCollectionVec*>( event->getCollection("original_zsdata") );
+    isDummyAlreadyExisting = true;
+  } catch( lcio::DataNotAvailableException& e ) {
+    sparseClusterCollectionVec = new LCCollectionVec(LCIO::TRACKERDATA);
+    sparseClusterCollectionVec->setTransient( !storeClusters );
+  }
+
+  CellIDDecoder<TrackerDataImpl> cellDecoder( zsInputDataCollectionVec );
+  CellIDEncoder<TrackerHitImpl> idHitEncoder( EUTELESCOPE::HITENCODING, hitCollection );
+  CellIDEncoder<TrackerDataImpl> idZSClusterEncoder( EUTELESCOPE::ZSCLUSTERDEFAULTENCODING, sparseClusterCollectionVec );
+  std::unique_ptr<CellIDEncoder<TrackerPulseImpl>> idZSPulseEncoder;
+  if( storeClusters ) {
+    idZSPulseEncoder = std::make_unique<CellIDEncoder<TrackerPulseImpl>>( EUTELESCOPE::PULSEDEFAULTENCODING, pulseCollection );
+  }
+
+  for( size_t idetector = 0; idetector < zsInputDataCollectionVec->size(); ++idetector ) {
+
+    TrackerDataImpl* zsData = dynamic_cast<TrackerDataImpl*>( zsInputDataCollectionVec->getElementAt(idetector) );
+    SparsePixelType type = static_cast<SparsePixelType>( static_cast<int>(cellDecoder(zsData)["sparsePixelType"]) );
+    int sensorID = static_cast<int>( cellDecoder(zsData)["sensorID"] );
+
+    //if this is an excluded sensor go to the next element
+    if( std::find( _ExcludedPlanes.begin(), _ExcludedPlanes.end(), sensorID ) != _ExcludedPlanes.end() ) {
+      continue;
+    }
+
+    if( type != kEUTelGenericSparsePixel ) {
+      streamlog_out ( ERROR4 ) << "We do not support pixel type: " << type << " in EUTelProcessorFusedHitMaker" << std::endl;
+      throw UnknownDataTypeException("Pixel type not supported by EUTelProcessorFusedHitMaker");
+    }
+
+    readPixels( zsData, sensorID );
+    if( _pixelBuffer.empty() ) continue;
+    findClusters();
+
+    double const xSize = geo::gGeometry().siPlaneXSize( sensorID );  // mm
+    double const ySize = geo::gGeometry().siPlaneYSize( sensorID );  // mm
+    double const xPitch = geo::gGeometry().siPlaneXPitch( sensorID ); // mm
+    double const yPitch = geo::gGeometry().siPlaneYPitch( sensorID ); // mm
+    double const resolutionX = geo::gGeometry().siPlaneXResolution( sensorID ); // mm
+    double const resolutionY = geo::gGeometry().siPlaneYResolution( sensorID ); // mm
+
+    for( size_t iCluster = 0; iCluster + 1 < _clusterBegin.size(); ++iCluster ) {
+
+      // charge weighted center of gravity in pixel indices
+      float xPos = 0.f, yPos = 0.f, totWeight = 0.f;
+      for( size_t k = _clusterBegin[iCluster]; k < _clusterBegin[iCluster+1]; ++k ) {
+        FusedPixel const & pixel = _pixelBuffer[ _clusterPixels[k] ];
+        xPos += pixel.x * pixel.signal;
+        yPos += pixel.y * pixel.signal;
+        totWeight += pixel.signal;
+      }
+      xPos /= totWeight;
+      yPos /= totWeight;
+
+      // LOCAL coordinate system with the origin in the sensor centre
+      double telPos[3];
+      telPos[0] = (xPos + 0.5) * xPitch - xSize/2.;
+      telPos[1] = (yPos + 0.5) * yPitch - ySize/2.;
+      telPos[2] = 0.;
+
+      if( !_wantLocalCoordinates ) {
+        const double localPos[3] = { telPos[0], telPos[1], telPos[2] };
+        geo::gGeometry().local2Master( sensorID, localPos, telPos );
+      }
+
+      // create the new hit
+      TrackerHitImpl* hit = new TrackerHitImpl;
+      hit->setPosition( &telPos[0] );
+      float cov[TRKHITNCOVMATRIX] = {0.,0.,0.,0.,0.,0.};
+      cov[0] = resolutionX * resolutionX; // cov(x,x)
+      cov[2] = resolutionY * resolutionY; // cov(y,y)
+      hit->setCovMatrix( cov );
+      hit->setType( kEUTelSparseClusterImpl );
+      hit->setTime( 0. );
+
+      // same layout as the EUTelTrackerDataInterfacerImpl would write
+      TrackerDataImpl* zsCluster = new TrackerDataImpl;
+      FloatVec& clusterCharges = zsCluster->chargeValues();
+      clusterCharges.reserve( 4*(_clusterBegin[iCluster+1] - _clusterBegin[iCluster]) );
+      for( size_t k = _clusterBegin[iCluster]; k < _clusterBegin[iCluster+1]; ++k ) {
+        FusedPixel const & pixel = _pixelBuffer[ _clusterPixels[k] ];
+        clusterCharges.push_back( static_cast<float>(pixel.x) );
+        clusterCharges.push_back( static_cast<float>(pixel.y) );
+        clusterCharges.push_back( pixel.signal );
+        clusterCharges.push_back( pixel.time );
+      }
+
+      idZSClusterEncoder["sensorID"] = sensorID;
+      idZSClusterEncoder["sparsePixelType"] = static_cast<int>( type );
+      idZSClusterEncoder["quality"] = 0;
+      idZSClusterEncoder.setCellID( zsCluster );
+      sparseClusterCollectionVec->push_back( zsCluster );
+
+      if( storeClusters ) {
+        TrackerPulseImpl* zsPulse = new TrackerPulseImpl;
+        (*idZSPulseEncoder)["sensorID"] = sensorID;
+        (*idZSPulseEncoder)["type"] = static_cast<int>(kEUTelSparseClusterImpl);
+        idZSPulseEncoder->setCellID( zsPulse );
+        zsPulse->setTrackerData( zsCluster );
+        pulseCollection->push_back( zsPulse );
+      }
+
+      // consumers of the hits expect the cluster as first raw hit
+      LCObjectVec clusterVec;
+      clusterVec.push_back( zsCluster );
+      hit->rawHits() = clusterVec;
+
+      idHitEncoder["sensorID"] = sensorID;
+      idHitEncoder["properties"] = 0;
+      if( !_wantLocalCoordinates ) idHitEncoder["properties"] = kHitInGlobalCoord;
+      idHitEncoder.setCellID( hit );
+
+      hitCollection->push_back( hit );
+      _totHitMap[sensorID] += 1;
+    }
+  }
+
+  if( !isDummyAlreadyExisting ) {
+    if( sparseClusterCollectionVec->size() != 0 ) {
+      evt->addCollection( sparseClusterCollectionVec, "original_zsdata" );
+    } else {
+      delete sparseClusterCollectionVec;
+    }
+  }
+
+  if( storeClusters ) {
+    if( !pulseCollectionExists ) {
+      if( pulseCollection->size() != 0 ) {
+        evt->addCollection( pulseCollection, _pulseCollectionName );
+      } else {
+        delete pulseCollection;
+      }
+    }
+  }
+
+  if( !hitCollectionExists ) {
+    evt->addCollection( hitCollection, _hitCollectionName );
+  }
+
+  _isFirstEvent = false;
+}
+
+void EUTelProcessorFusedHitMaker::end() {
+  streamlog_out ( MESSAGE4 ) << "Successfully finished" << std::endl;
+
+  for( auto const & entry: _totHitMap ) {
+    streamlog_out ( MESSAGE4 ) << "Sensor " << std::setw(3) << entry.first << ": " << entry.second << " hits" << std::endl;
+  }
+}
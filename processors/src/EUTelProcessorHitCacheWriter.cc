@@ -0,0 +1,156 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+// eutelescope includes ".h"
+#include "EUTelProcessorHitCacheWriter.h"
+
+#include "EUTELESCOPE.h"
+#include "EUTelRunHeaderImpl.h"
+#include "EUTelEventImpl.h"
+
+// marlin includes ".h"
+#include "marlin/Processor.h"
+#include "marlin/Exceptions.h"
+
+// lcio includes <.h>
+#include <IMPL/TrackerHitImpl.h>
+#include <IMPL/TrackerDataImpl.h>
+#include <IMPL/TrackerPulseImpl.h>
+#include <UTIL/CellIDDecoder.h>
+
+// system includes <>
+#include <string>
+#include <vector>
+#include <memory>
+
+using namespace lcio;
+using namespace marlin;
+using namespace eutelescope;
+
+EUTelProcessorHitCacheWriter::EUTelProcessorHitCacheWriter():
+  Processor("EUTelProcessorHitCacheWriter"),
+  _hitCollectionName(""),
+  _hitCacheFileName(""),
+  _iRun(0),
+  _iEvt(0),
+  _writer(),
+  _eventHits()
+{
+  // modify processor description
+  _description = "EUTelProcessorHitCacheWriter writes the hits into a compact, memory mappable hit cache file";
+
+  registerInputCollection(LCIO::TRACKERHIT, "HitCollectionName", "Input hit collection name",
+                          _hitCollectionName, std::string("hit") );
+
+  registerProcessorParameter("HitCacheFileName", "Name of the output hit cache file",
+                             _hitCacheFileName, std::string("hits.cache") );
+}
+
+void EUTelProcessorHitCacheWriter::init() {
+  printParameters();
+
+  // set to zero the run and event counters
+  _iRun = 0;
+  _iEvt = 0;
+
+  if( !_writer.open( _hitCacheFileName ) ) {
+    streamlog_out ( ERROR5 ) << "Unable to create the temporary files for " << _hitCacheFileName << std::endl;
+    throw StopProcessingException(this);
+  }
+}
+
+void EUTelProcessorHitCacheWriter::processRunHeader(LCRunHeader* rdr) {
+  std::unique_ptr<EUTelRunHeaderImpl> runHeader = std::make_unique<EUTelRunHeaderImpl>(rdr);
+  runHeader->addProcessor(type());
+  ++_iRun;
+}
+
+void EUTelProcessorHitCacheWriter::processEvent(LCEvent* event) {
+
+  ++_iEvt;
+
+  EUTelEventImpl* evt = static_cast<EUTelEventImpl*>(event);
+  if( evt->getEventType() == kEORE ) {
+    streamlog_out ( DEBUG4 ) << "EORE found: nothing else to do." << std::endl;
+    return;
+  } else if( evt->getEventType() == kUNKNOWN ) {
+    streamlog_out ( WARNING2 ) << "Event number " << evt->getEventNumber() << " in run " << evt->getRunNumber()
+                               << " is of unknown type. Continue considering it as a normal Data Event." << std::endl;
+  }
+
+  _eventHits.clear();
+
+  LCCollection* hitCollection = nullptr;
+  try {
+    hitCollection = event->getCollection(_hitCollectionName);
+  } catch( lcio::DataNotAvailableException& e ) {
+    streamlog_out ( DEBUG4 ) << _hitCollectionName << " collection not available in event " << event->getEventNumber() << std::endl;
+    _writer.addEvent( event->getRunNumber(), event->getEventNumber(), _eventHits );
+    return;
+  }
+
+  std::string encoding = hitCollection->getParameters().getStringVal( LCIO::CellIDEncoding );
+  if( encoding.empty() ) encoding = EUTELESCOPE::HITENCODING;
+  CellIDDecoder<TrackerHitImpl> hitDecoder( encoding );
+
+  _eventHits.reserve( hitCollection->getNumberOfElements() );
+
+  for( int iHit = 0; iHit < hitCollection->getNumberOfElements(); ++iHit ) {
+    TrackerHitImpl* hit = static_cast<TrackerHitImpl*>( hitCollection->getElementAt(iHit) );
+
+    EUTelCachedHit cached;
+    const double* pos = hit->getPosition();
+    cached.x = static_cast<float>( pos[0] );
+    cached.y = static_cast<float>( pos[1] );
+    cached.z = static_cast<float>( pos[2] );
+    const FloatVec& cov = hit->getCovMatrix();
+    cached.covXX = cov.size() > 2 ? cov[0] : 0.f;
+    cached.covYY = cov.size() > 2 ? cov[2] : 0.f;
+    cached.sensorID = hitDecoder(hit)["sensorID"];
+    cached.properties = hitDecoder(hit)["properties"];
+    cached.type = hit->getType();
+    cached.clusterSize = 0;
+    cached.charge = 0.f;
+
+    // the cluster is attached either directly or through its pulse;
+    // its charge values are kEUTelGenericSparsePixel: x, y, signal, time
+    const LCObjectVec& rawHits = hit->getRawHits();
+    if( !rawHits.empty() ) {
+      TrackerDataImpl* cluster = dynamic_cast<TrackerDataImpl*>( rawHits[0] );
+      TrackerPulseImpl* pulse = dynamic_cast<TrackerPulseImpl*>( rawHits[0] );
+      if( pulse ) cluster = dynamic_cast<TrackerDataImpl*>( pulse->getTrackerData() );
+      if( cluster ) {
+        const FloatVec& charges = cluster->getChargeValues();
+        cached.clusterSize = static_cast<int>( charges.size() / 4 );
+        for( size_t i = 2; i < charges.size(); i += 4 ) cached.charge += charges[i];
+      }
+      if( pulse && cached.charge == 0.f ) cached.charge = pulse->getCharge();
+    } else {
+      // a hit read back from a cache
+      cached.clusterSize = hit->ext<EUTelCachedClusterSize>();
+      cached.charge = hit->getEDep();
+    }
+
+    _eventHits.push_back( cached );
+  }
+
+  _writer.addEvent( event->getRunNumber(), event->getEventNumber(), _eventHits );
+}
+
+void EUTelProcessorHitCacheWriter::end() {
+
+  std::uint64_t const nEvents = _writer.getNumberOfEvents();
+  std::uint64_t const nHits = _writer.getNumberOfHits();
+
+  if( _writer.close() ) {
+    streamlog_out ( MESSAGE4 ) << nHits << " hits in " << nEvents << " events written to " << _hitCacheFileName << std::endl;
+  } else {
+    streamlog_out ( ERROR5 ) << "Unable to write the hit cache file " << _hitCacheFileName << std::endl;
+  }
+}
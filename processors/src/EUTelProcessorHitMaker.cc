@@ -26,6 +26,7 @@
 #include "EUTelDFFClusterImpl.h"
 #include "EUTelBrickedClusterImpl.h"
 #include "EUTelSparseClusterImpl.h"
+#include "EUTelEtaFunctionImpl.h"
 
 #include "EUTelExceptions.h"
 #include "EUTelAlignmentConstant.h"
@@ -83,6 +84,7 @@ _wantLocalCoordinates(false),
 _referenceHitLCIOFile("reference.slcio"),
 _iRun(0),
 _iEvt(0),
+_nEtaCorrectedHits(0),
 _conversionIdMap(),
 _alreadyBookedSensorID(),
 _aidaHistoMap(),
@@ -109,6 +111,7 @@ void EUTelProcessorHitMaker::init(){
 	// set to zero the run and event counters
 	_iRun = 0;
 	_iEvt = 0;
+	_nEtaCorrectedHits = 0;
 
 	geo::gGeometry().initializeTGeoDescription(EUTELESCOPE::GEOFILENAME, EUTELESCOPE::DUMPGEOROOT);
 
@@ -121,84 +124,7 @@ void EUTelProcessorHitMaker::init(){
 }
 
 void EUTelProcessorHitMaker::DumpReferenceHitDB() {
-	// create a reference hit collection file (DB)
-  LCWriter* lcWriter = LCFactory::getInstance()->createLCWriter();
-  try {
-    lcWriter->open( _referenceHitLCIOFile, LCIO::WRITE_NEW    );
-  } catch ( IOException& e ) {
-    streamlog_out ( ERROR4 ) << e.what() << endl;
-    exit(-1);
-  }
-
-  streamlog_out ( MESSAGE5 ) << "Writing to " << _referenceHitLCIOFile << std::endl;
-
-  LCRunHeaderImpl * lcHeader  = new LCRunHeaderImpl;
-  lcHeader->setRunNumber( 0 );
-  lcWriter->writeRunHeader(lcHeader);
-  delete lcHeader;
-  LCEventImpl * event = new LCEventImpl;
-  event->setRunNumber( 0 );
-  event->setEventNumber( 0 );
-  LCTime * now = new LCTime;
-  event->setTimeStamp( now->timeStamp() );
-  delete now;
-
-  LCCollectionVec * referenceHitCollection = new LCCollectionVec( LCIO::LCGENERICOBJECT );
-  double refVec[3] ;
-
-  EVENT::IntVec sensorIDVec = geo::gGeometry().sensorIDsVec();
-  
-  for(EVENT::IntVec::iterator it = sensorIDVec.begin(); it != sensorIDVec.end(); it++)
-  {
-    EUTelReferenceHit* refhit = new EUTelReferenceHit();
-
-    int sensorID = *it; 
-    refhit->setSensorID( sensorID );
-    refhit->setXOffset( geo::gGeometry().siPlaneXPosition( sensorID ) );
-    refhit->setYOffset( geo::gGeometry().siPlaneYPosition(sensorID) );
-    refhit->setZOffset( geo::gGeometry().siPlaneZPosition(sensorID) + 0.5*geo::gGeometry().siPlaneZSize(sensorID) );
-    
-    refVec[0] = 0.;
-    refVec[1] = 0.;
-    refVec[2] = 1.;
-  
-    double gRotation[3] = { 0., 0., 0.}; // not rotated
-    gRotation[0] = geo::gGeometry().siPlaneZRotation(sensorID); // Euler alpha ;
-    gRotation[1] = geo::gGeometry().siPlaneYRotation(sensorID); // Euler alpha ;
-    gRotation[2] = geo::gGeometry().siPlaneXRotation(sensorID); // Euler alpha ;
-    streamlog_out( DEBUG5 ) << "GEAR rotations: " << gRotation[0] << " " << gRotation[1] << " " <<  gRotation[2] << endl;
-    gRotation[0] =  gRotation[0]*3.1415926/180.; // 
-    gRotation[1] =  gRotation[1]*3.1415926/180.; //
-    gRotation[2] =  gRotation[2]*3.1415926/180.; //
-
-    TVector3 _RotatedVector( refVec[0], refVec[1], refVec[2] );
-    TVector3 _Xaxis( 1.0, 0.0, 0.0 );
-    TVector3 _Yaxis( 0.0, 1.0, 0.0 );
-    TVector3 _Zaxis( 0.0, 0.0, 1.0 );
-
-    if( TMath::Abs( gRotation[2]) > 1e-6 ) 
-    {
-        _RotatedVector.Rotate(  gRotation[2], _Xaxis ); // in ZY
-    }
-    if( TMath::Abs( gRotation[1]) > 1e-6 ) 
-    {
-        _RotatedVector.Rotate(  gRotation[1], _Yaxis ); // in ZX 
-    }
-    if( TMath::Abs( gRotation[0]) > 1e-6 ) 
-    {   
-        _RotatedVector.Rotate(  gRotation[0], _Zaxis ); // in XY
-    }
- 
-     refhit->setAlpha( _RotatedVector[0] );
-     refhit->setBeta( _RotatedVector[1] );
-     refhit->setGamma( _RotatedVector[2] );
-     referenceHitCollection->push_back( refhit );
-  }
-  event->addCollection( referenceHitCollection, _referenceHitCollectionName );
-
-  lcWriter->writeEvent( event );
-  delete event;
-  lcWriter->close();
+  Utility::writeReferenceHitDB( _referenceHitLCIOFile, _referenceHitCollectionName );
 }
 
 
@@ -265,6 +191,13 @@ void EUTelProcessorHitMaker::processEvent (LCEvent * event) {
     CellIDDecoder<TrackerPulseImpl> clusterCellDecoder(pulseCollection);
     CellIDDecoder<TrackerDataImpl> cellDecoder(EUTELESCOPE::ZSDATADEFAULTENCODING);
 
+    // the clusters of the previous event are not used any more
+    _clusterPool.recycle();
+
+    // the plane parameters and transformations of this event
+    std::shared_ptr<const geo::EUTelGeometrySnapshot> geometry = geo::gGeometry().getSnapshot();
+    int planeIndex = -1;
+
     int oldDetectorID = -100;
 
     double xSize = 0., ySize = 0.;
@@ -295,20 +228,24 @@ void EUTelProcessorHitMaker::processEvent (LCEvent * event) {
 							bookHistos( sensorID );
 					}
 
-					resolutionX  = geo::gGeometry().siPlaneXResolution( sensorID );// mm
-					resolutionY  = geo::gGeometry().siPlaneYResolution( sensorID );// mm
+					geo::EUTelPlane const & plane = geometry->planeOfSensor( sensorID ).setup;
+					planeIndex   = geometry->index( sensorID );
 
-					xSize        = geo::gGeometry().siPlaneXSize ( sensorID );    // mm
-					ySize        = geo::gGeometry().siPlaneYSize ( sensorID );    // mm
+					resolutionX  = plane.xRes;      // mm
+					resolutionY  = plane.yRes;      // mm
 
-					xPitch       = geo::gGeometry().siPlaneXPitch( sensorID );    // mm
-					yPitch       = geo::gGeometry().siPlaneYPitch( sensorID );    // mm
+					xSize        = plane.xSize;     // mm
+					ySize        = plane.ySize;     // mm
+
+					xPitch       = plane.xPitch;    // mm
+					yPitch       = plane.yPitch;    // mm
 
 			}
 
 
 			// LOCAL coordinate system !!!!!!
 			double telPos[3];
+			bool isEtaCorrected = false;
 			
 			if(clusterType == kEUTelGenericSparseClusterImpl)
 			{
@@ -349,7 +286,7 @@ void EUTelProcessorHitMaker::processEvent (LCEvent * event) {
 
 			else
 			{
-					EUTelSparseClusterImpl<EUTelGenericSparsePixel>* cluster = new EUTelSparseClusterImpl<EUTelGenericSparsePixel>(trackerData);
+					EUTelSparseClusterImpl<EUTelGenericSparsePixel>* cluster = _clusterPool.acquire(trackerData);
 
 					// get the position of the seed pixel. This is in pixel number.
 					int xCluSeed = 0;
@@ -396,6 +333,15 @@ void EUTelProcessorHitMaker::processEvent (LCEvent * event) {
 					xDet = (xCoG + 0.5) * xPitch;
 					yDet = (yCoG + 0.5) * yPitch; 
 
+					// the eta correction attached by EUTelCalculateEtaProcessor
+					// in single pass mode replaces the plain CoG
+					if( const EUTelEtaCorrectedShift* etaShift = pulse->ext<EUTelEtaCorrectedShiftExtension>() )
+					{
+							xDet = ( static_cast<double> (xCluSeed) + etaShift->x + 0.5 ) * xPitch ;
+							yDet = ( static_cast<double> (yCluSeed) + etaShift->y + 0.5 ) * yPitch ;
+							isEtaCorrected = true;
+					}
+
 					streamlog_out(DEBUG1) << "cluster[" << setw(4) << iCluster << "] on sensor[" << setw(3) << sensorID 
 							<< "] at [" << setw(8) << setprecision(3) << xCoG << ":" << setw(8) << setprecision(3) << yCoG << "]"
 							<< " ->  [" << setw(8) << setprecision(3) << xDet << ":" << setw(8) << setprecision(3) << yDet << "]"
@@ -409,9 +355,6 @@ void EUTelProcessorHitMaker::processEvent (LCEvent * event) {
 					telPos[0] = xDet - xSize/2. ;
 					telPos[1] = yDet - ySize/2. ; 
 					telPos[2] =   0.;
-
-					delete cluster;
-					cluster = nullptr;
 			}
 
 
@@ -441,7 +384,7 @@ void EUTelProcessorHitMaker::processEvent (LCEvent * event) {
 					// GLOBAL coordinate system !!!
 
 					const double localPos[3] = { telPos[0], telPos[1], telPos[2] };
-					geo::gGeometry().local2Master( sensorID, localPos, telPos);
+					geometry->local2Master( planeIndex, localPos, telPos);
 
 			}
 
@@ -489,7 +432,15 @@ void EUTelProcessorHitMaker::processEvent (LCEvent * event) {
 
 			// set the local/global bit flag property for the hit
 			idHitEncoder["properties"] = 0; // init
-			if (!_wantLocalCoordinates) idHitEncoder["properties"] = kHitInGlobalCoord;
+			int properties = 0;
+			if (!_wantLocalCoordinates) properties |= kHitInGlobalCoord;
+			// mark the hits of an eta correction in the same job, the
+			// events before the eta calculation are not corrected
+			if (isEtaCorrected) {
+				properties |= kEtaCorrectedHit;
+				++_nEtaCorrectedHits;
+			}
+			idHitEncoder["properties"] = properties;
 
 			// store values
 			idHitEncoder.setCellID( hit );
@@ -512,6 +463,9 @@ void EUTelProcessorHitMaker::processEvent (LCEvent * event) {
 
 void EUTelProcessorHitMaker::end() 
 {
+  if ( _nEtaCorrectedHits > 0 ) {
+    streamlog_out ( MESSAGE4 ) << _nEtaCorrectedHits << " hits flagged as kEtaCorrectedHit" << endl;
+  }
   streamlog_out ( MESSAGE4 )  << "Successfully finished" << endl;
 }
 
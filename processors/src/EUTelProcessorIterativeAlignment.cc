@@ -0,0 +1,437 @@
+/*
+ *   This source code is part of the Eutelescope package of Marlin.
+ *   You are free to use this source files for your own development as
+ *   long as it stays in a public research context. You are not
+ *   allowed to use it for commercial purpose. You must put this
+ *   header with author names in all development based on this file.
+ *
+ */
+
+// eutelescope includes ".h"
+#include "EUTelProcessorIterativeAlignment.h"
+
+#include "EUTELESCOPE.h"
+#include "EUTelExceptions.h"
+#include "EUTelRunHeaderImpl.h"
+#include "EUTelEventImpl.h"
+#include "EUTelGeometryTelescopeGeoDescription.h"
+#include "EUTelMillepedeSolver.h"
+
+// marlin includes ".h"
+#include "marlin/Processor.h"
+#include "marlin/Global.h"
+#include "marlin/StringParameters.h"
+
+// lcio includes <.h>
+#include <IMPL/TrackerHitImpl.h>
+#include <UTIL/CellIDDecoder.h>
+
+// Eigen
+#include <Eigen/Core>
+
+// system includes <>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <memory>
+#include <cmath>
+
+using namespace lcio;
+using namespace marlin;
+using namespace eutelescope;
+
+EUTelProcessorIterativeAlignment::EUTelProcessorIterativeAlignment():
+  Processor("EUTelProcessorIterativeAlignment"),
+  _hitCollectionName(""),
+  _excludedPlanes(),
+  _fixedPlanes(),
+  _alignMode(1),
+  _residualCut(0.5),
+  _maxChi2(10.),
+  _maxIterations(10),
+  _convergenceThreshold(0.1),
+  _GEARFileSuffix("_aligned"),
+  _iRun(0),
+  _iEvt(0),
+  _planeSensorID(),
+  _planeIndexMap(),
+  _resolutionX(),
+  _resolutionY(),
+  _planeBegin(),
+  _hitLocalX(),
+  _hitLocalY(),
+  _hitGlobalX(),
+  _hitGlobalY(),
+  _hitGlobalZ(),
+  _trackHits(),
+  _fitter()
+{
+  // modify processor description
+  _description = "EUTelProcessorIterativeAlignment keeps the hits in memory and iterates track fitting and alignment until convergence, writing an aligned GEAR file";
+
+  registerInputCollection(LCIO::TRACKERHIT, "HitCollectionName", "Input hit collection name",
+                          _hitCollectionName, std::string("hit") );
+
+  registerOptionalParameter("ExcludedPlanes", "Sensor IDs of the planes not used in the alignment",
+                            _excludedPlanes, std::vector<int>() );
+
+  registerOptionalParameter("FixedPlanes", "Sensor IDs of the planes kept fixed, by default the first and the last",
+                            _fixedPlanes, std::vector<int>() );
+
+  registerOptionalParameter("AlignMode", "Alignment constants: 1 - shifts in X and Y and rotation around Z, 2 - only shifts in X and Y",
+                            _alignMode, static_cast<int>(1) );
+
+  registerOptionalParameter("ResidualCut", "Window in mm, in X and Y, for the hits added to a track",
+                            _residualCut, static_cast<float>(0.5) );
+
+  registerOptionalParameter("MaxChi2", "Maximum chi2 / ndf of the tracks used for the alignment",
+                            _maxChi2, static_cast<float>(10.) );
+
+  registerOptionalParameter("MaxIterations", "Maximum number of alignment iterations",
+                            _maxIterations, static_cast<int>(10) );
+
+  registerOptionalParameter("ConvergenceThreshold", "Stop when all the corrections are smaller than this fraction of their errors",
+                            _convergenceThreshold, static_cast<float>(0.1) );
+
+  registerOptionalParameter("NewGEARSuffix", "Suffix for the new GEAR file, set to empty string (this is not default!) to overwrite old GEAR file",
+                            _GEARFileSuffix, std::string("_aligned") );
+}
+
+void EUTelProcessorIterativeAlignment::init() {
+  printParameters();
+
+  // set to zero the run and event counters
+  _iRun = 0;
+  _iEvt = 0;
+
+  geo::gGeometry().initializeTGeoDescription(EUTELESCOPE::GEOFILENAME, EUTELESCOPE::DUMPGEOROOT);
+
+  if( _alignMode != 1 && _alignMode != 2 ) {
+    streamlog_out ( ERROR2 ) << _alignMode << " is not a valid mode. Please choose 1 or 2." << std::endl;
+    throw InvalidParameterException("AlignMode has to be 1 or 2");
+  }
+
+  // the aligned planes ordered along z
+  std::multimap<double, int> sensorZMap;
+  for( int sensorID : geo::gGeometry().sensorIDsVec() ) {
+    if( std::find( _excludedPlanes.begin(), _excludedPlanes.end(), sensorID ) != _excludedPlanes.end() ) continue;
+    sensorZMap.insert( std::make_pair( geo::gGeometry().siPlaneZPosition(sensorID), sensorID ) );
+  }
+
+  _planeSensorID.clear();
+  _planeIndexMap.clear();
+  _resolutionX.clear();
+  _resolutionY.clear();
+  for( auto const & entry : sensorZMap ) {
+    int const sensorID = entry.second;
+    _planeIndexMap[sensorID] = static_cast<int>( _planeSensorID.size() );
+    _planeSensorID.push_back( sensorID );
+
+    // fall back to the binary resolution if none is given in the GEAR file
+    double resolutionX = geo::gGeometry().siPlaneXResolution( sensorID );
+    double resolutionY = geo::gGeometry().siPlaneYResolution( sensorID );
+    if( resolutionX <= 0. ) resolutionX = geo::gGeometry().siPlaneXPitch( sensorID ) / std::sqrt(12.);
+    if( resolutionY <= 0. ) resolutionY = geo::gGeometry().siPlaneYPitch( sensorID ) / std::sqrt(12.);
+    _resolutionX.push_back( resolutionX );
+    _resolutionY.push_back( resolutionY );
+  }
+
+  if( _planeSensorID.size() < 3 ) {
+    throw InvalidParameterException("At least three planes are needed for the alignment");
+  }
+
+  if( _fixedPlanes.empty() ) {
+    _fixedPlanes.push_back( _planeSensorID.front() );
+    _fixedPlanes.push_back( _planeSensorID.back() );
+  }
+
+  _planeBegin.assign( 1, 0 );
+  _hitLocalX.clear();
+  _hitLocalY.clear();
+}
+
+void EUTelProcessorIterativeAlignment::processRunHeader(LCRunHeader* rdr) {
+  std::unique_ptr<EUTelRunHeaderImpl> runHeader = std::make_unique<EUTelRunHeaderImpl>(rdr);
+  runHeader->addProcessor(type());
+  ++_iRun;
+}
+
+void EUTelProcessorIterativeAlignment::processEvent(LCEvent* event) {
+
+  ++_iEvt;
+
+  EUTelEventImpl* evt = static_cast<EUTelEventImpl*>(event);
+  if( evt->getEventType() == kEORE ) {
+    streamlog_out ( DEBUG4 ) << "EORE found: nothing else to do." << std::endl;
+    return;
+  } else if( evt->getEventType() == kUNKNOWN ) {
+    streamlog_out ( WARNING2 ) << "Event number " << evt->getEventNumber() << " in run " << evt->getRunNumber()
+                               << " is of unknown type. Continue considering it as a normal Data Event." << std::endl;
+  }
+
+  LCCollection* hitCollection = nullptr;
+  try {
+    hitCollection = event->getCollection(_hitCollectionName);
+  } catch( lcio::DataNotAvailableException& e ) {
+    streamlog_out ( DEBUG4 ) << _hitCollectionName << " collection not available in event " << event->getEventNumber() << std::endl;
+    return;
+  }
+
+  std::string encoding = hitCollection->getParameters().getStringVal( LCIO::CellIDEncoding );
+  if( encoding.empty() ) encoding = EUTELESCOPE::HITENCODING;
+  CellIDDecoder<TrackerHitImpl> hitDecoder( encoding );
+
+  // group the hits by plane before appending them to the resident arrays
+  size_t const nPlanes = _planeSensorID.size();
+  std::vector< std::vector<double> > planeX( nPlanes ), planeY( nPlanes );
+
+  for( int iHit = 0; iHit < hitCollection->getNumberOfElements(); ++iHit ) {
+    TrackerHitImpl* hit = static_cast<TrackerHitImpl*>( hitCollection->getElementAt(iHit) );
+    int const sensorID = hitDecoder(hit)["sensorID"];
+    auto planeIt = _planeIndexMap.find( sensorID );
+    if( planeIt == _planeIndexMap.end() ) continue;
+
+    double localPos[3];
+    const double* pos = hit->getPosition();
+    if( hitDecoder(hit)["properties"] & kHitInGlobalCoord ) {
+      // the TGeo description still holds the starting geometry here
+      geo::gGeometry().master2Local( sensorID, pos, localPos );
+    } else {
+      std::copy( pos, pos + 3, localPos );
+    }
+    planeX[planeIt->second].push_back( localPos[0] );
+    planeY[planeIt->second].push_back( localPos[1] );
+  }
+
+  // events without a hit on every plane can not give a track
+  for( size_t iPlane = 0; iPlane < nPlanes; ++iPlane ) {
+    if( planeX[iPlane].empty() ) return;
+  }
+
+  for( size_t iPlane = 0; iPlane < nPlanes; ++iPlane ) {
+    _hitLocalX.insert( _hitLocalX.end(), planeX[iPlane].begin(), planeX[iPlane].end() );
+    _hitLocalY.insert( _hitLocalY.end(), planeY[iPlane].begin(), planeY[iPlane].end() );
+    _planeBegin.push_back( _hitLocalX.size() );
+  }
+}
+
+void EUTelProcessorIterativeAlignment::moveHitsToGlobal() {
+
+  size_t const nPlanes = _planeSensorID.size();
+  size_t const nEvents = ( _planeBegin.size() - 1 ) / nPlanes;
+
+  _hitGlobalX.resize( _hitLocalX.size() );
+  _hitGlobalY.resize( _hitLocalX.size() );
+  _hitGlobalZ.resize( _hitLocalX.size() );
+
+  // the snapshot follows the plane parameters updated by the previous
+  // iterations, with the same transformation as the hit maker
+  std::shared_ptr<const geo::EUTelGeometrySnapshot> geometry = geo::gGeometry().getSnapshot();
+
+  for( size_t iPlane = 0; iPlane < nPlanes; ++iPlane ) {
+    geo::EUTelGeometrySnapshot::Plane const & plane = geometry->planeOfSensor( _planeSensorID[iPlane] );
+    Eigen::Matrix3d const & rotation = plane.rotation;
+    Eigen::Vector3d const & offset = plane.offset;
+
+    for( size_t iEvent = 0; iEvent < nEvents; ++iEvent ) {
+      size_t const begin = _planeBegin[iEvent * nPlanes + iPlane];
+      size_t const end   = _planeBegin[iEvent * nPlanes + iPlane + 1];
+      for( size_t iHit = begin; iHit < end; ++iHit ) {
+        Eigen::Vector3d const global = offset + rotation.col(0) * _hitLocalX[iHit] + rotation.col(1) * _hitLocalY[iHit];
+        _hitGlobalX[iHit] = global(0);
+        _hitGlobalY[iHit] = global(1);
+        _hitGlobalZ[iHit] = global(2);
+      }
+    }
+  }
+}
+
+void EUTelProcessorIterativeAlignment::findTracks() {
+
+  size_t const nPlanes = _planeSensorID.size();
+  size_t const nEvents = ( _planeBegin.size() - 1 ) / nPlanes;
+
+  _trackHits.clear();
+  _fitter.reset( static_cast<int>( nPlanes ) );
+
+  std::vector<size_t> candidate( nPlanes );
+  std::vector<double> x( nPlanes ), y( nPlanes ), z( nPlanes );
+
+  for( size_t iEvent = 0; iEvent < nEvents; ++iEvent ) {
+    size_t const * begin = &_planeBegin[iEvent * nPlanes];
+
+    // follow a straight line from each hit of the first plane
+    for( size_t seed = begin[0]; seed < begin[1]; ++seed ) {
+      candidate[0] = seed;
+      double slopeX = 0., slopeY = 0.;
+      bool complete = true;
+
+      for( size_t iPlane = 1; iPlane < nPlanes && complete; ++iPlane ) {
+        double bestDistance2 = -1.;
+        for( size_t iHit = begin[iPlane]; iHit < begin[iPlane + 1]; ++iHit ) {
+          double const dz = _hitGlobalZ[iHit] - _hitGlobalZ[seed];
+          double const dx = _hitGlobalX[iHit] - ( _hitGlobalX[seed] + slopeX * dz );
+          double const dy = _hitGlobalY[iHit] - ( _hitGlobalY[seed] + slopeY * dz );
+          if( std::fabs(dx) > _residualCut || std::fabs(dy) > _residualCut ) continue;
+          double const distance2 = dx * dx + dy * dy;
+          if( bestDistance2 < 0. || distance2 < bestDistance2 ) {
+            bestDistance2 = distance2;
+            candidate[iPlane] = iHit;
+          }
+        }
+        if( bestDistance2 < 0. ) {
+          complete = false;
+          break;
+        }
+
+        size_t const matched = candidate[iPlane];
+        double const dz = _hitGlobalZ[matched] - _hitGlobalZ[seed];
+        if( dz != 0. ) {
+          slopeX = ( _hitGlobalX[matched] - _hitGlobalX[seed] ) / dz;
+          slopeY = ( _hitGlobalY[matched] - _hitGlobalY[seed] ) / dz;
+        }
+      }
+      if( !complete ) continue;
+
+      for( size_t iPlane = 0; iPlane < nPlanes; ++iPlane ) {
+        x[iPlane] = _hitGlobalX[candidate[iPlane]];
+        y[iPlane] = _hitGlobalY[candidate[iPlane]];
+        z[iPlane] = _hitGlobalZ[candidate[iPlane]];
+      }
+      _fitter.addTrack( x.data(), y.data(), z.data(), _resolutionX.data(), _resolutionY.data() );
+      _trackHits.insert( _trackHits.end(), candidate.begin(), candidate.end() );
+    }
+  }
+
+  _fitter.fit();
+}
+
+bool EUTelProcessorIterativeAlignment::alignIteration(int iteration, bool & converged) {
+
+  int const nPlanes = static_cast<int>( _planeSensorID.size() );
+  int const nParameters = ( _alignMode == 1 ) ? 3 : 2;
+  int const ndf = 2 * nPlanes - 4;
+
+  moveHitsToGlobal();
+  findTracks();
+
+  EUTelMillepedeSolver solver;
+
+  for( int iPlane = 0; iPlane < nPlanes; ++iPlane ) {
+    bool const fixed = std::find( _fixedPlanes.begin(), _fixedPlanes.end(), _planeSensorID[iPlane] ) != _fixedPlanes.end();
+    for( int iPar = 0; iPar < nParameters; ++iPar ) {
+      solver.setParameter( iPlane * nParameters + iPar + 1, 0., fixed ? -1. : 0. );
+    }
+  }
+
+  // the corrections act on the hit positions as
+  //   x' = x - dx + gamma ( y - y0 )
+  //   y' = y - dy - gamma ( x - x0 )
+  // with (x0, y0) the plane center, as applied in EUTelPedeGEAR
+  float derLC[4];
+  float derGL[3];
+  int label[3];
+  int nAccepted = 0;
+
+  for( int iTrack = 0; iTrack < _fitter.getNumberOfTracks(); ++iTrack ) {
+    if( !_fitter.isValid(iTrack) ) continue;
+    if( ( _fitter.getChi2X(iTrack) + _fitter.getChi2Y(iTrack) ) / ndf > _maxChi2 ) continue;
+
+    for( int iPlane = 0; iPlane < nPlanes; ++iPlane ) {
+      int const sensorID = _planeSensorID[iPlane];
+      size_t const iHit = _trackHits[ iTrack * nPlanes + iPlane ];
+      double const z = _hitGlobalZ[iHit];
+      double const x0 = geo::gGeometry().siPlaneXPosition( sensorID );
+      double const y0 = geo::gGeometry().siPlaneYPosition( sensorID );
+      for( int iPar = 0; iPar < nParameters; ++iPar ) label[iPar] = iPlane * nParameters + iPar + 1;
+
+      derLC[0] = 1.; derLC[1] = z; derLC[2] = 0.; derLC[3] = 0.;
+      derGL[0] = 1.; derGL[1] = 0.; derGL[2] = -( _hitGlobalY[iHit] - y0 );
+      solver.mille( 4, derLC, nParameters, derGL, label,
+                    -_fitter.getResidualX(iPlane, iTrack), _resolutionX[iPlane] );
+
+      derLC[0] = 0.; derLC[1] = 0.; derLC[2] = 1.; derLC[3] = z;
+      derGL[0] = 0.; derGL[1] = 1.; derGL[2] = _hitGlobalX[iHit] - x0;
+      solver.mille( 4, derLC, nParameters, derGL, label,
+                    -_fitter.getResidualY(iPlane, iTrack), _resolutionY[iPlane] );
+    }
+    solver.end();
+    ++nAccepted;
+  }
+
+  streamlog_out ( MESSAGE4 ) << "Iteration " << iteration << ": " << _fitter.getNumberOfTracks() << " track candidates, "
+                             << nAccepted << " used for the alignment" << std::endl;
+
+  if( nAccepted == 0 || !solver.solve() ) {
+    streamlog_out ( ERROR2 ) << "Iteration " << iteration << ": the alignment can not be solved" << std::endl;
+    return false;
+  }
+
+  if( solver.getNdf() > 0 ) {
+    streamlog_out ( MESSAGE4 ) << "Iteration " << iteration << ": Sum(Chi^2)/Sum(Ndf) = "
+                               << solver.getChi2() / solver.getNdf() << std::endl;
+  }
+
+  // apply the corrections to the geometry and check the convergence
+  converged = true;
+  for( int iPlane = 0; iPlane < nPlanes; ++iPlane ) {
+    int const sensorID = _planeSensorID[iPlane];
+    double correction[3] = { 0., 0., 0. };
+    for( int iPar = 0; iPar < nParameters; ++iPar ) {
+      int const parLabel = iPlane * nParameters + iPar + 1;
+      correction[iPar] = solver.getValue( parLabel );
+      double const error = solver.getError( parLabel );
+      if( error > 0. && std::fabs( correction[iPar] ) > _convergenceThreshold * error ) converged = false;
+    }
+
+    geo::gGeometry().setPlaneXPosition( sensorID, geo::gGeometry().siPlaneXPosition( sensorID ) - correction[0] );
+    geo::gGeometry().setPlaneYPosition( sensorID, geo::gGeometry().siPlaneYPosition( sensorID ) - correction[1] );
+    if( correction[2] != 0. ) {
+      Eigen::Matrix3d const rotOld = geo::gGeometry().rotationMatrixFromAngles( sensorID );
+      Eigen::Matrix3d const rotAlign = geo::gGeometry().rotationMatrixFromAngles( 0., 0., -correction[2] );
+      Eigen::Vector3d const newCoeff = geo::gGeometry().getRotationAnglesFromMatrix( rotAlign * rotOld );
+      geo::gGeometry().setPlaneXRotationRadians( sensorID, newCoeff[0] );
+      geo::gGeometry().setPlaneYRotationRadians( sensorID, newCoeff[1] );
+      geo::gGeometry().setPlaneZRotationRadians( sensorID, newCoeff[2] );
+    }
+
+    streamlog_out ( MESSAGE2 ) << "Iteration " << iteration << ", sensor " << sensorID << ": xOff: " << correction[0]
+                               << ", yOff: " << correction[1] << ", gamma: " << correction[2] << std::endl;
+  }
+
+  return true;
+}
+
+void EUTelProcessorIterativeAlignment::end() {
+
+  size_t const nEvents = ( _planeBegin.size() - 1 ) / _planeSensorID.size();
+  streamlog_out ( MESSAGE4 ) << nEvents << " events with hits on all the " << _planeSensorID.size()
+                             << " planes kept in memory" << std::endl;
+
+  if( nEvents == 0 ) {
+    streamlog_out ( ERROR2 ) << "No events to align, the GEAR file is not written" << std::endl;
+    return;
+  }
+
+  bool converged = false;
+  int iteration = 1;
+  for( ; iteration <= _maxIterations && !converged; ++iteration ) {
+    if( !alignIteration( iteration, converged ) ) {
+      streamlog_out ( ERROR2 ) << "Alignment failed, the GEAR file is not written" << std::endl;
+      return;
+    }
+  }
+
+  if( converged ) {
+    streamlog_out ( MESSAGE4 ) << "The alignment converged after " << iteration - 1 << " iterations" << std::endl;
+  } else {
+    streamlog_out ( WARNING2 ) << "The alignment did not converge in " << _maxIterations << " iterations" << std::endl;
+  }
+
+  marlin::StringParameters* MarlinStringParams = marlin::Global::parameters;
+  std::string const gearFile = MarlinStringParams->getStringVal("GearXMLFile");
+  std::string const outputFilename = gearFile.substr( 0, gearFile.size() - 4 ) + _GEARFileSuffix + ".xml";
+  streamlog_out ( MESSAGE4 ) << "Writing the aligned geometry into " << outputFilename << std::endl;
+  geo::gGeometry().writeGEARFile( outputFilename );
+}
@@ -50,6 +50,8 @@
 #include <iostream>
 #include <iterator>
 #include <stdexcept>
+#include <algorithm>
+#include <future>
 
 namespace eutelescope {
 
@@ -69,7 +71,9 @@ EUTelProcessorNoisyPixelFinder::EUTelProcessorNoisyPixelFinder():
   _iEvt(0),
   _sensorIDVec(),
   _noisyPixelDBFile(""),
-  _finished(false)
+  _finished(false),
+  _updateInterval(0),
+  _updateCollectionName("")
 {
   //processor description
   _description = "EUTelProcessorNoisyPixelFinder computes the firing frequency of pixels and applies a cut on this value to mask (NOT remove) noisy pixels.";
@@ -90,6 +94,12 @@ EUTelProcessorNoisyPixelFinder::EUTelProcessorNoisyPixelFinder():
 
   registerOptionalParameter("HotPixelCollectionName", "This is the name of the hot pixel collection to be saved into the output slcio file",
                              _noisyPixelCollectionName, std::string("noisyPixel"));
+
+  registerOptionalParameter("UpdateInterval", "If larger than zero, an intermediate noisy pixel collection is added to the event every UpdateInterval events",
+                             _updateInterval, static_cast<int>(0) );
+
+  registerOutputCollection(LCIO::TRACKERDATA, "UpdateCollectionName", "Name of the intermediate noisy pixel collection added to the event (transient, not written out)",
+                             _updateCollectionName, std::string("noisyPixelUpdate"));
 }
 
 void EUTelProcessorNoisyPixelFinder::initializeHitMaps() {
@@ -113,22 +123,16 @@ void EUTelProcessorNoisyPixelFinder::initializeHitMaps() {
 			thisSensor.offY = minY;
 			thisSensor.sizeY = maxY - minY+1;
 
-			//this is the 2-dimensional array used to store all the pixels, it is implemented as a vector of vectors
-			//first the x-entries-vector
-			std::vector<std::vector<int>> hitVecP = std::vector<std::vector<int>>( thisSensor.sizeX );
-
-			//and the y-entries vector
-			for(auto& i: hitVecP) {
-				//resize it now
-				i.resize(thisSensor.sizeY, 0);
-			}
+			//this is the 2-dimensional array used to store all the pixels, it is a single
+			//contiguous block of counters, x-major
+			std::vector<int> hitCount( thisSensor.sizeX*thisSensor.sizeY, 0 );
 
 			//collection to later hold the hot pixels
 			std::vector<EUTelGenericSparsePixel> noisyPixelMap;
 
 			//store all the collections/pointers in the corresponding maps
 		    	_sensorMap[sensorID] = thisSensor;
-			_hitVecMap[sensorID] = hitVecP;
+			_hitCountMap[sensorID] = hitCount;
 			_noisyPixelMap[sensorID] = noisyPixelMap;
 		} catch(std::runtime_error& e) {
 			streamlog_out ( ERROR0 ) << "Noisy pixel masker could not retrieve plane " << sensorID << std::endl;
@@ -174,17 +178,15 @@ void EUTelProcessorNoisyPixelFinder::noisyPixelFinder(EUTelEventImpl* evt) {
 			TrackerDataImpl* zsData = dynamic_cast<TrackerDataImpl*>( zsInputCollectionVec->getElementAt(iDetector) );
 			int sensorID            = static_cast<int>( cellDecoder(zsData)["sensorID"] );
 
-			sensor* currentSensor = &_sensorMap[sensorID];
-			std::vector<std::vector<int>>* hitArray = &_hitVecMap[sensorID];
-
 			//if this is an excluded sensor go to the next element
-			bool foundexcludedsensor = false;
-			for(auto i : _excludedPlanes) {
-				if(i == sensorID) {
-					foundexcludedsensor = true;
-				}
-			}
-			if(foundexcludedsensor) continue;
+			if(std::find(_excludedPlanes.begin(), _excludedPlanes.end(), sensorID) != _excludedPlanes.end()) continue;
+
+			//only sensors from the SensorIDVec have hit counters
+			auto sensorIt = _sensorMap.find(sensorID);
+			if(sensorIt == _sensorMap.end()) continue;
+
+			sensor const & currentSensor = sensorIt->second;
+			int* hitCount = _hitCountMap[sensorID].data();
 
 			// now prepare the EUTelescope interface to sparsified data.  
 			int pixelType = cellDecoder(zsData)["sparsePixelType"];
@@ -196,16 +198,17 @@ void EUTelProcessorNoisyPixelFinder::noisyPixelFinder(EUTelEventImpl* evt) {
 
 				//compute the address in the array-like-structure, any offset
 				//has to be substracted (array index starts at 0)
-				int indexX = pixel.getXCoord() - currentSensor->offX;
-				int indexY = pixel.getYCoord() - currentSensor->offY;
+				int indexX = pixel.getXCoord() - currentSensor.offX;
+				int indexY = pixel.getYCoord() - currentSensor.offY;
 
-				try {
-					//increment the hit counter for this pixel
-					(hitArray->at(indexX)).at(indexY)++;
-				} catch(std::out_of_range& e) {
+				if(indexX < 0 || indexX >= currentSensor.sizeX || indexY < 0 || indexY >= currentSensor.sizeY) {
 					streamlog_out ( ERROR5 )  << "Pixel: " << pixel.getXCoord() << "|" <<  pixel.getYCoord() << " on plane: " << sensorID << " fired." << std::endl 
 						<< "This pixel is out of the range defined by the geometry. Either your data is corrupted or your pixel geometry not specified correctly!" << std::endl;
+					continue;
 				}
+
+				//increment the hit counter for this pixel
+				++hitCount[indexX*currentSensor.sizeY + indexY];
 			}
 		}    
 	} catch (lcio::DataNotAvailableException& e ) {
@@ -249,6 +252,12 @@ void EUTelProcessorNoisyPixelFinder::processEvent (LCEvent * event) {
 
 	//don't forget to increment the event counter
 	++_iEvt;
+
+	//in update mode publish the noisy pixels found so far
+	if(_updateInterval > 0 && _iEvt <= _noOfEvents && (_iEvt % _updateInterval == 0 || _iEvt == _noOfEvents)) {
+		findNoisyPixels(_iEvt);
+		publishNoisyPixels(event);
+	}
 }
 
 void EUTelProcessorNoisyPixelFinder::end() {
@@ -269,38 +278,16 @@ void EUTelProcessorNoisyPixelFinder::check(LCEvent* /*event*/ ) {
 	if( _iEvt == _noOfEvents) {
 		streamlog_out ( MESSAGE4 ) << "Finished determining hot pixels, writing them out..." << std::endl;
 
-		//iterate over all the sensors in our sensorMap
-		for(auto& thisSensor: _sensorMap)
+		findNoisyPixels(_iEvt);
+
+		for(auto& mapEntry: _noisyPixelMap)
 		{
-			auto sensorID = thisSensor.first;
 			streamlog_out ( MESSAGE3 ) << "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~" << std::endl;
-			streamlog_out ( MESSAGE3 ) << "Noisy pixels found on plane " << sensorID << " (max. fire freq set to: " << _maxAllowedFiringFreq << ")" << std::endl;
+			streamlog_out ( MESSAGE3 ) << "Noisy pixels found on plane " << mapEntry.first << " (max. fire freq set to: " << _maxAllowedFiringFreq << ")" << std::endl;
 			streamlog_out ( MESSAGE3 ) << "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~" << std::endl;
 
-			//get the correpsonding hit array-like vector of vectors
-			std::vector<std::vector<int>>* hitVector =  &_hitVecMap[sensorID];
-			//and the sensor which stores offsets
-			sensor* currentSensor = &_sensorMap[sensorID];
-
-			//loop over all pixels
-			for(auto  xIt = hitVector->begin(); xIt != hitVector->end(); ++xIt)
-			{
-				for(auto yIt = xIt->begin(); yIt != xIt->end(); ++yIt)
-				{
-					//compute the firing frequency
-					float fireFreq = (float)*yIt/(float)_iEvt;
-					//if it is larger than the allowed one, we write this pixel into a collection
-					if(fireFreq > _maxAllowedFiringFreq) {
-						streamlog_out ( MESSAGE3 )	<< "Pixel: " << xIt-hitVector->begin() + currentSensor->offX << "|" 
-										<< yIt - xIt->begin() + currentSensor->offY  << " fired " << fireFreq << std::endl;
-						EUTelGenericSparsePixel pixel;
-						pixel.setXCoord(xIt-hitVector->begin() + currentSensor->offX);
-						pixel.setYCoord(yIt - xIt->begin() + currentSensor->offY );
-						pixel.setSignal( fireFreq );
-						//writing out is done here
-						_noisyPixelMap[sensorID].push_back(pixel);
-					}
-				}
+			for(auto& pixel: mapEntry.second) {
+				streamlog_out ( MESSAGE3 )	<< "Pixel: " << pixel.getXCoord() << "|" << pixel.getYCoord() << " fired " << pixel.getSignal() << std::endl;
 			}
 		}
 
@@ -312,6 +299,79 @@ void EUTelProcessorNoisyPixelFinder::check(LCEvent* /*event*/ ) {
 	}
 }
 
+void EUTelProcessorNoisyPixelFinder::findNoisyPixels(int nEvents) {
+	//the sensors are independent, so each one is scanned in its own task
+	std::map<int, std::future<std::vector<EUTelGenericSparsePixel>>> scans;
+	for(auto& thisSensor: _sensorMap) {
+		auto sensorID = thisSensor.first;
+		scans[sensorID] = std::async(std::launch::async, [this, sensorID, nEvents]() { return findNoisyPixels(sensorID, nEvents); });
+	}
+	for(auto& scan: scans) {
+		_noisyPixelMap[scan.first] = scan.second.get();
+	}
+}
+
+std::vector<EUTelGenericSparsePixel> EUTelProcessorNoisyPixelFinder::findNoisyPixels(int sensorID, int nEvents) const {
+	std::vector<EUTelGenericSparsePixel> noisyPixels;
+	if(nEvents <= 0) return noisyPixels;
+
+	sensor const & currentSensor = _sensorMap.at(sensorID);
+	std::vector<int> const & hitCount = _hitCountMap.at(sensorID);
+
+	//a pixel is noisy if count/nEvents > maxFreq, i.e. the cut can be
+	//applied on the counters directly
+	double const countLimit = static_cast<double>(_maxAllowedFiringFreq)*nEvents;
+	int const nPixels = static_cast<int>(hitCount.size());
+
+	for(int index = 0; index < nPixels; ++index) {
+		if(hitCount[index] > countLimit) {
+			EUTelGenericSparsePixel pixel;
+			pixel.setXCoord( index / currentSensor.sizeY + currentSensor.offX );
+			pixel.setYCoord( index % currentSensor.sizeY + currentSensor.offY );
+			pixel.setSignal( static_cast<float>(hitCount[index])/static_cast<float>(nEvents) );
+			noisyPixels.push_back(pixel);
+		}
+	}
+	return noisyPixels;
+}
+
+void EUTelProcessorNoisyPixelFinder::publishNoisyPixels(LCEvent* event) {
+	LCCollectionVec* noisyPixelCollection = new LCCollectionVec( lcio::LCIO::TRACKERDATA );
+	fillNoisyPixelCollection( noisyPixelCollection );
+	//only meant for the processors of this job, the final list goes to the DB file
+	noisyPixelCollection->setTransient( true );
+	try {
+		event->addCollection( noisyPixelCollection, _updateCollectionName );
+	} catch( lcio::EventException& e ) {
+		streamlog_out ( ERROR5 ) << "Could not add collection " << _updateCollectionName << " to event " << event->getEventNumber() << ": " << e.what() << std::endl;
+		delete noisyPixelCollection;
+		return;
+	}
+	streamlog_out ( MESSAGE4 ) << "Published intermediate noisy pixel collection after " << _iEvt << " events" << std::endl;
+}
+
+void EUTelProcessorNoisyPixelFinder::fillNoisyPixelCollection(LCCollectionVec* noisyPixelCollection) {
+	//_noisyPixelMap holds the sensor if (first) and a vector of noisy pixels (second)
+	for(auto& mapEntry: _noisyPixelMap) {
+		CellIDEncoder< TrackerDataImpl > noisyPixelEncoder  ( EUTELESCOPE::ZSDATADEFAULTENCODING, noisyPixelCollection  );
+		noisyPixelEncoder["sensorID"]        = mapEntry.first;
+		noisyPixelEncoder["sparsePixelType"] = kEUTelGenericSparsePixel;
+
+		// prepare a new TrackerData for the hot Pixel data
+		std::unique_ptr<lcio::TrackerDataImpl> currentFrame( new lcio::TrackerDataImpl );
+		noisyPixelEncoder.setCellID( currentFrame.get() );
+
+		// this is the structure that will host the sparse pixel  
+		std::unique_ptr<EUTelTrackerDataInterfacerImpl<EUTelGenericSparsePixel>>
+			sparseFrame( new EUTelTrackerDataInterfacerImpl<EUTelGenericSparsePixel>(currentFrame.get()) );
+
+		for( auto& pixel: mapEntry.second) {
+			sparseFrame->push_back( pixel );                
+		}
+		noisyPixelCollection->push_back( currentFrame.release() );
+	}
+}
+
 void EUTelProcessorNoisyPixelFinder::noisyPixelDBWriter() {    
 	streamlog_out ( DEBUG5 ) << "Writing out hot pixel db into " << _noisyPixelDBFile.c_str() << std::endl;
 
@@ -358,25 +418,9 @@ void EUTelProcessorNoisyPixelFinder::noisyPixelDBWriter() {
 	}
 
 	streamlog_out( MESSAGE5 ) << "Noisy Pixel Finder summary:" << std::endl;
-	//_noisyPixelMap holds the sensor if (first) and a vector of noisy pixels (second)
-	for(auto& mapEntry: _noisyPixelMap) {
-		CellIDEncoder< TrackerDataImpl > noisyPixelEncoder  ( EUTELESCOPE::ZSDATADEFAULTENCODING, noisyPixelCollection  );
-		noisyPixelEncoder["sensorID"]        = mapEntry.first;
-		noisyPixelEncoder["sparsePixelType"] = kEUTelGenericSparsePixel;
-
-		// prepare a new TrackerData for the hot Pixel data
-		std::unique_ptr<lcio::TrackerDataImpl> currentFrame( new lcio::TrackerDataImpl );
-		noisyPixelEncoder.setCellID( currentFrame.get() );
-
-		// this is the structure that will host the sparse pixel  
-		std::unique_ptr<EUTelTrackerDataInterfacerImpl<EUTelGenericSparsePixel>>
-			sparseFrame( new EUTelTrackerDataInterfacerImpl<EUTelGenericSparsePixel>(currentFrame.get()) );
-
-		for( auto& pixel: mapEntry.second) {
-			sparseFrame->push_back( pixel );                
-		}
-		noisyPixelCollection->push_back( currentFrame.release() );
+	fillNoisyPixelCollection( noisyPixelCollection );
 
+	for(auto& mapEntry: _noisyPixelMap) {
 		streamlog_out( MESSAGE5 ) << "Found " << mapEntry.second.size() << " noisy pixels on sensor: " << mapEntry.first << std::endl;
 	}
 	lcWriter->writeEvent( event.get() );
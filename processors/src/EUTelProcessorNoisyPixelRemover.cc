@@ -42,13 +42,16 @@ EUTelProcessorNoisyPixelRemover::EUTelProcessorNoisyPixelRemover():
   Processor("EUTelProcessorNoisyPixelRemover"),
   _inputCollectionName(""),
   _outputCollectionName(""),
-  _noisyPixelCollectionName("")
+  _noisyPixelCollectionName(""),
+  _noisyPixelUpdateCollectionName("")
 {
   _description ="EUTelProcessorNoisyPixelRemover removes noisy pixels (TrackerData) from a collection. This processor requires a noisy pixel collection.";
 
   registerInputCollection(LCIO::TRACKERDATA, "InputCollectionName", "Input collection containing noisy raw data", _inputCollectionName, std::string ("noisy_raw_data_collection"));
   registerOutputCollection(LCIO::TRACKERDATA, "OutputCollectionName", "Output collection where noisy pixels have been removed", _outputCollectionName, std::string("noisefree_raw_data_collection"));
   registerProcessorParameter("NoisyPixelCollectionName", "Name of the noisy pixel collection.",  _noisyPixelCollectionName, std::string("noisypixel"));
+  registerOptionalParameter("NoisyPixelUpdateCollectionName", "Name of the intermediate noisy pixel collection, replaces the noisy pixel list in events where it is present (empty to disable)",
+                            _noisyPixelUpdateCollectionName, std::string(""));
 }
 
 void EUTelProcessorNoisyPixelRemover::init() {
@@ -71,6 +74,14 @@ void EUTelProcessorNoisyPixelRemover::processEvent(LCEvent* event) {
 		_firstEvent = false;
 	}
 
+	if(!_noisyPixelUpdateCollectionName.empty()) {
+		//An intermediate noisy pixel collection replaces the current list
+		auto names = event->getCollectionNames();
+		if(std::find(names->begin(), names->end(), _noisyPixelUpdateCollectionName) != names->end()) {
+			_noisyPixelMap = Utility::readNoisyPixelList(event, _noisyPixelUpdateCollectionName);
+		}
+	}
+
  	// get the collection of interest from the event.
 	LCCollectionVec* inputCollection = nullptr;
 
@@ -470,6 +470,9 @@ void EUTelProcessorSparseClustering::fillHistos (LCEvent * evt)
 
 		std::map<int, int> eventCounterMap;
 
+		// the clusters of the previous event are not used any more
+		_histoClusterPool.recycle();
+
 		for( int iPulse = _initialPulseCollectionSize; iPulse < _pulseCollectionVec->getNumberOfElements(); iPulse++ ) 
 		{
 			TrackerPulseImpl* pulse = dynamic_cast<TrackerPulseImpl*> ( _pulseCollectionVec->getElementAt(iPulse) );
@@ -482,7 +485,7 @@ void EUTelProcessorSparseClustering::fillHistos (LCEvent * evt)
 	
 			if( type == kEUTelSparseClusterImpl ) 
 			{
-		    		cluster = new EUTelSparseClusterImpl<EUTelGenericSparsePixel>( static_cast<TrackerDataImpl*>(pulse->getTrackerData()) );
+		    		cluster = _histoClusterPool.acquire( static_cast<TrackerDataImpl*>(pulse->getTrackerData()) );
 			}	 
 			else 
 			{
@@ -518,8 +521,6 @@ void EUTelProcessorSparseClustering::fillHistos (LCEvent * evt)
 			(dynamic_cast<AIDA::IHistogram2D*> (_hitMapHistos[detectorID]))->fill(static_cast<double >(xPos), static_cast<double >(yPos), 1.);
 			(dynamic_cast<AIDA::IHistogram1D*> (_clusterSizeTotalHistos[detectorID]))->fill( static_cast<int>(cluster->size()) );
 			(dynamic_cast<AIDA::IHistogram1D*> (_clusterSignalHistos[detectorID]))->fill(cluster->getTotalCharge());
-
-			delete cluster;
 		}
 
 		//fill the event multiplicity here
@@ -204,6 +204,12 @@ void EUTelProcessorTrueHitAnalysis::fillHistos(LCEvent* event) {
 				continue;
 			}
 
+			if (reconstructedHit->getRawHits().empty()) {
+
+				streamlog_out(WARNING2) << "found a hit without cluster at event " << event->getEventNumber() << std::endl;
+				continue;
+			}
+
 			TrackerDataImpl* zsData = dynamic_cast<TrackerDataImpl*>(reconstructedHit->getRawHits().front());
 
 			int pixelType = static_cast<int>(rawDataDecoder(zsData)["sparsePixelType"]);
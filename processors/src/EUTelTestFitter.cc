@@ -59,6 +59,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <algorithm>
 #include <cstdlib>
 #include <limits>
 
@@ -181,6 +182,7 @@ EUTelTestFitter::EUTelTestFitter()
   _nominalErrorX(NULL),
   _nominalFitArrayY(NULL),
   _nominalErrorY(NULL),
+  _patternFitCache(),
   _noOfEventWOInputHit(0),
   _noOfEventWOTrack(0),
   _noOfTracks(0),
@@ -1575,7 +1577,7 @@ void EUTelTestFitter::processEvent( LCEvent * event ) {
       {
         choiceChi2 = NominalFit();
       } else {
-        if(_useNominalResolution && _beamSlopeX==_beamSlopeY) choiceChi2 = SingleFit();
+        if(_useNominalResolution) choiceChi2 = PatternFit();
         else choiceChi2 = MatrixFit();
       }
 
@@ -2157,6 +2159,8 @@ void EUTelTestFitter::end(){
 
   delete [] _nominalFitArrayY ;
   delete [] _nominalErrorY ;
+
+  _patternFitCache.clear();
 }
 
 
@@ -2539,6 +2543,89 @@ double EUTelTestFitter::NominalFit()
   return chi2 ;
 }
 
+double EUTelTestFitter::PatternFit()
+{
+  // Hit pattern of the current fit hypothesis
+  // (more than 64 planes can not be encoded, use standard fit then)
+
+  if(_nTelPlanes > 64) return MatrixFit();
+
+  unsigned long long pattern = 0;
+
+  for(int ipl=0; ipl<_nTelPlanes;ipl++)
+    if(_isActive[ipl] && _planeEx[ipl]>0.)
+      pattern |= (1ULL << ipl);
+
+  map<unsigned long long, vector<double> >::iterator cached = _patternFitCache.find(pattern);
+
+  if(cached == _patternFitCache.end())
+    {
+      // New pattern: invert fit matrix once and store it together
+      // with the expected position errors
+
+      vector<double> entry(_nTelPlanes*_nTelPlanes + _nTelPlanes, 0.);
+      vector<double> pos(_nTelPlanes, 0.);
+      vector<double> err(_planeEx, _planeEx + _nTelPlanes);
+
+      int status = DoAnalFit(&pos[0], &err[0]);
+
+      if(status) return -1. ;
+
+      std::copy(_fitArray, _fitArray + _nTelPlanes*_nTelPlanes, entry.begin());
+      std::copy(err.begin(), err.end(), entry.begin() + _nTelPlanes*_nTelPlanes);
+
+      cached = _patternFitCache.insert(make_pair(pattern, entry)).first;
+
+      streamlog_out ( DEBUG5 ) << "Cached fit matrix for hit pattern " << pattern
+                               << " (" << _patternFitCache.size() << " patterns)" << endl;
+    }
+
+  const double * invArray = &(cached->second[0]);
+  const double * invError = invArray + _nTelPlanes*_nTelPlanes;
+
+  for(int ipl=0; ipl<_nTelPlanes;ipl++)
+    {
+      _fitX[ipl] = _fitY[ipl] = 0.;
+      _fitEx[ipl] = _fitEy[ipl] = invError[ipl];
+    }
+
+  // Weighted measurements, with beam tilt correction as in DoAnalFit,
+  // folded in column by column (contiguous, vectorizable inner loop)
+
+  for(int jpl=0; jpl<_nTelPlanes;jpl++)
+    {
+      double wx = 0.;
+      double wy = 0.;
+
+      if(pattern & (1ULL << jpl))
+        {
+          wx = _planeX[jpl]/_planeEx[jpl]/_planeEx[jpl];
+          wy = _planeY[jpl]/_planeEy[jpl]/_planeEy[jpl];
+        }
+
+      if(_useBeamConstraint && jpl<2)
+        {
+          double sign = (jpl == 0) ? -1. : 1. ;
+          wx += sign*_beamSlopeX*_planeDist[0]*_planeScat[0];
+          wy += sign*_beamSlopeY*_planeDist[0]*_planeScat[0];
+        }
+
+      if(wx == 0. && wy == 0.) continue;
+
+      const double * column = invArray + jpl*_nTelPlanes;
+
+      for(int ipl=0; ipl<_nTelPlanes;ipl++)
+        {
+          _fitX[ipl] += column[ipl]*wx;
+          _fitY[ipl] += column[ipl]*wy;
+        }
+    }
+
+  double chi2=GetFitChi2();
+
+  return chi2 ;
+}
+
 
 int EUTelTestFitter::DoAnalFit(double * pos, double *err, double slope)
 {
@@ -57,6 +57,7 @@ _channelsToBeUsed(),
 _skipMaskedEvents(false),
 _numberOfSkippedEvents(0),
 _chipSelection(),
+_maskOfChip(),
 _pedestalMap(),
 _noiseMap(),
 _chargeCalMap(),
@@ -359,6 +360,8 @@ float AlibavaBaseProcessor::getChargeCalAtChannel(int chipnum, int channum){
 // getter and setter for _chipSelection
 void AlibavaBaseProcessor::setChipSelection(EVENT::IntVec chipselection){
 	_chipSelection = chipselection;
+	// the masks depend on the chip selection
+	_maskOfChip.clear();
 }
 
 EVENT::IntVec AlibavaBaseProcessor::getChipSelection(){
@@ -400,6 +403,18 @@ bool AlibavaBaseProcessor::isMasked(int ichip, int ichan){
 	}
 }
 
+const std::vector<unsigned char> & AlibavaBaseProcessor::getMaskOfChip(int chipnum){
+	map<int, vector<unsigned char> >::const_iterator it = _maskOfChip.find(chipnum);
+	if (it != _maskOfChip.end())
+		return it->second;
+	
+	vector<unsigned char> & mask = _maskOfChip[chipnum];
+	mask.resize(ALIBAVA::NOOFCHANNELS);
+	for (int ichan=0; ichan<ALIBAVA::NOOFCHANNELS; ichan++)
+		mask[ichan] = isMasked(chipnum,ichan) ? 1 : 0;
+	return mask;
+}
+
 void AlibavaBaseProcessor::setChannelsToBeUsed(){
 	
 	// Let's decode this StringVec.
@@ -428,6 +443,7 @@ void AlibavaBaseProcessor::setChannelsToBeUsed(){
 			
 		}
 	}
+	_maskOfChip.clear();
 	printChannelMasking();
 	
 }
@@ -539,7 +555,7 @@ void AlibavaBaseProcessor::setAllMasksTo(bool abool){
 	for (int i=0; i<ALIBAVA::NOOFCHIPS; i++)
 		for (int j=0; j<ALIBAVA::NOOFCHANNELS; j++)
 			_isMasked[i][j]=abool;
-	
+	_maskOfChip.clear();
 }
 
 // only valid for AlibavaData nor for AlibavaClusters
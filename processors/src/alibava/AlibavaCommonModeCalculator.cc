@@ -0,0 +1,235 @@
+/*
+ * Created by Thomas Eichhorn
+ *  (2014 DESY)
+ *
+ *  email:thomas.eichhorn@cern.ch
+ *
+ *  modified by: Eda Yildirim eda.yildirim@cern.ch
+ */
+
+// alibava includes ".h"
+#include "AlibavaCommonModeCalculator.h"
+
+// lcio includes <.h>
+#include <lcio.h>
+
+// system includes <>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace lcio;
+using namespace alibava;
+
+namespace {
+	// number of partial sums in the channel loops
+	const int kLanes = 4;
+
+	// scales the median absolute deviation to the sigma of a gaussian
+	const double kMADToSigma = 1.4826;
+
+	// median of the first n values, which are reordered
+	double medianOf(float * values, size_t n){
+		const size_t half = n / 2;
+		nth_element(values, values + half, values + n);
+		double result = values[half];
+		if (n % 2 == 0) {
+			// the lower middle value is the largest of the lower half
+			result = 0.5 * ( result + *max_element(values, values + half) );
+		}
+		return result;
+	}
+}
+
+AlibavaCommonModeCalculator::AlibavaCommonModeCalculator() :
+_method(kIterativeMean),
+_nIteration(3),
+_noiseDeviation(2.5),
+_groupSize(ALIBAVA::NOOFCHANNELS),
+_use(),
+_values()
+{
+// does nothing
+}
+
+// setters and getters
+void AlibavaCommonModeCalculator::setMethod(Method method){
+	_method = method;
+}
+AlibavaCommonModeCalculator::Method AlibavaCommonModeCalculator::getMethod() const{
+	return _method;
+}
+
+void AlibavaCommonModeCalculator::setNIteration(int nIteration){
+	_nIteration = nIteration;
+}
+int AlibavaCommonModeCalculator::getNIteration() const{
+	return _nIteration;
+}
+
+void AlibavaCommonModeCalculator::setNoiseDeviation(float noiseDeviation){
+	_noiseDeviation = noiseDeviation;
+}
+float AlibavaCommonModeCalculator::getNoiseDeviation() const{
+	return _noiseDeviation;
+}
+
+void AlibavaCommonModeCalculator::setGroupSize(int groupSize){
+	_groupSize = groupSize;
+}
+int AlibavaCommonModeCalculator::getGroupSize() const{
+	return _groupSize;
+}
+
+bool AlibavaCommonModeCalculator::getMethodFromName(string name, Method & method){
+	if (name == "IterativeMean")
+		method = kIterativeMean;
+	else if (name == "Median")
+		method = kMedian;
+	else if (name == "Group")
+		method = kGroup;
+	else
+		return false;
+	return true;
+}
+
+void AlibavaCommonModeCalculator::calculate(const FloatVec & dataVec, const vector<unsigned char> & mask,
+														  FloatVec & commonModeVec, FloatVec & commonModeErrorVec){
+
+	const size_t nChannels = dataVec.size();
+	const size_t nMasks = min(nChannels, mask.size());
+
+	// the channels used, the ones without a mask are used
+	_use.resize(nChannels);
+	for (size_t ichan=0; ichan<nMasks; ichan++)
+		_use[ichan] = (mask[ichan] == 0);
+	for (size_t ichan=nMasks; ichan<nChannels; ichan++)
+		_use[ichan] = 1;
+
+	commonModeVec.resize(nChannels);
+	commonModeErrorVec.resize(nChannels);
+
+	double commonMode = 0, commonModeError = 0;
+	if (_method == kMedian) {
+		median(dataVec.data(), _use.data(), nChannels, commonMode, commonModeError);
+		fill(commonModeVec.begin(), commonModeVec.end(), float(commonMode));
+		fill(commonModeErrorVec.begin(), commonModeErrorVec.end(), float(commonModeError));
+	}
+	else {
+		// IterativeMean is a single group with all the channels
+		size_t groupSize = nChannels;
+		if (_method == kGroup && _groupSize > 0)
+			groupSize = size_t(_groupSize);
+
+		for (size_t begin=0; begin<nChannels; begin+=groupSize) {
+			const size_t end = min(begin + groupSize, nChannels);
+			iterativeMean(dataVec.data(), _use.data(), begin, end, commonMode, commonModeError);
+			fill(commonModeVec.begin() + begin, commonModeVec.begin() + end, float(commonMode));
+			fill(commonModeErrorVec.begin() + begin, commonModeErrorVec.begin() + end, float(commonModeError));
+		}
+	}
+}
+
+void AlibavaCommonModeCalculator::calculate(const vector<const FloatVec *> & dataVecs,
+														  const vector<const vector<unsigned char> *> & masks,
+														  vector<FloatVec> & commonModeVecs,
+														  vector<FloatVec> & commonModeErrorVecs){
+	commonModeVecs.resize(dataVecs.size());
+	commonModeErrorVecs.resize(dataVecs.size());
+	for (size_t ichip=0; ichip<dataVecs.size(); ichip++)
+		calculate(*dataVecs[ichip], *masks[ichip], commonModeVecs[ichip], commonModeErrorVecs[ichip]);
+}
+
+void AlibavaCommonModeCalculator::subtract(const FloatVec & dataVec, const FloatVec & commonModeVec,
+														 const vector<unsigned char> & mask, FloatVec & newDataVec){
+
+	const size_t nChannels = dataVec.size();
+	const size_t nMasks = min(nChannels, mask.size());
+	newDataVec.resize(nChannels);
+
+	const float * data = dataVec.data();
+	const float * commonMode = commonModeVec.data();
+	float * newData = newDataVec.data();
+
+	// the masked channels are set to zero
+	for (size_t ichan=0; ichan<nMasks; ichan++)
+		newData[ichan] = mask[ichan] ? 0.f : data[ichan] - commonMode[ichan];
+	for (size_t ichan=nMasks; ichan<nChannels; ichan++)
+		newData[ichan] = data[ichan] - commonMode[ichan];
+}
+
+void AlibavaCommonModeCalculator::iterativeMean(const float * data, const unsigned char * use, size_t begin, size_t end,
+																double & mean, double & sigma) const{
+
+	mean = 0;
+	sigma = 0;
+	const double noiseDeviation = _noiseDeviation;
+
+	for (int i=0; i<_nIteration; i++) {
+		// First iteration: take everything, then exclude outliers
+		const bool takeAll = (i == 0);
+		const double lastMean = mean;
+		const double lastSigma = sigma;
+
+		double total_signal[kLanes] = {0};
+		double total_signal_square[kLanes] = {0};
+		int nchan[kLanes] = {0};
+
+		// masked sums without branches, kLanes channels at a time
+		size_t ichan = begin;
+		for (; ichan + kLanes <= end; ichan += kLanes) {
+			for (int ilane=0; ilane<kLanes; ilane++) {
+				const double sig = data[ichan + ilane];
+				const bool isUsed = use[ichan + ilane] & ( takeAll | (fabs((sig - lastMean)/lastSigma) < noiseDeviation) );
+				total_signal[ilane] += isUsed ? sig : 0.;
+				total_signal_square[ilane] += isUsed ? sig*sig : 0.;
+				nchan[ilane] += isUsed;
+			}
+		}
+		for (; ichan < end; ichan++) {
+			const double sig = data[ichan];
+			const bool isUsed = use[ichan] & ( takeAll | (fabs((sig - lastMean)/lastSigma) < noiseDeviation) );
+			total_signal[0] += isUsed ? sig : 0.;
+			total_signal_square[0] += isUsed ? sig*sig : 0.;
+			nchan[0] += isUsed;
+		}
+
+		double sum = 0, sum_square = 0;
+		int n = 0;
+		for (int ilane=0; ilane<kLanes; ilane++) {
+			sum += total_signal[ilane];
+			sum_square += total_signal_square[ilane];
+			n += nchan[ilane];
+		}
+
+		// standard deviation = SQRT( E[x^2] - E[x]^2 )
+		// where E denotes average value
+		if (n > 0) {
+			mean = sum/n;
+			sigma = sqrt(sum_square/n - mean*mean);
+		}
+	}
+}
+
+void AlibavaCommonModeCalculator::median(const float * data, const unsigned char * use, size_t nChannels,
+													  double & median, double & sigma){
+
+	median = 0;
+	sigma = 0;
+
+	_values.resize(nChannels);
+	size_t n = 0;
+	for (size_t ichan=0; ichan<nChannels; ichan++) {
+		_values[n] = data[ichan];
+		n += use[ichan];
+	}
+	if (n == 0) return;
+
+	median = medianOf(_values.data(), n);
+
+	for (size_t i=0; i<n; i++)
+		_values[i] = fabs(_values[i] - median);
+	sigma = kMADToSigma * medianOf(_values.data(), n);
+}
@@ -12,6 +12,7 @@
 #include "AlibavaEventImpl.h"
 #include "ALIBAVA.h"
 #include "AlibavaPedNoiCalIOManager.h"
+#include "AlibavaCommonModeCalculator.h"
 
 
 // marlin includes ".h"
@@ -48,6 +49,7 @@
 #include <string>
 #include <iostream>
 #include <memory>
+#include <vector>
 
 
 using namespace std;
@@ -190,10 +192,9 @@ void AlibavaCommonModeSubtraction::processEvent (LCEvent * anEvent) {
 			chipIDEncoder.setCellID(newdataImpl);
 			
 			
-			FloatVec datavec, cmmdvec, newdatavec;
-			datavec = dataImpl->getChargeValues();
-			cmmdvec = cmmdImpl->getChargeValues();
-			newdatavec.clear();
+			const FloatVec & datavec = dataImpl->getChargeValues();
+			const FloatVec & cmmdvec = cmmdImpl->getChargeValues();
+			FloatVec newdatavec;
 			
 			
 			// check size of data sets are equal to ALIBAVA::NOOFCHANNELS
@@ -203,19 +204,8 @@ void AlibavaCommonModeSubtraction::processEvent (LCEvent * anEvent) {
 				streamlog_out( ERROR5 ) << "Number of channels in common mode data is not equal to ALIBAVA::NOOFCHANNELS! " << endl;
 
 			
-			// now subtract common mode values from all channels
-			for (size_t ichan=0; ichan<datavec.size();ichan++) {
-				if(isMasked(chipnum, ichan)) {
-					newdatavec.push_back(0);
-					continue;
-				}
-
-				float newdata = datavec[ichan] - cmmdvec[ichan];
-				
-				//store it in new data vector
-				newdatavec.push_back(newdata);
-				
-			}
+			// now subtract common mode values from all channels, the masked ones are set to 0
+			AlibavaCommonModeCalculator::subtract(datavec, cmmdvec, getMaskOfChip(chipnum), newdatavec);
 			
 			newdataImpl->setChargeValues(newdatavec);
 			newColVec->push_back(newdataImpl);
@@ -250,13 +240,13 @@ void AlibavaCommonModeSubtraction::fillHistos(TrackerDataImpl * trkdata){
 
 	// Fill the histograms with the corrected data
 
-	FloatVec datavec;
-	datavec = trkdata->getChargeValues();
+	const FloatVec & datavec = trkdata->getChargeValues();
 	int chipnum = getChipNum(trkdata);
+	const vector<unsigned char> & mask = getMaskOfChip(chipnum);
 
 	for ( size_t ichan = 0 ; ichan < datavec.size() ; ichan++ )
 	{
-		if ( isMasked(chipnum, ichan) ) continue;
+		if ( ichan < mask.size() && mask[ichan] ) continue;
 		
 		string tempHistoName = getChanDataHistoName(chipnum, ichan);
 		if ( TH1D * histo = dynamic_cast<TH1D*> (_rootObjectMap[tempHistoName]) )
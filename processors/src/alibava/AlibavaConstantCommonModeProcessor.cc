@@ -49,6 +49,7 @@
 #include <iostream>
 #include <sstream>
 #include <memory>
+#include <vector>
 
 
 using namespace std;
@@ -64,10 +65,13 @@ _commonmodeCollectionName(ALIBAVA::NOTSET),
 _commonmodeerrorCollectionName(ALIBAVA::NOTSET),
 _Niteration(3),
 _NoiseDeviation(2.5),
+_commonModeMethodName("IterativeMean"),
+_commonModeGroupSize(32),
 _commonmodeHistoName ("hcommonmode"),
 _commonmodeerrorHistoName ("hcommonmodeerror"),
-_commonmode(),
-_commonmodeerror()
+_commonModeCalculator(),
+_chipCommonMode(),
+_chipCommonModeError()
 {
 	
 	// modify processor description
@@ -96,6 +100,14 @@ _commonmodeerror()
 										"The limit to the deviation of noise. The data exceeds this deviation will be considered as signal and not be included in common mode error calculation",
 										_NoiseDeviation, float(2.5) );
 
+	registerOptionalParameter ("CommonModeMethod",
+										"The common mode method: IterativeMean (mean of the chip excluding the outliers), Median (median of the chip) or Group (IterativeMean of each group of CommonModeGroupSize channels)",
+										_commonModeMethodName, string("IterativeMean") );
+
+	registerOptionalParameter ("CommonModeGroupSize",
+										"The number of consecutive channels sharing a common mode, used only by the Group method",
+										_commonModeGroupSize, int(32) );
+
 }
 
 
@@ -125,6 +137,18 @@ void AlibavaConstantCommonModeProcessor::init () {
 		streamlog_out ( MESSAGE4 ) << "The Global Parameter "<< ALIBAVA::SKIPMASKEDEVENTS <<" is not set! Masked events will be used!" << endl;
 	}
 	
+	// set up the common mode calculation
+	AlibavaCommonModeCalculator::Method method;
+	if ( !AlibavaCommonModeCalculator::getMethodFromName(_commonModeMethodName, method) )
+		throw InvalidParameterException(string("CommonModeMethod cannot be " + _commonModeMethodName));
+	if ( method == AlibavaCommonModeCalculator::kGroup && _commonModeGroupSize <= 0 )
+		throw InvalidParameterException("CommonModeGroupSize has to be positive");
+	
+	_commonModeCalculator.setMethod(method);
+	_commonModeCalculator.setNIteration(_Niteration);
+	_commonModeCalculator.setNoiseDeviation(_NoiseDeviation);
+	_commonModeCalculator.setGroupSize(_commonModeGroupSize);
+	
 	// this method is called only once even when the rewind is active
 	// usually a good idea to
 	printParameters ();
@@ -174,25 +198,38 @@ void AlibavaConstantCommonModeProcessor::processEvent (LCEvent * anEvent) {
 		CellIDEncoder<TrackerDataImpl> commonCol_CellIDEncode (ALIBAVA::ALIBAVADATA_ENCODE,commonCollection);
 		CellIDEncoder<TrackerDataImpl> commerrCol_CellIDEncode (ALIBAVA::ALIBAVADATA_ENCODE,commerrCollection);
 
+		// Get the data and the masks of all the chips
+		vector<const FloatVec *> dataVecs(noOfDetector);
+		vector<const vector<unsigned char> *> masks(noOfDetector);
+		vector<int> chipnums(noOfDetector);
 		for ( size_t i = 0; i < noOfDetector; ++i )
 		{
-
-			// Get the data
 			TrackerDataImpl * trkdata = dynamic_cast< TrackerDataImpl * > ( collectionVec->getElementAt( i ) ) ;
+			chipnums[i] = getChipNum(trkdata);
+			dataVecs[i] = &trkdata->getChargeValues();
+			if ( int(dataVecs[i]->size()) != ALIBAVA::NOOFCHANNELS )
+				streamlog_out( ERROR5 ) << "Number of channels in input data of chip " << chipnums[i] << " is not equal to ALIBAVA::NOOFCHANNELS! " << endl;
+			masks[i] = &getMaskOfChip(chipnums[i]);
+		}
+		
+		// Find Commonmode of all chips at once
+		_commonModeCalculator.calculate(dataVecs, masks, _chipCommonMode, _chipCommonModeError);
 
-			chipnum = getChipNum(trkdata);
+		for ( size_t i = 0; i < noOfDetector; ++i )
+		{
+			chipnum = chipnums[i];
 			
-			// Find Commonmode
-			calculateConstantCommonMode(trkdata);
+			if ( !_chipCommonMode[i].empty() )
+				streamlog_out( DEBUG0 ) << "Chip " << chipnum << " : CommonModeCorrection = " << _chipCommonMode[i].front() << ", CommonModeCorrectionError = " << _chipCommonModeError[i].front() << endl;
 
 			TrackerDataImpl * commonData = new TrackerDataImpl();
-			commonData->setChargeValues(getCommonModeVec());
+			commonData->setChargeValues(_chipCommonMode[i]);
 			commonCol_CellIDEncode[ALIBAVA::ALIBAVADATA_ENCODE_CHIPNUM] = chipnum;
 			commonCol_CellIDEncode.setCellID(commonData);
 			commonCollection->push_back(commonData);
 
 			TrackerDataImpl * commerrData = new TrackerDataImpl();
-			commerrData->setChargeValues(getCommonModeErrorVec());
+			commerrData->setChargeValues(_chipCommonModeError[i]);
 			commerrCol_CellIDEncode[ALIBAVA::ALIBAVADATA_ENCODE_CHIPNUM] = chipnum;
 			commerrCol_CellIDEncode.setCellID(commerrData);
 			commerrCollection->push_back(commerrData);
@@ -226,80 +263,6 @@ void AlibavaConstantCommonModeProcessor::end() {
 	
 }
 
-void AlibavaConstantCommonModeProcessor::calculateConstantCommonMode(TrackerDataImpl *trkdata){
-  
-  	EVENT::FloatVec commonmodeVec;
-	EVENT::FloatVec commonmodeerrorVec;
-
-	FloatVec datavec;
-	datavec = trkdata->getChargeValues();
-
-	
-	int chipnum = getChipNum(trkdata);
-	
-	streamlog_out( DEBUG0 ) << "Chip " << chipnum << " of " << getNumberOfChips() << ", now iterating..." << endl;
-	
-	
-	double sig=0, tmpdouble=0;
-	double mean_signal=0;
-	double sigma_mean_signal=0;
-	
-	
-	for (int i=0; i<_Niteration; i++) {
-		int nchan=0;
-		double total_signal=0;
-		double total_signal_square=0;
-		
-		// find mean value of signals
-		for ( int ichan =0; ichan < int (datavec.size()); ichan++ ){
-			if ( isMasked(chipnum, ichan) )
-				continue;
-
-			sig = datavec[ichan];
-			
-			// First iteration: take everything
-			if (i==0) {
-				total_signal += sig;
-				total_signal_square += sig*sig;
-				nchan++;
-			}
-			else{ // exclude outliers
-				tmpdouble = fabs((sig - mean_signal)/sigma_mean_signal);
-				if (tmpdouble<_NoiseDeviation) {
-					total_signal += sig;
-					total_signal_square += sig*sig;
-					nchan++;
-				}
-			}
-		} // end of loop over channels
-		// here find the deviation from mean value
-		// standard deviation = SQRT( E[x^2] - E[x]^2 )
-		// where E denotes average value
-		if (nchan>0) {
-			mean_signal=total_signal/nchan;
-			sigma_mean_signal=sqrt(total_signal_square/nchan - mean_signal*mean_signal);
-		}
-
-	} // end of iterations
-	
-	streamlog_out( DEBUG0 ) << "===============================================================================" << endl;
-	streamlog_out( DEBUG0 ) << "Chip " << chipnum << " : CommonModeCorrection = " << mean_signal << ", CommonModeCorrectionError = " << sigma_mean_signal << endl;
-
-	streamlog_out( DEBUG0 ) << "===============================================================================" << endl;
-	
-	// Now reloop over all channels and create the output vector. This will be the same for all channels
-	for ( int ichan = 0; ichan < ALIBAVA::NOOFCHANNELS ; ichan++ )
-	{
-		commonmodeVec.push_back(mean_signal);
-		commonmodeerrorVec.push_back(sigma_mean_signal);
-	}
-	
-	setCommonModeVec(commonmodeVec);
-	setCommonModeErrorVec(commonmodeerrorVec);
-	
-}
-
-
 string AlibavaConstantCommonModeProcessor::getCommonCorrectionName(){
 	string s;
 	s = "Common Mode Correction Values";
@@ -310,14 +273,14 @@ string AlibavaConstantCommonModeProcessor::getCommonCorrectionName(){
 void AlibavaConstantCommonModeProcessor::fillHistos(TrackerDataImpl * trkdata, int event){
 
 	// Fill the histograms with the corrected data
-	FloatVec datavec;
-	datavec = trkdata->getChargeValues();
+	const FloatVec & datavec = trkdata->getChargeValues();
 	
 	int chipnum = getChipNum(trkdata);
+	const vector<unsigned char> & mask = getMaskOfChip(chipnum);
 	
 	for ( size_t ichan = 0 ; ichan < datavec.size() ; ichan++ )
 	{
-		if ( isMasked(chipnum,ichan) ) continue;
+		if ( ichan < mask.size() && mask[ichan] ) continue;
 		
 		string tempHistoName = getCommonCorrectionName();
 		if ( TH1D * histo = dynamic_cast<TH1D*> (_rootObjectMap[tempHistoName]) )
@@ -347,27 +310,6 @@ std::string AlibavaConstantCommonModeProcessor::getCommonModeErrorCollectionName
 }
 
 
-// getter and setter for _commonmode
-void AlibavaConstantCommonModeProcessor::setCommonModeVec(EVENT::FloatVec common){
-	if (common.size()!=unsigned(ALIBAVA::NOOFCHANNELS)) {
-		streamlog_out( ERROR5 ) <<"Size of common mode vector set doesn't match with number of channels in the data stream."<< endl;
-	}
-	_commonmode = common;
-}
-EVENT::FloatVec AlibavaConstantCommonModeProcessor::getCommonModeVec(){
-	return _commonmode;
-}
-
-// getter and setter for _commonmodeerror
-void AlibavaConstantCommonModeProcessor::setCommonModeErrorVec(EVENT::FloatVec commonerror){
-	if (commonerror.size()!=unsigned(ALIBAVA::NOOFCHANNELS)) {
-		streamlog_out( ERROR5 ) <<"Size of common mode error vector set doesn't match with number of channels in the data stream."<< endl;
-	}
-	_commonmodeerror = commonerror;
-}
-EVENT::FloatVec AlibavaConstantCommonModeProcessor::getCommonModeErrorVec(){
-	return _commonmodeerror;
-}
 
 
 
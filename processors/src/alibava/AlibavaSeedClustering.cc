@@ -13,6 +13,9 @@
 #include "AlibavaPedNoiCalIOManager.h"
 #include "AlibavaCluster.h"
 
+// eutelescope includes ".h"
+#include "EUTelBitScan.h"
+
 
 // marlin includes ".h"
 #include "marlin/Processor.h"
@@ -44,6 +47,8 @@
 #include <iostream>
 #include <stdlib.h>
 #include <memory>
+#include <algorithm>
+#include <cstdint>
 
 using namespace std;
 using namespace lcio;
@@ -257,63 +262,33 @@ vector<AlibavaCluster> AlibavaSeedClustering::findClusters(TrackerDataImpl * trk
 	int chipnum = getChipNum(trkdata);
 	
 	// then get the data vector
-	FloatVec dataVec;
-	dataVec = trkdata->getChargeValues();
+	const FloatVec & dataVec = trkdata->getChargeValues();
 	
 	// we will need noise vector too
-	FloatVec noiseVec = getNoiseOfChip(chipnum);
-	
-	// then check which channels we can add to a cluster
-	// obviously not the ones masked
-	vector<bool> channel_can_be_used;
-	for (int ichan=0; ichan<int(dataVec.size()); ichan++)
-		channel_can_be_used.push_back(!isMasked(chipnum,ichan));
+	const FloatVec & noiseVec = _noiseMap[chipnum];
 	
+	// and the channels masked
+	const vector<unsigned char> & mask = getMaskOfChip(chipnum);
 	
 	// Now mask channels that cannot pass NeighbourSNRCut
-	// And add the channel numbers as seed candidate if it pass SeedSNRCut
-	vector<int> seedCandidates;
-	seedCandidates.clear();
-	for (int ichan=0; ichan<int(channel_can_be_used.size()); ichan++) {
-		// if this channel is already masked, continue
-		if (!channel_can_be_used[ichan]) continue;
-		// now calculate snr = signal/noise
-		float snr = (_signalPolarity * dataVec[ichan])/noiseVec[ichan];
-		// mask channels that cannot pass NeighbourSNRCut
-		if (snr < _neighCut)
-			channel_can_be_used[ichan]=false;
-		else if (snr > _seedCut) {
-			seedCandidates.push_back(ichan);
-		}
-	}
-	
-	// sort seed channels according to their SNR, highest comes first!
-	for (unsigned int i=0; i+1<seedCandidates.size(); i++) {
-		int ichan = seedCandidates[i];
-		float isnr = (_signalPolarity*dataVec[ichan])/noiseVec[ichan];
-		int next_chan = seedCandidates[i+1];
-		float next_snr = (_signalPolarity*dataVec[next_chan])/noiseVec[next_chan];
-		if(isnr < next_snr){ // swap
-			seedCandidates[i] = next_chan;
-			seedCandidates[i+1] = ichan;
-			//start from beginning
-			i=0;
-		}
-	}
+	// and find the seed channels, sorted according to their SNR, highest comes first!
+	findSeeds(dataVec, noiseVec, mask);
+	vector<unsigned char> & channel_can_be_used = _channelCanBeUsed;
+	const int nChannels = int(channel_can_be_used.size());
 	
 	// now form clusters starting from the seed channel that has highest SNR
 	int clusterID = 0;
 	// form clusters and store them in a vector
 	vector<AlibavaCluster> clusterVector;
-	for (unsigned int iseed=0; iseed<seedCandidates.size(); iseed++) {
+	for (unsigned int iseed=0; iseed<_seedCandidates.size(); iseed++) {
 		// if this seed channel used in another cluster, skip it
-		int seedChan = seedCandidates[iseed];
+		int seedChan = _seedCandidates[iseed];
 		if (!channel_can_be_used[seedChan]) continue;
 		
 		AlibavaCluster acluster;
 		acluster.setChipNum(chipnum);
 		acluster.setSeedChanNum(seedChan);
-		acluster.setEta( calculateEta(trkdata,seedChan) );
+		acluster.setEta( calculateEta(dataVec,mask,seedChan) );
 		acluster.setIsSensitiveAxisX(_isSensitiveAxisX);
 		acluster.setSignalPolarity(_signalPolarity);
 		acluster.setClusterID(clusterID);
@@ -329,12 +304,9 @@ vector<AlibavaCluster> AlibavaSeedClustering::findClusters(TrackerDataImpl * trk
 				
 		// add channels on the left
 		int ichan = seedChan-1;
-		bool continueSearch = true;
-		while (continueSearch) {
+		while (true) {
 			// first if ichan < 0
 			if (ichan < 0) {
-				// stop search
-				continueSearch = false;
 				// this also means that left neighbour is not bonded
 				thereIsNonBondedChan = true;
 				// then exit while loop
@@ -342,7 +314,7 @@ vector<AlibavaCluster> AlibavaSeedClustering::findClusters(TrackerDataImpl * trk
 			}
 			
 			// if chan masked
-			if (isMasked(chipnum,ichan)==true) {
+			if (mask[ichan]) {
 				// this means that it is not bonded.
 				thereIsNonBondedChan = true;
 				// then we are sure that there is no other channel on the left
@@ -368,14 +340,11 @@ vector<AlibavaCluster> AlibavaSeedClustering::findClusters(TrackerDataImpl * trk
 			ichan--;
 		}
 		
-		continueSearch = true;
 		ichan = seedChan+1;
 		// add channels on right
-		while (continueSearch) {
-			// first if ichan < 0
-			if (ichan >= int(channel_can_be_used.size()) ) {
-				// stop search
-				continueSearch = false;
+		while (true) {
+			// first if ichan is after the last channel
+			if (ichan >= nChannels) {
 				// this also means that right neighbour is not bonded
 				thereIsNonBondedChan = true;
 				// then exit while loop
@@ -383,7 +352,7 @@ vector<AlibavaCluster> AlibavaSeedClustering::findClusters(TrackerDataImpl * trk
 			}
 			
 			// if chan masked
-			if (isMasked(chipnum,ichan)==true) {
+			if (mask[ichan]) {
 				// this means that it is not bonded.
 				thereIsNonBondedChan = true;
 				// then we are sure that there is no other channel on the left
@@ -417,14 +386,73 @@ vector<AlibavaCluster> AlibavaSeedClustering::findClusters(TrackerDataImpl * trk
 	return clusterVector;
 }
 
+void AlibavaSeedClustering::findSeeds(const FloatVec & dataVec, const FloatVec & noiseVec, const vector<unsigned char> & mask){
+	
+	// the mask covers all the channels of a chip
+	const size_t nChannels = min(dataVec.size(), mask.size());
+	if (nChannels != dataVec.size())
+		streamlog_out( ERROR5 ) << "More data ("<<dataVec.size()<<") than channels on a chip! The extra data are not used." << endl;
+	
+	_snr.resize(nChannels);
+	_channelCanBeUsed.resize(nChannels);
+	_isSeed.resize(nChannels);
+	
+	const float * data = dataVec.data();
+	const float * noise = noiseVec.data();
+	const unsigned char * masked = mask.data();
+	float * snr = _snr.data();
+	unsigned char * canBeUsed = _channelCanBeUsed.data();
+	unsigned char * isSeed = _isSeed.data();
+	const float polarity = float(_signalPolarity);
+	const float neighCut = _neighCut;
+	const float seedCut = _seedCut;
+	
+	// without branches: snr = signal/noise, then the
+	// channels that cannot pass NeighbourSNRCut are masked and the
+	// ones passing SeedSNRCut are seed candidates
+	for (size_t ichan=0; ichan<nChannels; ichan++)
+		snr[ichan] = (polarity * data[ichan])/noise[ichan];
+	for (size_t ichan=0; ichan<nChannels; ichan++) {
+		canBeUsed[ichan] = (masked[ichan] == 0) & !(snr[ichan] < neighCut);
+		isSeed[ichan] = canBeUsed[ichan] & (snr[ichan] > seedCut);
+	}
+	
+	// pack the seed flags, 64 channels per word
+	const size_t nWords = (nChannels + 63) / 64;
+	_seedMask.assign(nWords, 0);
+	for (size_t iword=0; iword<nWords; iword++) {
+		const size_t first = iword * 64;
+		const size_t nBits = min<size_t>(64, nChannels - first);
+		uint64_t word = 0;
+		for (size_t ibit=0; ibit<nBits; ibit++)
+			word |= uint64_t(isSeed[first + ibit]) << ibit;
+		_seedMask[iword] = word;
+	}
+	
+	// visit only the set bits
+	_seedCandidates.clear();
+	for (size_t iword=0; iword<nWords; iword++) {
+		eutelescope::Utility::forEachSetBit(_seedMask[iword], [this, iword](int ibit) {
+			_seedCandidates.push_back(int(iword * 64 + ibit));
+		});
+	}
+	
+	// sort seed channels according to their SNR, highest comes first!
+	// channels with the same SNR keep their order
+	stable_sort(_seedCandidates.begin(), _seedCandidates.end(),
+					[snr](int ichan, int jchan) { return snr[ichan] > snr[jchan]; });
+}
+
 float AlibavaSeedClustering::calculateEta(TrackerDataImpl *trkdata, int seedChan){
 	
 	// first get chip number
 	int chipnum = getChipNum(trkdata);
-	// then get the data vector
-	FloatVec dataVec;
-	dataVec = trkdata->getChargeValues();
+	
+	return calculateEta(trkdata->getChargeValues(), getMaskOfChip(chipnum), seedChan);
+}
 
+float AlibavaSeedClustering::calculateEta(const FloatVec & dataVec, const vector<unsigned char> & mask, int seedChan){
+	
 	// we will multiply all signal values by _signalPolarity to work on positive signal always
 	float seedSignal = _signalPolarity * dataVec.at(seedChan);
 
@@ -434,14 +462,14 @@ float AlibavaSeedClustering::calculateEta(TrackerDataImpl *trkdata, int seedChan
 	int leftChan = seedChan - 1;
 	float leftSignal = unrealisticSignal;
 	// check if the channel on the left is masked
-	if ( leftChan >= 0 && isMasked(chipnum,leftChan)==false ) {
+	if ( leftChan >= 0 && mask.at(leftChan)==0 ) {
 		leftSignal = _signalPolarity * dataVec.at(leftChan);
 	}
 	
 	int rightChan = seedChan+1;
 	float rightSignal = unrealisticSignal;
 	// check if the channel on the right is masked
-	if ( rightChan < int( dataVec.size() ) && isMasked(chipnum, rightChan) == false ) {
+	if ( rightChan < int( dataVec.size() ) && rightChan < int( mask.size() ) && mask[rightChan] == 0 ) {
 		rightSignal = _signalPolarity * dataVec.at(rightChan);
 	}
 	
@@ -14,58 +14,72 @@ inline double getScatterSigma(double eBeam, double radLength){
   return(scatterTheta);
 }
 
-void EstMat::addTrack( std::vector<Measurement<FITTERTYPE> > track){
+void EstMat::addTrack( const std::vector<Measurement<FITTERTYPE> >& track){
   //Add a track to memory
-  tracks.push_back(track);
+  if(trackBegin.empty()){ trackBegin.push_back(0); }
+  for(size_t meas = 0; meas < track.size(); meas++){
+    measX.push_back( track[meas].getX() );
+    measY.push_back( track[meas].getY() );
+    measZ.push_back( track[meas].getZ() );
+    measIden.push_back( track[meas].getIden() );
+  }
+  trackBegin.push_back( measX.size() );
 }
 
-void EstMat::readTrack(int track, TrackerSystem<FITTERTYPE, 4>& system){
-  //Read a track into the tracker system into memory
-  for(size_t meas = 0; meas < tracks.at(track).size(); meas++){
-    Measurement<FITTERTYPE>& m1 = tracks.at(track).at(meas);
+void EstMat::indexTracks(){
+  //Look up the plane of every measurement once, instead of for every track read
+  measPlane.assign(measIden.size(), -1);
+  for(size_t meas = 0; meas < measIden.size(); meas++){
     for(size_t ii = 0; ii < system.planes.size(); ii++){
-      if( (int) m1.getIden() == (int) system.planes.at(ii).getSensorID()){
-	double x = m1.getX() * ( 1.0 + xScale.at(ii)) + m1.getY() * zRot.at(ii);
-	double y = m1.getY() * ( 1.0 + yScale.at(ii)) - m1.getX() * zRot.at(ii);
-	x += xShift.at(ii);
-	y += yShift.at(ii); 
-	
-	double z = m1.getZ();
-	system.addMeasurement(ii, x, y, z, true, m1.getIden());
+      if( measIden[meas] == (int) system.planes.at(ii).getSensorID()){
+	measPlane[meas] = ii;
 	break;
       }
     }
   }
 }
 
+void EstMat::readTrack(int track, TrackerSystem<FITTERTYPE, 4>& system){
+  //Read a track into the tracker system into memory
+  for(size_t meas = trackBegin[track]; meas < trackBegin[track + 1]; meas++){
+    int ii = measPlane[meas];
+    if(ii < 0) { continue; }
+    double x = measX[meas] * ( 1.0 + xScale[ii]) + measY[meas] * zRot[ii];
+    double y = measY[meas] * ( 1.0 + yScale[ii]) - measX[meas] * zRot[ii];
+    x += xShift[ii];
+    y += yShift[ii]; 
+    system.addMeasurement(ii, x, y, measZ[meas], true, measIden[meas]);
+  }
+}
+
 void EstMat::readTracksToArray(float** measX, float** measY, int nTracks, int nPlanes){
-  if(static_cast<size_t>(nTracks) > tracks.size()){
+  if(static_cast<size_t>(nTracks) > this->nTracks()){
     throw std::runtime_error("Trying to read too many tracks!");
   }
   for(int tr = 0; tr < nTracks; tr++){
-    if(tracks.at(tr).size() != 9 or nPlanes != 9){
+    if(trackBegin[tr + 1] - trackBegin[tr] != 9 or nPlanes != 9){
       cout << "nPlanes = " << nPlanes << endl;
       throw std::runtime_error("SDR2CL currently needs exactly nine measurements in all the tracks.");
     }
     for(int pl = 0; pl < nPlanes; pl++){
-      measX[pl][tr] = tracks.at(tr).at(pl).getX();
-      measY[pl][tr] = tracks.at(tr).at(pl).getY();
+      measX[pl][tr] = this->measX[trackBegin[tr] + pl];
+      measY[pl][tr] = this->measY[trackBegin[tr] + pl];
     }
   }
 }
 
 void EstMat::readTracksToDoubleArray(float** measX, int nTracks, int nPlanes){
-  if(static_cast<size_t>(nTracks) > tracks.size()){
+  if(static_cast<size_t>(nTracks) > this->nTracks()){
     throw std::runtime_error("Trying to read too many tracks!");
   }
   for(int tr = 0; tr < nTracks; tr++){
-    if(tracks.at(tr).size() != 9 or nPlanes != 9){
+    if(trackBegin[tr + 1] - trackBegin[tr] != 9 or nPlanes != 9){
       cout << "nPlanes = " << nPlanes << endl;
       throw std::runtime_error("SDR2CL currently needs exactly nine measurements in all the tracks.");
     }
     for(int pl = 0; pl < nPlanes; pl++){
-      measX[pl][(2 * tr)]     = tracks.at(tr).at(pl).getX();
-      measX[pl][(2 * tr) + 1] = tracks.at(tr).at(pl).getY();
+      measX[pl][(2 * tr)]     = this->measX[trackBegin[tr] + pl];
+      measX[pl][(2 * tr) + 1] = this->measY[trackBegin[tr] + pl];
     }
   }
 }
@@ -137,7 +151,7 @@ void FakeChi2::operator() (size_t offset, size_t stride){
   
   {
 #ifdef DOTHREAD
-    boost::mutex::scoped_lock lock(resultGurad);
+    std::lock_guard<std::mutex> lock(resultGurad);
 #endif
     if(firstRun){ calibrate(system); }
   }
@@ -172,7 +186,7 @@ void FakeChi2::operator() (size_t offset, size_t stride){
 
   {
 #ifdef DOTHREAD
-    boost::mutex::scoped_lock lock(resultGurad);
+    std::lock_guard<std::mutex> lock(resultGurad);
 #endif
     result += chi2;
   }
@@ -188,7 +202,7 @@ void FakeAbsDev::operator() (size_t offset, size_t stride){
   
   {
 #ifdef DOTHREAD
-    boost::mutex::scoped_lock lock(resultGurad);
+    std::lock_guard<std::mutex> lock(resultGurad);
 #endif
     if(firstRun){ calibrate(system); }
   }
@@ -223,7 +237,7 @@ void FakeAbsDev::operator() (size_t offset, size_t stride){
 
   {
 #ifdef DOTHREAD
-    boost::mutex::scoped_lock lock(resultGurad);
+    std::lock_guard<std::mutex> lock(resultGurad);
 #endif
     result += chi2;
   }
@@ -248,7 +262,7 @@ void Chi2::operator() (size_t offset, size_t stride){
   
   {
 #ifdef DOTHREAD
-    boost::mutex::scoped_lock lock(resultGurad);
+    std::lock_guard<std::mutex> lock(resultGurad);
 #endif
     result += varchi2;
   }
@@ -366,7 +380,7 @@ void SDR::operator() (size_t offset, size_t stride){
   }
   {
 #ifdef DOTHREAD
-    boost::mutex::scoped_lock lock(resultGurad);
+    std::lock_guard<std::mutex> lock(resultGurad);
 #endif
     result += varvar;
   }
@@ -457,13 +471,32 @@ void FwBw::operator() (size_t offset, size_t stride){
   }
   {
 #ifdef DOTHREAD
-    boost::mutex::scoped_lock lock(resultGurad);
+    std::lock_guard<std::mutex> lock(resultGurad);
 #endif
     result += -1.0 * logL;
     retVal2 += return2;
   }
 }
 
+Minimizer::Minimizer(EstMat& mat) : inited(false), mat(mat), nThreads(4) {
+#ifdef DOTHREAD
+  jobGeneration = 0;
+  jobsPending = 0;
+  stopWorkers = false;
+#endif
+}
+
+Minimizer::~Minimizer(){
+#ifdef DOTHREAD
+  {
+    std::lock_guard<std::mutex> lock(poolGuard);
+    stopWorkers = true;
+  }
+  poolWake.notify_all();
+  for(size_t ii = 0; ii < workers.size(); ii++){ workers[ii].join(); }
+#endif
+}
+
 void Minimizer::init(){
   //Initialize nThread threads
 #ifndef DOTHREAD
@@ -474,8 +507,29 @@ void Minimizer::init(){
     systems.assign(nThreads, mat.system);
   }
   inited = true;
+  mat.indexTracks();
 }
 
+#ifdef DOTHREAD
+void Minimizer::workerLoop(size_t offset){
+  //Wait for a new evaluation, run our share of the tracks, report back
+  size_t seenGeneration = 0;
+  while(true){
+    {
+      std::unique_lock<std::mutex> lock(poolGuard);
+      while(jobGeneration == seenGeneration and not stopWorkers){ poolWake.wait(lock); }
+      if(stopWorkers){ return; }
+      seenGeneration = jobGeneration;
+    }
+    (*this)(offset, nThreads);
+    {
+      std::lock_guard<std::mutex> lock(poolGuard);
+      if(--jobsPending == 0){ poolDone.notify_one(); }
+    }
+  }
+}
+#endif
+
 void Minimizer::prepareThreads(){
   //Copy thicknesses and resolutions, reset resturn values
   for(size_t ii = 0; ii < mat.system.planes.size(); ii++){
@@ -494,11 +548,25 @@ FITTERTYPE Minimizer::operator() (void){
   //Start threads if DOTHREAD, run job in main thread if not.
   prepareThreads();
 #ifdef DOTHREAD
-  boost::thread_group threads;
-  for(int ii = 0; ii < nThreads; ii++){
-    threads.create_thread( boost::bind(&Minimizer::operator(), this, ii, nThreads));
+  //The pool is started on the first evaluation and reused afterwards. The
+  //tracks are split statically, SDR and FwBw are not additive over tracks
+  //and a changing split would make the objective noisy for the simplex.
+  if(workers.empty()){
+    for(size_t ii = 1; ii < nThreads; ii++){
+      workers.push_back( std::thread(&Minimizer::workerLoop, this, ii) );
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(poolGuard);
+    jobsPending = workers.size();
+    jobGeneration++;
+  }
+  poolWake.notify_all();
+  (*this)(0, nThreads);
+  {
+    std::unique_lock<std::mutex> lock(poolGuard);
+    while(jobsPending > 0){ poolDone.wait(lock); }
   }
-  threads.join_all();
 #else
   (*this)(0, 1);
 #endif
@@ -663,7 +731,8 @@ void EstMat::plot(char* fname){
   cout << "Inited plots" << endl;
   
   //Loop over all tracks
-  for(size_t track = 0; track < tracks.size(); track++){
+  indexTracks();
+  for(size_t track = 0; track < nTracks(); track++){
     system.clear();
     readTrack(track, system);
     system.clusterTracker();
@@ -946,8 +1015,8 @@ void EstMat::simplexSearch(Minimizer* minimizeMe, size_t iterations, int restart
   cout << "Initial guesses" << endl;
   printAllFreeParams();
   
-  if(tracks.size() < maxIterations){
-    itMax = tracks.size();
+  if(nTracks() < maxIterations){
+    itMax = nTracks();
   } else {
     itMax = maxIterations;
   }
@@ -1032,7 +1101,7 @@ void EstMat::quasiNewtonHomeMade(Minimizer* minimizeMe, int iterations){
 
   size_t nParams = getNSimplexParams();
   gsl_vector* vc = systemToEst();
-  itMax = tracks.size();
+  itMax = nTracks();
   double mseval = 0, fwbwval = 0;
 
   size_t resSize = resXIndex.size() + resYIndex.size();
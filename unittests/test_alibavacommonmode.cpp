@@ -0,0 +1,179 @@
+//STL
+#include <cmath>
+#include <random>
+#include <vector>
+
+//GTest
+#include "gtest/gtest.h"
+
+//Alibava
+#include "AlibavaCommonModeCalculator.h"
+
+using alibava::AlibavaCommonModeCalculator;
+
+namespace {
+
+	/** The iterative mean as calculated channel by channel in AlibavaConstantCommonModeProcessor before it
+	 *  used AlibavaCommonModeCalculator.
+	 */
+	void referenceIterativeMean(std::vector<float> const & data, std::vector<unsigned char> const & mask, int nIteration,
+			double noiseDeviation, double & mean, double & sigma) {
+		mean = 0;
+		sigma = 0;
+		for(int i = 0; i < nIteration; i++) {
+			int nchan = 0;
+			double total = 0, totalSquare = 0;
+			for(size_t ichan = 0; ichan < data.size(); ichan++) {
+				if( mask[ichan] ) continue;
+				double sig = data[ichan];
+				if( i == 0 || std::fabs((sig - mean)/sigma) < noiseDeviation ) {
+					total += sig;
+					totalSquare += sig*sig;
+					nchan++;
+				}
+			}
+			if( nchan > 0 ) {
+				mean = total/nchan;
+				sigma = std::sqrt(totalSquare/nchan - mean*mean);
+			}
+		}
+	}
+}
+
+/** IterativeMean must give the result of the channel by channel loop, up to the summation order.
+ */
+TEST(AlibavaCommonModeCalculatorTest, IterativeMeanCompareWithLoop) {
+
+	std::default_random_engine generator( 128 );
+	std::normal_distribution<float> signal(3., 5.);
+	std::uniform_int_distribution<int> masked(0, 9);
+
+	AlibavaCommonModeCalculator calculator;
+	std::vector<float> data(128), commonMode, commonModeError;
+	std::vector<unsigned char> mask(128);
+	for(int iEvent = 0; iEvent < 100; iEvent++) {
+		for(size_t ichan = 0; ichan < data.size(); ichan++) {
+			data[ichan] = signal(generator);
+			mask[ichan] = masked(generator) == 0;
+		}
+		//a few channels with a hit
+		data[10 + iEvent] += 200.;
+		data[11 + iEvent] += 80.;
+
+		double mean, sigma;
+		referenceIterativeMean(data, mask, 3, 2.5, mean, sigma);
+		calculator.calculate(data, mask, commonMode, commonModeError);
+		ASSERT_EQ( commonMode.size(), 128u );
+		for(size_t ichan = 0; ichan < data.size(); ichan++) {
+			ASSERT_NEAR( commonMode[ichan], mean, 1e-4 );
+			ASSERT_NEAR( commonModeError[ichan], sigma, 1e-4 );
+		}
+	}
+}
+
+/** A channel far from the others is excluded after the first iteration. The remaining channels are all equal, so
+ *  the RMS becomes zero and stays zero in the following iterations.
+ */
+TEST(AlibavaCommonModeCalculatorTest, IterativeMeanZeroSigma) {
+
+	AlibavaCommonModeCalculator calculator;
+	std::vector<float> commonMode, commonModeError;
+
+	std::vector<float> const data = {0, 0, 0, 0, 0, 0, 0, 40};
+	calculator.calculate(data, std::vector<unsigned char>(8, 0), commonMode, commonModeError);
+	ASSERT_EQ( commonMode[0], 0.f );
+	ASSERT_EQ( commonModeError[0], 0.f );
+
+	//the same value in all the channels, with rounding in the sums
+	std::vector<float> const constant(128, 3.3f);
+	calculator.calculate(constant, std::vector<unsigned char>(), commonMode, commonModeError);
+	ASSERT_NEAR( commonMode[0], 3.3f, 1e-6 );
+	ASSERT_EQ( commonModeError[0], 0.f );
+}
+
+/** With all the channels masked the common mode and its error are zero for every method.
+ */
+TEST(AlibavaCommonModeCalculatorTest, AllChannelsMasked) {
+
+	AlibavaCommonModeCalculator calculator;
+	std::vector<float> const data = {1, 2, 3, 4, 5};
+	std::vector<unsigned char> const mask(5, 1);
+	std::vector<float> commonMode, commonModeError;
+
+	AlibavaCommonModeCalculator::Method const methods[3] = {
+		AlibavaCommonModeCalculator::kIterativeMean,
+		AlibavaCommonModeCalculator::kMedian,
+		AlibavaCommonModeCalculator::kGroup };
+	for(auto method: methods) {
+		calculator.setMethod(method);
+		calculator.setGroupSize(2);
+		calculator.calculate(data, mask, commonMode, commonModeError);
+		ASSERT_EQ( commonMode, std::vector<float>(5, 0.f) );
+		ASSERT_EQ( commonModeError, std::vector<float>(5, 0.f) );
+	}
+
+	std::vector<float> subtracted;
+	AlibavaCommonModeCalculator::subtract(data, commonMode, mask, subtracted);
+	ASSERT_EQ( subtracted, std::vector<float>(5, 0.f) );
+}
+
+/** Median of the unmasked channels and the median absolute deviation scaled to a gaussian sigma. Channels beyond
+ *  the end of the mask are used.
+ */
+TEST(AlibavaCommonModeCalculatorTest, Median) {
+
+	AlibavaCommonModeCalculator calculator;
+	calculator.setMethod(AlibavaCommonModeCalculator::kMedian);
+	std::vector<float> commonMode, commonModeError;
+
+	//odd number of channels: 1 2 4 5 9 after masking the 100
+	std::vector<float> const odd = {9, 100, 4, 1, 5, 2};
+	calculator.calculate(odd, std::vector<unsigned char>({0, 1}), commonMode, commonModeError);
+	ASSERT_FLOAT_EQ( commonMode[5], 4. );
+	//deviations 5 0 3 1 2
+	ASSERT_FLOAT_EQ( commonModeError[5], 1.4826*2. );
+
+	//even number of channels: 2 3 4 5
+	std::vector<float> const even = {5, 3, 2, 4};
+	calculator.calculate(even, std::vector<unsigned char>(), commonMode, commonModeError);
+	ASSERT_FLOAT_EQ( commonMode[0], 3.5 );
+	//deviations 1.5 0.5 1.5 0.5
+	ASSERT_FLOAT_EQ( commonModeError[0], 1.4826 );
+}
+
+/** Group calculates the iterative mean for each group of consecutive channels, the last group may be shorter.
+ */
+TEST(AlibavaCommonModeCalculatorTest, Group) {
+
+	AlibavaCommonModeCalculator calculator;
+	calculator.setMethod(AlibavaCommonModeCalculator::kGroup);
+	calculator.setGroupSize(4);
+	std::vector<float> commonMode, commonModeError;
+
+	std::vector<float> const data = {1, 1, 1, 1, 10, 12, 10, 12, 5, 7, 50};
+	std::vector<unsigned char> const mask = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+	calculator.calculate(data, mask, commonMode, commonModeError);
+
+	std::vector<float> const expected = {1, 1, 1, 1, 11, 11, 11, 11, 6, 6, 6};
+	std::vector<float> const expectedError = {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1};
+	ASSERT_EQ( commonMode, expected );
+	ASSERT_EQ( commonModeError, expectedError );
+
+	std::vector<float> subtracted;
+	AlibavaCommonModeCalculator::subtract(data, commonMode, mask, subtracted);
+	ASSERT_EQ( subtracted, std::vector<float>({0, 0, 0, 0, -1, 1, -1, 1, -1, 1, 0}) );
+}
+
+/** The method names accepted by the processors.
+ */
+TEST(AlibavaCommonModeCalculatorTest, MethodFromName) {
+
+	AlibavaCommonModeCalculator::Method method;
+	ASSERT_TRUE( AlibavaCommonModeCalculator::getMethodFromName("Median", method) );
+	ASSERT_EQ( method, AlibavaCommonModeCalculator::kMedian );
+	ASSERT_TRUE( AlibavaCommonModeCalculator::getMethodFromName("Group", method) );
+	ASSERT_EQ( method, AlibavaCommonModeCalculator::kGroup );
+	ASSERT_TRUE( AlibavaCommonModeCalculator::getMethodFromName("IterativeMean", method) );
+	ASSERT_EQ( method, AlibavaCommonModeCalculator::kIterativeMean );
+	ASSERT_FALSE( AlibavaCommonModeCalculator::getMethodFromName("median", method) );
+}
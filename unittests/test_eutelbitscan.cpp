@@ -0,0 +1,43 @@
+//STL
+#include <cstdint>
+#include <random>
+#include <vector>
+
+//GTest
+#include "gtest/gtest.h"
+
+//EUTelescope
+#include "EUTelBitScan.h"
+
+using namespace eutelescope;
+
+/** The lowest set bit is found for every single bit and for words with more bits set.
+ */
+TEST(EUTelBitScanTest, LowestSetBit) {
+
+	for(int bit = 0; bit < 64; bit++) {
+		std::uint64_t const word = static_cast<std::uint64_t>(1) << bit;
+		ASSERT_EQ( Utility::lowestSetBit(word), bit );
+		ASSERT_EQ( Utility::lowestSetBit(~static_cast<std::uint64_t>(0) << bit), bit );
+	}
+}
+
+/** The visited bits are the set bits of the word in increasing order, compared with a test of every bit.
+ */
+TEST(EUTelBitScanTest, ForEachSetBit) {
+
+	std::default_random_engine generator( 64 );
+	std::uniform_int_distribution<std::uint64_t> random;
+
+	std::vector<std::uint64_t> words = {0, 1, static_cast<std::uint64_t>(1) << 63, ~static_cast<std::uint64_t>(0)};
+	for(int i = 0; i < 1000; i++) words.push_back( random(generator) );
+
+	for(std::uint64_t word: words) {
+		std::vector<int> expected, visited;
+		for(int bit = 0; bit < 64; bit++) {
+			if( (word >> bit) & 1 ) expected.push_back(bit);
+		}
+		Utility::forEachSetBit(word, [&visited](int bit) { visited.push_back(bit); });
+		ASSERT_EQ( visited, expected ) << "word " << word;
+	}
+}
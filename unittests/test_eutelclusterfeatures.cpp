@@ -0,0 +1,133 @@
+//STL
+#include <memory>
+#include <vector>
+
+//GTest
+#include "gtest/gtest.h"
+
+//LCIO
+#include <IMPL/LCCollectionVec.h>
+#include <IMPL/TrackerDataImpl.h>
+#include <IMPL/TrackerPulseImpl.h>
+#include <UTIL/CellIDEncoder.h>
+
+//EUTelescope
+#include "EUTELESCOPE.h"
+#include "EUTelClusterFeatures.h"
+#include "EUTelGenericSparsePixel.h"
+#include "EUTelSparseClusterImpl.h"
+
+using namespace eutelescope;
+
+/** A cross shaped sparse cluster on sensor 3 with known signals and noise.
+ */
+class EUTelClusterFeaturesTest : public ::testing::Test {
+protected:
+	IMPL::LCCollectionVec collection;
+	std::unique_ptr<IMPL::TrackerDataImpl> data;
+	std::unique_ptr<EUTelSparseClusterImpl<EUTelGenericSparsePixel> > cluster;
+
+	EUTelClusterFeaturesTest() : collection(lcio::LCIO::TRACKERDATA), data(new IMPL::TrackerDataImpl) {
+		UTIL::CellIDEncoder<IMPL::TrackerDataImpl> encoder( EUTELESCOPE::ZSCLUSTERDEFAULTENCODING, &collection );
+		encoder["sensorID"] = 3;
+		encoder["sparsePixelType"] = static_cast<int>( kEUTelGenericSparsePixel );
+		encoder["quality"] = 0;
+		encoder.setCellID( data.get() );
+
+		cluster.reset( new EUTelSparseClusterImpl<EUTelGenericSparsePixel>( data.get() ) );
+		cluster->push_back( EUTelGenericSparsePixel(10, 20, 5.f) );
+		cluster->push_back( EUTelGenericSparsePixel(11, 20, 20.f) );
+		cluster->push_back( EUTelGenericSparsePixel(12, 20, 8.f) );
+		cluster->push_back( EUTelGenericSparsePixel(11, 21, 3.f) );
+		cluster->push_back( EUTelGenericSparsePixel(11, 19, 1.f) );
+		cluster->setNoiseValues( std::vector<float>({1.f, 2.f, 1.f, 1.f, 2.f}) );
+	}
+};
+
+/** The record holds the same values as the cluster methods called one by one.
+ */
+TEST_F(EUTelClusterFeaturesTest, SameAsCluster) {
+
+	EUTelClusterFeatureRequest request;
+	request.nCharge = {1, 2, 3, 9};
+	request.nxnCharge = {3};
+	request.nSNR = {2};
+	request.nxnSNR = {3};
+	request.centerOfGravity = true;
+	request.noise = true;
+
+	EUTelClusterFeatures features;
+	features.compute( *cluster, request );
+
+	ASSERT_EQ( features.getDetectorID(), 3 );
+	ASSERT_FLOAT_EQ( features.getTotalCharge(), 37.f );
+	ASSERT_FLOAT_EQ( features.getSeedCharge(), 20.f );
+	ASSERT_EQ( features.getClusterQuality(), kGoodCluster );
+
+	for(int n: request.nCharge) ASSERT_EQ( features.getNCharge(n), cluster->getClusterCharge(n) ) << "n " << n;
+	ASSERT_FLOAT_EQ( features.getNCharge(3), 33.f );
+	ASSERT_EQ( features.getNxNCharge(3), cluster->getClusterCharge(3, 3) );
+
+	float xCoG, yCoG, xExpected, yExpected;
+	features.getCenterOfGravity( xCoG, yCoG );
+	cluster->getCenterOfGravity( xExpected, yExpected );
+	ASSERT_EQ( xCoG, xExpected );
+	ASSERT_EQ( yCoG, yExpected );
+
+	ASSERT_TRUE( features.hasNoise() );
+	ASSERT_EQ( features.getClusterNoise(), cluster->getClusterNoise() );
+	ASSERT_EQ( features.getClusterSNR(), cluster->getClusterSNR() );
+	ASSERT_EQ( features.getSeedSNR(), cluster->getSeedSNR() );
+	ASSERT_EQ( features.getNSNR(2), cluster->getClusterSNR(2) );
+	ASSERT_EQ( features.getNxNSNR(3), cluster->getClusterSNR(3, 3) );
+
+	//sizes which were not requested are zero
+	ASSERT_EQ( features.getNCharge(4), 0.f );
+	ASSERT_EQ( features.getNxNSNR(5), 0.f );
+}
+
+/** A record covers a request only if all the requested quantities were computed.
+ */
+TEST_F(EUTelClusterFeaturesTest, Covers) {
+
+	EUTelClusterFeatureRequest request;
+	request.nCharge = {2, 3};
+
+	EUTelClusterFeatures features;
+	ASSERT_FALSE( features.covers(EUTelClusterFeatureRequest()) );
+
+	features.compute( *cluster, request );
+	ASSERT_TRUE( features.covers(EUTelClusterFeatureRequest()) );
+	ASSERT_TRUE( features.covers(request) );
+	ASSERT_FALSE( features.hasNoise() );
+
+	EUTelClusterFeatureRequest other = request;
+	other.nCharge = {3};
+	ASSERT_TRUE( features.covers(other) );
+	other.nCharge = {4};
+	ASSERT_FALSE( features.covers(other) );
+	other = request;
+	other.noise = true;
+	ASSERT_FALSE( features.covers(other) );
+	other = request;
+	other.centerOfGravity = true;
+	ASSERT_FALSE( features.covers(other) );
+}
+
+/** A record attached to a pulse is found again and replaced by a later one.
+ */
+TEST_F(EUTelClusterFeaturesTest, AttachToPulse) {
+
+	IMPL::TrackerPulseImpl pulse;
+	ASSERT_TRUE( EUTelClusterFeatures::get(&pulse) == nullptr );
+
+	EUTelClusterFeatures * features = new EUTelClusterFeatures;
+	features->compute( *cluster, EUTelClusterFeatureRequest() );
+	EUTelClusterFeatures::attach( &pulse, features );
+	ASSERT_EQ( EUTelClusterFeatures::get(&pulse), features );
+	ASSERT_EQ( EUTelClusterFeatures::get(&pulse)->getDetectorID(), 3 );
+
+	EUTelClusterFeatures * replacement = new EUTelClusterFeatures;
+	EUTelClusterFeatures::attach( &pulse, replacement );
+	ASSERT_EQ( EUTelClusterFeatures::get(&pulse), replacement );
+}
@@ -0,0 +1,65 @@
+//STL
+#include <string>
+#include <vector>
+
+//GTest
+#include "gtest/gtest.h"
+
+//EUTelescope
+#include "EUTelEventObjectPool.h"
+
+using eutelescope::EUTelEventObjectPool;
+
+namespace {
+
+	/** Counts constructions and resets, and keeps a buffer to check that the memory is reused.
+	 */
+	struct Counted {
+		static int nConstructed;
+		static int nReset;
+		std::string name;
+		std::vector<int> buffer;
+
+		Counted(std::string const & aName, int size) : name(aName), buffer(size, 0) { nConstructed++; }
+		void reset(std::string const & aName, int size) {
+			name = aName;
+			buffer.assign(size, 0);
+			nReset++;
+		}
+	};
+	int Counted::nConstructed = 0;
+	int Counted::nReset = 0;
+}
+
+/** After a recycle the same objects are handed out again, reset with the new arguments, and new ones are only
+ *  constructed when more objects are needed than in any previous event.
+ */
+TEST(EUTelEventObjectPoolTest, Recycle) {
+
+	Counted::nConstructed = Counted::nReset = 0;
+	EUTelEventObjectPool<Counted> pool;
+
+	std::vector<Counted *> first;
+	for(int i = 0; i < 3; i++) first.push_back( pool.acquire("first", 100) );
+	ASSERT_EQ( Counted::nConstructed, 3 );
+	ASSERT_EQ( pool.getNumberOfUsed(), 3u );
+	ASSERT_NE( first[0], first[1] );
+
+	pool.recycle();
+	ASSERT_EQ( pool.getNumberOfUsed(), 0u );
+	ASSERT_EQ( pool.getNumberOfObjects(), 3u );
+
+	Counted * reused = pool.acquire("second", 10);
+	ASSERT_EQ( reused, first[0] );
+	ASSERT_EQ( reused->name, "second" );
+	ASSERT_EQ( reused->buffer.size(), 10u );
+	ASSERT_GE( reused->buffer.capacity(), 100u );
+	ASSERT_EQ( Counted::nConstructed, 3 );
+	ASSERT_EQ( Counted::nReset, 1 );
+
+	for(int i = 0; i < 4; i++) pool.acquire("second", 10);
+	ASSERT_EQ( Counted::nConstructed, 5 );
+	ASSERT_EQ( Counted::nReset, 3 );
+	ASSERT_EQ( pool.getNumberOfUsed(), 5u );
+	ASSERT_EQ( pool.getNumberOfObjects(), 5u );
+}
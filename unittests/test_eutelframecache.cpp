@@ -0,0 +1,215 @@
+//STL
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//POSIX
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+//GTest
+#include "gtest/gtest.h"
+
+//EUTelescope
+#include "EUTelFrameCache.h"
+
+using eutelescope::EUTelAsciiNumberScanner;
+using eutelescope::EUTelFrameCacheReader;
+using eutelescope::EUTelFrameCacheWriter;
+
+/** Writes the test files in the working directory and removes them afterwards.
+ */
+class EUTelFrameCacheTest : public ::testing::Test {
+protected:
+	std::string const textFile = "test_eutelframecache_source.txt";
+	std::string const cacheFile = "test_eutelframecache_source.cache";
+
+	virtual void TearDown() {
+		std::remove( textFile.c_str() );
+		std::remove( cacheFile.c_str() );
+		std::remove( (cacheFile + ".tmp").c_str() );
+	}
+
+	void writeText(std::string const & content) {
+		std::ofstream out( textFile.c_str(), std::ios::binary );
+		out << content;
+	}
+
+	/** Writes a cache of nFrames frames of 4x3 pixels, pixel i of frame f has the value 100*f + i.
+	 */
+	void writeCache(int nFrames) {
+		EUTelFrameCacheWriter writer;
+		ASSERT_TRUE( writer.open(cacheFile, textFile, 4, 3) );
+		std::vector<short> frame(12);
+		for(int iFrame = 0; iFrame < nFrames; iFrame++) {
+			for(int i = 0; i < 12; i++) frame[i] = static_cast<short>(100*iFrame + i);
+			ASSERT_TRUE( writer.addFrame(&frame[0]) );
+		}
+		ASSERT_TRUE( writer.close() );
+	}
+};
+
+/** The scanner reads the file in blocks of 1 MiB: 12345 is split after 12 and the sign of -7 is the last byte of
+ *  the second block. Both must be continued with the next block.
+ */
+TEST_F(EUTelFrameCacheTest, NumberAcrossBufferBoundary) {
+
+	std::size_t const blockSize = 1 << 20;
+	writeText( std::string(blockSize - 2, ' ') + "12345 " + std::string(blockSize - 5, '\n') + "-7 8" );
+
+	EUTelAsciiNumberScanner scanner;
+	ASSERT_TRUE( scanner.open(textFile) );
+	short value = 0;
+	ASSERT_EQ( scanner.next(value), EUTelAsciiNumberScanner::kValue );
+	ASSERT_EQ( value, 12345 );
+	ASSERT_EQ( scanner.next(value), EUTelAsciiNumberScanner::kValue );
+	ASSERT_EQ( value, -7 );
+	ASSERT_EQ( scanner.next(value), EUTelAsciiNumberScanner::kValue );
+	ASSERT_EQ( value, 8 );
+	ASSERT_EQ( scanner.next(value), EUTelAsciiNumberScanner::kEnd );
+}
+
+/** A sign without digits is an error, in the middle as well as at the end of the file.
+ */
+TEST_F(EUTelFrameCacheTest, SignWithoutDigits) {
+
+	short value = 0;
+	EUTelAsciiNumberScanner scanner;
+
+	writeText( "3 - 4" );
+	ASSERT_TRUE( scanner.open(textFile) );
+	ASSERT_EQ( scanner.next(value), EUTelAsciiNumberScanner::kValue );
+	ASSERT_EQ( value, 3 );
+	ASSERT_EQ( scanner.next(value), EUTelAsciiNumberScanner::kError );
+
+	writeText( "5 +" );
+	ASSERT_TRUE( scanner.open(textFile) );
+	ASSERT_EQ( scanner.next(value), EUTelAsciiNumberScanner::kValue );
+	ASSERT_EQ( scanner.next(value), EUTelAsciiNumberScanner::kError );
+
+	writeText( "12a" );
+	ASSERT_TRUE( scanner.open(textFile) );
+	ASSERT_EQ( scanner.next(value), EUTelAsciiNumberScanner::kValue );
+	ASSERT_EQ( scanner.next(value), EUTelAsciiNumberScanner::kError );
+}
+
+/** The range is the one of a short: -32768 is accepted, +32768 is not.
+ */
+TEST_F(EUTelFrameCacheTest, ShortRange) {
+
+	short value = 0;
+	EUTelAsciiNumberScanner scanner;
+
+	writeText( "32767 -32768 +12 32768" );
+	ASSERT_TRUE( scanner.open(textFile) );
+	ASSERT_EQ( scanner.next(value), EUTelAsciiNumberScanner::kValue );
+	ASSERT_EQ( value, 32767 );
+	ASSERT_EQ( scanner.next(value), EUTelAsciiNumberScanner::kValue );
+	ASSERT_EQ( value, -32768 );
+	ASSERT_EQ( scanner.next(value), EUTelAsciiNumberScanner::kValue );
+	ASSERT_EQ( value, 12 );
+	ASSERT_EQ( scanner.next(value), EUTelAsciiNumberScanner::kError );
+
+	writeText( "-32769" );
+	ASSERT_TRUE( scanner.open(textFile) );
+	ASSERT_EQ( scanner.next(value), EUTelAsciiNumberScanner::kError );
+
+	writeText( "0000000000000000000000001" );
+	ASSERT_TRUE( scanner.open(textFile) );
+	ASSERT_EQ( scanner.next(value), EUTelAsciiNumberScanner::kValue );
+	ASSERT_EQ( value, 1 );
+}
+
+/** Reading a whole frame: kEnd only if the file ends before the first value.
+ */
+TEST_F(EUTelFrameCacheTest, ReadFrame) {
+
+	short values[5];
+	std::size_t nRead = 0;
+	EUTelAsciiNumberScanner scanner;
+
+	writeText( "1 2 3 4 5\n6 7\n" );
+	ASSERT_TRUE( scanner.open(textFile) );
+	ASSERT_EQ( scanner.next(values, 5, nRead), EUTelAsciiNumberScanner::kValue );
+	ASSERT_EQ( nRead, 5u );
+	ASSERT_EQ( values[4], 5 );
+	ASSERT_EQ( scanner.next(values, 5, nRead), EUTelAsciiNumberScanner::kError );
+	ASSERT_EQ( nRead, 2u );
+	ASSERT_EQ( scanner.next(values, 5, nRead), EUTelAsciiNumberScanner::kEnd );
+}
+
+/** Frames written to the cache are read back unchanged.
+ */
+TEST_F(EUTelFrameCacheTest, RoundTrip) {
+
+	writeText( "source" );
+	writeCache(3);
+
+	EUTelFrameCacheReader reader;
+	ASSERT_TRUE( reader.open(cacheFile, textFile, 4, 3) );
+	ASSERT_EQ( reader.getNumberOfFrames(), 3u );
+	for(int iFrame = 0; iFrame < 3; iFrame++) {
+		for(int i = 0; i < 12; i++) ASSERT_EQ( reader.getFrame(iFrame)[i], 100*iFrame + i );
+	}
+
+	//a different frame size is refused
+	ASSERT_FALSE( reader.open(cacheFile, textFile, 3, 4) );
+	ASSERT_FALSE( reader.isOpen() );
+}
+
+/** A cache which is shorter than announced by its header is refused, and a writer which is not closed leaves no
+ *  cache behind.
+ */
+TEST_F(EUTelFrameCacheTest, TruncatedCache) {
+
+	writeText( "source" );
+	writeCache(3);
+	struct stat cacheStat;
+	ASSERT_EQ( ::stat(cacheFile.c_str(), &cacheStat), 0 );
+	ASSERT_EQ( ::truncate(cacheFile.c_str(), cacheStat.st_size - 1), 0 );
+
+	EUTelFrameCacheReader reader;
+	ASSERT_FALSE( reader.open(cacheFile, textFile, 4, 3) );
+
+	std::remove( cacheFile.c_str() );
+	{
+		EUTelFrameCacheWriter writer;
+		ASSERT_TRUE( writer.open(cacheFile, textFile, 4, 3) );
+		short frame[12] = {0};
+		ASSERT_TRUE( writer.addFrame(frame) );
+	}
+	ASSERT_NE( ::access(cacheFile.c_str(), F_OK), 0 );
+	ASSERT_NE( ::access((cacheFile + ".tmp").c_str(), F_OK), 0 );
+}
+
+/** A cache is refused once its source has a different size or modification time.
+ */
+TEST_F(EUTelFrameCacheTest, SourceChanged) {
+
+	writeText( "source" );
+	struct utimbuf times;
+	times.actime = times.modtime = 1000000000;
+	ASSERT_EQ( ::utime(textFile.c_str(), &times), 0 );
+	writeCache(2);
+
+	EUTelFrameCacheReader reader;
+	ASSERT_TRUE( reader.open(cacheFile, textFile, 4, 3) );
+
+	//same size, other modification time
+	times.actime = times.modtime = 1000000001;
+	ASSERT_EQ( ::utime(textFile.c_str(), &times), 0 );
+	ASSERT_FALSE( reader.open(cacheFile, textFile, 4, 3) );
+
+	//same modification time, other size
+	writeText( "source2" );
+	times.actime = times.modtime = 1000000000;
+	ASSERT_EQ( ::utime(textFile.c_str(), &times), 0 );
+	ASSERT_FALSE( reader.open(cacheFile, textFile, 4, 3) );
+
+	//back to the original source
+	writeText( "source" );
+	ASSERT_EQ( ::utime(textFile.c_str(), &times), 0 );
+	ASSERT_TRUE( reader.open(cacheFile, textFile, 4, 3) );
+}
@@ -3,6 +3,7 @@
 #include <random>
 #include <chrono>
 #include <cmath>
+#include <memory>
 
 //Eigen
 #include <Eigen/Core>
@@ -11,13 +12,39 @@
 //GTest
 #include "gtest/gtest.h"
 
+//GEAR
+#include "gearimpl/GearMgrImpl.h"
+#include "gearimpl/ConstantBField.h"
+#include "gearimpl/Vector3D.h"
+
 //EUTelescope
 #include "eutelgeotest.h"
+#include "EUTelExceptions.h"
 
 #define PI 3.14159265
 
 namespace eugeo = eutelescope::geo;
 
+// Puts a constant magnetic field (in Tesla) into the geometry for the lifetime of the object. The geometry keeps
+// the planes it has read, only the field is taken from the new GEAR manager. The field is set back to zero at the end.
+class ConstantFieldGuard {
+public:
+	ConstantFieldGuard(double bx, double by, double bz) {
+		gear::GearXML gearXML( "unitTestGear1.xml" );
+		gearManager = dynamic_cast<gear::GearMgrImpl*>( gearXML.createGearMgr() );
+		gearManager->setBField( new gear::ConstantBField( gear::Vector3D(bx, by, bz) ) );
+		eugeo::gGeometry().setGearManager( gearManager );
+	}
+
+	~ConstantFieldGuard() {
+		gearManager->setBField( new gear::ConstantBField( gear::Vector3D(0, 0, 0) ) );
+		eugeo::gGeometry().setGearManager( gearManager );
+	}
+
+private:
+	gear::GearMgrImpl* gearManager;
+};
+
 // The fixture for testing class eutelgeotest. From google test primer.
 class eutelgeotestTest : public ::testing::Test {
 protected:
@@ -280,4 +307,280 @@ TEST_F(eutelgeotestTest, radLengthTest1) {
 	std::cout << "Rad: " << eugeo::gGeometry().FindRad(begin3, end3) << std::endl;
 }
 
+/** The material map is built together with the TGeo geometry. At the center of each plane and at normal incidence
+ *  it must give the radiation length found by stepping through TGeo with FindRad.
+ */
+TEST_F(eutelgeotestTest, MaterialMapNormalIncidence) {
+
+	ASSERT_TRUE( eugeo::gGeometry().hasMaterialMap() );
+
+	auto sensorIDVec = eugeo::gGeometry().sensorIDsVec();
+	for( auto sensorID: sensorIDVec ) {
+		TVector3 normalT = eugeo::gGeometry().siPlaneNormal( sensorID );
+		Eigen::Vector3d normal( normalT[0], normalT[1], normalT[2] );
+		Eigen::Vector3d center = eugeo::gGeometry().getOffsetVector( sensorID );
+		double halfDepth = 0.51*eugeo::gGeometry().siPlaneZSize( sensorID );
+		double reference = eugeo::gGeometry().FindRad( center - halfDepth*normal, center + halfDepth*normal );
+
+		ASSERT_GT( reference, 0 );
+		ASSERT_NEAR( eugeo::gGeometry().planeRadLength( sensorID, 0, 0, normal ), reference, 1e-3*reference );
+		ASSERT_NEAR( eugeo::gGeometry().planeRadLengthGlobalIncidence( sensorID, normal ), reference, 1e-3*reference );
+		ASSERT_NEAR( eugeo::gGeometry().planeRadLengthLocalIncidence( sensorID, Eigen::Vector3d(0,0,1) ), reference, 1e-3*reference );
+	}
+}
+
+/** The planes are uniform slabs, so the map must not depend on the position on the plane and must scale with 1/cos
+ *  of the incidence angle.
+ */
+TEST_F(eutelgeotestTest, MaterialMapPositionAndIncidence) {
+
+	double const abs_err = 1e-12;
+	auto sensorIDVec = eugeo::gGeometry().sensorIDsVec();
+	for( auto sensorID: sensorIDVec ) {
+		TVector3 normalT = eugeo::gGeometry().siPlaneNormal( sensorID );
+		TVector3 xAxisT = eugeo::gGeometry().siPlaneXAxis( sensorID );
+		Eigen::Vector3d normal( normalT[0], normalT[1], normalT[2] );
+		Eigen::Vector3d xAxis( xAxisT[0], xAxisT[1], xAxisT[2] );
+		double halfX = 0.5*eugeo::gGeometry().siPlaneXSize( sensorID );
+		double halfY = 0.5*eugeo::gGeometry().siPlaneYSize( sensorID );
+
+		double center = eugeo::gGeometry().planeRadLength( sensorID, 0, 0, normal );
+		ASSERT_NEAR( eugeo::gGeometry().planeRadLength( sensorID, 0.7*halfX, -0.3*halfY, normal ), center, abs_err );
+		//outside of the plane the map is clamped at its edges
+		ASSERT_NEAR( eugeo::gGeometry().planeRadLength( sensorID, 3*halfX, 3*halfY, normal ), center, abs_err );
+
+		Eigen::Vector3d tilted = cos(30*PI/180)*normal + sin(30*PI/180)*xAxis;
+		ASSERT_NEAR( eugeo::gGeometry().planeRadLength( sensorID, 0, 0, tilted ), center/cos(30*PI/180), 1e-9 );
+		ASSERT_NEAR( eugeo::gGeometry().planeRadLengthLocalIncidence( sensorID, Eigen::Vector3d(0.5,0,1) ), center*sqrt(1.25), 1e-9 );
+	}
+}
+
+/** Unknown sensor IDs must be reported as for the geometry without material map.
+ */
+TEST_F(eutelgeotestTest, MaterialMapUnknownSensor) {
+
+	ASSERT_TRUE( eugeo::gGeometry().hasMaterialMap() );
+	Eigen::Vector3d const dir(0,0,1);
+	ASSERT_THROW( eugeo::gGeometry().planeRadLengthLocalIncidence( 1000, dir ), eutelescope::InvalidGeometryException );
+	ASSERT_THROW( eugeo::gGeometry().planeRadLengthGlobalIncidence( 1000, dir ), eutelescope::InvalidGeometryException );
+	ASSERT_THROW( eugeo::gGeometry().planeRadLength( 1000, 0, 0, dir ), eutelescope::InvalidGeometryException );
+	ASSERT_EQ( eugeo::gGeometry().radLengthToNextPlane( 1000, dir ), 0 );
+}
+
+/** The air between two planes is stored with the map. It must match FindRad along z from the back of a plane to the
+ *  front of the next one, and the last plane has nothing behind it.
+ */
+TEST_F(eutelgeotestTest, MaterialMapGapToNextPlane) {
+
+	auto sensorIDVec = eugeo::gGeometry().sensorIDsVec();
+	Eigen::Vector3d const dir(0,0,1);
+	for( size_t i = 0; i + 1 < sensorIDVec.size(); i++ ) {
+		int sensorID = sensorIDVec[i];
+		int nextID = sensorIDVec[i+1];
+		Eigen::Vector3d start = eugeo::gGeometry().getOffsetVector( sensorID );
+		start(2) += 0.51*eugeo::gGeometry().siPlaneZSize( sensorID );
+		Eigen::Vector3d end = start;
+		end(2) = eugeo::gGeometry().siPlaneZPosition( nextID ) - 0.51*eugeo::gGeometry().siPlaneZSize( nextID );
+		double reference = end(2) > start(2) ? eugeo::gGeometry().FindRad( start, end ) : 0;
+
+		ASSERT_NEAR( eugeo::gGeometry().radLengthToNextPlane( sensorID, dir ), reference, 1e-3*reference + 1e-12 );
+		ASSERT_NEAR( eugeo::gGeometry().radLengthToNextPlane( sensorID, Eigen::Vector3d(0,1,1) ), sqrt(2.)*reference, 1e-3*reference + 1e-12 );
+	}
+	ASSERT_EQ( eugeo::gGeometry().radLengthToNextPlane( sensorIDVec.back(), dir ), 0 );
+}
+
+/** A line through all the planes collects every plane once. The weights of the sensors and of the air are fractions
+ *  of the returned total.
+ */
+TEST_F(eutelgeotestTest, MaterialMapTotalRadiationLength) {
+
+	auto sensorIDVec = eugeo::gGeometry().sensorIDsVec();
+	double const start[3] = {0, 0, eugeo::gGeometry().siPlaneZPosition( sensorIDVec.front() ) - 5};
+	double const end[3] = {0, 0, eugeo::gGeometry().siPlaneZPosition( sensorIDVec.back() ) + 5};
+
+	std::map<const int, double> sensorWeights;
+	std::map<const int, double> airWeights;
+	float total = eugeo::gGeometry().calculateTotalRadiationLengthAndWeights( start, end, sensorWeights, airWeights );
+
+	ASSERT_GT( total, 0 );
+	ASSERT_EQ( sensorWeights.size(), sensorIDVec.size() );
+
+	double sum = 0;
+	double sensorSum = 0;
+	for( auto sensorID: sensorIDVec ) {
+		ASSERT_EQ( sensorWeights.count( sensorID ), 1u );
+		sensorSum += sensorWeights[sensorID]*total;
+		sum += sensorWeights[sensorID] + airWeights[sensorID];
+	}
+	ASSERT_NEAR( sum, 1, 1e-6 );
+
+	double reference = 0;
+	for( auto sensorID: sensorIDVec ) {
+		//the line crosses every plane at its center
+		reference += eugeo::gGeometry().planeRadLength( sensorID, 0, 0, Eigen::Vector3d(0,0,1) );
+	}
+	ASSERT_NEAR( sensorSum, reference, 1e-5*reference );
+}
+
+/** Without magnetic field a track reaches a plane along a straight line. The intersection must lie on the plane and
+ *  on the line, for every plane including the rotated ones, and the momentum is unchanged.
+ */
+TEST_F(eutelgeotestTest, StraightLineIntersection) {
+
+	ASSERT_TRUE( eugeo::gGeometry().isFieldFree() );
+
+	std::uniform_real_distribution<double> offset(-2.0,2.0);
+	std::uniform_real_distribution<double> slope(-0.05,0.05);
+	double const abs_err = 1e-4;
+
+	auto sensorIDVec = eugeo::gGeometry().sensorIDsVec();
+	for(size_t i = 0; i < 100; i++) {
+		float const x0 = offset(generator), y0 = offset(generator), z0 = -20;
+		float const pz = 5, px = slope(generator)*pz, py = slope(generator)*pz;
+		double const pMag = std::sqrt( px*px + py*py + pz*pz );
+
+		for( auto sensorID: sensorIDVec ) {
+			float position[3];
+			TVector3 momentum;
+			float arcLength;
+			int newNextPlaneID;
+			ASSERT_TRUE( eugeo::gGeometry().findIntersectionWithCertainID( x0, y0, z0, px, py, pz, -1, sensorID, position, momentum, arcLength, newNextPlaneID ) );
+			ASSERT_EQ( newNextPlaneID, sensorID );
+
+			double global[3] = {position[0], position[1], position[2]};
+			double local[3];
+			eugeo::gGeometry().master2Local( sensorID, global, local );
+			ASSERT_NEAR( local[2], 0, abs_err );
+
+			ASSERT_NEAR( position[0], x0 + arcLength*px/pMag, abs_err );
+			ASSERT_NEAR( position[1], y0 + arcLength*py/pMag, abs_err );
+			ASSERT_NEAR( position[2], z0 + arcLength*pz/pMag, abs_err );
+			ASSERT_NEAR( momentum.X(), px, 1e-6 );
+			ASSERT_NEAR( momentum.Y(), py, 1e-6 );
+			ASSERT_NEAR( momentum.Z(), pz, 1e-6 );
+		}
+	}
+
+	//a track parallel to the plane never reaches it
+	float position[3];
+	TVector3 momentum;
+	float arcLength;
+	int newNextPlaneID;
+	ASSERT_FALSE( eugeo::gGeometry().findIntersectionWithCertainID( 0, 0, 0, 1, 0, 0, -1, 5, position, momentum, arcLength, newNextPlaneID ) );
+	ASSERT_EQ( newNextPlaneID, -999 );
+}
+
+/** In a field along y a track starting along z follows a circle of radius R = p/(0.3 B) in the xz plane. Its crossing
+ *  with a plane perpendicular to z must be on that circle, bent towards +x for a negative charge by the Lorentz force.
+ *  For a vanishing field the helix must give the straight line intersection.
+ */
+TEST_F(eutelgeotestTest, HelixIntersection) {
+
+	//sensor 5 is perpendicular to z
+	int const sensorID = 5;
+	double const zPlane = eugeo::gGeometry().siPlaneZPosition( sensorID );
+	float const x0 = 1.0, y0 = 0.5, z0 = -20, p = 0.5;
+	double const dz = zPlane - z0;
+	double const abs_err = 1e-4;
+
+	float position[3];
+	TVector3 momentum;
+	float arcLength;
+	int newNextPlaneID;
+
+	{
+		ConstantFieldGuard field(0, 1, 0);
+		ASSERT_FALSE( eugeo::gGeometry().isFieldFree() );
+
+		//radius in mm for p in GeV and B in Tesla
+		double const radius = p/0.299792458E-3;
+		double const bending = radius - std::sqrt( radius*radius - dz*dz );
+
+		ASSERT_TRUE( eugeo::gGeometry().findIntersectionWithCertainID( x0, y0, z0, 0, 0, p, -1, sensorID, position, momentum, arcLength, newNextPlaneID ) );
+		ASSERT_NEAR( position[0], x0 + bending, abs_err );
+		ASSERT_NEAR( position[1], y0, abs_err );
+		ASSERT_NEAR( position[2], zPlane, abs_err );
+		ASSERT_NEAR( arcLength, radius*std::asin( dz/radius ), abs_err );
+		ASSERT_NEAR( momentum.X(), p*dz/radius, 1e-6 );
+		ASSERT_NEAR( momentum.Mag(), p, 1e-6 );
+
+		TVector3 const propagated = eugeo::gGeometry().getXYZMomentumfromArcLength( TVector3(0, 0, p), TVector3(x0, y0, z0), -1, arcLength );
+		ASSERT_NEAR( propagated.X(), momentum.X(), 1e-6 );
+		ASSERT_NEAR( propagated.Z(), momentum.Z(), 1e-6 );
+
+		//the opposite charge bends the other way
+		ASSERT_TRUE( eugeo::gGeometry().findIntersectionWithCertainID( x0, y0, z0, 0, 0, p, 1, sensorID, position, momentum, arcLength, newNextPlaneID ) );
+		ASSERT_NEAR( position[0], x0 - bending, abs_err );
+	}
+
+	float straight[3];
+	ASSERT_TRUE( eugeo::gGeometry().isFieldFree() );
+	ASSERT_TRUE( eugeo::gGeometry().findIntersectionWithCertainID( x0, y0, z0, 0.01, 0.02, p, -1, sensorID, straight, momentum, arcLength, newNextPlaneID ) );
+
+	{
+		ConstantFieldGuard field(0, 1E-6, 0);
+		ASSERT_FALSE( eugeo::gGeometry().isFieldFree() );
+		ASSERT_TRUE( eugeo::gGeometry().findIntersectionWithCertainID( x0, y0, z0, 0.01, 0.02, p, -1, sensorID, position, momentum, arcLength, newNextPlaneID ) );
+		for(int i = 0; i < 3; i++) {
+			ASSERT_NEAR( position[i], straight[i], abs_err );
+		}
+	}
+}
+
+/** The batched intersection must give the same results as the intersection of each track on its own, with and
+ *  without field, and mark the tracks not crossing the plane.
+ */
+TEST_F(eutelgeotestTest, BatchedIntersection) {
+
+	std::uniform_real_distribution<double> offset(-2.0,2.0);
+	std::uniform_real_distribution<double> slope(-0.05,0.05);
+	double const abs_err = 1e-4;
+	size_t const nTracks = 50;
+
+	//the values are rounded to float as for the single track method
+	std::vector<double> positions, momenta;
+	for(size_t i = 0; i < nTracks; i++) {
+		positions.push_back( static_cast<float>( offset(generator) ) );
+		positions.push_back( static_cast<float>( offset(generator) ) );
+		positions.push_back( -20 );
+		momenta.push_back( static_cast<float>( slope(generator) ) );
+		momenta.push_back( static_cast<float>( slope(generator) ) );
+		momenta.push_back( 1 );
+	}
+	//this one is parallel to the planes perpendicular to z
+	momenta[3*(nTracks-1)] = 1;
+	momenta[3*(nTracks-1)+2] = 0;
+
+	for(int withField = 0; withField < 2; withField++) {
+		std::unique_ptr<ConstantFieldGuard> field( withField ? new ConstantFieldGuard(0, 1, 0) : nullptr );
+
+		for( auto sensorID: {1, 5} ) {
+			std::vector<double> outputPositions, outputMomenta, arcLengths;
+			int nCrossing = eugeo::gGeometry().findIntersectionsWithPlane( sensorID, positions, momenta, -1, outputPositions, outputMomenta, arcLengths );
+			ASSERT_EQ( arcLengths.size(), nTracks );
+
+			int nSingle = 0;
+			for(size_t i = 0; i < nTracks; i++) {
+				float position[3];
+				TVector3 momentum;
+				float arcLength;
+				int newNextPlaneID;
+				bool crossing = eugeo::gGeometry().findIntersectionWithCertainID( positions[3*i], positions[3*i+1], positions[3*i+2],
+						momenta[3*i], momenta[3*i+1], momenta[3*i+2], -1, sensorID, position, momentum, arcLength, newNextPlaneID );
+				ASSERT_EQ( crossing, !std::isnan( arcLengths[i] ) );
+				if( !crossing ) continue;
+				nSingle++;
+				ASSERT_NEAR( arcLengths[i], arcLength, abs_err );
+				for(int j = 0; j < 3; j++) {
+					ASSERT_NEAR( outputPositions[3*i+j], position[j], abs_err );
+				}
+				ASSERT_NEAR( outputMomenta[3*i], momentum.X(), 1e-6 );
+				ASSERT_NEAR( outputMomenta[3*i+1], momentum.Y(), 1e-6 );
+				ASSERT_NEAR( outputMomenta[3*i+2], momentum.Z(), 1e-6 );
+			}
+			ASSERT_EQ( nCrossing, nSingle );
+		}
+	}
+}
+
 // }  // namespace - could surround eutelgeotestTest in a namespace
@@ -0,0 +1,116 @@
+//STL
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//POSIX
+#include <sys/stat.h>
+#include <unistd.h>
+
+//GTest
+#include "gtest/gtest.h"
+
+//EUTelescope
+#include "EUTelHitCache.h"
+
+using eutelescope::EUTelCachedHit;
+using eutelescope::EUTelHitCacheFileReader;
+using eutelescope::EUTelHitCacheFileWriter;
+
+/** Writes the test cache in the working directory and removes it afterwards.
+ */
+class EUTelHitCacheTest : public ::testing::Test {
+protected:
+	std::string const cacheFile = "test_eutelhitcache.cache";
+
+	virtual void TearDown() {
+		std::remove( cacheFile.c_str() );
+	}
+
+	static EUTelCachedHit makeHit(int i) {
+		EUTelCachedHit hit;
+		hit.x = 0.5f*i;
+		hit.y = -0.25f*i;
+		hit.z = 150.f*(i % 6);
+		hit.covXX = 1e-5f*i;
+		hit.covYY = 2e-5f*i;
+		hit.charge = 100.f + i;
+		hit.sensorID = i % 6;
+		hit.clusterSize = 1 + i % 4;
+		hit.properties = i % 2;
+		hit.type = 3;
+		return hit;
+	}
+
+	/** Three events with 3, 0 and 2 hits: an odd number of events and hits checks the padding of the sections.
+	 */
+	void writeCache() {
+		EUTelHitCacheFileWriter writer;
+		ASSERT_TRUE( writer.open(cacheFile) );
+		writer.addEvent(123, 7, {makeHit(0), makeHit(1), makeHit(2)});
+		writer.addEvent(123, 8, {});
+		writer.addEvent(124, 0, {makeHit(3), makeHit(4)});
+		ASSERT_EQ( writer.getNumberOfEvents(), 3u );
+		ASSERT_EQ( writer.getNumberOfHits(), 5u );
+		ASSERT_TRUE( writer.close() );
+	}
+};
+
+/** The events and hits written are read back unchanged.
+ */
+TEST_F(EUTelHitCacheTest, RoundTrip) {
+
+	writeCache();
+
+	EUTelHitCacheFileReader reader;
+	ASSERT_TRUE( reader.open(cacheFile) );
+	ASSERT_EQ( reader.getNumberOfEvents(), 3u );
+	ASSERT_EQ( reader.getNumberOfHits(), 5u );
+
+	ASSERT_EQ( reader.getRunNumber(0), 123 );
+	ASSERT_EQ( reader.getEventNumber(1), 8 );
+	ASSERT_EQ( reader.getRunNumber(2), 124 );
+	ASSERT_EQ( reader.getHitBegin(0), 0u );
+	ASSERT_EQ( reader.getHitEnd(0), 3u );
+	ASSERT_EQ( reader.getHitBegin(1), reader.getHitEnd(1) );
+	ASSERT_EQ( reader.getHitBegin(2), 3u );
+	ASSERT_EQ( reader.getHitEnd(2), 5u );
+
+	for(int i = 0; i < 5; i++) {
+		EUTelCachedHit const expected = makeHit(i);
+		EUTelCachedHit const hit = reader.getHit(i);
+		ASSERT_EQ( hit.x, expected.x );
+		ASSERT_EQ( hit.y, expected.y );
+		ASSERT_EQ( hit.z, expected.z );
+		ASSERT_EQ( hit.covXX, expected.covXX );
+		ASSERT_EQ( hit.covYY, expected.covYY );
+		ASSERT_EQ( hit.charge, expected.charge );
+		ASSERT_EQ( hit.sensorID, expected.sensorID );
+		ASSERT_EQ( hit.clusterSize, expected.clusterSize );
+		ASSERT_EQ( hit.properties, expected.properties );
+		ASSERT_EQ( hit.type, expected.type );
+		ASSERT_EQ( reader.getCharge()[i], expected.charge );
+	}
+}
+
+/** A truncated cache or a file which is not a cache is refused.
+ */
+TEST_F(EUTelHitCacheTest, InvalidFile) {
+
+	writeCache();
+	struct stat cacheStat;
+	ASSERT_EQ( ::stat(cacheFile.c_str(), &cacheStat), 0 );
+	ASSERT_EQ( ::truncate(cacheFile.c_str(), cacheStat.st_size - 8), 0 );
+
+	EUTelHitCacheFileReader reader;
+	ASSERT_FALSE( reader.open(cacheFile) );
+	ASSERT_FALSE( reader.isOpen() );
+
+	{
+		std::ofstream out( cacheFile.c_str(), std::ios::binary );
+		out << std::string(4096, 'x');
+	}
+	ASSERT_FALSE( reader.open(cacheFile) );
+	ASSERT_FALSE( reader.open("test_eutelhitcache_missing.cache") );
+}
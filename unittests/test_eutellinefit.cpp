@@ -0,0 +1,177 @@
+//STL
+#include <cmath>
+#include <random>
+#include <vector>
+
+//GTest
+#include "gtest/gtest.h"
+
+//EUTelescope
+#include "EUTelLineFitBatch.h"
+
+using eutelescope::EUTelLineFitBatch;
+
+namespace {
+
+	// Textbook weighted straight line fit p = a + b z of a single track, one projection
+	struct ScalarFit {
+		double intercept;
+		double slope;
+		double chi2;
+	};
+
+	ScalarFit scalarFit(std::vector<double> const & p, std::vector<double> const & z, std::vector<double> const & err) {
+		double s1 = 0, sz = 0, sp = 0, szz = 0, szp = 0;
+		for(size_t i = 0; i < p.size(); i++) {
+			if( err[i] <= 0 ) continue;
+			double w = 1/(err[i]*err[i]);
+			s1 += w;
+			sz += w*z[i];
+			sp += w*p[i];
+			szz += w*z[i]*z[i];
+			szp += w*z[i]*p[i];
+		}
+		ScalarFit fit;
+		fit.slope = (s1*szp - sz*sp)/(s1*szz - sz*sz);
+		fit.intercept = (sp - fit.slope*sz)/s1;
+		fit.chi2 = 0;
+		for(size_t i = 0; i < p.size(); i++) {
+			if( err[i] <= 0 ) continue;
+			double r = fit.intercept + fit.slope*z[i] - p[i];
+			fit.chi2 += r*r/(err[i]*err[i]);
+		}
+		return fit;
+	}
+
+	std::vector<double> const planeZ = {0, 150, 300, 450, 600, 750};
+}
+
+/** Points exactly on a line must give back the line, with zero residuals and chi2.
+ */
+TEST(EUTelLineFitBatchTest, ExactLine) {
+
+	double const abs_err = 1e-9;
+	size_t const nPlanes = planeZ.size();
+	std::vector<double> x(nPlanes), y(nPlanes), ex(nPlanes, 0.0045), ey(nPlanes, 0.0045);
+	for(size_t i = 0; i < nPlanes; i++) {
+		x[i] = 1.5 + 0.001*planeZ[i];
+		y[i] = -2.0 - 0.002*planeZ[i];
+	}
+
+	EUTelLineFitBatch batch( nPlanes );
+	ASSERT_EQ( batch.addTrack( &x[0], &y[0], &planeZ[0], &ex[0], &ey[0] ), 0 );
+	batch.fit();
+
+	ASSERT_EQ( batch.getNumberOfTracks(), 1 );
+	ASSERT_TRUE( batch.isValid(0) );
+	ASSERT_NEAR( batch.getInterceptX(0), 1.5, abs_err );
+	ASSERT_NEAR( batch.getSlopeX(0), 0.001, abs_err );
+	ASSERT_NEAR( batch.getInterceptY(0), -2.0, abs_err );
+	ASSERT_NEAR( batch.getSlopeY(0), -0.002, abs_err );
+	ASSERT_NEAR( batch.getChi2X(0), 0, abs_err );
+	ASSERT_NEAR( batch.getChi2Y(0), 0, abs_err );
+	for(size_t i = 0; i < nPlanes; i++) {
+		ASSERT_NEAR( batch.getFitX(i, 0), x[i], abs_err );
+		ASSERT_NEAR( batch.getResidualY(i, 0), 0, abs_err );
+	}
+}
+
+/** Smeared tracks with different x and y errors on each plane must give the results of the scalar fit of each
+ *  track. In particular the y projection must be weighted with the y errors only.
+ */
+TEST(EUTelLineFitBatchTest, CompareWithScalarFit) {
+
+	double const rel_err = 1e-9;
+	size_t const nPlanes = planeZ.size();
+	size_t const nTracks = 200;
+	std::default_random_engine generator( 12345 );
+	std::normal_distribution<double> smear(0, 1);
+	std::uniform_real_distribution<double> uniform(-0.01, 0.01);
+
+	std::vector<double> ex = {0.0045, 0.0045, 0.0045, 0.0100, 0.0045, 0.0045};
+	std::vector<double> ey = {0.0030, 0.0500, 0.0030, 0.0030, 0.0800, 0.0030};
+
+	EUTelLineFitBatch batch( nPlanes );
+	batch.reserve( nTracks );
+	std::vector< std::vector<double> > xs, ys;
+	for(size_t iTrack = 0; iTrack < nTracks; iTrack++) {
+		std::vector<double> x(nPlanes), y(nPlanes);
+		double a = 10*uniform(generator), b = uniform(generator);
+		double c = 10*uniform(generator), d = uniform(generator);
+		for(size_t i = 0; i < nPlanes; i++) {
+			x[i] = a + b*planeZ[i] + ex[i]*smear(generator);
+			y[i] = c + d*planeZ[i] + ey[i]*smear(generator);
+		}
+		batch.addTrack( &x[0], &y[0], &planeZ[0], &ex[0], &ey[0] );
+		xs.push_back(x);
+		ys.push_back(y);
+	}
+	batch.fit();
+
+	for(size_t iTrack = 0; iTrack < nTracks; iTrack++) {
+		ScalarFit fitX = scalarFit( xs[iTrack], planeZ, ex );
+		ScalarFit fitY = scalarFit( ys[iTrack], planeZ, ey );
+		ASSERT_TRUE( batch.isValid(iTrack) );
+		ASSERT_NEAR( batch.getSlopeX(iTrack), fitX.slope, rel_err*std::abs(fitX.slope) + 1e-12 );
+		ASSERT_NEAR( batch.getInterceptX(iTrack), fitX.intercept, rel_err*std::abs(fitX.intercept) + 1e-12 );
+		ASSERT_NEAR( batch.getChi2X(iTrack), fitX.chi2, rel_err*fitX.chi2 + 1e-9 );
+		ASSERT_NEAR( batch.getSlopeY(iTrack), fitY.slope, rel_err*std::abs(fitY.slope) + 1e-12 );
+		ASSERT_NEAR( batch.getInterceptY(iTrack), fitY.intercept, rel_err*std::abs(fitY.intercept) + 1e-12 );
+		ASSERT_NEAR( batch.getChi2Y(iTrack), fitY.chi2, rel_err*fitY.chi2 + 1e-9 );
+	}
+}
+
+/** With equal x errors and very different y errors the y fit must follow the precise y measurements. Fitting y with
+ *  the x errors gives a different line, so this tells the two weightings apart.
+ */
+TEST(EUTelLineFitBatchTest, YResolution) {
+
+	double const abs_err = 1e-9;
+	std::vector<double> const z = {0, 100, 200};
+	std::vector<double> const x = {0, 0, 0};
+	std::vector<double> const y = {0, 1, 0};
+	std::vector<double> const ex = {1, 1, 1};
+	std::vector<double> const ey = {0.01, 1, 0.01};
+
+	EUTelLineFitBatch batch( 3 );
+	batch.addTrack( &x[0], &y[0], &z[0], &ex[0], &ey[0] );
+	batch.fit();
+
+	ScalarFit withY = scalarFit( y, z, ey );
+	ScalarFit withX = scalarFit( y, z, ex );
+	ASSERT_NEAR( batch.getSlopeY(0), withY.slope, abs_err );
+	ASSERT_NEAR( batch.getInterceptY(0), withY.intercept, abs_err );
+	ASSERT_NEAR( batch.getChi2Y(0), withY.chi2, abs_err );
+	ASSERT_GT( std::abs( batch.getInterceptY(0) - withX.intercept ), 0.1 );
+}
+
+/** Planes with a non positive error are left out of the projection. A projection with a single plane left can not be
+ *  fitted and the track is marked as not valid.
+ */
+TEST(EUTelLineFitBatchTest, ExcludedPlanes) {
+
+	double const abs_err = 1e-9;
+	std::vector<double> const z = {0, 100, 200};
+	std::vector<double> const x = {1, 2, 100};
+	std::vector<double> const y = {5, 5, 5};
+	std::vector<double> const ex = {0.01, 0.01, 0};
+	std::vector<double> const ey = {0.01, -1, 0};
+
+	EUTelLineFitBatch batch( 3 );
+	batch.addTrack( &x[0], &y[0], &z[0], &ex[0], &ey[0] );
+	batch.addTrack( &x[0], &x[0], &z[0], &ex[0], &ex[0] );
+	batch.fit();
+
+	ASSERT_FALSE( batch.isValid(0) );
+	ASSERT_NEAR( batch.getSlopeX(0), 0.01, abs_err );
+	ASSERT_NEAR( batch.getInterceptX(0), 1, abs_err );
+
+	ASSERT_TRUE( batch.isValid(1) );
+	ASSERT_NEAR( batch.getSlopeY(1), 0.01, abs_err );
+
+	//clear keeps the number of planes
+	batch.clear();
+	batch.fit();
+	ASSERT_EQ( batch.getNumberOfTracks(), 0 );
+	ASSERT_EQ( batch.getNumberOfPlanes(), 3 );
+}
@@ -0,0 +1,157 @@
+//STL
+#include <cmath>
+#include <random>
+#include <vector>
+
+//GTest
+#include "gtest/gtest.h"
+
+//EUTelescope
+#include "EUTelMillepedeSolver.h"
+
+using eutelescope::EUTelMillepedeSolver;
+
+namespace {
+
+	std::vector<double> const planeZ = {0, 150, 300, 450};
+
+	/** Straight tracks x = a + b z measured on each plane, with the measurement shifted by the
+	 *  offset of the plane. The offset of plane i is the global parameter with label i+1.
+	 */
+	void fillTracks(EUTelMillepedeSolver & solver, std::vector<double> const & offset, int nTracks) {
+		std::default_random_engine generator( 4711 );
+		std::uniform_real_distribution<double> intercept(-5, 5);
+		std::uniform_real_distribution<double> slope(-0.01, 0.01);
+		for(int iTrack = 0; iTrack < nTracks; iTrack++) {
+			double a = intercept(generator);
+			double b = slope(generator);
+			for(size_t iPlane = 0; iPlane < planeZ.size(); iPlane++) {
+				float derLC[2] = {1.f, static_cast<float>(planeZ[iPlane])};
+				float derGL[1] = {1.f};
+				int label[1] = {static_cast<int>(iPlane) + 1};
+				float residual = static_cast<float>(a + b*planeZ[iPlane] + offset[iPlane]);
+				solver.mille(2, derLC, 1, derGL, label, residual, 0.01f);
+			}
+			solver.end();
+		}
+	}
+}
+
+/** The first and last planes are fixed with a negative pre-sigma, so the two weak modes are removed and the
+ *  offsets of the other planes are found exactly. The fixed parameters stay at their start values.
+ */
+TEST(EUTelMillepedeSolverTest, FixedParameters) {
+
+	double const abs_err = 1e-4;
+	std::vector<double> const offset = {0.02, 0.05, -0.03, -0.01};
+
+	EUTelMillepedeSolver solver;
+	fillTracks(solver, offset, 100);
+	solver.setParameter(1, 0.02, -1.);
+	solver.setParameter(4, -0.01, -1.);
+	ASSERT_TRUE( solver.solve() );
+
+	ASSERT_EQ( solver.getNumberOfTracks(), 100 );
+	ASSERT_EQ( solver.getNumberOfRejectedTracks(), 0 );
+	ASSERT_DOUBLE_EQ( solver.getValue(1), 0.02 );
+	ASSERT_DOUBLE_EQ( solver.getValue(4), -0.01 );
+	ASSERT_EQ( solver.getError(1), 0. );
+	ASSERT_EQ( solver.getError(4), 0. );
+	ASSERT_NEAR( solver.getValue(2), 0.05, abs_err );
+	ASSERT_NEAR( solver.getValue(3), -0.03, abs_err );
+	ASSERT_GT( solver.getError(2), 0. );
+
+	//4 measurements and 2 local parameters per track, 2 free global parameters
+	ASSERT_EQ( solver.getNdf(), 100*4 - 100*2 - 2 );
+	ASSERT_NEAR( solver.getChi2(), 0, 1e-3 );
+}
+
+/** The weak modes are removed with two Lagrange constraints instead: no global shift and no global shear. The
+ *  offsets fulfil both constraints, so they are found exactly and the constraints hold for the result.
+ */
+TEST(EUTelMillepedeSolverTest, LagrangeConstraint) {
+
+	double const abs_err = 1e-4;
+	//sum offset = 0 and sum z*offset = 0
+	std::vector<double> const offset = {0.03, -0.04, -0.01, 0.02};
+
+	EUTelMillepedeSolver solver;
+	fillTracks(solver, offset, 100);
+	solver.addConstraint( {1, 2, 3, 4}, {1., 1., 1., 1.}, 0. );
+	solver.addConstraint( {1, 2, 3, 4}, planeZ, 0. );
+	ASSERT_TRUE( solver.solve() );
+
+	double sum = 0, shear = 0;
+	for(int iPlane = 0; iPlane < 4; iPlane++) {
+		ASSERT_NEAR( solver.getValue(iPlane + 1), offset[iPlane], abs_err );
+		sum += solver.getValue(iPlane + 1);
+		shear += planeZ[iPlane]*solver.getValue(iPlane + 1);
+	}
+	ASSERT_NEAR( sum, 0, 1e-9 );
+	ASSERT_NEAR( shear, 0, 1e-6 );
+	ASSERT_EQ( solver.getNdf(), 100*4 - 100*2 - 4 + 2 );
+	ASSERT_EQ( solver.getNumberOfSkippedConstraints(), 0 );
+
+	//without the constraints the weak modes make the system singular
+	EUTelMillepedeSolver unconstrained;
+	fillTracks(unconstrained, offset, 100);
+	ASSERT_FALSE( unconstrained.solve() );
+}
+
+/** A pre-sigma adds a Gaussian constraint around the start value: with a tiny pre-sigma the parameter stays at
+ *  the start value, the other offsets follow.
+ */
+TEST(EUTelMillepedeSolverTest, PreSigma) {
+
+	double const abs_err = 1e-4;
+	std::vector<double> const offset = {0., 0.05, -0.03, 0.};
+
+	EUTelMillepedeSolver solver;
+	fillTracks(solver, offset, 100);
+	solver.setParameter(1, 0., 1e-9);
+	solver.setParameter(4, 0., 1e-9);
+	ASSERT_TRUE( solver.solve() );
+
+	ASSERT_NEAR( solver.getValue(1), 0, abs_err );
+	ASSERT_NEAR( solver.getValue(2), 0.05, abs_err );
+	ASSERT_NEAR( solver.getValue(3), -0.03, abs_err );
+	ASSERT_NEAR( solver.getValue(4), 0, abs_err );
+}
+
+/** A constraint on labels which are never measured has no free parameter. It is skipped instead of making the
+ *  system singular and its labels stay at their start values.
+ */
+TEST(EUTelMillepedeSolverTest, ConstraintWithoutFreeParameter) {
+
+	double const abs_err = 1e-4;
+	std::vector<double> const offset = {0., 0.05, -0.03, 0.};
+
+	EUTelMillepedeSolver solver;
+	fillTracks(solver, offset, 100);
+	solver.setParameter(1, 0., -1.);
+	solver.setParameter(4, 0., -1.);
+	solver.setParameter(98, 0.5, 0.);
+	solver.addConstraint( {98, 99}, {1., 1.}, 1. );
+	ASSERT_TRUE( solver.solve() );
+
+	ASSERT_EQ( solver.getNumberOfSkippedConstraints(), 1 );
+	ASSERT_DOUBLE_EQ( solver.getValue(98), 0.5 );
+	ASSERT_DOUBLE_EQ( solver.getValue(99), 0. );
+	ASSERT_NEAR( solver.getValue(2), 0.05, abs_err );
+	ASSERT_NEAR( solver.getValue(3), -0.03, abs_err );
+}
+
+/** Tracks with fewer measurements than local parameters are rejected and do not enter the fit.
+ */
+TEST(EUTelMillepedeSolverTest, RejectedTrack) {
+
+	EUTelMillepedeSolver solver;
+	float derLC[2] = {1.f, 0.f};
+	float derGL[1] = {1.f};
+	int label[1] = {1};
+	solver.mille(2, derLC, 1, derGL, label, 0.1f, 0.01f);
+	solver.end();
+
+	ASSERT_EQ( solver.getNumberOfTracks(), 0 );
+	ASSERT_EQ( solver.getNumberOfRejectedTracks(), 1 );
+}
@@ -0,0 +1,144 @@
+//STL
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+//GTest
+#include "gtest/gtest.h"
+
+//EUTelescope
+#include "EUTelTrackClusterAssociation.h"
+
+using eutelescope::EUTelAffineTransform3D;
+using eutelescope::EUTelHitGrid2D;
+using eutelescope::EUTelPixelMask;
+
+/** The mask must give the same answers as a scan over the list of masked pixels, also for pixels outside of the
+ *  sensor and for duplicated entries.
+ */
+TEST(EUTelPixelMaskTest, CompareWithScan) {
+
+	int const nColumns = 130, nRows = 70;
+	double const xPitch = 0.0184, yPitch = 0.0184;
+	std::default_random_engine generator( 2017 );
+	std::uniform_int_distribution<int> column(-3, nColumns + 2);
+	std::uniform_int_distribution<int> row(-3, nRows + 2);
+	std::uniform_real_distribution<double> posX(-0.1, nColumns*xPitch + 0.1);
+	std::uniform_real_distribution<double> posY(-0.1, nRows*yPitch + 0.1);
+	std::uniform_real_distribution<double> distance(0.001, 0.08);
+
+	EUTelPixelMask mask;
+	mask.reset(nColumns, nRows, xPitch, yPitch);
+	std::vector< std::pair<int,int> > masked;
+	for(int i = 0; i < 150; i++) {
+		std::pair<int,int> pixel( column(generator), row(generator) );
+		masked.push_back(pixel);
+		mask.mask(pixel.first, pixel.second);
+	}
+	mask.mask(masked[0].first, masked[0].second);
+
+	for(auto const & pixel: masked) {
+		ASSERT_TRUE( mask.isMasked(pixel.first, pixel.second) );
+	}
+	ASSERT_FALSE( mask.isMasked(nColumns + 10, nRows + 10) );
+
+	for(int iQuery = 0; iQuery < 5000; iQuery++) {
+		double x = posX(generator), y = posY(generator), d = distance(generator);
+		bool nearPixel = false, nearColumn = false;
+		for(auto const & pixel: masked) {
+			double dx = std::abs( x - (pixel.first*xPitch + xPitch/2.) );
+			double dy = std::abs( y - (pixel.second*yPitch + yPitch/2.) );
+			nearColumn = nearColumn || dx < d;
+			nearPixel = nearPixel || ( dx < d && dy < d );
+		}
+		ASSERT_EQ( mask.isNearMaskedPixel(x, y, d), nearPixel ) << "x " << x << " y " << y << " d " << d;
+		ASSERT_EQ( mask.isNearMaskedColumn(x, d), nearColumn ) << "x " << x << " d " << d;
+	}
+}
+
+/** The grid query must return the same hits as a loop over all the hits, in increasing index order.
+ */
+TEST(EUTelHitGrid2DTest, CompareWithScan) {
+
+	std::default_random_engine generator( 42 );
+	std::uniform_real_distribution<double> pos(-10, 10);
+	std::uniform_real_distribution<double> distance(0, 1.5);
+
+	std::vector<double> x, y;
+	EUTelHitGrid2D grid;
+	for(int i = 0; i < 300; i++) {
+		x.push_back( pos(generator) );
+		y.push_back( pos(generator) );
+		grid.add(x.back(), y.back(), i);
+	}
+	grid.add(NAN, 0., 300);
+	grid.build(0.5);
+	ASSERT_EQ( grid.size(), 300u );
+
+	std::vector<int> found;
+	for(int iQuery = 0; iQuery < 2000; iQuery++) {
+		double qx = 1.2*pos(generator), qy = 1.2*pos(generator), d = distance(generator);
+		std::vector<int> expected;
+		for(size_t i = 0; i < x.size(); i++) {
+			if( std::abs(x[i] - qx) <= d && std::abs(y[i] - qy) <= d ) expected.push_back( static_cast<int>(i) );
+		}
+		grid.query(qx, qy, d, found);
+		ASSERT_EQ( found, expected ) << "x " << qx << " y " << qy << " d " << d;
+	}
+}
+
+/** Hits far apart must not blow up the number of cells, which stays at a few per hit, and the queries must still
+ *  find the hits.
+ */
+TEST(EUTelHitGrid2DTest, FarApartHits) {
+
+	EUTelHitGrid2D grid;
+	grid.add(0., 0., 0);
+	grid.add(1e6, 1e6, 1);
+	grid.add(1e6, 0., 2);
+	grid.add(0.05, 0.05, 3);
+	grid.build(0.1);
+	ASSERT_LE( grid.getNumberOfCells(), 64u );
+
+	std::vector<int> found;
+	grid.query(0., 0., 0.1, found);
+	ASSERT_EQ( found, std::vector<int>({0, 3}) );
+	grid.query(1e6, 1e6, 0.1, found);
+	ASSERT_EQ( found, std::vector<int>({1}) );
+	grid.query(5e5, 5e5, 0.1, found);
+	ASSERT_TRUE( found.empty() );
+
+	//many hits along a line, the cells still scale with the number of hits
+	grid.clear();
+	for(int i = 0; i < 1000; i++) grid.add(i*1000., 0.5*i, i);
+	grid.build(0.01);
+	ASSERT_LE( grid.getNumberOfCells(), 4000u );
+	grid.query(5000., 2.5, 0.01, found);
+	ASSERT_EQ( found, std::vector<int>({5}) );
+}
+
+/** A chain of rotations and translations is replaced by a single affine transformation.
+ */
+TEST(EUTelAffineTransform3DTest, Chain) {
+
+	double const abs_err = 1e-12;
+	double const angle = 0.3;
+	auto chain = [angle](double const * in, double * out) {
+		double tmp[3] = { in[0] + 1., in[1] - 2., in[2] + 0.5 };
+		out[0] = std::cos(angle)*tmp[0] - std::sin(angle)*tmp[1];
+		out[1] = std::sin(angle)*tmp[0] + std::cos(angle)*tmp[1];
+		out[2] = tmp[2] - 3.;
+	};
+
+	EUTelAffineTransform3D transform;
+	double const in[3] = {0.7, -1.1, 20.};
+	double expected[3], out[3];
+	transform.apply(in, out);
+	for(int i = 0; i < 3; i++) ASSERT_EQ( out[i], in[i] );
+
+	transform.build(chain);
+	chain(in, expected);
+	transform.apply(in, out);
+	for(int i = 0; i < 3; i++) ASSERT_NEAR( out[i], expected[i], abs_err );
+}